@@ -1,17 +1,25 @@
 #version 330
 
-in vec3 position;
-in vec2 uv;
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 uv;
 
 uniform float aspect_ratio;
-uniform mat4 mvp;
+layout(std140) uniform Gst3DCamera
+{
+   mat4 view;
+   mat4 projection;
+   mat4 view_projection;
+   mat4 inverse_view_projection;
+   float time;
+};
+uniform mat4 model;
 
 out vec2 fractal_position;
 out vec2 out_uv;
 
 void main()
 {
-  gl_Position = mvp * vec4(position, 1);
+  gl_Position = view_projection * model * vec4(position, 1);
   fractal_position = vec2(position.x * 0.5 - 0.3, position.y * 0.5);
   fractal_position *= 3.5;
   /*
@@ -1,13 +1,20 @@
 #version 330
 
-in vec4 position;
-in vec3 color;
-uniform mat4 mvp;
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec3 color;
+layout(std140) uniform Gst3DCamera
+{
+   mat4 view;
+   mat4 projection;
+   mat4 view_projection;
+   mat4 inverse_view_projection;
+   float time;
+};
+uniform mat4 model;
 out vec3 out_color;
 
 void main()
 {
-   gl_Position = mvp * position;
+   gl_Position = view_projection * model * position;
    out_color = color;
 }
-
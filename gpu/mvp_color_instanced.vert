@@ -0,0 +1,20 @@
+#version 330
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec3 color;
+layout(location = 8) in mat4 instance_model;
+layout(std140) uniform Gst3DCamera
+{
+   mat4 view;
+   mat4 projection;
+   mat4 view_projection;
+   mat4 inverse_view_projection;
+   float time;
+};
+out vec3 out_color;
+
+void main()
+{
+   gl_Position = view_projection * instance_model * position;
+   out_color = color;
+}
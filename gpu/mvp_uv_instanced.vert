@@ -0,0 +1,22 @@
+#version 330
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 uv;
+layout(location = 8) in mat4 instance_model;
+layout(std140) uniform Gst3DCamera
+{
+   mat4 view;
+   mat4 projection;
+   mat4 view_projection;
+   mat4 inverse_view_projection;
+   float time;
+};
+out vec2 out_uv;
+out vec3 out_pos;
+
+void main()
+{
+   gl_Position = view_projection * instance_model * vec4(position, 1);
+   out_uv = uv;
+   out_pos = position;
+}
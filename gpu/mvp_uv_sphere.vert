@@ -0,0 +1,42 @@
+#version 330
+
+/* Sphere generated from gl_VertexID without any vertex buffers. Every
+ * instance is the triangle strip of stacks * 2 vertices between rows
+ * gl_InstanceID and gl_InstanceID + 1, slices - 1 instances in total. */
+
+layout(std140) uniform Gst3DCamera
+{
+   mat4 view;
+   mat4 projection;
+   mat4 view_projection;
+   mat4 inverse_view_projection;
+   float time;
+};
+uniform mat4 model;
+uniform float radius;
+uniform int stacks;
+uniform int slices;
+out vec2 out_uv;
+out vec3 out_pos;
+
+const float PI = 3.14159265358979;
+
+void main()
+{
+   int i = gl_InstanceID + gl_VertexID % 2;
+   int j = gl_VertexID / 2;
+
+   float I = 1.0 / float(slices - 1);
+   float J = 1.0 / float(stacks - 1);
+
+   float theta = PI * float(i) * I;
+   float phi = 2.0 * PI * float(j) * J + PI / 2.0;
+
+   vec3 position = radius * vec3(sin(theta) * cos(phi),
+                                 -cos(theta),
+                                 sin(phi) * sin(theta));
+
+   gl_Position = view_projection * model * vec4(position, 1);
+   out_uv = vec2(float(j) * J, float(i) * I);
+   out_pos = position;
+}
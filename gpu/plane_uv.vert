@@ -0,0 +1,17 @@
+#version 330
+
+/* Screen space quads drawn outside of the scene with their own ortho
+ * projection, so they do not read the camera block. */
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 uv;
+uniform mat4 mvp;
+out vec2 out_uv;
+out vec3 out_pos;
+
+void main()
+{
+   gl_Position = mvp * vec4(position, 1);
+   out_uv = uv;
+   out_pos = position;
+}
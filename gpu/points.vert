@@ -1,8 +1,15 @@
 #version 330
 
-in vec3 position;
-// in vec2 uv;
-uniform mat4 mvp;
+layout(location = 0) in vec3 position;
+// layout(location = 1) in vec2 uv;
+layout(std140) uniform Gst3DCamera
+{
+   mat4 view;
+   mat4 projection;
+   mat4 view_projection;
+   mat4 inverse_view_projection;
+   float time;
+};
 out vec2 out_uv;
 uniform sampler2D texture;
 
@@ -29,10 +36,10 @@ void main()
         pos = vec3(9999.0);
     }
     */
-   gl_Position = mvp * vec4(pos, 1.0);
+   gl_Position = view_projection * vec4(pos, 1.0);
 
 
-   //gl_Position = mvp * vec4(position, 1);
+   //gl_Position = view_projection * vec4(position, 1);
    //out_uv = uv;
 }
 
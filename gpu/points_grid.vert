@@ -0,0 +1,35 @@
+#version 330
+
+/* Point grid generated from gl_VertexID, grid_width * grid_height points
+ * in the order of gst_3d_mesh_upload_point_plane, without any vertex or
+ * index buffers. The depth of each point is sampled from the texture. */
+
+layout(std140) uniform Gst3DCamera
+{
+   mat4 view;
+   mat4 projection;
+   mat4 view_projection;
+   mat4 inverse_view_projection;
+   float time;
+};
+uniform int grid_width;
+uniform int grid_height;
+uniform sampler2D texture;
+out vec2 out_uv;
+
+void main()
+{
+   int i = gl_VertexID / grid_height;
+   int j = gl_VertexID % grid_height;
+
+   vec3 pos = vec3(-1.0 + 2.0 * float(i) / float(grid_width),
+                   -1.0 + 2.0 * float(j) / float(grid_height),
+                   0.0);
+
+   vec2 in_xy = vec2(0.5) + 0.5 * pos.xy;
+   out_uv = in_xy;
+
+   pos.z = texture2D(texture, in_xy).r;
+
+   gl_Position = view_projection * vec4(pos, 1.0);
+}
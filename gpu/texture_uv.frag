@@ -1,10 +1,40 @@
 #version 330
 
+/* Variants, selected with gst_3d_shader_new_variant:
+ *   INPUT_EQUIRECTANGULAR  sample an equirectangular video along the eye
+ *                          rays of the camera block instead of at out_uv
+ *   DEBUG_UV               show the texture coordinates */
+
 in vec2 out_uv;
 uniform sampler2D texture;
 out vec4 frag_color;
 
+#ifdef INPUT_EQUIRECTANGULAR
+layout(std140) uniform Gst3DCamera
+{
+   mat4 view;
+   mat4 projection;
+   mat4 view_projection;
+   mat4 inverse_view_projection;
+   float time;
+};
+
+const float PI = 3.1416;
+#endif
+
 void main()
 {
+#if defined(DEBUG_UV)
+  frag_color = vec4 (out_uv, 0, 1);
+#elif defined(INPUT_EQUIRECTANGULAR)
+  vec2 frag_coord = vec2 (out_uv) * 2 - 1;
+  vec4 view_dir = normalize (inverse_view_projection * vec4 (frag_coord, 1, 1));
+
+  float u = atan (view_dir.x, -view_dir.z) / (2 * PI) + 0.5;
+  float v = acos (-view_dir.y) / PI;
+
+  frag_color = texture2D (texture, vec2 (u, v));
+#else
   frag_color = texture2D (texture, out_uv);
+#endif
 }
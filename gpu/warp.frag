@@ -3,17 +3,44 @@
 #version 330
 precision highp float;
 
+/* Variants, selected with gst_3d_shader_new_variant:
+ *   HMD_DISTORTION_K       vec4 of the first OHMD_DISTORTION_K coefficients
+ *   HMD_LENS_CENTER_LEFT   vec2 lens centers in texture coordinates
+ *   HMD_LENS_CENTER_RIGHT
+ *   HMD_WARP_SCALE         vec2 scale from the warped radius to the texture
+ *   HMD_WARP_SCALE_IN      vec2 scale from the texture to the radius
+ *   STEREO_MONO            the input is one mono view shown to both eyes
+ *                          instead of side by side eyes
+ *   DEBUG_WARP             show the warped texture coordinates */
+
+#ifndef HMD_DISTORTION_K
+#define HMD_DISTORTION_K vec4(1.0, 0.22, 0.24, 0.0)
+#endif
+#ifndef HMD_LENS_CENTER_LEFT
+#define HMD_LENS_CENTER_LEFT vec2(0.25, 0.5)
+#endif
+#ifndef HMD_LENS_CENTER_RIGHT
+#define HMD_LENS_CENTER_RIGHT vec2(0.75, 0.5)
+#endif
+#ifndef HMD_WARP_SCALE
+#define HMD_WARP_SCALE vec2(0.1469278, 0.2350845)
+#endif
+#ifndef HMD_WARP_SCALE_IN
+#define HMD_WARP_SCALE_IN vec2(4.0, 2.5)
+#endif
+
 uniform sampler2D texture;
 uniform vec2 screen_size;
 
-const vec4 kappa = vec4(1.0, 0.22, 0.24, 0.0);
-// const vec4 kappa = vec4(1.0, 1.7, 0.7, 15.0);
+const vec4 kappa = HMD_DISTORTION_K;
 
+/* centers of the side by side eye viewports, given by the layout and
+ * not by the device */
 const vec2 screen_center_left = vec2(0.25, 0.5);
 const vec2 screen_center_right = vec2(0.75, 0.5);
 
-const vec2 scale = vec2(0.1469278, 0.2350845);
-const vec2 scale_in = vec2(4, 2.5);
+const vec2 scale = HMD_WARP_SCALE;
+const vec2 scale_in = HMD_WARP_SCALE_IN;
 
 in vec2 out_uv;
 out vec4 frag_color;
@@ -42,9 +69,9 @@ bool is_outside_area(vec2 tc, vec2 screen_center)
 
 void main()
 {
-	// The following two variables need to be set per eye
-	vec2 screen_center = out_uv.x < 0.5 ? screen_center_left : screen_center_right;
-	vec2 tc = hmd_warp(screen_center);
+	bool left = out_uv.x < 0.5;
+	vec2 screen_center = left ? screen_center_left : screen_center_right;
+	vec2 tc = hmd_warp(left ? HMD_LENS_CENTER_LEFT : HMD_LENS_CENTER_RIGHT);
 
 	if (is_outside_area(tc, screen_center))
 	{
@@ -53,7 +80,14 @@ void main()
 		return;
 	}
 
-  // double mono video for fake stereo
-	//tc.x = gl_FragCoord.x < center_x ? (2.0 * tc.x) : (2.0 * (tc.x - 0.5));
+#ifdef STEREO_MONO
+	// double mono video for fake stereo
+	tc.x = left ? (2.0 * tc.x) : (2.0 * (tc.x - 0.5));
+#endif
+
+#ifdef DEBUG_WARP
+	frag_color = vec4(tc, 0.0, 1.0);
+#else
 	frag_color = texture2D(texture, tc);
+#endif
 }
@@ -0,0 +1,348 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Bounding volume hierarchy over axis aligned boxes for frustum culling.
+ * The tree is built top down by splitting at the median centroid along
+ * the widest axis, and stored flat with both children of a node next to
+ * each other, after their parent. Moving boxes are handled by refitting
+ * the tree bottom up, which keeps the topology and costs one pass over
+ * the nodes.
+ *
+ * Culling tracks the frustum planes a subtree is already fully inside of,
+ * so subtrees inside the frustum are accepted without further tests.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gst3dbvh.h"
+
+#define N_PLANES 6
+#define ALL_PLANES ((1 << N_PLANES) - 1)
+
+struct Gst3DBvhNode
+{
+  gfloat min[3];
+  gfloat max[3];
+  /* first item of a leaf, left child of an inner node */
+  guint first;
+  /* number of items, 0 for inner nodes */
+  guint count;
+};
+
+struct _Gst3DBvh
+{
+  struct Gst3DBvhNode *nodes;
+  guint n_nodes;
+  guint node_capacity;
+
+  /* box indices, each leaf references a range */
+  guint *items;
+  guint count;
+
+  /* box of each item as floats and its centroid, used while building */
+  gfloat *bounds;
+  gfloat *centroids;
+};
+
+Gst3DBvh *
+gst_3d_bvh_new (void)
+{
+  return g_new0 (Gst3DBvh, 1);
+}
+
+void
+gst_3d_bvh_free (Gst3DBvh * self)
+{
+  if (!self)
+    return;
+  g_free (self->nodes);
+  g_free (self->items);
+  g_free (self->bounds);
+  g_free (self->centroids);
+  g_free (self);
+}
+
+static void
+_read_boxes (Gst3DBvh * self, const graphene_box_t * boxes)
+{
+  graphene_point3d_t min, max;
+
+  for (guint i = 0; i < self->count; i++) {
+    gfloat *b = &self->bounds[i * 6];
+    graphene_box_get_min (&boxes[i], &min);
+    graphene_box_get_max (&boxes[i], &max);
+    b[0] = min.x;
+    b[1] = min.y;
+    b[2] = min.z;
+    b[3] = max.x;
+    b[4] = max.y;
+    b[5] = max.z;
+  }
+}
+
+static void
+_fit_leaf (Gst3DBvh * self, struct Gst3DBvhNode *node)
+{
+  for (guint a = 0; a < 3; a++) {
+    node->min[a] = G_MAXFLOAT;
+    node->max[a] = -G_MAXFLOAT;
+  }
+
+  for (guint i = node->first; i < node->first + node->count; i++) {
+    const gfloat *b = &self->bounds[self->items[i] * 6];
+    for (guint a = 0; a < 3; a++) {
+      node->min[a] = MIN (node->min[a], b[a]);
+      node->max[a] = MAX (node->max[a], b[3 + a]);
+    }
+  }
+}
+
+static void
+_fit_inner (Gst3DBvh * self, struct Gst3DBvhNode *node)
+{
+  const struct Gst3DBvhNode *left = &self->nodes[node->first];
+  const struct Gst3DBvhNode *right = &self->nodes[node->first + 1];
+
+  for (guint a = 0; a < 3; a++) {
+    node->min[a] = MIN (left->min[a], right->min[a]);
+    node->max[a] = MAX (left->max[a], right->max[a]);
+  }
+}
+
+static gint
+_compare_centroids (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const gfloat *centroids = (const gfloat *) user_data;
+  gfloat ca = centroids[*(const guint *) a * 3];
+  gfloat cb = centroids[*(const guint *) b * 3];
+  return ca < cb ? -1 : (ca > cb ? 1 : 0);
+}
+
+static void
+_split (Gst3DBvh * self, guint index)
+{
+  struct Gst3DBvhNode *node = &self->nodes[index];
+
+  _fit_leaf (self, node);
+  if (node->count <= GST_3D_BVH_LEAF_SIZE)
+    return;
+
+  gfloat cmin[3] = { G_MAXFLOAT, G_MAXFLOAT, G_MAXFLOAT };
+  gfloat cmax[3] = { -G_MAXFLOAT, -G_MAXFLOAT, -G_MAXFLOAT };
+  for (guint i = node->first; i < node->first + node->count; i++) {
+    const gfloat *c = &self->centroids[self->items[i] * 3];
+    for (guint a = 0; a < 3; a++) {
+      cmin[a] = MIN (cmin[a], c[a]);
+      cmax[a] = MAX (cmax[a], c[a]);
+    }
+  }
+
+  guint axis = 0;
+  for (guint a = 1; a < 3; a++)
+    if (cmax[a] - cmin[a] > cmax[axis] - cmin[axis])
+      axis = a;
+
+  g_qsort_with_data (&self->items[node->first], node->count, sizeof (guint),
+      _compare_centroids, self->centroids + axis);
+
+  guint first = node->first;
+  guint half = node->count / 2;
+  guint count = node->count;
+  guint left = self->n_nodes;
+  self->n_nodes += 2;
+
+  node->first = left;
+  node->count = 0;
+
+  self->nodes[left].first = first;
+  self->nodes[left].count = half;
+  self->nodes[left + 1].first = first + half;
+  self->nodes[left + 1].count = count - half;
+
+  _split (self, left);
+  _split (self, left + 1);
+
+  _fit_inner (self, &self->nodes[index]);
+}
+
+/* Builds the tree over @count boxes. Box i is reported as index i by
+ * gst_3d_bvh_cull. */
+void
+gst_3d_bvh_build (Gst3DBvh * self, const graphene_box_t * boxes, guint count)
+{
+  self->count = count;
+  self->n_nodes = 0;
+  if (count == 0)
+    return;
+
+  /* a binary tree with single item leaves has 2n - 1 nodes */
+  guint capacity = 2 * count - 1;
+  if (capacity > self->node_capacity) {
+    self->nodes = g_renew (struct Gst3DBvhNode, self->nodes, capacity);
+    self->node_capacity = capacity;
+  }
+
+  self->items = g_renew (guint, self->items, count);
+  self->bounds = g_renew (gfloat, self->bounds, (gsize) count * 6);
+  self->centroids = g_renew (gfloat, self->centroids, (gsize) count * 3);
+
+  _read_boxes (self, boxes);
+  for (guint i = 0; i < count; i++) {
+    self->items[i] = i;
+    for (guint a = 0; a < 3; a++)
+      self->centroids[i * 3 + a] =
+          (self->bounds[i * 6 + a] + self->bounds[i * 6 + 3 + a]) * 0.5f;
+  }
+
+  self->nodes[0].first = 0;
+  self->nodes[0].count = count;
+  self->n_nodes = 1;
+  _split (self, 0);
+}
+
+/* Updates the node bounds to moved @boxes, in the order passed to
+ * gst_3d_bvh_build. Culling stays correct, but the tree gets less tight
+ * the further boxes move from where they were at build time. */
+void
+gst_3d_bvh_refit (Gst3DBvh * self, const graphene_box_t * boxes)
+{
+  _read_boxes (self, boxes);
+
+  /* children are stored after their parent */
+  for (guint i = self->n_nodes; i-- > 0;) {
+    struct Gst3DBvhNode *node = &self->nodes[i];
+    if (node->count)
+      _fit_leaf (self, node);
+    else
+      _fit_inner (self, node);
+  }
+}
+
+guint
+gst_3d_bvh_get_count (Gst3DBvh * self)
+{
+  return self->count;
+}
+
+/* Classifies the box against the planes in @mask. Returns FALSE if it is
+ * outside of one of them, otherwise clears the planes it is fully
+ * inside of from @mask. */
+static gboolean
+_test_planes (const gfloat * min, const gfloat * max, const gfloat * planes,
+    guint * mask)
+{
+  for (guint p = 0; p < N_PLANES; p++) {
+    if (!(*mask & (1 << p)))
+      continue;
+
+    const gfloat *plane = &planes[p * 4];
+    gfloat outer = plane[3], inner = plane[3];
+    for (guint a = 0; a < 3; a++) {
+      if (plane[a] > 0.f) {
+        outer += plane[a] * max[a];
+        inner += plane[a] * min[a];
+      } else {
+        outer += plane[a] * min[a];
+        inner += plane[a] * max[a];
+      }
+    }
+
+    if (outer < 0.f)
+      return FALSE;
+    if (inner >= 0.f)
+      *mask &= ~(1 << p);
+  }
+  return TRUE;
+}
+
+static void
+_mark_subtree (Gst3DBvh * self, guint index, guint8 * visible)
+{
+  const struct Gst3DBvhNode *node = &self->nodes[index];
+
+  if (node->count) {
+    for (guint i = node->first; i < node->first + node->count; i++)
+      visible[self->items[i]] = TRUE;
+    return;
+  }
+
+  _mark_subtree (self, node->first, visible);
+  _mark_subtree (self, node->first + 1, visible);
+}
+
+static guint
+_cull (Gst3DBvh * self, guint index, const gfloat * planes, guint mask,
+    guint8 * visible)
+{
+  const struct Gst3DBvhNode *node = &self->nodes[index];
+
+  if (!_test_planes (node->min, node->max, planes, &mask))
+    return 1;
+
+  if (mask == 0) {
+    _mark_subtree (self, index, visible);
+    return 1;
+  }
+
+  if (node->count) {
+    guint tests = 1;
+    for (guint i = node->first; i < node->first + node->count; i++) {
+      const gfloat *b = &self->bounds[self->items[i] * 6];
+      guint item_mask = mask;
+      visible[self->items[i]] = _test_planes (b, b + 3, planes, &item_mask);
+      tests++;
+    }
+    return tests;
+  }
+
+  return 1 + _cull (self, node->first, planes, mask, visible)
+      + _cull (self, node->first + 1, planes, mask, visible);
+}
+
+/* Sets visible[i] for every box intersecting @frustum and clears it for
+ * the others. @visible holds one entry per box. Returns the number of
+ * box tests done, for statistics. */
+guint
+gst_3d_bvh_cull (Gst3DBvh * self, const graphene_frustum_t * frustum,
+    guint8 * visible)
+{
+  graphene_plane_t frustum_planes[N_PLANES];
+  gfloat planes[N_PLANES * 4];
+
+  if (self->count == 0)
+    return 0;
+
+  graphene_frustum_get_planes (frustum, frustum_planes);
+  for (guint p = 0; p < N_PLANES; p++) {
+    graphene_vec3_t normal;
+    graphene_plane_get_normal (&frustum_planes[p], &normal);
+    planes[p * 4] = graphene_vec3_get_x (&normal);
+    planes[p * 4 + 1] = graphene_vec3_get_y (&normal);
+    planes[p * 4 + 2] = graphene_vec3_get_z (&normal);
+    planes[p * 4 + 3] = graphene_plane_get_constant (&frustum_planes[p]);
+  }
+
+  memset (visible, 0, self->count);
+  return _cull (self, 0, planes, ALL_PLANES, visible);
+}
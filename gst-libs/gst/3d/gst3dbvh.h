@@ -0,0 +1,46 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_BVH_H__
+#define __GST_3D_BVH_H__
+
+#include <glib.h>
+#include <graphene.h>
+
+G_BEGIN_DECLS
+
+/* maximum number of boxes in a leaf */
+#define GST_3D_BVH_LEAF_SIZE 4
+
+typedef struct _Gst3DBvh Gst3DBvh;
+
+Gst3DBvh *gst_3d_bvh_new (void);
+void gst_3d_bvh_free (Gst3DBvh * self);
+
+void gst_3d_bvh_build (Gst3DBvh * self, const graphene_box_t * boxes,
+    guint count);
+void gst_3d_bvh_refit (Gst3DBvh * self, const graphene_box_t * boxes);
+guint gst_3d_bvh_get_count (Gst3DBvh * self);
+
+guint gst_3d_bvh_cull (Gst3DBvh * self, const graphene_frustum_t * frustum,
+    guint8 * visible);
+
+G_END_DECLS
+#endif /* __GST_3D_BVH_H__ */
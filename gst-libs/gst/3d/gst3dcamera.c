@@ -92,15 +92,13 @@ gst_3d_camera_navigation_event (Gst3DCamera * self, GstEvent * event)
 void
 gst_3d_camera_update_view_mvp (Gst3DCamera * self)
 {
-  graphene_matrix_t projection_matrix;
-  graphene_matrix_init_perspective (&projection_matrix,
+  graphene_matrix_init_perspective (&self->projection,
       self->fov, self->aspect, self->znear, self->zfar);
 
-  graphene_matrix_t view_matrix;
-  graphene_matrix_init_look_at (&view_matrix, &self->eye, &self->center,
+  graphene_matrix_init_look_at (&self->view, &self->eye, &self->center,
       &self->up);
 
-  graphene_matrix_multiply (&view_matrix, &projection_matrix, &self->mvp);
+  graphene_matrix_multiply (&self->view, &self->projection, &self->mvp);
 }
 
 void
@@ -41,7 +41,10 @@ struct _Gst3DCamera
   /*< private > */
   GstObject parent;
 
+  /* view projection, the product of view and projection */
   graphene_matrix_t mvp;
+  graphene_matrix_t view;
+  graphene_matrix_t projection;
 
   /* position */
   graphene_vec3_t eye;
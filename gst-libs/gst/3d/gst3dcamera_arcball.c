@@ -130,8 +130,7 @@ gst_3d_camera_arcball_update_view (Gst3DCamera * cam)
       radius * -cos (self->theta),
       radius * sin (self->theta) * sin (self->phi));
 
-  graphene_matrix_t projection_matrix;
-  graphene_matrix_init_perspective (&projection_matrix,
+  graphene_matrix_init_perspective (&cam->projection,
       cam->fov, cam->aspect, cam->znear, cam->zfar);
 
   graphene_matrix_t view_matrix;
@@ -140,11 +139,10 @@ gst_3d_camera_arcball_update_view (Gst3DCamera * cam)
 
   /* fix graphene look at */
   graphene_matrix_t v_inverted;
-  graphene_matrix_t v_inverted_fix;
   graphene_matrix_inverse (&view_matrix, &v_inverted);
-  gst_3d_math_matrix_negate_component (&v_inverted, 3, 2, &v_inverted_fix);
+  gst_3d_math_matrix_negate_component (&v_inverted, 3, 2, &cam->view);
 
-  graphene_matrix_multiply (&v_inverted_fix, &projection_matrix, &cam->mvp);
+  graphene_matrix_multiply (&cam->view, &cam->projection, &cam->mvp);
 }
 
 static void
@@ -50,7 +50,7 @@ static void gst_3d_camera_hmd_update_view (Gst3DCamera * self);
 void
 gst_3d_camera_hmd_init (Gst3DCameraHmd * self)
 {
-  self->hmd = gst_3d_hmd_new ();
+  self->hmd = gst_3d_hmd_get_default ();
   self->query_type = HMD_QUERY_TYPE_MATRIX_STEREO;
   self->update_view_funct = &gst_3d_camera_hmd_update_view_from_matrix;
 }
@@ -91,6 +91,23 @@ gst_3d_camera_hmd_update_view (Gst3DCamera * cam)
   self->update_view_funct (self);
 }
 
+static void
+_set_eyes (Gst3DCameraHmd * self, const graphene_matrix_t * left_view,
+    const graphene_matrix_t * left_projection,
+    const graphene_matrix_t * right_view,
+    const graphene_matrix_t * right_projection)
+{
+  self->left_view_matrix = *left_view;
+  self->left_projection_matrix = *left_projection;
+  self->right_view_matrix = *right_view;
+  self->right_projection_matrix = *right_projection;
+
+  graphene_matrix_multiply (left_view, left_projection,
+      &self->left_vp_matrix);
+  graphene_matrix_multiply (right_view, right_projection,
+      &self->right_vp_matrix);
+}
+
 void
 gst_3d_camera_hmd_update_view_from_quaternion (Gst3DCameraHmd * self)
 {
@@ -108,10 +125,8 @@ gst_3d_camera_hmd_update_view_from_quaternion (Gst3DCameraHmd * self)
   graphene_quaternion_to_matrix (&quat, &right_eye_model_view);
   graphene_quaternion_to_matrix (&quat, &left_eye_model_view);
 
-  graphene_matrix_multiply (&left_eye_model_view, &left_eye_projection,
-      &self->left_vp_matrix);
-  graphene_matrix_multiply (&right_eye_model_view, &right_eye_projection,
-      &self->right_vp_matrix);
+  _set_eyes (self, &left_eye_model_view, &left_eye_projection,
+      &right_eye_model_view, &right_eye_projection);
 }
 
 void
@@ -146,10 +161,8 @@ gst_3d_camera_hmd_update_view_from_quaternion_stereo (Gst3DCameraHmd * self)
   graphene_matrix_multiply (&left_eye_model_view, &translate_left,
       &left_eye_model_view);
 
-  graphene_matrix_multiply (&left_eye_model_view, &left_eye_projection,
-      &self->left_vp_matrix);
-  graphene_matrix_multiply (&right_eye_model_view, &right_eye_projection,
-      &self->right_vp_matrix);
+  _set_eyes (self, &left_eye_model_view, &left_eye_projection,
+      &right_eye_model_view, &right_eye_projection);
 }
 
 void
@@ -186,10 +199,8 @@ gst_3d_camera_hmd_update_view_from_matrix (Gst3DCameraHmd * self)
   _matrix_invert_y_rotation (&left_eye_model_view, &left_eye_model_view_inv);
   _matrix_invert_y_rotation (&right_eye_model_view, &right_eye_model_view_inv);
 
-  graphene_matrix_multiply (&right_eye_model_view_inv, &left_eye_projection,
-      &self->left_vp_matrix);
-  graphene_matrix_multiply (&left_eye_model_view_inv, &right_eye_projection,
-      &self->right_vp_matrix);
+  _set_eyes (self, &right_eye_model_view_inv, &left_eye_projection,
+      &left_eye_model_view_inv, &right_eye_projection);
 
 }
 
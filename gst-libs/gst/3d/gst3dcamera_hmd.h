@@ -53,6 +53,12 @@ struct _Gst3DCameraHmd
   
   graphene_matrix_t left_vp_matrix;
   graphene_matrix_t right_vp_matrix;
+
+  /* factors of the view projections above */
+  graphene_matrix_t left_view_matrix;
+  graphene_matrix_t left_projection_matrix;
+  graphene_matrix_t right_view_matrix;
+  graphene_matrix_t right_projection_matrix;
   
   Gst3DHmdQueryType query_type;
   
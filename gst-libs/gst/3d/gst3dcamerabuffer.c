@@ -0,0 +1,227 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Per frame camera data in one uniform buffer, holding a Gst3DCameraBlock
+ * for each eye. The blocks are written on the CPU as the cameras change
+ * and uploaded with a single BufferSubData per frame. Drawing an eye only
+ * binds its block range to GST_3D_CAMERA_BUFFER_BINDING, so the view and
+ * projection are shared by every program without any per draw uniform
+ * upload.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gl/gl.h>
+#include <gst/gl/gstglfuncs.h>
+
+#include "gst3dcamerabuffer.h"
+#include "gst3dmemory.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_3d_camera_buffer_debug);
+#define GST_CAT_DEFAULT gst_3d_camera_buffer_debug
+
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER 0x8A11
+#endif
+#ifndef GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+#define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#endif
+#ifndef GL_INVALID_INDEX
+#define GL_INVALID_INDEX 0xFFFFFFFFu
+#endif
+
+typedef void (GSTGLAPI * Gst3DBindBufferRange) (GLenum target, GLuint index,
+    GLuint buffer, GLintptr offset, GLsizeiptr size);
+typedef GLuint (GSTGLAPI * Gst3DGetUniformBlockIndex) (GLuint program,
+    const GLchar * name);
+typedef void (GSTGLAPI * Gst3DUniformBlockBinding) (GLuint program,
+    GLuint block_index, GLuint binding);
+
+struct _Gst3DCameraBuffer
+{
+  GstGLContext *context;
+
+  GLuint ubo;
+  /* size of one block rounded up to the offset alignment */
+  gsize stride;
+  guint8 *data;
+  gboolean dirty;
+
+  Gst3DBindBufferRange bind_buffer_range;
+};
+
+static void
+_init_debug (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    GST_DEBUG_CATEGORY_INIT (gst_3d_camera_buffer_debug, "3dcamerabuffer", 0,
+        "camera uniform buffer");
+    g_once_init_leave (&initialized, 1);
+  }
+}
+
+static Gst3DCameraBlock *
+_get_block (Gst3DCameraBuffer * self, guint eye)
+{
+  return (Gst3DCameraBlock *) (self->data + eye * self->stride);
+}
+
+Gst3DCameraBuffer *
+gst_3d_camera_buffer_new (GstGLContext * context)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+
+  GstGLFuncs *gl = context->gl_vtable;
+  GLint alignment = 0;
+
+  _init_debug ();
+
+  Gst3DCameraBuffer *self = g_new0 (Gst3DCameraBuffer, 1);
+  self->context = gst_object_ref (context);
+  self->bind_buffer_range = (Gst3DBindBufferRange)
+      gst_gl_context_get_proc_address (context, "glBindBufferRange");
+
+  gl->GetIntegerv (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  alignment = MAX (alignment, 16);
+  self->stride = (sizeof (Gst3DCameraBlock) + alignment - 1)
+      / alignment * alignment;
+  self->data = g_malloc0 (self->stride * GST_3D_CAMERA_BUFFER_EYES);
+
+  graphene_matrix_t identity;
+  graphene_matrix_init_identity (&identity);
+  for (guint eye = 0; eye < GST_3D_CAMERA_BUFFER_EYES; eye++)
+    gst_3d_camera_buffer_set_eye (self, eye, &identity, &identity);
+
+  gl->GenBuffers (1, &self->ubo);
+  gl->BindBuffer (GL_UNIFORM_BUFFER, self->ubo);
+  gl->BufferData (GL_UNIFORM_BUFFER, self->stride * GST_3D_CAMERA_BUFFER_EYES,
+      self->data, GL_DYNAMIC_DRAW);
+  gl->BindBuffer (GL_UNIFORM_BUFFER, 0);
+  gst_3d_memory_alloc (context, GST_3D_MEMORY_BUFFER,
+      self->stride * GST_3D_CAMERA_BUFFER_EYES);
+  self->dirty = FALSE;
+
+  GST_DEBUG ("camera buffer with %" G_GSIZE_FORMAT " bytes per eye",
+      self->stride);
+
+  return self;
+}
+
+void
+gst_3d_camera_buffer_free (Gst3DCameraBuffer * self)
+{
+  if (!self)
+    return;
+
+  GstGLFuncs *gl = self->context->gl_vtable;
+  gl->DeleteBuffers (1, &self->ubo);
+  gst_3d_memory_release (self->context, GST_3D_MEMORY_BUFFER,
+      self->stride * GST_3D_CAMERA_BUFFER_EYES);
+
+  gst_object_unref (self->context);
+  g_free (self->data);
+  g_free (self);
+}
+
+/* The view projection and its inverse are derived here, once per eye and
+ * frame, instead of in the shaders. */
+void
+gst_3d_camera_buffer_set_eye (Gst3DCameraBuffer * self, guint eye,
+    const graphene_matrix_t * view, const graphene_matrix_t * projection)
+{
+  g_return_if_fail (eye < GST_3D_CAMERA_BUFFER_EYES);
+
+  Gst3DCameraBlock *block = _get_block (self, eye);
+  graphene_matrix_t view_projection, inverse;
+
+  graphene_matrix_multiply (view, projection, &view_projection);
+  if (!graphene_matrix_inverse (&view_projection, &inverse))
+    graphene_matrix_init_identity (&inverse);
+
+  graphene_matrix_to_float (view, block->view);
+  graphene_matrix_to_float (projection, block->projection);
+  graphene_matrix_to_float (&view_projection, block->view_projection);
+  graphene_matrix_to_float (&inverse, block->inverse_view_projection);
+  self->dirty = TRUE;
+}
+
+void
+gst_3d_camera_buffer_set_time (Gst3DCameraBuffer * self, gfloat seconds)
+{
+  for (guint eye = 0; eye < GST_3D_CAMERA_BUFFER_EYES; eye++)
+    _get_block (self, eye)->time = seconds;
+  self->dirty = TRUE;
+}
+
+/* Uploads all eyes at once if anything changed since the last upload. */
+void
+gst_3d_camera_buffer_upload (Gst3DCameraBuffer * self)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  if (!self->dirty)
+    return;
+
+  gl->BindBuffer (GL_UNIFORM_BUFFER, self->ubo);
+  gl->BufferSubData (GL_UNIFORM_BUFFER, 0,
+      self->stride * GST_3D_CAMERA_BUFFER_EYES, self->data);
+  gl->BindBuffer (GL_UNIFORM_BUFFER, 0);
+  self->dirty = FALSE;
+}
+
+/* Makes the block of @eye the one read by all programs. */
+void
+gst_3d_camera_buffer_bind (Gst3DCameraBuffer * self, guint eye)
+{
+  g_return_if_fail (eye < GST_3D_CAMERA_BUFFER_EYES);
+
+  if (!self->bind_buffer_range)
+    return;
+
+  self->bind_buffer_range (GL_UNIFORM_BUFFER, GST_3D_CAMERA_BUFFER_BINDING,
+      self->ubo, eye * self->stride, sizeof (Gst3DCameraBlock));
+}
+
+/* GLSL 330 can not set block bindings in the shader, so every linked
+ * program using the block is pointed at the binding here. */
+void
+gst_3d_camera_buffer_bind_program (GstGLContext * context, guint program)
+{
+  Gst3DGetUniformBlockIndex get_uniform_block_index =
+      (Gst3DGetUniformBlockIndex) gst_gl_context_get_proc_address (context,
+      "glGetUniformBlockIndex");
+  Gst3DUniformBlockBinding uniform_block_binding =
+      (Gst3DUniformBlockBinding) gst_gl_context_get_proc_address (context,
+      "glUniformBlockBinding");
+
+  if (!get_uniform_block_index || !uniform_block_binding)
+    return;
+
+  GLuint index = get_uniform_block_index (program, GST_3D_CAMERA_BUFFER_BLOCK);
+  if (index != GL_INVALID_INDEX)
+    uniform_block_binding (program, index, GST_3D_CAMERA_BUFFER_BINDING);
+}
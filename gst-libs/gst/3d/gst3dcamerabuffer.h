@@ -0,0 +1,73 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_CAMERA_BUFFER_H__
+#define __GST_3D_CAMERA_BUFFER_H__
+
+#include <gst/gst.h>
+#include <gst/gl/gstgl_fwd.h>
+#include <graphene.h>
+
+G_BEGIN_DECLS
+
+/* Uniform block shared by the vertex shaders in gpu/, bound to
+ * GST_3D_CAMERA_BUFFER_BINDING by gst_3d_camera_buffer_bind_program */
+#define GST_3D_CAMERA_BUFFER_BLOCK "Gst3DCamera"
+#define GST_3D_CAMERA_BUFFER_BINDING 0
+#define GST_3D_CAMERA_BUFFER_EYES 2
+
+/* std140 layout of the block, matrices in the order of
+ * graphene_matrix_to_float:
+ *
+ *   layout(std140) uniform Gst3DCamera
+ *   {
+ *      mat4 view;
+ *      mat4 projection;
+ *      mat4 view_projection;
+ *      mat4 inverse_view_projection;
+ *      float time;
+ *   };
+ */
+typedef struct
+{
+  gfloat view[16];
+  gfloat projection[16];
+  gfloat view_projection[16];
+  gfloat inverse_view_projection[16];
+  gfloat time;
+  gfloat padding[3];
+} Gst3DCameraBlock;
+
+typedef struct _Gst3DCameraBuffer Gst3DCameraBuffer;
+
+Gst3DCameraBuffer *gst_3d_camera_buffer_new (GstGLContext * context);
+void gst_3d_camera_buffer_free (Gst3DCameraBuffer * self);
+
+void gst_3d_camera_buffer_set_eye (Gst3DCameraBuffer * self, guint eye,
+    const graphene_matrix_t * view, const graphene_matrix_t * projection);
+void gst_3d_camera_buffer_set_time (Gst3DCameraBuffer * self, gfloat seconds);
+void gst_3d_camera_buffer_upload (Gst3DCameraBuffer * self);
+void gst_3d_camera_buffer_bind (Gst3DCameraBuffer * self, guint eye);
+
+void gst_3d_camera_buffer_bind_program (GstGLContext * context,
+    guint program);
+
+G_END_DECLS
+#endif /* __GST_3D_CAMERA_BUFFER_H__ */
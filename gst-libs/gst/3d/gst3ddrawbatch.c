@@ -0,0 +1,567 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Packs static meshes sharing one interleaved vertex format and index
+ * type into shared vertex and index buffers, so all meshes drawn with one
+ * shader are submitted with a single MultiDrawElementsIndirect. Each
+ * command draws all instances of one mesh, the per instance model matrix
+ * is read from the instanced array at GST_3D_MESH_INSTANCE_LOCATION
+ * starting at the base instance of the command. Vertex attributes use the
+ * fixed locations of gst_3d_mesh_attribute_location, so packing does not
+ * depend on the program.
+ *
+ * Without indirect draws (GL 3.3) the commands are issued in a loop of
+ * DrawElementsInstanced, emulating base vertex and base instance by
+ * offsetting the attribute pointers of the shared VAO.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gl/gl.h>
+#include <gst/gl/gstglfuncs.h>
+
+#include "gst3ddrawbatch.h"
+#include "gst3dmemory.h"
+#include "gst3dglstate.h"
+
+#define GST_CAT_DEFAULT gst_3d_draw_batch_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#ifndef GL_COPY_READ_BUFFER
+#define GL_COPY_READ_BUFFER 0x8F36
+#endif
+#ifndef GL_COPY_WRITE_BUFFER
+#define GL_COPY_WRITE_BUFFER 0x8F37
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+#define INSTANCE_VECTOR_LENGTH 16
+
+typedef void (GSTGLAPI * Gst3DMultiDrawElementsIndirect) (GLenum mode,
+    GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+/* layout defined by GL for DrawElementsIndirect */
+struct Gst3DDrawCommand
+{
+  GLuint count;
+  GLuint instance_count;
+  GLuint first_index;
+  GLint base_vertex;
+  GLuint base_instance;
+};
+
+struct Gst3DDrawBatchEntry
+{
+  Gst3DMesh *mesh;
+  guint base_vertex;
+  guint first_index;
+  guint index_count;
+  /* model matrices pushed since the last flush */
+  GArray *transforms;
+};
+
+struct _Gst3DDrawBatch
+{
+  GstGLContext *context;
+  Gst3DShader *shader;
+
+  /* format of the first packed mesh, struct Gst3DAttributeBuffer */
+  GArray *attributes;
+  gsize stride;
+  GLenum index_type;
+  gsize index_size;
+  GLenum draw_mode;
+
+  GLuint vao;
+  GLuint vbo_vertices;
+  GLuint vbo_indices;
+  GLuint vbo_instances;
+  GLuint indirect;
+
+  gsize vertex_capacity;
+  gsize vertex_used;
+  gsize index_capacity;
+  gsize index_used;
+  gsize instance_capacity;
+  gsize indirect_capacity;
+
+  GArray *entries;
+  GHashTable *lookup;
+
+  GArray *commands;
+  GArray *instance_data;
+
+  Gst3DMultiDrawElementsIndirect multi_draw;
+
+  /* bytes reported to gst3dmemory */
+  gsize gpu_bytes;
+};
+
+static void
+_init_debug (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    GST_DEBUG_CATEGORY_INIT (gst_3d_draw_batch_debug, "3ddrawbatch", 0,
+        "draw batch");
+    g_once_init_leave (&initialized, 1);
+  }
+}
+
+static Gst3DMultiDrawElementsIndirect
+_get_multi_draw (GstGLContext * context)
+{
+  /* base instance is needed to offset the instanced array per command */
+  if (!gst_gl_context_check_gl_version (context, GST_GL_API_OPENGL3, 4, 3)
+      && !(gst_gl_context_check_feature (context,
+              "GL_ARB_multi_draw_indirect")
+          && gst_gl_context_check_feature (context, "GL_ARB_base_instance")))
+    return NULL;
+
+  return (Gst3DMultiDrawElementsIndirect)
+      gst_gl_context_get_proc_address (context, "glMultiDrawElementsIndirect");
+}
+
+Gst3DDrawBatch *
+gst_3d_draw_batch_new (GstGLContext * context, Gst3DShader * shader)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+  g_return_val_if_fail (shader != NULL, NULL);
+
+  _init_debug ();
+
+  GstGLFuncs *gl = context->gl_vtable;
+  Gst3DDrawBatch *self = g_new0 (Gst3DDrawBatch, 1);
+  self->context = gst_object_ref (context);
+  self->shader = gst_object_ref (shader);
+
+  self->attributes = g_array_new (FALSE, FALSE,
+      sizeof (struct Gst3DAttributeBuffer));
+  self->entries = g_array_new (FALSE, FALSE,
+      sizeof (struct Gst3DDrawBatchEntry));
+  self->lookup = g_hash_table_new (NULL, NULL);
+  self->commands = g_array_new (FALSE, FALSE, sizeof (struct Gst3DDrawCommand));
+  self->instance_data = g_array_new (FALSE, FALSE, sizeof (gfloat));
+
+  self->multi_draw = _get_multi_draw (context);
+
+  gl->GenVertexArrays (1, &self->vao);
+  gl->GenBuffers (1, &self->vbo_instances);
+  if (self->multi_draw)
+    gl->GenBuffers (1, &self->indirect);
+
+  GST_DEBUG ("new batch for shader %" GST_PTR_FORMAT ", %s", shader,
+      self->multi_draw ? "multi draw indirect" : "draw loop");
+
+  return self;
+}
+
+void
+gst_3d_draw_batch_free (Gst3DDrawBatch * self)
+{
+  if (!self)
+    return;
+
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  for (guint i = 0; i < self->entries->len; i++) {
+    struct Gst3DDrawBatchEntry *entry =
+        &g_array_index (self->entries, struct Gst3DDrawBatchEntry, i);
+    gst_object_unref (entry->mesh);
+    g_array_free (entry->transforms, TRUE);
+  }
+  g_array_free (self->entries, TRUE);
+  g_hash_table_destroy (self->lookup);
+  g_array_free (self->attributes, TRUE);
+  g_array_free (self->commands, TRUE);
+  g_array_free (self->instance_data, TRUE);
+
+  gl->DeleteVertexArrays (1, &self->vao);
+  gst_3d_gl_state_invalidate (self->context);
+  gl->DeleteBuffers (1, &self->vbo_instances);
+  if (self->vbo_vertices)
+    gl->DeleteBuffers (1, &self->vbo_vertices);
+  if (self->vbo_indices)
+    gl->DeleteBuffers (1, &self->vbo_indices);
+  if (self->indirect)
+    gl->DeleteBuffers (1, &self->indirect);
+
+  gst_3d_memory_release (self->context, GST_3D_MEMORY_BUFFER, self->gpu_bytes);
+
+  gst_object_unref (self->shader);
+  gst_object_unref (self->context);
+  g_free (self);
+}
+
+/* Only static interleaved meshes can be copied into the shared buffers,
+ * procedural and dynamic meshes are drawn on their own. */
+gboolean
+gst_3d_draw_batch_can_pack (Gst3DMesh * mesh)
+{
+  return mesh->type == GST_3D_MESH_TYPE_BUFFER
+      && mesh->layout == GST_3D_MESH_LAYOUT_INTERLEAVED
+      && mesh->vbo_vertices != 0 && mesh->index_count > 0
+      && mesh->attribute_buffers != NULL;
+}
+
+static gboolean
+_format_matches (Gst3DDrawBatch * self, Gst3DMesh * mesh)
+{
+  GList *l;
+  guint i = 0;
+
+  if (mesh->index_type != self->index_type
+      || mesh->draw_mode != self->draw_mode)
+    return FALSE;
+
+  for (l = mesh->attribute_buffers; l != NULL; l = l->next, i++) {
+    struct Gst3DAttributeBuffer *buf = (struct Gst3DAttributeBuffer *) l->data;
+    if (i >= self->attributes->len)
+      return FALSE;
+    struct Gst3DAttributeBuffer *attrib =
+        &g_array_index (self->attributes, struct Gst3DAttributeBuffer, i);
+    if (g_strcmp0 (buf->name, attrib->name) != 0
+        || buf->vector_length != attrib->vector_length
+        || buf->type != attrib->type || buf->normalized != attrib->normalized
+        || buf->offset != attrib->offset || buf->stride != self->stride)
+      return FALSE;
+  }
+
+  return i == self->attributes->len;
+}
+
+static void
+_adopt_format (Gst3DDrawBatch * self, Gst3DMesh * mesh)
+{
+  GList *l;
+
+  self->stride =
+      ((struct Gst3DAttributeBuffer *) mesh->attribute_buffers->data)->stride;
+  self->index_type = mesh->index_type;
+  self->index_size = mesh->index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+  self->draw_mode = mesh->draw_mode;
+
+  for (l = mesh->attribute_buffers; l != NULL; l = l->next) {
+    struct Gst3DAttributeBuffer attrib =
+        *(struct Gst3DAttributeBuffer *) l->data;
+    attrib.data = NULL;
+    /* the shader may still be compiling, and the pinned locations stay
+     * valid when it is relinked */
+    attrib.shader_location = gst_3d_mesh_attribute_location (attrib.name);
+    g_array_append_val (self->attributes, attrib);
+  }
+}
+
+/* Points the vertex attributes at @base_vertex. Expects the VAO to be
+ * bound. */
+static void
+_point_attributes (Gst3DDrawBatch * self, guint base_vertex)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+  gsize base = (gsize) base_vertex * self->stride;
+
+  gl->BindBuffer (GL_ARRAY_BUFFER, self->vbo_vertices);
+  for (guint i = 0; i < self->attributes->len; i++) {
+    struct Gst3DAttributeBuffer *attrib =
+        &g_array_index (self->attributes, struct Gst3DAttributeBuffer, i);
+    if (attrib->shader_location == -1)
+      continue;
+    gl->VertexAttribPointer (attrib->shader_location, attrib->vector_length,
+        attrib->type, attrib->normalized, self->stride,
+        (const GLvoid *) (base + attrib->offset));
+    gl->EnableVertexAttribArray (attrib->shader_location);
+  }
+}
+
+/* Points the per instance mat4 at @base_instance. Expects the VAO to be
+ * bound. */
+static void
+_point_instances (Gst3DDrawBatch * self, guint base_instance)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+  gsize stride = INSTANCE_VECTOR_LENGTH * sizeof (GLfloat);
+  gsize base = (gsize) base_instance * stride;
+
+  gl->BindBuffer (GL_ARRAY_BUFFER, self->vbo_instances);
+  for (guint c = 0; c < 4; c++) {
+    gl->VertexAttribPointer (GST_3D_MESH_INSTANCE_LOCATION + c, 4, GL_FLOAT,
+        GL_FALSE, stride, (const GLvoid *) (base + c * 4 * sizeof (GLfloat)));
+    gl->EnableVertexAttribArray (GST_3D_MESH_INSTANCE_LOCATION + c);
+    gl->VertexAttribDivisor (GST_3D_MESH_INSTANCE_LOCATION + c, 1);
+  }
+}
+
+/* Makes room for @needed bytes in the static buffer @id, keeping the
+ * first @used bytes. The copy stays on the GPU. */
+static void
+_reserve (Gst3DDrawBatch * self, GLuint * id, gsize * capacity, gsize used,
+    gsize needed)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  if (needed <= *capacity)
+    return;
+
+  gsize new_capacity = MAX (needed, *capacity * 2);
+  GLuint new_id;
+
+  gl->GenBuffers (1, &new_id);
+  gl->BindBuffer (GL_COPY_WRITE_BUFFER, new_id);
+  gl->BufferData (GL_COPY_WRITE_BUFFER, new_capacity, NULL, GL_STATIC_DRAW);
+
+  if (*id) {
+    if (used) {
+      gl->BindBuffer (GL_COPY_READ_BUFFER, *id);
+      gl->CopyBufferSubData (GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+          used);
+    }
+    gl->DeleteBuffers (1, id);
+  }
+
+  gst_3d_memory_release (self->context, GST_3D_MEMORY_BUFFER, *capacity);
+  gst_3d_memory_alloc (self->context, GST_3D_MEMORY_BUFFER, new_capacity);
+  self->gpu_bytes += new_capacity - *capacity;
+
+  *id = new_id;
+  *capacity = new_capacity;
+}
+
+/* Grows the stream buffer @id to @size and uploads @data to it, orphaning
+ * the previous storage. */
+static void
+_upload_stream (Gst3DDrawBatch * self, GLenum target, GLuint id,
+    gsize * capacity, gconstpointer data, gsize size)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  gl->BindBuffer (target, id);
+  if (size > *capacity) {
+    gst_3d_memory_release (self->context, GST_3D_MEMORY_BUFFER, *capacity);
+    gst_3d_memory_alloc (self->context, GST_3D_MEMORY_BUFFER, size);
+    self->gpu_bytes += size - *capacity;
+    *capacity = size;
+    gl->BufferData (target, size, data, GL_STREAM_DRAW);
+  } else {
+    gl->BufferData (target, *capacity, NULL, GL_STREAM_DRAW);
+    gl->BufferSubData (target, 0, size, data);
+  }
+}
+
+static gboolean
+_pack_mesh (Gst3DDrawBatch * self, Gst3DMesh * mesh)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  if (g_hash_table_contains (self->lookup, mesh))
+    return TRUE;
+
+  if (!gst_3d_draw_batch_can_pack (mesh))
+    return FALSE;
+
+  if (self->attributes->len == 0)
+    _adopt_format (self, mesh);
+  else if (!_format_matches (self, mesh))
+    return FALSE;
+
+  gsize vertex_bytes = (gsize) mesh->vertex_count * self->stride;
+  gsize index_bytes = (gsize) mesh->index_count * self->index_size;
+  GLuint old_vertices = self->vbo_vertices;
+  GLuint old_indices = self->vbo_indices;
+
+  _reserve (self, &self->vbo_vertices, &self->vertex_capacity,
+      self->vertex_used, self->vertex_used + vertex_bytes);
+  _reserve (self, &self->vbo_indices, &self->index_capacity,
+      self->index_used, self->index_used + index_bytes);
+
+  gl->BindBuffer (GL_COPY_READ_BUFFER, mesh->vbo_vertices);
+  gl->BindBuffer (GL_COPY_WRITE_BUFFER, self->vbo_vertices);
+  gl->CopyBufferSubData (GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+      mesh->vertex_offset, self->vertex_used, vertex_bytes);
+
+  gl->BindBuffer (GL_COPY_READ_BUFFER, mesh->vbo_indices);
+  gl->BindBuffer (GL_COPY_WRITE_BUFFER, self->vbo_indices);
+  gl->CopyBufferSubData (GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+      mesh->index_offset, self->index_used, index_bytes);
+
+  struct Gst3DDrawBatchEntry entry = {
+    .mesh = gst_object_ref (mesh),
+    .base_vertex = self->vertex_used / self->stride,
+    .first_index = self->index_used / self->index_size,
+    .index_count = mesh->index_count,
+    .transforms = g_array_new (FALSE, FALSE, sizeof (graphene_matrix_t)),
+  };
+  g_array_append_val (self->entries, entry);
+  g_hash_table_insert (self->lookup, mesh,
+      GUINT_TO_POINTER (self->entries->len));
+
+  self->vertex_used += vertex_bytes;
+  self->index_used += index_bytes;
+
+  /* the VAO references the buffer objects, not their names */
+  if (old_vertices != self->vbo_vertices || old_indices != self->vbo_indices) {
+    gst_3d_gl_state_bind_vertex_array (self->context, self->vao);
+    _point_attributes (self, 0);
+    _point_instances (self, 0);
+    gl->BindBuffer (GL_ELEMENT_ARRAY_BUFFER, self->vbo_indices);
+    gst_3d_gl_state_bind_vertex_array (self->context, 0);
+  }
+
+  GST_DEBUG ("packed mesh %" GST_PTR_FORMAT " at vertex %u, index %u", mesh,
+      entry.base_vertex, entry.first_index);
+
+  return TRUE;
+}
+
+/* Copies @mesh and all its levels of detail into the shared buffers.
+ * Returns FALSE if @mesh can not be packed or its vertex format differs
+ * from the meshes already in the batch. Meshes are expected to stay
+ * unchanged after they were added. */
+gboolean
+gst_3d_draw_batch_add_mesh (Gst3DDrawBatch * self, Gst3DMesh * mesh)
+{
+  if (!_pack_mesh (self, mesh))
+    return FALSE;
+
+  if (mesh->lods)
+    for (guint i = 0; i < mesh->lods->len; i++)
+      _pack_mesh (self, g_array_index (mesh->lods, struct Gst3DMeshLod,
+              i).mesh);
+
+  return TRUE;
+}
+
+/* Queues an instance of @mesh for the next flush. Returns FALSE if @mesh
+ * was not added to the batch. */
+gboolean
+gst_3d_draw_batch_push (Gst3DDrawBatch * self, Gst3DMesh * mesh,
+    const graphene_matrix_t * model)
+{
+  guint index = GPOINTER_TO_UINT (g_hash_table_lookup (self->lookup, mesh));
+  if (index == 0)
+    return FALSE;
+
+  struct Gst3DDrawBatchEntry *entry =
+      &g_array_index (self->entries, struct Gst3DDrawBatchEntry, index - 1);
+  g_array_append_val (entry->transforms, *model);
+  return TRUE;
+}
+
+static void
+_build_commands (Gst3DDrawBatch * self)
+{
+  guint n_instances = 0;
+
+  g_array_set_size (self->commands, 0);
+  g_array_set_size (self->instance_data, 0);
+
+  for (guint i = 0; i < self->entries->len; i++) {
+    struct Gst3DDrawBatchEntry *entry =
+        &g_array_index (self->entries, struct Gst3DDrawBatchEntry, i);
+    if (entry->transforms->len == 0)
+      continue;
+
+    struct Gst3DDrawCommand command = {
+      .count = entry->index_count,
+      .instance_count = entry->transforms->len,
+      .first_index = entry->first_index,
+      .base_vertex = entry->base_vertex,
+      .base_instance = n_instances,
+    };
+    g_array_append_val (self->commands, command);
+
+    guint offset = self->instance_data->len;
+    g_array_set_size (self->instance_data,
+        offset + entry->transforms->len * INSTANCE_VECTOR_LENGTH);
+    for (guint t = 0; t < entry->transforms->len; t++)
+      graphene_matrix_to_float (&g_array_index (entry->transforms,
+              graphene_matrix_t, t), &g_array_index (self->instance_data,
+              gfloat, offset + t * INSTANCE_VECTOR_LENGTH));
+
+    n_instances += entry->transforms->len;
+    g_array_set_size (entry->transforms, 0);
+  }
+}
+
+/* Draws all instances pushed since the last flush, with one indirect draw
+ * call when available. */
+void
+gst_3d_draw_batch_flush (Gst3DDrawBatch * self)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  _build_commands (self);
+  if (self->commands->len == 0)
+    return;
+
+  _upload_stream (self, GL_ARRAY_BUFFER, self->vbo_instances,
+      &self->instance_capacity, self->instance_data->data,
+      self->instance_data->len * sizeof (gfloat));
+
+  gst_3d_shader_bind (self->shader);
+  gst_3d_gl_state_bind_vertex_array (self->context, self->vao);
+
+  /* all packed meshes share the draw mode and index type, restart
+   * indices are compared before the base vertex is added */
+  Gst3DMesh *format =
+      g_array_index (self->entries, struct Gst3DDrawBatchEntry, 0).mesh;
+  gst_3d_mesh_set_primitive_restart (format, self->draw_mode, TRUE);
+
+  if (self->multi_draw) {
+    _upload_stream (self, GL_DRAW_INDIRECT_BUFFER, self->indirect,
+        &self->indirect_capacity, self->commands->data,
+        self->commands->len * sizeof (struct Gst3DDrawCommand));
+    self->multi_draw (self->draw_mode, self->index_type, NULL,
+        self->commands->len, 0);
+    gl->BindBuffer (GL_DRAW_INDIRECT_BUFFER, 0);
+  } else {
+    for (guint i = 0; i < self->commands->len; i++) {
+      struct Gst3DDrawCommand *command =
+          &g_array_index (self->commands, struct Gst3DDrawCommand, i);
+      _point_attributes (self, command->base_vertex);
+      _point_instances (self, command->base_instance);
+      gl->DrawElementsInstanced (self->draw_mode, command->count,
+          self->index_type,
+          (const GLvoid *) ((gsize) command->first_index * self->index_size),
+          command->instance_count);
+    }
+  }
+
+  gst_3d_mesh_set_primitive_restart (format, self->draw_mode, FALSE);
+}
+
+Gst3DShader *
+gst_3d_draw_batch_get_shader (Gst3DDrawBatch * self)
+{
+  return self->shader;
+}
+
+gboolean
+gst_3d_draw_batch_is_indirect (Gst3DDrawBatch * self)
+{
+  return self->multi_draw != NULL;
+}
@@ -0,0 +1,49 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_DRAW_BATCH_H__
+#define __GST_3D_DRAW_BATCH_H__
+
+#include <gst/gst.h>
+#include <gst/gl/gstgl_fwd.h>
+#include <graphene.h>
+
+#include "gst3dmesh.h"
+#include "gst3dshader.h"
+
+G_BEGIN_DECLS
+
+typedef struct _Gst3DDrawBatch Gst3DDrawBatch;
+
+Gst3DDrawBatch *gst_3d_draw_batch_new (GstGLContext * context,
+    Gst3DShader * shader);
+void gst_3d_draw_batch_free (Gst3DDrawBatch * self);
+
+gboolean gst_3d_draw_batch_can_pack (Gst3DMesh * mesh);
+gboolean gst_3d_draw_batch_add_mesh (Gst3DDrawBatch * self, Gst3DMesh * mesh);
+gboolean gst_3d_draw_batch_push (Gst3DDrawBatch * self, Gst3DMesh * mesh,
+    const graphene_matrix_t * model);
+void gst_3d_draw_batch_flush (Gst3DDrawBatch * self);
+
+Gst3DShader *gst_3d_draw_batch_get_shader (Gst3DDrawBatch * self);
+gboolean gst_3d_draw_batch_is_indirect (Gst3DDrawBatch * self);
+
+G_END_DECLS
+#endif /* __GST_3D_DRAW_BATCH_H__ */
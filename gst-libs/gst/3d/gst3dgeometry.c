@@ -0,0 +1,352 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* CPU tessellation of the built in shapes. Generators are split into
+ * separable parts: trigonometry only depends on either the row or the
+ * column of a vertex, so it is evaluated once per row and once per column
+ * into tables instead of once per vertex. The tables are laid out like an
+ * output row, so the inner loops are one multiply-add per float without
+ * strided stores, and rows are independent, which lets large
+ * tessellations be distributed over threads without synchronization.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+
+#include "gst3dgeometry.h"
+
+typedef void (*GeometryRowsFunc) (Gst3DGeometry * self, gpointer user_data,
+    guint first, guint last);
+
+struct RowJob
+{
+  Gst3DGeometry *geometry;
+  GeometryRowsFunc func;
+  gpointer user_data;
+  guint first;
+  guint last;
+};
+
+struct SphereParams
+{
+  gfloat radius;
+  guint stacks;
+  guint slices;
+  /* per stack tables laid out like one output row, so each row is a
+   * single unit stride loop over its floats. xz holds the scaled cos and
+   * sin of phi with 0 in the y lanes, y_lane 1 in the y lanes only. u_lane
+   * and v_lane do the same for the texture coordinates. */
+  const gfloat *xz;
+  const gfloat *y_lane;
+  const gfloat *u_lane;
+  const gfloat *v_lane;
+};
+
+struct PlaneParams
+{
+  guint width;
+  guint height;
+  /* per point tables laid out like one output column, x_lane is 1 in the
+   * x lanes only and yz holds the y coordinates with 0 elsewhere */
+  const gfloat *x_lane;
+  const gfloat *yz;
+};
+
+Gst3DGeometry *
+gst_3d_geometry_new (void)
+{
+  return g_new0 (Gst3DGeometry, 1);
+}
+
+void
+gst_3d_geometry_free (Gst3DGeometry * self)
+{
+  if (self == NULL)
+    return;
+  g_free (self->positions);
+  g_free (self->uvs);
+  g_free (self->indices);
+  g_free (self->tables);
+  g_free (self);
+}
+
+static void
+_reserve (Gst3DGeometry * self, guint vertex_count, guint index_count,
+    guint table_size)
+{
+  if (vertex_count > self->vertex_capacity) {
+    g_free (self->positions);
+    g_free (self->uvs);
+    self->positions = g_new (gfloat, (gsize) vertex_count * 3);
+    self->uvs = g_new (gfloat, (gsize) vertex_count * 2);
+    self->vertex_capacity = vertex_count;
+  }
+  if (index_count > self->index_capacity) {
+    g_free (self->indices);
+    self->indices = g_new (guint32, index_count);
+    self->index_capacity = index_count;
+  }
+  if (table_size > self->table_capacity) {
+    g_free (self->tables);
+    self->tables = g_new (gfloat, table_size);
+    self->table_capacity = table_size;
+  }
+
+  self->vertex_count = vertex_count;
+  self->index_count = index_count;
+}
+
+static gpointer
+_run_job (gpointer data)
+{
+  struct RowJob *job = data;
+  job->func (job->geometry, job->user_data, job->first, job->last);
+  return NULL;
+}
+
+/* Runs func over rows [0, rows), in slices of about equal size on up to
+ * n_threads threads when the output is large enough to pay for them. The
+ * calling thread works on the first slice. */
+static void
+_for_each_row (Gst3DGeometry * self, guint rows, guint vertex_count,
+    GeometryRowsFunc func, gpointer user_data)
+{
+  guint n_threads = self->n_threads;
+
+  if (n_threads == 0)
+    n_threads = MIN (g_get_num_processors (), GST_3D_GEOMETRY_MAX_THREADS);
+  if (vertex_count < GST_3D_GEOMETRY_PARALLEL_THRESHOLD)
+    n_threads = 1;
+  n_threads = MAX (1, MIN (n_threads, rows));
+
+  if (n_threads == 1) {
+    func (self, user_data, 0, rows);
+    return;
+  }
+
+  struct RowJob *jobs = g_new (struct RowJob, n_threads);
+  GThread **threads = g_new0 (GThread *, n_threads);
+
+  for (guint t = 0; t < n_threads; t++) {
+    jobs[t].geometry = self;
+    jobs[t].func = func;
+    jobs[t].user_data = user_data;
+    jobs[t].first = (guint) ((guint64) rows * t / n_threads);
+    jobs[t].last = (guint) ((guint64) rows * (t + 1) / n_threads);
+  }
+
+  for (guint t = 1; t < n_threads; t++)
+    threads[t] = g_thread_try_new ("gst3dgeometry", _run_job, &jobs[t], NULL);
+
+  _run_job (&jobs[0]);
+
+  /* fall back to the calling thread if a thread could not be spawned */
+  for (guint t = 1; t < n_threads; t++) {
+    if (threads[t])
+      g_thread_join (threads[t]);
+    else
+      _run_job (&jobs[t]);
+  }
+
+  g_free (threads);
+  g_free (jobs);
+}
+
+/* out[k] = s * a[k] + t * b[k], in blocks of 4 that the SLP vectorizer
+ * of -O2 turns into vector operations, which the loop vectorizer would
+ * only do at -O3. */
+static inline void
+_lanes_madd (gfloat *restrict out, gfloat s, const gfloat *restrict a,
+    gfloat t, const gfloat *restrict b, guint n)
+{
+  guint k = 0;
+
+  for (; k + 4 <= n; k += 4) {
+    out[k + 0] = s * a[k + 0] + t * b[k + 0];
+    out[k + 1] = s * a[k + 1] + t * b[k + 1];
+    out[k + 2] = s * a[k + 2] + t * b[k + 2];
+    out[k + 3] = s * a[k + 3] + t * b[k + 3];
+  }
+  for (; k < n; k++)
+    out[k] = s * a[k] + t * b[k];
+}
+
+static void
+_sphere_rows (Gst3DGeometry * self, gpointer user_data, guint first,
+    guint last)
+{
+  const struct SphereParams *p = user_data;
+  const guint stacks = p->stacks;
+  const gfloat *restrict xz = p->xz;
+  const gfloat *restrict y_lane = p->y_lane;
+  const gfloat *restrict u_lane = p->u_lane;
+  const gfloat *restrict v_lane = p->v_lane;
+  const gfloat I = 1.0f / (gfloat) (p->slices - 1);
+
+  for (guint i = first; i < last; i++) {
+    const gfloat theta = G_PI * i * I;
+    const gfloat sin_theta = sinf (theta);
+    const gfloat y = -cosf (theta) * p->radius;
+    const gfloat v = i * I;
+
+    gfloat *position = self->positions + (gsize) i * stacks * 3;
+    gfloat *uv = self->uvs + (gsize) i * stacks * 2;
+
+    /* the outputs stay interleaved for upload, but the loops run over the
+     * floats of the row instead of its vertices, without strided stores */
+    _lanes_madd (position, sin_theta, xz, y, y_lane, stacks * 3);
+    _lanes_madd (uv, 1.0f, u_lane, v, v_lane, stacks * 2);
+
+    /* one strip between this and the next row, restarted after it */
+    if (i + 1 < p->slices) {
+      guint32 *restrict index =
+          self->indices + (gsize) i * (stacks * 2 + 1);
+      const guint32 row = i * stacks;
+      for (guint j = 0; j < stacks; j++) {
+        index[j * 2 + 0] = row + j;
+        index[j * 2 + 1] = row + stacks + j;
+      }
+      if (i + 2 < p->slices)
+        index[stacks * 2] = GST_3D_GEOMETRY_RESTART_INDEX;
+    }
+  }
+}
+
+/* UV sphere of slices rows from pole to pole with stacks vertices each,
+ * drawn as GL_TRIANGLE_STRIP. Vertex (i, j) is at index i * stacks + j.
+ * Each band between two rows is its own strip, separated by
+ * GST_3D_GEOMETRY_RESTART_INDEX, so no triangles span the row seams. */
+void
+gst_3d_geometry_generate_sphere (Gst3DGeometry * self, gfloat radius,
+    guint stacks, guint slices)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (stacks > 1 && slices > 1);
+
+  _reserve (self, slices * stacks, (slices - 1) * (stacks * 2 + 1) - 1,
+      stacks * 10);
+
+  gfloat *xz = self->tables;
+  gfloat *y_lane = xz + stacks * 3;
+  gfloat *u_lane = y_lane + stacks * 3;
+  gfloat *v_lane = u_lane + stacks * 2;
+  const gfloat J = 1.0f / (gfloat) (stacks - 1);
+
+  for (guint j = 0; j < stacks; j++) {
+    const gfloat phi = 2.0f * G_PI * j * J + G_PI / 2.0f;
+    xz[j * 3 + 0] = cosf (phi) * radius;
+    xz[j * 3 + 1] = 0.0f;
+    xz[j * 3 + 2] = sinf (phi) * radius;
+    y_lane[j * 3 + 0] = 0.0f;
+    y_lane[j * 3 + 1] = 1.0f;
+    y_lane[j * 3 + 2] = 0.0f;
+    u_lane[j * 2 + 0] = j * J;
+    u_lane[j * 2 + 1] = 0.0f;
+    v_lane[j * 2 + 0] = 0.0f;
+    v_lane[j * 2 + 1] = 1.0f;
+  }
+
+  struct SphereParams params = {
+    .radius = radius,
+    .stacks = stacks,
+    .slices = slices,
+    .xz = xz,
+    .y_lane = y_lane,
+    .u_lane = u_lane,
+    .v_lane = v_lane,
+  };
+
+  _for_each_row (self, slices, self->vertex_count, _sphere_rows, &params);
+}
+
+static void
+_point_plane_rows (Gst3DGeometry * self, gpointer user_data, guint first,
+    guint last)
+{
+  const struct PlaneParams *p = user_data;
+  const guint height = p->height;
+  const gfloat step = 2.0f / (gfloat) p->width;
+
+  for (guint i = first; i < last; i++) {
+    const gfloat x = -1.0f + i * step;
+    gfloat *position = self->positions + (gsize) i * height * 3;
+
+    _lanes_madd (position, x, p->x_lane, 1.0f, p->yz, height * 3);
+  }
+}
+
+/* Sphere resolution for viewing from the center, where facets are not
+ * visible as geometry but through the texture coordinates, which are
+ * interpolated linearly along each chord instead of along the arc. For a
+ * segment spanning the angle t the largest angular offset between the
+ * two is sqrt(3) t^3 / 108, reached 1/sqrt(3) of the half segment away
+ * from its middle, about 21% in from either end. Picks the coarsest
+ * segment angle keeping this below @max_error, in radians. */
+void
+gst_3d_geometry_sphere_resolution (gfloat max_error, guint * stacks,
+    guint * slices)
+{
+  gdouble segment = cbrt (108.0 * max_error / sqrt (3.0));
+  gdouble segments = ceil (2.0 * G_PI / segment);
+
+  segments = CLAMP (segments, GST_3D_GEOMETRY_SPHERE_MIN_SEGMENTS,
+      GST_3D_GEOMETRY_SPHERE_MAX_SEGMENTS);
+
+  /* stacks go around the sphere, slices from pole to pole, both count the
+   * seam vertex twice */
+  *stacks = (guint) segments + 1;
+  *slices = (guint) ceil (segments / 2.0) + 1;
+}
+
+/* width x height points covering [-1, 1]^2 in the z = 0 plane, drawn as
+ * GL_POINTS in vertex order. Only positions are generated, no indices. */
+void
+gst_3d_geometry_generate_point_plane (Gst3DGeometry * self, guint width,
+    guint height)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (width > 0 && height > 0);
+
+  _reserve (self, width * height, 0, height * 6);
+
+  gfloat *x_lane = self->tables;
+  gfloat *yz = x_lane + height * 3;
+  const gfloat step = 2.0f / (gfloat) height;
+  for (guint j = 0; j < height; j++) {
+    x_lane[j * 3 + 0] = 1.0f;
+    x_lane[j * 3 + 1] = 0.0f;
+    x_lane[j * 3 + 2] = 0.0f;
+    yz[j * 3 + 0] = 0.0f;
+    yz[j * 3 + 1] = -1.0f + j * step;
+    yz[j * 3 + 2] = 0.0f;
+  }
+
+  struct PlaneParams params = {
+    .width = width,
+    .height = height,
+    .x_lane = x_lane,
+    .yz = yz,
+  };
+
+  _for_each_row (self, width, self->vertex_count, _point_plane_rows, &params);
+}
@@ -0,0 +1,76 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_GEOMETRY_H__
+#define __GST_3D_GEOMETRY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* vertex count from which generation is split across threads */
+#define GST_3D_GEOMETRY_PARALLEL_THRESHOLD (1 << 18)
+#define GST_3D_GEOMETRY_MAX_THREADS 8
+
+/* segments around the sphere chosen by gst_3d_geometry_sphere_resolution */
+#define GST_3D_GEOMETRY_SPHERE_MIN_SEGMENTS 16
+#define GST_3D_GEOMETRY_SPHERE_MAX_SEGMENTS 4096
+
+/* primitive restart index separating strips, drawn with primitive
+ * restart enabled and mapped to G_MAXUINT16 for 16-bit index buffers */
+#define GST_3D_GEOMETRY_RESTART_INDEX G_MAXUINT32
+
+typedef struct _Gst3DGeometry Gst3DGeometry;
+
+/* CPU side tessellation output, one tightly packed array per attribute
+ * so it can be handed to gst_3d_mesh_append_attribute_buffer for either
+ * mesh layout. Buffers are kept between generate calls and only grow,
+ * regenerating a shape of equal or smaller size does not allocate. */
+struct _Gst3DGeometry
+{
+  guint vertex_count;
+  guint index_count;
+
+  gfloat *positions;
+  gfloat *uvs;
+  guint32 *indices;
+
+  /* 0 picks the number of processors, 1 disables threading */
+  guint n_threads;
+
+  /* private */
+  guint vertex_capacity;
+  guint index_capacity;
+  gfloat *tables;
+  guint table_capacity;
+};
+
+Gst3DGeometry *gst_3d_geometry_new (void);
+void gst_3d_geometry_free (Gst3DGeometry * self);
+
+void gst_3d_geometry_generate_sphere (Gst3DGeometry * self, gfloat radius,
+    guint stacks, guint slices);
+void gst_3d_geometry_sphere_resolution (gfloat max_error, guint * stacks,
+    guint * slices);
+void gst_3d_geometry_generate_point_plane (Gst3DGeometry * self, guint width,
+    guint height);
+
+G_END_DECLS
+#endif /* __GST_3D_GEOMETRY_H__ */
@@ -0,0 +1,429 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Shadow copy of the bindings Gst3D objects change while drawing, kept
+ * per GstGLContext. Binds of the value already current are skipped, which
+ * removes the unconditional rebinds of the program, VAO, texture and
+ * framebuffer between the nodes and eyes of a frame.
+ *
+ * The copy is only right as long as all binds go through it, which does
+ * not hold for GstGL and setup code binding directly. Binds are therefore
+ * only skipped between gst_3d_gl_state_begin and gst_3d_gl_state_end
+ * around a draw, which start from unknown state. Outside of that every
+ * bind is issued. Deleting a bound object reverts its binding, deleters
+ * call gst_3d_gl_state_invalidate. Primitive restart is handled the same
+ * way, it is enabled once per scope instead of around every draw.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gl/gl.h>
+#include <gst/gl/gstglfuncs.h>
+
+#include "gst3dglstate.h"
+
+#define GST_CAT_DEFAULT gst_3d_gl_state_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#ifndef GL_READ_FRAMEBUFFER
+#define GL_READ_FRAMEBUFFER 0x8CA8
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER
+#define GL_DRAW_FRAMEBUFFER 0x8CA9
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER_BINDING
+#define GL_DRAW_FRAMEBUFFER_BINDING 0x8CA6
+#endif
+#ifndef GL_PRIMITIVE_RESTART
+#define GL_PRIMITIVE_RESTART 0x8F9D
+#endif
+#ifndef GL_PRIMITIVE_RESTART_FIXED_INDEX
+#define GL_PRIMITIVE_RESTART_FIXED_INDEX 0x8D69
+#endif
+
+#define GL_STATE_QUARK gst_3d_gl_state_quark ()
+
+/* no object is named this, marks a binding as unknown */
+#define UNKNOWN G_MAXUINT
+
+typedef void (GSTGLAPI * Gst3DBindTextureUnit) (GLuint unit, GLuint texture);
+typedef void (GSTGLAPI * Gst3DPrimitiveRestartIndex) (GLuint index);
+
+struct Gst3DGLState
+{
+  GLuint program;
+  GLuint vao;
+  GLuint active_unit;
+  GLuint textures[GST_3D_GL_STATE_TEXTURE_UNITS];
+  GLuint draw_fbo;
+  GLuint read_fbo;
+  gboolean viewport_known;
+  gint viewport[4];
+  /* TRUE once enabled in the scope, and the index set for GL 3.1 */
+  GLuint restart;
+  GLuint restart_index;
+
+  /* restart was enabled since the outermost begin and is disabled again
+   * in the matching end, see gst_3d_gl_state_primitive_restart */
+  gboolean restart_used;
+
+  /* nesting of gst_3d_gl_state_begin, binds are only cached above 0 */
+  guint depth;
+
+  /* from ARB_direct_state_access, binds without changing the active
+   * texture unit */
+  Gst3DBindTextureUnit bind_texture_unit;
+
+  /* GL 4.3 and ES 3 restart at the largest value of the index type, GL
+   * 3.1 needs the index set with glPrimitiveRestartIndex */
+  gboolean restart_fixed_index;
+  Gst3DPrimitiveRestartIndex restart_index_func;
+
+  guint64 issued;
+  guint64 avoided;
+};
+
+static GQuark
+gst_3d_gl_state_quark (void)
+{
+  static GQuark quark = 0;
+  if (!quark) {
+    quark = g_quark_from_static_string ("gst-3d-gl-state");
+    GST_DEBUG_CATEGORY_INIT (gst_3d_gl_state_debug, "3dglstate", 0,
+        "GL state cache");
+  }
+  return quark;
+}
+
+static void
+_invalidate (struct Gst3DGLState *state)
+{
+  state->program = UNKNOWN;
+  state->vao = UNKNOWN;
+  state->active_unit = UNKNOWN;
+  for (guint i = 0; i < GST_3D_GL_STATE_TEXTURE_UNITS; i++)
+    state->textures[i] = UNKNOWN;
+  state->draw_fbo = UNKNOWN;
+  state->read_fbo = UNKNOWN;
+  state->viewport_known = FALSE;
+  state->restart = UNKNOWN;
+  state->restart_index = UNKNOWN;
+}
+
+static gboolean
+_dsa_supported (GstGLContext * context)
+{
+  return gst_gl_context_check_gl_version (context, GST_GL_API_OPENGL3, 4, 5)
+      || gst_gl_context_check_feature (context, "GL_ARB_direct_state_access");
+}
+
+static struct Gst3DGLState *
+_get_state (GstGLContext * context)
+{
+  static GMutex create_lock;
+  struct Gst3DGLState *state;
+
+  /* looked up on every bind, only lock to create */
+  state = g_object_get_qdata (G_OBJECT (context), GL_STATE_QUARK);
+  if (state)
+    return state;
+
+  g_mutex_lock (&create_lock);
+  state = g_object_get_qdata (G_OBJECT (context), GL_STATE_QUARK);
+  if (!state) {
+    state = g_new0 (struct Gst3DGLState, 1);
+    _invalidate (state);
+    if (_dsa_supported (context))
+      state->bind_texture_unit = (Gst3DBindTextureUnit)
+          gst_gl_context_get_proc_address (context, "glBindTextureUnit");
+    GST_DEBUG ("direct state access %s",
+        state->bind_texture_unit ? "supported" : "not supported");
+    state->restart_fixed_index =
+        gst_gl_context_check_gl_version (context, GST_GL_API_OPENGL3, 4, 3)
+        || gst_gl_context_check_gl_version (context, GST_GL_API_GLES2, 3, 0)
+        || gst_gl_context_check_feature (context,
+        "GL_ARB_ES3_compatibility");
+    if (!state->restart_fixed_index)
+      state->restart_index_func = (Gst3DPrimitiveRestartIndex)
+          gst_gl_context_get_proc_address (context, "glPrimitiveRestartIndex");
+    g_object_set_qdata_full (G_OBJECT (context), GL_STATE_QUARK, state,
+        (GDestroyNotify) g_free);
+  }
+  g_mutex_unlock (&create_lock);
+
+  return state;
+}
+
+/* Returns whether the bind has to be issued, counting the outcome. */
+static gboolean
+_update (struct Gst3DGLState *state, GLuint * current, GLuint value)
+{
+  if (state->depth > 0 && *current == value) {
+    state->avoided++;
+    return FALSE;
+  }
+  *current = state->depth > 0 ? value : UNKNOWN;
+  state->issued++;
+  return TRUE;
+}
+
+/* Forgets all bindings, to be called when GL state may have been changed
+ * without going through this cache. */
+void
+gst_3d_gl_state_invalidate (GstGLContext * context)
+{
+  g_return_if_fail (GST_IS_GL_CONTEXT (context));
+
+  _invalidate (_get_state (context));
+}
+
+/* Starts skipping redundant binds until the matching
+ * gst_3d_gl_state_end. The outermost begin forgets all bindings, between
+ * the two all binds have to go through this cache. */
+void
+gst_3d_gl_state_begin (GstGLContext * context)
+{
+  g_return_if_fail (GST_IS_GL_CONTEXT (context));
+
+  struct Gst3DGLState *state = _get_state (context);
+  if (state->depth++ == 0)
+    _invalidate (state);
+}
+
+void
+gst_3d_gl_state_end (GstGLContext * context)
+{
+  g_return_if_fail (GST_IS_GL_CONTEXT (context));
+
+  struct Gst3DGLState *state = _get_state (context);
+  g_return_if_fail (state->depth > 0);
+  if (--state->depth > 0)
+    return;
+
+  if (state->restart_used) {
+    gst_3d_gl_state_primitive_restart (context, GL_UNSIGNED_INT, FALSE);
+    state->restart_used = FALSE;
+  }
+  _invalidate (state);
+}
+
+/* Unbinds the program, VAO and texture of unit 0 for code that expects
+ * the defaults. The framebuffer and viewport belong to the caller. */
+void
+gst_3d_gl_state_reset (GstGLContext * context)
+{
+  gst_3d_gl_state_use_program (context, 0);
+  gst_3d_gl_state_bind_vertex_array (context, 0);
+  gst_3d_gl_state_bind_texture (context, 0, 0);
+}
+
+void
+gst_3d_gl_state_use_program (GstGLContext * context, GLuint program)
+{
+  struct Gst3DGLState *state = _get_state (context);
+
+  if (_update (state, &state->program, program))
+    context->gl_vtable->UseProgram (program);
+}
+
+void
+gst_3d_gl_state_bind_vertex_array (GstGLContext * context, GLuint vao)
+{
+  struct Gst3DGLState *state = _get_state (context);
+
+  if (_update (state, &state->vao, vao))
+    context->gl_vtable->BindVertexArray (vao);
+}
+
+/* Binds @texture to GL_TEXTURE_2D of @unit. */
+void
+gst_3d_gl_state_bind_texture (GstGLContext * context, guint unit,
+    GLuint texture)
+{
+  struct Gst3DGLState *state = _get_state (context);
+  GstGLFuncs *gl = context->gl_vtable;
+
+  if (unit >= GST_3D_GL_STATE_TEXTURE_UNITS)
+    state->issued++;
+  else if (!_update (state, &state->textures[unit], texture))
+    return;
+
+  if (state->bind_texture_unit) {
+    state->bind_texture_unit (unit, texture);
+    return;
+  }
+
+  if (_update (state, &state->active_unit, unit))
+    gl->ActiveTexture (GL_TEXTURE0 + unit);
+  gl->BindTexture (GL_TEXTURE_2D, texture);
+}
+
+/* GL_FRAMEBUFFER binds both the draw and the read framebuffer. */
+void
+gst_3d_gl_state_bind_framebuffer (GstGLContext * context, GLenum target,
+    GLuint fbo)
+{
+  struct Gst3DGLState *state = _get_state (context);
+
+  switch (target) {
+    case GL_DRAW_FRAMEBUFFER:
+      if (_update (state, &state->draw_fbo, fbo))
+        context->gl_vtable->BindFramebuffer (target, fbo);
+      break;
+    case GL_READ_FRAMEBUFFER:
+      if (_update (state, &state->read_fbo, fbo))
+        context->gl_vtable->BindFramebuffer (target, fbo);
+      break;
+    default:
+      if (state->depth > 0 && state->draw_fbo == fbo
+          && state->read_fbo == fbo) {
+        state->avoided++;
+        return;
+      }
+      state->draw_fbo = state->read_fbo = state->depth > 0 ? fbo : UNKNOWN;
+      state->issued++;
+      context->gl_vtable->BindFramebuffer (target, fbo);
+      break;
+  }
+}
+
+/* Only queries GL when the program in use is unknown. */
+GLuint
+gst_3d_gl_state_get_program (GstGLContext * context)
+{
+  struct Gst3DGLState *state = _get_state (context);
+  GLint program = 0;
+
+  if (state->depth > 0 && state->program != UNKNOWN)
+    return state->program;
+
+  context->gl_vtable->GetIntegerv (GL_CURRENT_PROGRAM, &program);
+  if (state->depth > 0)
+    state->program = program;
+
+  return program;
+}
+
+/* Only queries GL when the binding is unknown. */
+GLuint
+gst_3d_gl_state_get_draw_framebuffer (GstGLContext * context)
+{
+  struct Gst3DGLState *state = _get_state (context);
+  GLint fbo = 0;
+
+  if (state->depth > 0 && state->draw_fbo != UNKNOWN)
+    return state->draw_fbo;
+
+  context->gl_vtable->GetIntegerv (GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+  if (state->depth > 0)
+    state->draw_fbo = fbo;
+
+  return fbo;
+}
+
+void
+gst_3d_gl_state_viewport (GstGLContext * context, gint x, gint y,
+    gint width, gint height)
+{
+  struct Gst3DGLState *state = _get_state (context);
+  gint viewport[4] = { x, y, width, height };
+
+  if (state->depth > 0 && state->viewport_known
+      && memcmp (state->viewport, viewport, sizeof (viewport)) == 0) {
+    state->avoided++;
+    return;
+  }
+
+  memcpy (state->viewport, viewport, sizeof (viewport));
+  state->viewport_known = state->depth > 0;
+  state->issued++;
+  context->gl_vtable->Viewport (x, y, width, height);
+}
+
+/* Whether strips separated by restart indices can be drawn as they are,
+ * either with the fixed restart index or with glPrimitiveRestartIndex. */
+gboolean
+gst_3d_gl_state_has_primitive_restart (GstGLContext * context)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), FALSE);
+
+  struct Gst3DGLState *state = _get_state (context);
+  return state->restart_fixed_index || state->restart_index_func != NULL;
+}
+
+/* Restarts primitives at the largest value of @index_type. Lists never
+ * hold that value and strips only use it as separator, so between begin
+ * and end restart stays enabled for all draws and is only disabled again
+ * by the outermost gst_3d_gl_state_end. Outside of that every change is
+ * issued. Not counted in the bind stats. */
+void
+gst_3d_gl_state_primitive_restart (GstGLContext * context, GLenum index_type,
+    gboolean enable)
+{
+  struct Gst3DGLState *state = _get_state (context);
+  GstGLFuncs *gl = context->gl_vtable;
+  GLenum cap = state->restart_fixed_index ? GL_PRIMITIVE_RESTART_FIXED_INDEX
+      : GL_PRIMITIVE_RESTART;
+
+  if (!state->restart_fixed_index && !state->restart_index_func)
+    return;
+
+  if (state->depth == 0) {
+    if (enable)
+      gl->Enable (cap);
+    else
+      gl->Disable (cap);
+  } else if (enable && state->restart != TRUE) {
+    gl->Enable (cap);
+    state->restart = TRUE;
+    state->restart_used = TRUE;
+  }
+
+  if (!enable || state->restart_fixed_index)
+    return;
+
+  GLuint index = index_type == GL_UNSIGNED_SHORT ? G_MAXUINT16 : G_MAXUINT32;
+  if (state->depth == 0 || state->restart_index != index) {
+    state->restart_index_func (index);
+    if (state->depth > 0)
+      state->restart_index = index;
+  }
+}
+
+/* Counts the binds issued to GL and the ones skipped since the context
+ * was created. */
+void
+gst_3d_gl_state_get_stats (GstGLContext * context, guint64 * issued,
+    guint64 * avoided)
+{
+  g_return_if_fail (GST_IS_GL_CONTEXT (context));
+
+  struct Gst3DGLState *state = _get_state (context);
+
+  if (issued)
+    *issued = state->issued;
+  if (avoided)
+    *avoided = state->avoided;
+}
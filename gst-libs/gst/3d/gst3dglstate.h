@@ -0,0 +1,57 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_GL_STATE_H__
+#define __GST_3D_GL_STATE_H__
+
+#include <gst/gst.h>
+#include <gst/gl/gstgl_fwd.h>
+#include <gst/gl/gstglfuncs.h>
+
+G_BEGIN_DECLS
+
+/* texture units whose GL_TEXTURE_2D binding is tracked, binds to higher
+ * units are always issued */
+#define GST_3D_GL_STATE_TEXTURE_UNITS 8
+
+void gst_3d_gl_state_begin (GstGLContext * context);
+void gst_3d_gl_state_end (GstGLContext * context);
+void gst_3d_gl_state_invalidate (GstGLContext * context);
+void gst_3d_gl_state_reset (GstGLContext * context);
+
+void gst_3d_gl_state_use_program (GstGLContext * context, GLuint program);
+GLuint gst_3d_gl_state_get_program (GstGLContext * context);
+void gst_3d_gl_state_bind_vertex_array (GstGLContext * context, GLuint vao);
+void gst_3d_gl_state_bind_texture (GstGLContext * context, guint unit,
+    GLuint texture);
+void gst_3d_gl_state_bind_framebuffer (GstGLContext * context, GLenum target,
+    GLuint fbo);
+GLuint gst_3d_gl_state_get_draw_framebuffer (GstGLContext * context);
+void gst_3d_gl_state_viewport (GstGLContext * context, gint x, gint y,
+    gint width, gint height);
+gboolean gst_3d_gl_state_has_primitive_restart (GstGLContext * context);
+void gst_3d_gl_state_primitive_restart (GstGLContext * context,
+    GLenum index_type, gboolean enable);
+
+void gst_3d_gl_state_get_stats (GstGLContext * context, guint64 * issued,
+    guint64 * avoided);
+
+G_END_DECLS
+#endif /* __GST_3D_GL_STATE_H__ */
@@ -39,6 +39,11 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 G_DEFINE_TYPE_WITH_CODE (Gst3DHmd, gst_3d_hmd, GST_TYPE_OBJECT,
     GST_DEBUG_CATEGORY_INIT (gst_3d_hmd_debug, "3dhmd", 0, "hmd"));
 
+/* the headset shared by the cameras and hmdwarp, closed with the last
+ * reference */
+static GWeakRef default_hmd;
+G_LOCK_DEFINE_STATIC (default_hmd);
+
 Gst3DHmd *
 gst_3d_hmd_new (void)
 {
@@ -46,11 +51,37 @@ gst_3d_hmd_new (void)
   return hmd;
 }
 
+/* Returns a new reference to the shared HMD, opening the device only
+ * when nothing holds it yet. */
+Gst3DHmd *
+gst_3d_hmd_get_default (void)
+{
+  G_LOCK (default_hmd);
+  Gst3DHmd *hmd = g_weak_ref_get (&default_hmd);
+  if (!hmd) {
+    hmd = gst_3d_hmd_new ();
+    g_weak_ref_set (&default_hmd, hmd);
+  }
+  G_UNLOCK (default_hmd);
+
+  return hmd;
+}
+
 static void
 gst_3d_hmd_finalize (GObject * object)
 {
   Gst3DHmd *self = GST_3D_HMD (object);
   g_return_if_fail (self != NULL);
+
+  if (self->device) {
+    ohmd_close_device (self->device);
+    self->device = NULL;
+  }
+  if (self->hmd_context) {
+    ohmd_ctx_destroy (self->hmd_context);
+    self->hmd_context = NULL;
+  }
+
   G_OBJECT_CLASS (gst_3d_hmd_parent_class)->finalize (object);
 }
 
@@ -114,6 +145,39 @@ gst_3d_hmd_reset (Gst3DHmd * self)
   GST_DEBUG ("Resetting OHMD_ROTATION_QUAT and OHMD_POSITION_VECTOR.");
 }
 
+/* Fits the warp to the outer edge of an eye viewport, which is 0.5 x 1
+ * of the side by side texture, like the OpenHMD and Oculus warps do. */
+static void
+gst_3d_hmd_update_warp_scale (Gst3DHmd * self)
+{
+  if (self->screen_width <= 0 || self->screen_height <= 0)
+    return;
+
+  const gfloat *k = self->distortion_k;
+  gfloat aspect = gst_3d_hmd_get_eye_aspect (self);
+  gfloat scale_in_x = 2.0 / 0.5;
+  gfloat scale_in_y = 2.0 / aspect;
+
+  /* distance from the lens center to the outer edge in [-1, 1] */
+  gfloat offset = 0.25 - graphene_vec2_get_x (&self->left_lens_center);
+  gfloat r = 1.0 + fabsf (offset * scale_in_x);
+  gfloat r_sq = r * r;
+  gfloat fit = k[0] + k[1] * r_sq + k[2] * r_sq * r_sq
+      + k[3] * r_sq * r_sq * r_sq;
+
+  if (fit <= 0) {
+    GST_WARNING ("Distortion fit %f is invalid, keeping the default scale",
+        fit);
+    return;
+  }
+
+  graphene_vec2_init (&self->warp_scale_in, scale_in_x, scale_in_y);
+  graphene_vec2_init (&self->warp_scale, 0.25 / fit, 0.5 * aspect / fit);
+
+  GST_DEBUG ("Warp scale %f %f, scale in %f %f (fit %f)",
+      0.25 / fit, 0.5 * aspect / fit, scale_in_x, scale_in_y, fit);
+}
+
 static void
 gst_3d_hmd_get_device_properties (Gst3DHmd * self)
 {
@@ -155,6 +219,13 @@ gst_3d_hmd_get_device_properties (Gst3DHmd * self)
   GST_DEBUG ("Horizontal Lens Separation: %.3fcm", lens_x_separation * 100.0);
   GST_DEBUG ("Vertical Lens Position: %.3fcm", lens_y_position * 100.0);
 
+  if (screen_width_physical > 0 && screen_height_physical > 0) {
+    gfloat offset = lens_x_separation / (2.0 * screen_width_physical);
+    gfloat y = lens_y_position / screen_height_physical;
+    graphene_vec2_init (&self->left_lens_center, 0.5 - offset, y);
+    graphene_vec2_init (&self->right_lens_center, 0.5 + offset, y);
+  }
+
   ohmd_device_getf (self->device, OHMD_LEFT_EYE_FOV, &self->left_fov);
   ohmd_device_getf (self->device, OHMD_RIGHT_EYE_FOV, &self->right_fov);
   GST_DEBUG ("FOV (left/right): %f %f", self->left_fov, self->right_fov);
@@ -182,6 +253,9 @@ gst_3d_hmd_get_device_properties (Gst3DHmd * self)
   ohmd_device_getf (self->device, OHMD_DISTORTION_K, kappa);
   GST_DEBUG ("Kappa: %f, %f, %f, %f, %f, %f",
       kappa[0], kappa[1], kappa[2], kappa[3], kappa[4], kappa[5]);
+  memcpy (self->distortion_k, kappa, sizeof (self->distortion_k));
+
+  gst_3d_hmd_update_warp_scale (self);
 
   float position[3];
   ohmd_device_getf (self->device, OHMD_POSITION_VECTOR, position);
@@ -192,6 +266,16 @@ void
 gst_3d_hmd_init (Gst3DHmd * self)
 {
   self->device = NULL;
+  self->hmd_context = NULL;
+
+  /* the defaults of warp.frag, kept without a device */
+  const gfloat distortion_k[4] = { 1.0, 0.22, 0.24, 0.0 };
+  memcpy (self->distortion_k, distortion_k, sizeof (self->distortion_k));
+  graphene_vec2_init (&self->left_lens_center, 0.25, 0.5);
+  graphene_vec2_init (&self->right_lens_center, 0.75, 0.5);
+  graphene_vec2_init (&self->warp_scale, 0.1469278, 0.2350845);
+  graphene_vec2_init (&self->warp_scale_in, 4.0, 2.5);
+
   gst_3d_hmd_open_device (self);
   if (self->device)
     gst_3d_hmd_get_device_properties (self);
@@ -57,6 +57,16 @@ struct _Gst3DHmd
   float znear;
   
   gfloat eye_separation;
+
+  /* first four OHMD_DISTORTION_K coefficients and the lens centers in
+   * texture coordinates of the side by side screen, used by the warp */
+  gfloat distortion_k[4];
+  graphene_vec2_t left_lens_center;
+  graphene_vec2_t right_lens_center;
+
+  /* warp scales into and out of the distortion, fitted to the device */
+  graphene_vec2_t warp_scale;
+  graphene_vec2_t warp_scale_in;
 };
 
 struct _Gst3DHmdClass
@@ -65,6 +75,7 @@ struct _Gst3DHmdClass
 };
 
 Gst3DHmd *gst_3d_hmd_new (void);
+Gst3DHmd *gst_3d_hmd_get_default (void);
 GType gst_3d_hmd_get_type (void);
 graphene_matrix_t gst_3d_hmd_get_matrix (Gst3DHmd * self, ohmd_float_value type);
 graphene_quaternion_t gst_3d_hmd_get_quaternion (Gst3DHmd * self);
@@ -0,0 +1,500 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Scene import through assimp. Parsing, post processing and the conversion
+ * to Gst3DMeshData run on a worker thread. Only gst_3d_import_upload has to
+ * be called on the GL thread, it uploads all meshes into one vertex and one
+ * index buffer and builds the Gst3DNode hierarchy, sharing meshes
+ * referenced by several nodes.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gl/gl.h>
+
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "gst3dimport.h"
+#include "gst3dmesh.h"
+#include "gst3dmeshoptimize.h"
+#include "gst3dmeshsimplify.h"
+#include "gst3dmeshcompress.h"
+
+#define GST_CAT_DEFAULT gst_3d_import_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define IMPORT_FLAGS (aiProcess_Triangulate \
+    | aiProcess_JoinIdenticalVertices \
+    | aiProcess_SortByPType \
+    | aiProcess_GenSmoothNormals \
+    | aiProcess_ValidateDataStructure)
+
+struct Gst3DImportNode
+{
+  gchar *name;
+  graphene_matrix_t transform;
+  GArray *meshes;
+  GList *children;
+};
+
+struct _Gst3DImport
+{
+  gchar *file;
+  Gst3DImportFlags flags;
+  GThread *thread;
+  gint loaded;
+
+  GError *error;
+  GPtrArray *meshes;
+  /* GPtrArray of simplified Gst3DMeshData per mesh, or NULL */
+  GPtrArray *lods;
+  struct Gst3DImportNode *root;
+};
+
+G_DEFINE_QUARK (gst-3d-import-error-quark, gst_3d_import_error);
+
+static void
+_init_debug (void)
+{
+  static gsize initialized = 0;
+  if (g_once_init_enter (&initialized)) {
+    GST_DEBUG_CATEGORY_INIT (gst_3d_import_debug, "3dimport", 0, "import");
+    g_once_init_leave (&initialized, 1);
+  }
+}
+
+static void
+_import_node_free (struct Gst3DImportNode *node)
+{
+  g_free (node->name);
+  g_array_unref (node->meshes);
+  g_list_free_full (node->children, (GDestroyNotify) _import_node_free);
+  g_free (node);
+}
+
+/* assimp matrices are row major for column vectors, graphene uses row
+ * vectors, so the float layout is the transpose. */
+static void
+_matrix_from_assimp (const struct aiMatrix4x4 *m, graphene_matrix_t * result)
+{
+  const float *values = &m->a1;
+  float transposed[16];
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+      transposed[i * 4 + j] = values[j * 4 + i];
+  graphene_matrix_init_from_float (result, transposed);
+}
+
+/* The root of a merged scene draws its only mesh untransformed. */
+static struct Gst3DImportNode *
+_merged_node (void)
+{
+  struct Gst3DImportNode *node = g_new0 (struct Gst3DImportNode, 1);
+  const guint mesh = 0;
+
+  node->name = g_strdup ("merged");
+  graphene_matrix_init_identity (&node->transform);
+  node->meshes = g_array_sized_new (FALSE, FALSE, sizeof (guint), 1);
+  g_array_append_val (node->meshes, mesh);
+
+  return node;
+}
+
+static struct Gst3DImportNode *
+_import_node (const struct aiNode *ai_node)
+{
+  struct Gst3DImportNode *node = g_new0 (struct Gst3DImportNode, 1);
+
+  node->name = g_strndup (ai_node->mName.data, ai_node->mName.length);
+  _matrix_from_assimp (&ai_node->mTransformation, &node->transform);
+
+  node->meshes = g_array_sized_new (FALSE, FALSE, sizeof (guint),
+      ai_node->mNumMeshes);
+  g_array_append_vals (node->meshes, ai_node->mMeshes, ai_node->mNumMeshes);
+
+  for (guint i = 0; i < ai_node->mNumChildren; i++)
+    node->children = g_list_append (node->children,
+        _import_node (ai_node->mChildren[i]));
+
+  return node;
+}
+
+static Gst3DMeshData *
+_import_mesh (const struct aiMesh *ai_mesh)
+{
+  /* points and lines are split off by aiProcess_SortByPType */
+  if (!(ai_mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE))
+    return NULL;
+
+  Gst3DMeshData *data = gst_3d_mesh_data_new ();
+  gint position = gst_3d_mesh_data_add_attribute (data, "position", 3);
+  gint uv = gst_3d_mesh_data_add_attribute (data, "uv", 2);
+  gint normal = -1;
+  if (ai_mesh->mNormals)
+    normal = gst_3d_mesh_data_add_attribute (data, "normal", 3);
+
+  gst_3d_mesh_data_alloc (data, ai_mesh->mNumVertices,
+      3 * ai_mesh->mNumFaces);
+
+  for (guint i = 0; i < ai_mesh->mNumVertices; i++) {
+    gfloat *p = gst_3d_mesh_data_get_attribute (data, position, i);
+    p[0] = ai_mesh->mVertices[i].x;
+    p[1] = ai_mesh->mVertices[i].y;
+    p[2] = ai_mesh->mVertices[i].z;
+
+    if (ai_mesh->mTextureCoords[0]) {
+      gfloat *t = gst_3d_mesh_data_get_attribute (data, uv, i);
+      t[0] = ai_mesh->mTextureCoords[0][i].x;
+      t[1] = ai_mesh->mTextureCoords[0][i].y;
+    }
+
+    if (normal != -1) {
+      gfloat *n = gst_3d_mesh_data_get_attribute (data, normal, i);
+      n[0] = ai_mesh->mNormals[i].x;
+      n[1] = ai_mesh->mNormals[i].y;
+      n[2] = ai_mesh->mNormals[i].z;
+    }
+  }
+
+  for (guint i = 0; i < ai_mesh->mNumFaces; i++) {
+    /* aiProcess_Triangulate guarantees three indices per face */
+    data->indices[i * 3] = ai_mesh->mFaces[i].mIndices[0];
+    data->indices[i * 3 + 1] = ai_mesh->mFaces[i].mIndices[1];
+    data->indices[i * 3 + 2] = ai_mesh->mFaces[i].mIndices[2];
+  }
+
+  return data;
+}
+
+static void
+_optimize_mesh (Gst3DMeshData * data, guint index)
+{
+  Gst3DMeshOptimizeStats stats;
+
+  if (gst_3d_mesh_data_optimize (data, GST_3D_MESH_OPTIMIZE_CACHE_SIZE,
+          &stats))
+    GST_DEBUG ("optimized mesh %d: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, "
+        "%d clusters", index, stats.acmr_before, stats.acmr_after,
+        stats.atvr_before, stats.atvr_after, stats.clusters);
+}
+
+static GPtrArray *
+_generate_lods (Gst3DImport * self, Gst3DMeshData * data, guint index)
+{
+  GPtrArray *lods = gst_3d_mesh_data_generate_lods (data,
+      GST_3D_MESH_SIMPLIFY_MAX_LODS, GST_3D_MESH_SIMPLIFY_TARGET_ERROR);
+
+  for (guint i = 0; i < lods->len; i++) {
+    Gst3DMeshData *lod = g_ptr_array_index (lods, i);
+    GST_DEBUG ("mesh %d LOD %d: %d triangles", index, i + 1,
+        lod->index_count / 3);
+    if (self->flags & GST_3D_IMPORT_FLAG_OPTIMIZE)
+      gst_3d_mesh_data_optimize (lod, GST_3D_MESH_OPTIMIZE_CACHE_SIZE, NULL);
+  }
+
+  return lods;
+}
+
+static void
+_compress_mesh (Gst3DImport * self, Gst3DMeshData * data, GPtrArray * lods)
+{
+  Gst3DMeshCompressFlags flags = GST_3D_MESH_COMPRESS_NONE;
+  if (self->flags & GST_3D_IMPORT_FLAG_COMPRESS)
+    flags |= GST_3D_MESH_COMPRESS_DEFAULT;
+  if (self->flags & GST_3D_IMPORT_FLAG_COMPRESS_POSITIONS)
+    flags |= GST_3D_MESH_COMPRESS_POSITION;
+
+  if (flags == GST_3D_MESH_COMPRESS_NONE)
+    return;
+
+  gsize stride = data->stride;
+  if (gst_3d_mesh_data_compress (data, flags))
+    GST_DEBUG ("compressed vertices from %" G_GSIZE_FORMAT " to %"
+        G_GSIZE_FORMAT " bytes", stride, data->stride);
+
+  if (lods)
+    for (guint i = 0; i < lods->len; i++)
+      gst_3d_mesh_data_compress (g_ptr_array_index (lods, i), flags);
+}
+
+/* aiProcess_PreTransformVertices already applied the node transforms, so
+ * the meshes only have to be appended to the first one, which is taken
+ * out of @meshes. */
+static Gst3DMeshData *
+_merge_meshes (Gst3DImport * self, GPtrArray * meshes)
+{
+  Gst3DMeshData *merged = NULL;
+
+  for (guint i = 0; i < meshes->len; i++) {
+    Gst3DMeshData *data = g_ptr_array_index (meshes, i);
+    if (!data)
+      continue;
+    if (!merged) {
+      merged = data;
+      g_ptr_array_index (meshes, i) = NULL;
+    } else if (!gst_3d_mesh_data_concat (merged, data)) {
+      GST_WARNING ("%s: mesh %d has a different vertex layout, skipping",
+          self->file, i);
+    }
+  }
+
+  return merged;
+}
+
+static void
+_load (Gst3DImport * self)
+{
+  guint ai_flags = IMPORT_FLAGS;
+  if (self->flags & GST_3D_IMPORT_FLAG_MERGE)
+    ai_flags |= aiProcess_PreTransformVertices;
+
+  const struct aiScene *scene = aiImportFile (self->file, ai_flags);
+
+  if (!scene || !scene->mRootNode) {
+    g_set_error (&self->error, GST_3D_IMPORT_ERROR,
+        GST_3D_IMPORT_ERROR_FAILED, "Could not import %s: %s", self->file,
+        aiGetErrorString ());
+    if (scene)
+      aiReleaseImport (scene);
+    return;
+  }
+
+  guint n_triangle_meshes = 0;
+  for (guint i = 0; i < scene->mNumMeshes; i++) {
+    Gst3DMeshData *data = _import_mesh (scene->mMeshes[i]);
+    if (data)
+      n_triangle_meshes++;
+    g_ptr_array_add (self->meshes, data);
+  }
+
+  if ((self->flags & GST_3D_IMPORT_FLAG_MERGE) && n_triangle_meshes > 0) {
+    Gst3DMeshData *merged = _merge_meshes (self, self->meshes);
+    g_ptr_array_set_size (self->meshes, 0);
+    g_ptr_array_add (self->meshes, merged);
+    self->root = _merged_node ();
+  } else {
+    self->root = _import_node (scene->mRootNode);
+  }
+
+  for (guint i = 0; i < self->meshes->len; i++) {
+    Gst3DMeshData *data = g_ptr_array_index (self->meshes, i);
+    GPtrArray *lods = NULL;
+    if (data) {
+      if (self->flags & GST_3D_IMPORT_FLAG_OPTIMIZE)
+        _optimize_mesh (data, i);
+      if (self->flags & GST_3D_IMPORT_FLAG_GENERATE_LODS)
+        lods = _generate_lods (self, data, i);
+      _compress_mesh (self, data, lods);
+    }
+    g_ptr_array_add (self->lods, lods);
+  }
+
+  GST_DEBUG ("imported %s: %d meshes, %d with triangles", self->file,
+      scene->mNumMeshes, n_triangle_meshes);
+
+  if (n_triangle_meshes == 0)
+    g_set_error (&self->error, GST_3D_IMPORT_ERROR,
+        GST_3D_IMPORT_ERROR_NO_MESHES, "%s contains no triangle meshes",
+        self->file);
+
+  aiReleaseImport (scene);
+}
+
+static gpointer
+_load_thread (gpointer user_data)
+{
+  Gst3DImport *self = user_data;
+  _load (self);
+  g_atomic_int_set (&self->loaded, TRUE);
+  return NULL;
+}
+
+static void
+_lods_unref (GPtrArray * lods)
+{
+  if (lods)
+    g_ptr_array_unref (lods);
+}
+
+static Gst3DImport *
+_import_new (const gchar * file, Gst3DImportFlags flags)
+{
+  _init_debug ();
+
+  Gst3DImport *self = g_new0 (Gst3DImport, 1);
+  self->file = g_strdup (file);
+  self->flags = flags;
+  self->meshes =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) gst_3d_mesh_data_free);
+  self->lods = g_ptr_array_new_with_free_func ((GDestroyNotify) _lods_unref);
+  return self;
+}
+
+Gst3DImport *
+gst_3d_import_load (const gchar * file, Gst3DImportFlags flags,
+    GError ** error)
+{
+  Gst3DImport *self = _import_new (file, flags);
+  _load (self);
+  self->loaded = TRUE;
+
+  if (self->error) {
+    g_propagate_error (error, self->error);
+    self->error = NULL;
+    gst_3d_import_free (self);
+    return NULL;
+  }
+
+  return self;
+}
+
+/* Starts loading on a worker thread and returns immediately. Poll with
+ * gst_3d_import_is_loaded or block with gst_3d_import_wait. */
+Gst3DImport *
+gst_3d_import_load_async (const gchar * file, Gst3DImportFlags flags)
+{
+  Gst3DImport *self = _import_new (file, flags);
+  self->thread = g_thread_new ("3dimport", _load_thread, self);
+  return self;
+}
+
+gboolean
+gst_3d_import_is_loaded (Gst3DImport * self)
+{
+  return g_atomic_int_get (&self->loaded);
+}
+
+gboolean
+gst_3d_import_wait (Gst3DImport * self, GError ** error)
+{
+  if (self->thread) {
+    g_thread_join (self->thread);
+    self->thread = NULL;
+  }
+
+  if (self->error) {
+    g_propagate_error (error, g_error_copy (self->error));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+void
+gst_3d_import_free (Gst3DImport * self)
+{
+  if (!self)
+    return;
+
+  if (self->thread)
+    g_thread_join (self->thread);
+
+  g_clear_error (&self->error);
+  g_ptr_array_unref (self->meshes);
+  g_ptr_array_unref (self->lods);
+  if (self->root)
+    _import_node_free (self->root);
+  g_free (self->file);
+  g_free (self);
+}
+
+guint
+gst_3d_import_get_n_meshes (Gst3DImport * self)
+{
+  g_return_val_if_fail (gst_3d_import_is_loaded (self), 0);
+  return self->meshes->len;
+}
+
+/* Returns NULL for meshes without triangles. */
+Gst3DMeshData *
+gst_3d_import_get_mesh (Gst3DImport * self, guint index)
+{
+  g_return_val_if_fail (gst_3d_import_is_loaded (self), NULL);
+  g_return_val_if_fail (index < self->meshes->len, NULL);
+  return g_ptr_array_index (self->meshes, index);
+}
+
+/* Returns NULL unless imported with GST_3D_IMPORT_FLAG_GENERATE_LODS. */
+GPtrArray *
+gst_3d_import_get_lods (Gst3DImport * self, guint index)
+{
+  g_return_val_if_fail (gst_3d_import_is_loaded (self), NULL);
+  g_return_val_if_fail (index < self->lods->len, NULL);
+  return g_ptr_array_index (self->lods, index);
+}
+
+static Gst3DNode *
+_build_node (struct Gst3DImportNode *import_node, GstGLContext * context,
+    GPtrArray * meshes)
+{
+  Gst3DNode *node = gst_3d_node_new (context);
+  node->transform = import_node->transform;
+
+  for (guint i = 0; i < import_node->meshes->len; i++) {
+    guint index = g_array_index (import_node->meshes, guint, i);
+    Gst3DMesh *mesh = g_ptr_array_index (meshes, index);
+    if (mesh)
+      node->meshes = g_list_append (node->meshes, gst_object_ref (mesh));
+  }
+
+  GList *l;
+  for (l = import_node->children; l != NULL; l = l->next)
+    gst_3d_node_append_child (node, _build_node (l->data, context, meshes));
+
+  return node;
+}
+
+/* Must be called on the GL thread. All meshes and their levels of detail
+ * are uploaded with one BufferData for the vertices and one for the
+ * indices. The returned root node draws its children with @shader, which
+ * can be NULL to bind one later. */
+Gst3DNode *
+gst_3d_import_upload (Gst3DImport * self, GstGLContext * context,
+    Gst3DShader * shader)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+
+  if (!gst_3d_import_wait (self, NULL))
+    return NULL;
+
+  GPtrArray *meshes = gst_3d_mesh_new_batch (context, self->meshes,
+      self->lods);
+
+  for (guint i = 0; shader && i < meshes->len; i++) {
+    Gst3DMesh *mesh = g_ptr_array_index (meshes, i);
+    if (mesh)
+      gst_3d_mesh_bind_shader (mesh, shader);
+  }
+
+  Gst3DNode *root = _build_node (self->root, context, meshes);
+  if (shader)
+    root->shader = gst_object_ref (shader);
+
+  g_ptr_array_unref (meshes);
+
+  return root;
+}
@@ -0,0 +1,75 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_IMPORT_H__
+#define __GST_3D_IMPORT_H__
+
+#include <gst/gst.h>
+#include <gst/gl/gstgl_fwd.h>
+
+#include "gst3dmeshdata.h"
+#include "gst3dnode.h"
+#include "gst3dshader.h"
+
+G_BEGIN_DECLS
+
+#define GST_3D_IMPORT_ERROR (gst_3d_import_error_quark ())
+
+typedef enum
+{
+  GST_3D_IMPORT_ERROR_FAILED,
+  GST_3D_IMPORT_ERROR_NO_MESHES,
+} Gst3DImportError;
+
+typedef enum
+{
+  GST_3D_IMPORT_FLAG_NONE = 0,
+  GST_3D_IMPORT_FLAG_OPTIMIZE = (1 << 0),
+  GST_3D_IMPORT_FLAG_GENERATE_LODS = (1 << 1),
+  /* GST_3D_MESH_COMPRESS_DEFAULT, applied after optimization and LODs */
+  GST_3D_IMPORT_FLAG_COMPRESS = (1 << 2),
+  /* additionally half float positions */
+  GST_3D_IMPORT_FLAG_COMPRESS_POSITIONS = (1 << 3),
+  /* one mesh of all triangle meshes with the node transforms applied,
+   * referenced by a single root node */
+  GST_3D_IMPORT_FLAG_MERGE = (1 << 4),
+} Gst3DImportFlags;
+
+typedef struct _Gst3DImport Gst3DImport;
+
+GQuark gst_3d_import_error_quark (void);
+
+Gst3DImport *gst_3d_import_load (const gchar * file, Gst3DImportFlags flags,
+    GError ** error);
+Gst3DImport *gst_3d_import_load_async (const gchar * file,
+    Gst3DImportFlags flags);
+gboolean gst_3d_import_is_loaded (Gst3DImport * self);
+gboolean gst_3d_import_wait (Gst3DImport * self, GError ** error);
+void gst_3d_import_free (Gst3DImport * self);
+
+guint gst_3d_import_get_n_meshes (Gst3DImport * self);
+Gst3DMeshData *gst_3d_import_get_mesh (Gst3DImport * self, guint index);
+GPtrArray *gst_3d_import_get_lods (Gst3DImport * self, guint index);
+
+Gst3DNode *gst_3d_import_upload (Gst3DImport * self, GstGLContext * context,
+    Gst3DShader * shader);
+
+G_END_DECLS
+#endif /* __GST_3D_IMPORT_H__ */
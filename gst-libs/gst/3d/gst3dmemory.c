@@ -0,0 +1,281 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Per GstGLContext accounting of the GPU memory held by Gst3D objects.
+ * Every object that allocates a buffer, texture or program reports its
+ * size here and releases it again when freed, so the totals reflect what
+ * the context currently holds. Sizes are what was requested from GL,
+ * driver padding and internal copies are not visible to us.
+ *
+ * An optional budget only warns, allocations are never refused. It is
+ * meant to find out how many streams fit on one GPU before running out
+ * of memory.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gl/gl.h>
+
+#include "gst3dmemory.h"
+
+#define GST_CAT_DEFAULT gst_3d_memory_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define MEMORY_QUARK gst_3d_memory_quark ()
+
+struct Gst3DMemory
+{
+  GMutex lock;
+  guint64 usage[GST_3D_MEMORY_N_KINDS];
+  guint64 total;
+  guint64 peak;
+  guint64 budget;
+  gboolean over_budget;
+};
+
+static const gchar *kind_names[GST_3D_MEMORY_N_KINDS] = {
+  "buffers", "textures", "programs",
+};
+
+static GQuark
+gst_3d_memory_quark (void)
+{
+  static GQuark quark = 0;
+  if (!quark) {
+    quark = g_quark_from_static_string ("gst-3d-memory");
+    GST_DEBUG_CATEGORY_INIT (gst_3d_memory_debug, "3dmemory", 0,
+        "GPU memory accounting");
+  }
+  return quark;
+}
+
+static void
+_memory_free (struct Gst3DMemory *memory)
+{
+  GST_DEBUG ("context destroyed holding %" G_GUINT64_FORMAT " bytes, peak %"
+      G_GUINT64_FORMAT, memory->total, memory->peak);
+  g_mutex_clear (&memory->lock);
+  g_free (memory);
+}
+
+static struct Gst3DMemory *
+_get_memory (GstGLContext * context)
+{
+  static GMutex create_lock;
+  struct Gst3DMemory *memory;
+
+  g_mutex_lock (&create_lock);
+  memory = g_object_get_qdata (G_OBJECT (context), MEMORY_QUARK);
+  if (!memory) {
+    memory = g_new0 (struct Gst3DMemory, 1);
+    g_mutex_init (&memory->lock);
+    g_object_set_qdata_full (G_OBJECT (context), MEMORY_QUARK, memory,
+        (GDestroyNotify) _memory_free);
+  }
+  g_mutex_unlock (&create_lock);
+
+  return memory;
+}
+
+/* Returns FALSE if the allocation pushed the context over its budget. */
+gboolean
+gst_3d_memory_alloc (GstGLContext * context, Gst3DMemoryKind kind,
+    gsize bytes)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), FALSE);
+  g_return_val_if_fail (kind < GST_3D_MEMORY_N_KINDS, FALSE);
+
+  struct Gst3DMemory *memory = _get_memory (context);
+  gboolean within_budget = TRUE;
+
+  g_mutex_lock (&memory->lock);
+  memory->usage[kind] += bytes;
+  memory->total += bytes;
+  memory->peak = MAX (memory->peak, memory->total);
+
+  if (memory->budget && memory->total > memory->budget) {
+    within_budget = FALSE;
+    /* warn once per crossing, not for every allocation above it */
+    if (!memory->over_budget)
+      GST_WARNING ("%" G_GUINT64_FORMAT " bytes allocated on %" GST_PTR_FORMAT
+          ", over budget of %" G_GUINT64_FORMAT, memory->total, context,
+          memory->budget);
+    memory->over_budget = TRUE;
+  }
+  g_mutex_unlock (&memory->lock);
+
+  GST_LOG ("%s +%" G_GSIZE_FORMAT, kind_names[kind], bytes);
+
+  return within_budget;
+}
+
+void
+gst_3d_memory_release (GstGLContext * context, Gst3DMemoryKind kind,
+    gsize bytes)
+{
+  g_return_if_fail (GST_IS_GL_CONTEXT (context));
+  g_return_if_fail (kind < GST_3D_MEMORY_N_KINDS);
+
+  if (bytes == 0)
+    return;
+
+  struct Gst3DMemory *memory = _get_memory (context);
+
+  g_mutex_lock (&memory->lock);
+  if (bytes > memory->usage[kind]) {
+    GST_ERROR ("releasing %" G_GSIZE_FORMAT " bytes of %s, only %"
+        G_GUINT64_FORMAT " allocated", bytes, kind_names[kind],
+        memory->usage[kind]);
+    bytes = memory->usage[kind];
+  }
+  memory->usage[kind] -= bytes;
+  memory->total -= bytes;
+  if (!memory->budget || memory->total <= memory->budget)
+    memory->over_budget = FALSE;
+  g_mutex_unlock (&memory->lock);
+
+  GST_LOG ("%s -%" G_GSIZE_FORMAT, kind_names[kind], bytes);
+}
+
+guint64
+gst_3d_memory_get_usage (GstGLContext * context, Gst3DMemoryKind kind)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), 0);
+  g_return_val_if_fail (kind < GST_3D_MEMORY_N_KINDS, 0);
+
+  struct Gst3DMemory *memory = _get_memory (context);
+  g_mutex_lock (&memory->lock);
+  guint64 usage = memory->usage[kind];
+  g_mutex_unlock (&memory->lock);
+  return usage;
+}
+
+guint64
+gst_3d_memory_get_total (GstGLContext * context)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), 0);
+
+  struct Gst3DMemory *memory = _get_memory (context);
+  g_mutex_lock (&memory->lock);
+  guint64 total = memory->total;
+  g_mutex_unlock (&memory->lock);
+  return total;
+}
+
+guint64
+gst_3d_memory_get_peak (GstGLContext * context)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), 0);
+
+  struct Gst3DMemory *memory = _get_memory (context);
+  g_mutex_lock (&memory->lock);
+  guint64 peak = memory->peak;
+  g_mutex_unlock (&memory->lock);
+  return peak;
+}
+
+/* 0 disables the budget. */
+void
+gst_3d_memory_set_budget (GstGLContext * context, guint64 bytes)
+{
+  g_return_if_fail (GST_IS_GL_CONTEXT (context));
+
+  struct Gst3DMemory *memory = _get_memory (context);
+  g_mutex_lock (&memory->lock);
+  memory->budget = bytes;
+  memory->over_budget = bytes && memory->total > bytes;
+  if (memory->over_budget)
+    GST_WARNING ("%" G_GUINT64_FORMAT " bytes already allocated, over new "
+        "budget of %" G_GUINT64_FORMAT, memory->total, bytes);
+  g_mutex_unlock (&memory->lock);
+}
+
+guint64
+gst_3d_memory_get_budget (GstGLContext * context)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), 0);
+
+  struct Gst3DMemory *memory = _get_memory (context);
+  g_mutex_lock (&memory->lock);
+  guint64 budget = memory->budget;
+  g_mutex_unlock (&memory->lock);
+  return budget;
+}
+
+/* Snapshot of all counters, in bytes:
+ * gst-3d-memory, buffers=(guint64), textures=(guint64),
+ * programs=(guint64), total=(guint64), peak=(guint64), budget=(guint64) */
+GstStructure *
+gst_3d_memory_get_stats (GstGLContext * context)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+
+  struct Gst3DMemory *memory = _get_memory (context);
+  GstStructure *stats = gst_structure_new_empty (GST_3D_MEMORY_QUERY_NAME);
+
+  g_mutex_lock (&memory->lock);
+  for (guint i = 0; i < GST_3D_MEMORY_N_KINDS; i++)
+    gst_structure_set (stats, kind_names[i], G_TYPE_UINT64, memory->usage[i],
+        NULL);
+  gst_structure_set (stats,
+      "total", G_TYPE_UINT64, memory->total,
+      "peak", G_TYPE_UINT64, memory->peak,
+      "budget", G_TYPE_UINT64, memory->budget, NULL);
+  g_mutex_unlock (&memory->lock);
+
+  return stats;
+}
+
+/* Custom query to be sent to an element using Gst3D. On success its
+ * structure holds the fields of gst_3d_memory_get_stats. */
+GstQuery *
+gst_3d_memory_query_new (void)
+{
+  return gst_query_new_custom (GST_QUERY_CUSTOM,
+      gst_structure_new_empty (GST_3D_MEMORY_QUERY_NAME));
+}
+
+/* Answers a query created by gst_3d_memory_query_new with the stats of
+ * @context. Returns FALSE for any other query. */
+gboolean
+gst_3d_memory_handle_query (GstGLContext * context, GstQuery * query)
+{
+  g_return_val_if_fail (GST_IS_QUERY (query), FALSE);
+
+  if (GST_QUERY_TYPE (query) != GST_QUERY_CUSTOM || !context)
+    return FALSE;
+
+  GstStructure *structure = gst_query_writable_structure (query);
+  if (!gst_structure_has_name (structure, GST_3D_MEMORY_QUERY_NAME))
+    return FALSE;
+
+  GstStructure *stats = gst_3d_memory_get_stats (context);
+  for (guint i = 0; i < gst_structure_n_fields (stats); i++) {
+    const gchar *field = gst_structure_nth_field_name (stats, i);
+    gst_structure_set_value (structure, field,
+        gst_structure_get_value (stats, field));
+  }
+  gst_structure_free (stats);
+
+  return TRUE;
+}
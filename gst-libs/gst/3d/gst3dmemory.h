@@ -0,0 +1,59 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_MEMORY_H__
+#define __GST_3D_MEMORY_H__
+
+#include <gst/gst.h>
+#include <gst/gl/gstgl_fwd.h>
+
+G_BEGIN_DECLS
+
+/* structure name of the GST_QUERY_CUSTOM answered with the memory stats
+ * of an element's GL context */
+#define GST_3D_MEMORY_QUERY_NAME "gst-3d-memory"
+
+typedef enum
+{
+  GST_3D_MEMORY_BUFFER,
+  GST_3D_MEMORY_TEXTURE,
+  GST_3D_MEMORY_PROGRAM,
+  GST_3D_MEMORY_N_KINDS,
+} Gst3DMemoryKind;
+
+gboolean gst_3d_memory_alloc (GstGLContext * context, Gst3DMemoryKind kind,
+    gsize bytes);
+void gst_3d_memory_release (GstGLContext * context, Gst3DMemoryKind kind,
+    gsize bytes);
+
+guint64 gst_3d_memory_get_usage (GstGLContext * context, Gst3DMemoryKind kind);
+guint64 gst_3d_memory_get_total (GstGLContext * context);
+guint64 gst_3d_memory_get_peak (GstGLContext * context);
+
+void gst_3d_memory_set_budget (GstGLContext * context, guint64 bytes);
+guint64 gst_3d_memory_get_budget (GstGLContext * context);
+
+GstStructure *gst_3d_memory_get_stats (GstGLContext * context);
+
+GstQuery *gst_3d_memory_query_new (void);
+gboolean gst_3d_memory_handle_query (GstGLContext * context, GstQuery * query);
+
+G_END_DECLS
+#endif /* __GST_3D_MEMORY_H__ */
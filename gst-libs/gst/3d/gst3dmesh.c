@@ -31,6 +31,10 @@
 #include <gst/gl/gstglfuncs.h>
 
 #include "gst3dmesh.h"
+#include "gst3dgeometry.h"
+#include "gst3dmemory.h"
+#include "gst3dimport.h"
+#include "gst3dglstate.h"
 
 #define GST_CAT_DEFAULT gst_3d_mesh_debug
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -38,12 +42,92 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 G_DEFINE_TYPE_WITH_CODE (Gst3DMesh, gst_3d_mesh, GST_TYPE_OBJECT,
     GST_DEBUG_CATEGORY_INIT (gst_3d_mesh_debug, "3dmesh", 0, "mesh"));
 
+/* Programs are shared between meshes. The procedural mesh that uploaded
+ * its generator parameters last is kept on the program, the others upload
+ * theirs again before drawing with it. */
+#define PROCEDURAL_OWNER_QUARK \
+    g_quark_from_static_string ("gst-3d-mesh-procedural-owner")
+
+struct Gst3DProceduralShader
+{
+  Gst3DProgram *program;
+  guint generation;
+  /* grid_width and grid_height, or radius, stacks and slices */
+  GLint uniforms[3];
+};
+
+static gboolean
+_is_procedural (Gst3DMesh * self)
+{
+  return self->type == GST_3D_MESH_TYPE_PROCEDURAL_SPHERE
+      || self->type == GST_3D_MESH_TYPE_PROCEDURAL_GRID;
+}
+
+/* Strips and fans can hold several primitives separated by
+ * GST_3D_GEOMETRY_RESTART_INDEX, list modes never restart. */
+static gboolean
+_draw_mode_restarts (GLenum draw_mode)
+{
+  return draw_mode == GL_TRIANGLE_STRIP || draw_mode == GL_TRIANGLE_FAN
+      || draw_mode == GL_LINE_STRIP || draw_mode == GL_LINE_LOOP;
+}
+
+static struct Gst3DProceduralShader *
+_find_procedural_shader (Gst3DMesh * self, GLuint program)
+{
+  GList *l;
+  for (l = self->procedural_shaders; l != NULL; l = l->next) {
+    struct Gst3DProceduralShader *entry =
+        (struct Gst3DProceduralShader *) l->data;
+    if (entry->program->handle == program)
+      return entry;
+  }
+  return NULL;
+}
+
+/* Locations are looked up once, a program is never linked again. */
+static struct Gst3DProceduralShader *
+_new_procedural_shader (Gst3DMesh * self, Gst3DProgram * program)
+{
+  const gchar *names[] = { "radius", "stacks", "slices" };
+  struct Gst3DProceduralShader *entry =
+      g_new0 (struct Gst3DProceduralShader, 1);
+
+  if (self->type == GST_3D_MESH_TYPE_PROCEDURAL_GRID) {
+    names[0] = "grid_width";
+    names[1] = "grid_height";
+    names[2] = NULL;
+  }
+
+  entry->program = gst_object_ref (program);
+  entry->generation = self->procedural_generation - 1;
+  for (guint i = 0; i < G_N_ELEMENTS (entry->uniforms); i++)
+    entry->uniforms[i] = names[i] ?
+        gst_3d_program_get_uniform_location (program, names[i]) : -1;
+
+  return entry;
+}
+
 void
 gst_3d_mesh_init (Gst3DMesh * self)
 {
-  self->index_size = 0;
+  self->index_count = 0;
+  self->index_type = GL_UNSIGNED_SHORT;
   self->vao = 0;
+  self->vbo_vertices = 0;
   self->vbo_indices = 0;
+  self->vertex_offset = 0;
+  self->index_offset = 0;
+  self->buffer_owner = NULL;
+  self->layout = GST_3D_MESH_LAYOUT_INTERLEAVED;
+  self->type = GST_3D_MESH_TYPE_BUFFER;
+  self->procedural_shaders = NULL;
+  self->procedural_generation = 0;
+  graphene_point3d_init (&self->bounds_center, 0.f, 0.f, 0.f);
+  self->bounds_radius = 0.f;
+  graphene_box_init_from_box (&self->bounds_box, graphene_box_empty ());
+  self->bounds_valid = FALSE;
+  self->lods = NULL;
 }
 
 Gst3DMesh *
@@ -55,6 +139,22 @@ gst_3d_mesh_new (GstGLContext * context)
   return mesh;
 }
 
+void
+gst_3d_mesh_set_layout (Gst3DMesh * self, Gst3DMeshLayout layout)
+{
+  g_return_if_fail (self->attribute_buffers == NULL);
+  self->layout = layout;
+}
+
+/* Smaller vertex formats for the float attributes appended after this,
+ * as used by the generators. Defaults to GST_3D_MESH_COMPRESS_NONE. */
+void
+gst_3d_mesh_set_compression (Gst3DMesh * self, Gst3DMeshCompressFlags flags)
+{
+  g_return_if_fail (self->attribute_buffers == NULL);
+  self->compression = flags;
+}
+
 Gst3DMesh *
 gst_3d_mesh_new_sphere (GstGLContext * context, float radius, unsigned stacks,
     unsigned slices)
@@ -66,6 +166,52 @@ gst_3d_mesh_new_sphere (GstGLContext * context, float radius, unsigned stacks,
   return mesh;
 }
 
+/* Sphere with @n_levels coarser versions, each with half the stacks and
+ * slices of the previous one. */
+Gst3DMesh *
+gst_3d_mesh_new_sphere_lod (GstGLContext * context, float radius,
+    unsigned stacks, unsigned slices, guint n_levels)
+{
+  Gst3DMesh *mesh = gst_3d_mesh_new_sphere (context, radius, stacks, slices);
+  gfloat screen_size = GST_3D_MESH_LOD_SCREEN_SIZE;
+
+  for (guint level = 1; level <= n_levels; level++) {
+    unsigned lod_stacks = MAX (stacks >> level, 4);
+    unsigned lod_slices = MAX (slices >> level, 4);
+    gst_3d_mesh_add_lod (mesh, gst_3d_mesh_new_sphere (context, radius,
+            lod_stacks, lod_slices), screen_size);
+    screen_size *= 0.5f;
+    if (lod_stacks == 4 && lod_slices == 4)
+      break;
+  }
+
+  return mesh;
+}
+
+Gst3DMesh *
+gst_3d_mesh_new_procedural_sphere (GstGLContext * context, float radius,
+    unsigned stacks, unsigned slices)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+  Gst3DMesh *mesh = gst_3d_mesh_new (context);
+  gst_3d_mesh_init_buffers (mesh);
+  gst_3d_mesh_upload_procedural_sphere (mesh, radius, stacks, slices);
+  return mesh;
+}
+
+/* Mesh for geometry that changes every frame, see
+ * gst_3d_mesh_update_data. gst_3d_mesh_upload_line also streams into
+ * dynamic meshes. */
+Gst3DMesh *
+gst_3d_mesh_new_dynamic (GstGLContext * context)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+  Gst3DMesh *mesh = gst_3d_mesh_new (context);
+  mesh->type = GST_3D_MESH_TYPE_DYNAMIC;
+  gst_3d_mesh_init_buffers (mesh);
+  return mesh;
+}
+
 Gst3DMesh *
 gst_3d_mesh_new_plane (GstGLContext * context, float aspect)
 {
@@ -88,6 +234,17 @@ gst_3d_mesh_new_point_plane (GstGLContext * context, unsigned width,
   return mesh;
 }
 
+Gst3DMesh *
+gst_3d_mesh_new_procedural_grid (GstGLContext * context, unsigned width,
+    unsigned height)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+  Gst3DMesh *mesh = gst_3d_mesh_new (context);
+  gst_3d_mesh_init_buffers (mesh);
+  gst_3d_mesh_upload_procedural_grid (mesh, width, height);
+  return mesh;
+}
+
 Gst3DMesh *
 gst_3d_mesh_new_line (GstGLContext * context, graphene_vec3_t * from,
     graphene_vec3_t * to, graphene_vec3_t * color)
@@ -119,6 +276,23 @@ gst_3d_mesh_new_assimp (GstGLContext * context, const char *file)
   return mesh;
 }
 
+static void
+_clear_attribute_buffers (Gst3DMesh * self)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+  GList *l;
+
+  for (l = self->attribute_buffers; l != NULL; l = l->next) {
+    struct Gst3DAttributeBuffer *buf = (struct Gst3DAttributeBuffer *) l->data;
+    if (buf->location)
+      gl->DeleteBuffers (1, (GLuint *) & buf->location);
+    g_free (buf->data);
+    g_free (buf);
+  }
+  g_list_free (self->attribute_buffers);
+  self->attribute_buffers = NULL;
+}
+
 static void
 gst_3d_mesh_finalize (GObject * object)
 {
@@ -126,21 +300,64 @@ gst_3d_mesh_finalize (GObject * object)
   g_return_if_fail (self != NULL);
 
   GstGLFuncs *gl = self->context->gl_vtable;
+  GList *l;
+
   if (self->vao) {
     gl->DeleteVertexArrays (1, &self->vao);
+    gst_3d_gl_state_invalidate (self->context);
     self->vao = 0;
   }
 
-  GList *l;
-  for (l = self->attribute_buffers; l != NULL; l = l->next) {
-    struct Gst3DAttributeBuffer *buf = (struct Gst3DAttributeBuffer *) l->data;
-    gl->DeleteBuffers (1, &buf->location);
-    g_free (buf);
+  _clear_attribute_buffers (self);
+
+  if (self->buffer_owner) {
+    gst_object_unref (self->buffer_owner);
+    self->buffer_owner = NULL;
+  } else {
+    if (self->vbo_vertices)
+      gl->DeleteBuffers (1, &self->vbo_vertices);
+    if (self->vbo_indices)
+      gl->DeleteBuffers (1, &self->vbo_indices);
   }
+  self->vbo_vertices = 0;
+  self->vbo_indices = 0;
 
-  if (self->vbo_indices) {
-    gl->DeleteBuffers (1, &self->vbo_indices);
-    self->vbo_indices = 0;
+  for (l = self->instance_buffers; l != NULL; l = l->next) {
+    struct Gst3DInstanceBuffer *buf = (struct Gst3DInstanceBuffer *) l->data;
+    gl->DeleteBuffers (1, &buf->vbo);
+    g_free (buf);
+  }
+  g_list_free (self->instance_buffers);
+  self->instance_buffers = NULL;
+
+  gst_3d_memory_release (self->context, GST_3D_MEMORY_BUFFER,
+      self->vertex_bytes + self->index_bytes);
+  self->vertex_bytes = 0;
+  self->index_bytes = 0;
+
+  for (l = self->procedural_shaders; l != NULL; l = l->next) {
+    struct Gst3DProceduralShader *entry =
+        (struct Gst3DProceduralShader *) l->data;
+    GObject *program = G_OBJECT (entry->program);
+    if (g_object_get_qdata (program, PROCEDURAL_OWNER_QUARK) == self)
+      g_object_set_qdata (program, PROCEDURAL_OWNER_QUARK, NULL);
+    gst_object_unref (entry->program);
+    g_free (entry);
+  }
+  g_list_free (self->procedural_shaders);
+  self->procedural_shaders = NULL;
+
+  gst_3d_stream_buffer_free (self->stream_vertices);
+  self->stream_vertices = NULL;
+  gst_3d_stream_buffer_free (self->stream_indices);
+  self->stream_indices = NULL;
+
+  if (self->lods) {
+    for (guint i = 0; i < self->lods->len; i++)
+      gst_object_unref (g_array_index (self->lods, struct Gst3DMeshLod,
+              i).mesh);
+    g_array_free (self->lods, TRUE);
+    self->lods = NULL;
   }
 
   if (self->context) {
@@ -167,15 +384,55 @@ gst_3d_mesh_init_buffers (Gst3DMesh * self)
   GstGLFuncs *gl = self->context->gl_vtable;
 
   gl->GenVertexArrays (1, &self->vao);
-  gl->BindVertexArray (self->vao);
+  gst_3d_gl_state_bind_vertex_array (self->context, self->vao);
   gl->GenBuffers (1, &self->vbo_indices);
 }
 
 void
 gst_3d_mesh_bind (Gst3DMesh * self)
+{
+  gst_3d_gl_state_bind_vertex_array (self->context, self->vao);
+}
+
+/* Points the attributes of the VAO at the segments written by the last
+ * update. Expects the VAO to be bound. */
+static void
+_bind_dynamic_attributes (Gst3DMesh * self)
 {
   GstGLFuncs *gl = self->context->gl_vtable;
-  gl->BindVertexArray (self->vao);
+
+  if (!self->stream_vertices)
+    return;
+
+  gl->BindBuffer (GL_ARRAY_BUFFER,
+      gst_3d_stream_buffer_get_id (self->stream_vertices));
+
+  GList *l;
+  for (l = self->attribute_buffers; l != NULL; l = l->next) {
+    struct Gst3DAttributeBuffer *buf = (struct Gst3DAttributeBuffer *) l->data;
+    if (buf->shader_location == -1)
+      continue;
+    gl->VertexAttribPointer (buf->shader_location, buf->vector_length,
+        buf->type, buf->normalized, buf->stride, (const GLvoid *) buf->offset);
+    gl->EnableVertexAttribArray (buf->shader_location);
+  }
+
+  gl->BindBuffer (GL_ELEMENT_ARRAY_BUFFER,
+      gst_3d_stream_buffer_get_id (self->stream_indices));
+}
+
+/* Fixed location of the attribute @name, or -1 if the shaders do not
+ * pin it. */
+GLint
+gst_3d_mesh_attribute_location (const gchar * name)
+{
+  if (g_strcmp0 (name, "position") == 0)
+    return GST_3D_MESH_POSITION_LOCATION;
+  if (g_strcmp0 (name, "uv") == 0 || g_strcmp0 (name, "color") == 0)
+    return GST_3D_MESH_UV_LOCATION;
+  if (g_strcmp0 (name, "normal") == 0)
+    return GST_3D_MESH_NORMAL_LOCATION;
+  return -1;
 }
 
 void
@@ -183,25 +440,65 @@ gst_3d_mesh_bind_shader (Gst3DMesh * self, Gst3DShader * shader)
 {
   GstGLFuncs *gl = self->context->gl_vtable;
 
+  /* bind the levels first so the VAO of @self stays bound */
+  if (self->lods)
+    for (guint i = 0; i < self->lods->len; i++)
+      gst_3d_mesh_bind_shader (g_array_index (self->lods, struct Gst3DMeshLod,
+              i).mesh, shader);
+
   gst_3d_shader_bind (shader);
 
+  if (self->type == GST_3D_MESH_TYPE_DYNAMIC) {
+    GList *l;
+    for (l = self->attribute_buffers; l != NULL; l = l->next) {
+      struct Gst3DAttributeBuffer *buf =
+          (struct Gst3DAttributeBuffer *) l->data;
+      buf->shader_location =
+          gst_3d_program_get_attribute_location (shader->program, buf->name);
+    }
+    gst_3d_gl_state_bind_vertex_array (self->context, self->vao);
+    _bind_dynamic_attributes (self);
+    return;
+  }
+
+  if (_is_procedural (self)) {
+    /* the geometry comes from gl_VertexID, only remember the program
+     * to upload the generator parameters when drawing with it */
+    if (!_find_procedural_shader (self, shader->program->handle))
+      self->procedural_shaders = g_list_append (self->procedural_shaders,
+          _new_procedural_shader (self, shader->program));
+    gst_3d_gl_state_bind_vertex_array (self->context, self->vao);
+    return;
+  }
+
+  gst_3d_mesh_upload_attributes (self);
+
+  gst_3d_gl_state_bind_vertex_array (self->context, self->vao);
+
+  /* interleaved meshes keep all attributes in one buffer, bind it once */
+  if (self->layout == GST_3D_MESH_LAYOUT_INTERLEAVED)
+    gl->BindBuffer (GL_ARRAY_BUFFER, self->vbo_vertices);
+
   GList *l;
   for (l = self->attribute_buffers; l != NULL; l = l->next) {
     struct Gst3DAttributeBuffer *buf = (struct Gst3DAttributeBuffer *) l->data;
-    GST_DEBUG ("%s: location: %d length: %d size: %zu", buf->name,
-        buf->location, buf->vector_length, buf->element_size);
+    GST_DEBUG ("%s: location: %d length: %d size: %zu offset: %zu stride: %zu",
+        buf->name, buf->location, buf->vector_length, buf->element_size,
+        buf->offset, buf->stride);
 
-    gl->BindBuffer (GL_ARRAY_BUFFER, buf->location);
+    if (self->layout == GST_3D_MESH_LAYOUT_SEPARATE)
+      gl->BindBuffer (GL_ARRAY_BUFFER, buf->location);
 
     GLint attrib_location =
-        gst_gl_shader_get_attribute_location (shader->shader, buf->name);
+        gst_3d_program_get_attribute_location (shader->program, buf->name);
 
     if (attrib_location != -1) {
-      gl->VertexAttribPointer (attrib_location, buf->vector_length, GL_FLOAT,
-          GL_FALSE, 0, 0);
+      gl->VertexAttribPointer (attrib_location, buf->vector_length,
+          buf->type, buf->normalized, buf->stride,
+          (const GLvoid *) (self->vertex_offset + buf->offset));
       gl->EnableVertexAttribArray (attrib_location);
     } else {
-      GST_WARNING ("could not find attribute %s in shader.", buf->name);
+      GST_DEBUG ("could not find attribute %s in shader.", buf->name);
     }
   }
   gl->BindBuffer (GL_ELEMENT_ARRAY_BUFFER, self->vbo_indices);
@@ -216,59 +513,660 @@ gst_3d_mesh_unbind_buffers (Gst3DMesh * self)
   gl->BindBuffer (GL_ARRAY_BUFFER, 0);
 }
 
+/* Uploads the generator parameters to the program in use, unless it still
+ * holds the current ones of this mesh. The program comes from the bind
+ * cache, so drawing inside a gst_3d_gl_state_begin() scope does not query
+ * GL.
+ */
+static void
+_upload_procedural_uniforms (Gst3DMesh * self)
+{
+  struct Gst3DProceduralShader *entry = _find_procedural_shader (self,
+      gst_3d_gl_state_get_program (self->context));
+  if (!entry)
+    return;
+
+  GObject *program = G_OBJECT (entry->program);
+  if (g_object_get_qdata (program, PROCEDURAL_OWNER_QUARK) == self
+      && entry->generation == self->procedural_generation)
+    return;
+
+  GstGLFuncs *gl = self->context->gl_vtable;
+  if (self->type == GST_3D_MESH_TYPE_PROCEDURAL_GRID) {
+    gl->Uniform1i (entry->uniforms[0], self->grid_width);
+    gl->Uniform1i (entry->uniforms[1], self->grid_height);
+  } else {
+    gl->Uniform1f (entry->uniforms[0], self->radius);
+    gl->Uniform1i (entry->uniforms[1], self->stacks);
+    gl->Uniform1i (entry->uniforms[2], self->slices);
+  }
+  g_object_set_qdata (program, PROCEDURAL_OWNER_QUARK, self);
+  entry->generation = self->procedural_generation;
+}
+
+/* Toggles primitive restart around drawing the index buffer of @self as
+ * @draw_mode. Only strips and fans are restarted, disabling is always
+ * passed on to the state cache, which keeps restart enabled within a
+ * gst_3d_gl_state_begin scope. */
+void
+gst_3d_mesh_set_primitive_restart (Gst3DMesh * self, GLenum draw_mode,
+    gboolean enable)
+{
+  if (_is_procedural (self) || (enable && !_draw_mode_restarts (draw_mode)))
+    return;
+
+  gst_3d_gl_state_primitive_restart (self->context, self->index_type, enable);
+}
+
 void
 gst_3d_mesh_draw (Gst3DMesh * self)
 {
-  GstGLFuncs *gl = self->context->gl_vtable;
-  gl->DrawElements (self->draw_mode, self->index_size, GL_UNSIGNED_SHORT, 0);
+  gst_3d_mesh_draw_mode (self, self->draw_mode);
 }
 
 void
 gst_3d_mesh_draw_mode (Gst3DMesh * self, GLenum draw_mode)
 {
   GstGLFuncs *gl = self->context->gl_vtable;
-  gl->DrawElements (draw_mode, self->index_size, GL_UNSIGNED_SHORT, 0);
+
+  if (self->type == GST_3D_MESH_TYPE_PROCEDURAL_SPHERE) {
+    _upload_procedural_uniforms (self);
+    gl->DrawArraysInstanced (draw_mode, 0, self->stacks * 2,
+        self->slices - 1);
+    return;
+  }
+
+  if (_is_procedural (self)) {
+    _upload_procedural_uniforms (self);
+    gl->DrawArrays (draw_mode, 0, self->vertex_count);
+    return;
+  }
+
+  /* buffers drawn in vertex order, like the point plane */
+  if (self->index_count == 0) {
+    gl->DrawArrays (draw_mode, 0, self->vertex_count);
+    return;
+  }
+
+  gst_3d_mesh_set_primitive_restart (self, draw_mode, TRUE);
+  gl->DrawElements (draw_mode, self->index_count, self->index_type,
+      (const GLvoid *) self->index_offset);
+  gst_3d_mesh_set_primitive_restart (self, draw_mode, FALSE);
 }
 
 void
 gst_3d_mesh_draw_arrays (Gst3DMesh * self)
 {
   GstGLFuncs *gl = self->context->gl_vtable;
-  gl->DrawArrays (self->draw_mode, 0, self->index_size);
+
+  if (self->type == GST_3D_MESH_TYPE_PROCEDURAL_SPHERE) {
+    gst_3d_mesh_draw (self);
+    return;
+  }
+
+  if (_is_procedural (self))
+    _upload_procedural_uniforms (self);
+  gl->DrawArrays (self->draw_mode, 0, self->vertex_count);
+}
+
+static void
+_read_position (const guint8 * data, GLenum type, gfloat * position)
+{
+  if (type == GL_HALF_FLOAT) {
+    const guint16 *half = (const guint16 *) data;
+    for (guint i = 0; i < 3; i++)
+      position[i] = gst_3d_mesh_compress_half_to_float (half[i]);
+  } else {
+    memcpy (position, data, 3 * sizeof (gfloat));
+  }
+}
+
+static void
+_update_bounds (Gst3DMesh * self, const guint8 * positions, GLenum type,
+    gsize stride, guint count)
+{
+  gfloat min[3] = { G_MAXFLOAT, G_MAXFLOAT, G_MAXFLOAT };
+  gfloat max[3] = { -G_MAXFLOAT, -G_MAXFLOAT, -G_MAXFLOAT };
+  gfloat p[3];
+
+  if (count == 0)
+    return;
+
+  for (guint v = 0; v < count; v++) {
+    _read_position (positions + v * stride, type, p);
+    for (guint i = 0; i < 3; i++) {
+      min[i] = MIN (min[i], p[i]);
+      max[i] = MAX (max[i], p[i]);
+    }
+  }
+
+  graphene_point3d_init (&self->bounds_center, (min[0] + max[0]) * 0.5f,
+      (min[1] + max[1]) * 0.5f, (min[2] + max[2]) * 0.5f);
+  graphene_box_init (&self->bounds_box,
+      &GRAPHENE_POINT3D_INIT (min[0], min[1], min[2]),
+      &GRAPHENE_POINT3D_INIT (max[0], max[1], max[2]));
+  self->bounds_valid = TRUE;
+
+  gfloat radius2 = 0.f;
+  for (guint v = 0; v < count; v++) {
+    _read_position (positions + v * stride, type, p);
+    gfloat dx = p[0] - self->bounds_center.x;
+    gfloat dy = p[1] - self->bounds_center.y;
+    gfloat dz = p[2] - self->bounds_center.z;
+    radius2 = MAX (radius2, dx * dx + dy * dy + dz * dz);
+  }
+  self->bounds_radius = sqrtf (radius2);
+}
+
+static void
+_account_vertices (Gst3DMesh * self, gsize bytes)
+{
+  self->vertex_bytes += bytes;
+  gst_3d_memory_alloc (self->context, GST_3D_MEMORY_BUFFER, bytes);
+}
+
+/* index buffers are replaced by every upload, not appended to */
+static void
+_account_indices (Gst3DMesh * self, gsize bytes)
+{
+  gst_3d_memory_release (self->context, GST_3D_MEMORY_BUFFER,
+      self->index_bytes);
+  self->index_bytes = bytes;
+  gst_3d_memory_alloc (self->context, GST_3D_MEMORY_BUFFER, bytes);
+}
+
+static struct Gst3DInstanceBuffer *
+_find_instance_buffer (Gst3DMesh * self, guint location)
+{
+  GList *l;
+  for (l = self->instance_buffers; l != NULL; l = l->next) {
+    struct Gst3DInstanceBuffer *buf = (struct Gst3DInstanceBuffer *) l->data;
+    if (buf->location == location)
+      return buf;
+  }
+  return NULL;
+}
+
+/* Expects the VAO and the instance buffer to be bound. */
+static void
+_setup_instance_attribute (Gst3DMesh * self, struct Gst3DInstanceBuffer *buf)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+  guint column_length = MIN (buf->vector_length, 4);
+  guint columns = buf->vector_length / column_length;
+  gsize stride = buf->vector_length * sizeof (GLfloat);
+
+  for (guint c = 0; c < columns; c++) {
+    gl->VertexAttribPointer (buf->location + c, column_length, GL_FLOAT,
+        GL_FALSE, stride, (const GLvoid *) (c * column_length *
+            sizeof (GLfloat)));
+    gl->EnableVertexAttribArray (buf->location + c);
+    gl->VertexAttribDivisor (buf->location + c, buf->divisor);
+  }
+}
+
+/* Uploads @count per instance vectors to the attribute at @location,
+ * advancing every @divisor instances. The storage is orphaned on every
+ * upload, so it can be refilled each frame without waiting for the
+ * previous draw. Leaves the VAO of @self bound. */
+void
+gst_3d_mesh_upload_instance_attribute (Gst3DMesh * self, guint location,
+    guint vector_length, guint divisor, const gfloat * data, guint count)
+{
+  g_return_if_fail (vector_length > 0);
+  g_return_if_fail (vector_length <= 4 || vector_length % 4 == 0);
+
+  GstGLFuncs *gl = self->context->gl_vtable;
+  struct Gst3DInstanceBuffer *buf = _find_instance_buffer (self, location);
+  gboolean setup = FALSE;
+
+  gst_3d_gl_state_bind_vertex_array (self->context, self->vao);
+
+  if (!buf) {
+    buf = g_new0 (struct Gst3DInstanceBuffer, 1);
+    buf->location = location;
+    gl->GenBuffers (1, &buf->vbo);
+    self->instance_buffers = g_list_append (self->instance_buffers, buf);
+    setup = TRUE;
+  }
+
+  if (buf->vector_length != vector_length || buf->divisor != divisor) {
+    buf->vector_length = vector_length;
+    buf->divisor = divisor;
+    setup = TRUE;
+  }
+
+  gl->BindBuffer (GL_ARRAY_BUFFER, buf->vbo);
+  if (setup)
+    _setup_instance_attribute (self, buf);
+
+  gsize size = (gsize) count * vector_length * sizeof (GLfloat);
+  if (size > buf->size) {
+    gst_3d_memory_release (self->context, GST_3D_MEMORY_BUFFER, buf->size);
+    self->vertex_bytes -= buf->size;
+    buf->size = size;
+    _account_vertices (self, size);
+    gl->BufferData (GL_ARRAY_BUFFER, size, data, GL_STREAM_DRAW);
+  } else {
+    gl->BufferData (GL_ARRAY_BUFFER, buf->size, NULL, GL_STREAM_DRAW);
+    gl->BufferSubData (GL_ARRAY_BUFFER, 0, size, data);
+  }
+}
+
+/* One mat4 per instance at GST_3D_MESH_INSTANCE_LOCATION. */
+void
+gst_3d_mesh_upload_instance_transforms (Gst3DMesh * self,
+    const graphene_matrix_t * transforms, guint count)
+{
+  gfloat *data = g_new (gfloat, (gsize) count * 16);
+  for (guint i = 0; i < count; i++)
+    graphene_matrix_to_float (&transforms[i], &data[i * 16]);
+
+  gst_3d_mesh_upload_instance_attribute (self, GST_3D_MESH_INSTANCE_LOCATION,
+      16, 1, data, count);
+
+  g_free (data);
+}
+
+/* Draws @instance_count instances with a single call. The mesh has to be
+ * bound and its instance attributes uploaded. The procedural sphere uses
+ * its instances for the rows and can not be instanced further. */
+void
+gst_3d_mesh_draw_instanced (Gst3DMesh * self, guint instance_count)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  g_return_if_fail (self->type != GST_3D_MESH_TYPE_PROCEDURAL_SPHERE);
+
+  if (_is_procedural (self)) {
+    _upload_procedural_uniforms (self);
+    gl->DrawArraysInstanced (self->draw_mode, 0, self->vertex_count,
+        instance_count);
+    return;
+  }
+
+  if (self->index_count == 0) {
+    gl->DrawArraysInstanced (self->draw_mode, 0, self->vertex_count,
+        instance_count);
+    return;
+  }
+
+  gst_3d_mesh_set_primitive_restart (self, self->draw_mode, TRUE);
+  gl->DrawElementsInstanced (self->draw_mode, self->index_count,
+      self->index_type, (const GLvoid *) self->index_offset, instance_count);
+  gst_3d_mesh_set_primitive_restart (self, self->draw_mode, FALSE);
 }
 
+/* Appends a float attribute. If the mesh compression selects a smaller
+ * format for @name, the attribute is converted before upload. */
 void
 gst_3d_mesh_append_attribute_buffer (Gst3DMesh * self, const gchar * name,
     size_t element_size, guint vector_length, GLfloat * vertices)
 {
   struct Gst3DAttributeBuffer *attrib_buffer =
-      malloc (sizeof (struct Gst3DAttributeBuffer));
+      g_new0 (struct Gst3DAttributeBuffer, 1);
 
   GstGLFuncs *gl = self->context->gl_vtable;
 
   attrib_buffer->name = name;
   attrib_buffer->element_size = element_size;
   attrib_buffer->vector_length = vector_length;
+  attrib_buffer->type = GL_FLOAT;
+  attrib_buffer->normalized = GL_FALSE;
+  attrib_buffer->shader_location = -1;
+
+  if (g_strcmp0 (name, "position") == 0 && vector_length >= 3)
+    _update_bounds (self, (const guint8 *) vertices, GL_FLOAT,
+        vector_length * element_size, self->vertex_count);
+
+  gpointer packed = NULL;
+  if (self->compression && element_size == sizeof (GLfloat)) {
+    struct Gst3DMeshDataAttribute format;
+    packed = gst_3d_mesh_compress_attribute (name, (const guint8 *) vertices,
+        vector_length * element_size, self->vertex_count, vector_length,
+        self->compression, &format);
+    if (packed) {
+      attrib_buffer->element_size = format.element_size;
+      attrib_buffer->vector_length = format.vector_length;
+      attrib_buffer->type = format.type;
+      attrib_buffer->normalized = format.normalized;
+      vertices = packed;
+    }
+  }
 
-  gl->GenBuffers (1, &attrib_buffer->location);
+  gsize size = self->vertex_count *
+      gst_3d_mesh_data_attribute_size (attrib_buffer->type,
+      attrib_buffer->vector_length, attrib_buffer->element_size);
 
-  GST_DEBUG ("generated %s buffer #%d", attrib_buffer->name,
-      attrib_buffer->location);
+  if (self->layout == GST_3D_MESH_LAYOUT_INTERLEAVED) {
+    /* keep a copy until all attributes are known, see
+     * gst_3d_mesh_upload_attributes */
+    attrib_buffer->data = packed ? packed : g_memdup (vertices, size);
+    packed = NULL;
+  } else {
+    gl->GenBuffers (1, (GLuint *) & attrib_buffer->location);
 
-  gl->BindBuffer (GL_ARRAY_BUFFER, attrib_buffer->location);
-  gl->BufferData (GL_ARRAY_BUFFER,
-      self->vertex_count * attrib_buffer->vector_length *
-      attrib_buffer->element_size, vertices, GL_STATIC_DRAW);
+    GST_DEBUG ("generated %s buffer #%d", attrib_buffer->name,
+        attrib_buffer->location);
+
+    gl->BindBuffer (GL_ARRAY_BUFFER, attrib_buffer->location);
+    gl->BufferData (GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+    _account_vertices (self, size);
+  }
+
+  g_free (packed);
 
   self->attribute_buffers =
       g_list_append (self->attribute_buffers, attrib_buffer);
 }
 
+/* Packs the pending attributes of an interleaved mesh into a single
+ * vertex buffer. Every vertex holds all of its attributes next to each
+ * other, which is friendlier to the vertex fetch cache than one buffer
+ * per attribute. Does nothing for separate layouts or if already uploaded.
+ */
 void
-gst_3d_mesh_upload_plane (Gst3DMesh * self, float aspect)
+gst_3d_mesh_upload_attributes (Gst3DMesh * self)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+  GList *l;
+  gsize stride = 0;
+
+  if (self->layout != GST_3D_MESH_LAYOUT_INTERLEAVED || self->vbo_vertices)
+    return;
+
+  if (self->attribute_buffers == NULL)
+    return;
+
+  for (l = self->attribute_buffers; l != NULL; l = l->next) {
+    struct Gst3DAttributeBuffer *buf = (struct Gst3DAttributeBuffer *) l->data;
+    buf->offset = stride;
+    stride += gst_3d_mesh_data_attribute_size (buf->type, buf->vector_length,
+        buf->element_size);
+  }
+
+  guint8 *interleaved = g_malloc (self->vertex_count * stride);
+
+  for (l = self->attribute_buffers; l != NULL; l = l->next) {
+    struct Gst3DAttributeBuffer *buf = (struct Gst3DAttributeBuffer *) l->data;
+    gsize attrib_size = gst_3d_mesh_data_attribute_size (buf->type,
+        buf->vector_length, buf->element_size);
+    const guint8 *src = buf->data;
+    guint8 *dst = interleaved + buf->offset;
+
+    for (guint i = 0; i < self->vertex_count; i++) {
+      memcpy (dst, src, attrib_size);
+      src += attrib_size;
+      dst += stride;
+    }
+
+    buf->stride = stride;
+    g_free (buf->data);
+    buf->data = NULL;
+  }
+
+  gl->GenBuffers (1, &self->vbo_vertices);
+  GST_DEBUG ("generated interleaved buffer #%d, stride %zu",
+      self->vbo_vertices, stride);
+
+  gl->BindBuffer (GL_ARRAY_BUFFER, self->vbo_vertices);
+  gl->BufferData (GL_ARRAY_BUFFER, self->vertex_count * stride, interleaved,
+      GL_STATIC_DRAW);
+  _account_vertices (self, self->vertex_count * stride);
+
+  g_free (interleaved);
+}
+
+/* Largest index other than the restart index. */
+static GLuint
+_max_index (const GLuint * indices, guint count)
+{
+  GLuint max_index = 0;
+
+  for (guint i = 0; i < count; i++)
+    if (indices[i] != GST_3D_GEOMETRY_RESTART_INDEX && indices[i] > max_index)
+      max_index = indices[i];
+
+  return max_index;
+}
+
+static gboolean
+_has_restart_index (const GLuint * indices, guint count)
+{
+  for (guint i = 0; i < count; i++)
+    if (indices[i] == GST_3D_GEOMETRY_RESTART_INDEX)
+      return TRUE;
+  return FALSE;
+}
+
+static gboolean
+_needs_unroll (Gst3DMesh * self)
+{
+  return _draw_mode_restarts (self->draw_mode)
+      && !gst_3d_gl_state_has_primitive_restart (self->context);
+}
+
+/* Without primitive restart the separators would be drawn as vertices, so
+ * the mesh is drawn as joined strips or as lists instead. Replaces
+ * @indices and @count and returns the array to free, or NULL if they are
+ * drawn as they are. */
+static GLuint *
+_unroll_restarts (Gst3DMesh * self, const GLuint ** indices, guint * count)
+{
+  if (!_needs_unroll (self) || !_has_restart_index (*indices, *count))
+    return NULL;
+
+  guint draw_mode = self->draw_mode;
+  GLuint *unrolled = gst_3d_mesh_data_unroll_restarts (*indices, *count,
+      &draw_mode, count);
+  GST_DEBUG ("no primitive restart, drawing 0x%x as 0x%x", self->draw_mode,
+      draw_mode);
+  self->draw_mode = draw_mode;
+  *indices = unrolled;
+
+  return unrolled;
+}
+
+/* G_MAXUINT16 is the restart index of 16 bit buffers, so it can not be
+ * used as a vertex index. */
+static GLenum
+_index_type (GLuint max_index)
+{
+  return max_index < G_MAXUINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+static void
+_convert_short_indices (GLushort * dest, const GLuint * indices, guint count)
+{
+  for (guint i = 0; i < count; i++)
+    dest[i] = indices[i] == GST_3D_GEOMETRY_RESTART_INDEX ?
+        G_MAXUINT16 : indices[i];
+}
+
+/* Uploads the index buffer and stores the exact element count. Indices
+ * are stored as 16 bit when every index fits, 32 bit otherwise, so large
+ * meshes stay drawable while small ones use half the index memory.
+ * GST_3D_GEOMETRY_RESTART_INDEX is kept as restart index of either size.
+ */
+void
+gst_3d_mesh_upload_indices (Gst3DMesh * self, const GLuint * indices,
+    guint count)
 {
   GstGLFuncs *gl = self->context->gl_vtable;
+  GLuint *unrolled = _unroll_restarts (self, &indices, &count);
+  GLuint max_index = _max_index (indices, count);
+
+  self->index_count = count;
+
+  gl->BindBuffer (GL_ELEMENT_ARRAY_BUFFER, self->vbo_indices);
+
+  if (_index_type (max_index) == GL_UNSIGNED_SHORT) {
+    GLushort *short_indices = g_new (GLushort, count);
+    _convert_short_indices (short_indices, indices, count);
+
+    self->index_type = GL_UNSIGNED_SHORT;
+    gl->BufferData (GL_ELEMENT_ARRAY_BUFFER, count * sizeof (GLushort),
+        short_indices, GL_STATIC_DRAW);
+    _account_indices (self, count * sizeof (GLushort));
+    g_free (short_indices);
+  } else {
+    self->index_type = GL_UNSIGNED_INT;
+    gl->BufferData (GL_ELEMENT_ARRAY_BUFFER, count * sizeof (GLuint),
+        indices, GL_STATIC_DRAW);
+    _account_indices (self, count * sizeof (GLuint));
+  }
+
+  GST_DEBUG ("uploaded %d indices of type 0x%x, max index %d", count,
+      self->index_type, max_index);
+
+  g_free (unrolled);
+}
+
+static void
+_append_data_attributes (Gst3DMesh * self, const Gst3DMeshData * data)
+{
+  for (guint i = 0; i < data->n_attributes; i++) {
+    const struct Gst3DMeshDataAttribute *attrib = &data->attributes[i];
+    struct Gst3DAttributeBuffer *attrib_buffer =
+        g_new0 (struct Gst3DAttributeBuffer, 1);
+
+    attrib_buffer->name = attrib->name;
+    attrib_buffer->element_size = attrib->element_size;
+    attrib_buffer->vector_length = attrib->vector_length;
+    attrib_buffer->type = attrib->type;
+    attrib_buffer->normalized = attrib->normalized;
+    attrib_buffer->offset = attrib->offset;
+    attrib_buffer->stride = data->stride;
+    attrib_buffer->shader_location = -1;
+
+    self->attribute_buffers =
+        g_list_append (self->attribute_buffers, attrib_buffer);
+  }
+}
+
+static void
+_update_data_bounds (Gst3DMesh * self, const Gst3DMeshData * data)
+{
+  gint position =
+      gst_3d_mesh_data_find_attribute ((Gst3DMeshData *) data, "position");
+  if (position != -1 && data->attributes[position].vector_length >= 3)
+    _update_bounds (self, data->vertices + data->attributes[position].offset,
+        data->attributes[position].type, data->stride, data->vertex_count);
+}
+
+/* Uploads CPU side mesh data. The vertex blob is already interleaved, so
+ * it goes to the GPU as is, only the attribute descriptors are copied.
+ */
+void
+gst_3d_mesh_upload_data (Gst3DMesh * self, const Gst3DMeshData * data)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  g_return_if_fail (self->attribute_buffers == NULL);
+
+  self->layout = GST_3D_MESH_LAYOUT_INTERLEAVED;
+  self->vertex_count = data->vertex_count;
+  self->draw_mode = data->draw_mode;
+
+  _append_data_attributes (self, data);
+
+  gl->GenBuffers (1, &self->vbo_vertices);
+  gl->BindBuffer (GL_ARRAY_BUFFER, self->vbo_vertices);
+  gl->BufferData (GL_ARRAY_BUFFER, data->vertex_count * data->stride,
+      data->vertices, GL_STATIC_DRAW);
+  _account_vertices (self, data->vertex_count * data->stride);
+
+  _update_data_bounds (self, data);
+
+  gst_3d_mesh_upload_indices (self, data->indices, data->index_count);
+}
+
+static void
+_append_file_attributes (Gst3DMesh * self, Gst3DMeshFile * file,
+    guint index)
+{
+  const Gst3DMeshFileEntry *entry = gst_3d_mesh_file_get_entry (file, index);
+
+  self->layout = GST_3D_MESH_LAYOUT_INTERLEAVED;
+  self->vertex_count = entry->vertex_count;
+  self->draw_mode = entry->draw_mode;
+
+  for (guint i = 0; i < entry->n_attributes; i++) {
+    const Gst3DMeshFileAttribute *attrib = &entry->attributes[i];
+    struct Gst3DAttributeBuffer *attrib_buffer =
+        g_new0 (struct Gst3DAttributeBuffer, 1);
+
+    attrib_buffer->name = g_intern_string (attrib->name);
+    attrib_buffer->element_size = attrib->element_size;
+    attrib_buffer->vector_length = attrib->vector_length;
+    attrib_buffer->type = attrib->type ? attrib->type : GL_FLOAT;
+    attrib_buffer->normalized = attrib->normalized;
+    attrib_buffer->offset = attrib->offset;
+    attrib_buffer->stride = entry->stride;
+    attrib_buffer->shader_location = -1;
+
+    if (g_strcmp0 (attrib_buffer->name, "position") == 0
+        && attrib->vector_length >= 3)
+      _update_bounds (self, (const guint8 *) gst_3d_mesh_file_get_vertices
+          (file, index) + attrib->offset, attrib_buffer->type, entry->stride,
+          entry->vertex_count);
+
+    self->attribute_buffers =
+        g_list_append (self->attribute_buffers, attrib_buffer);
+  }
+}
+
+/* Uploads mesh @index of a mapped cache file. Vertex and index blobs are
+ * handed to BufferData directly from the mapping, without any copy or
+ * index conversion on the CPU.
+ */
+void
+gst_3d_mesh_upload_file (Gst3DMesh * self, Gst3DMeshFile * file, guint index)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+  const Gst3DMeshFileEntry *entry = gst_3d_mesh_file_get_entry (file, index);
+
+  g_return_if_fail (entry != NULL);
+  g_return_if_fail (self->attribute_buffers == NULL);
+
+  _append_file_attributes (self, file, index);
+
+  gl->GenBuffers (1, &self->vbo_vertices);
+  gl->BindBuffer (GL_ARRAY_BUFFER, self->vbo_vertices);
+  gl->BufferData (GL_ARRAY_BUFFER, (gsize) entry->vertex_count * entry->stride,
+      gst_3d_mesh_file_get_vertices (file, index), GL_STATIC_DRAW);
+  _account_vertices (self, (gsize) entry->vertex_count * entry->stride);
+
+  /* the stored separators are only drawable with primitive restart */
+  if (_needs_unroll (self)) {
+    gconstpointer stored = gst_3d_mesh_file_get_indices (file, index);
+    GLuint *indices = g_new (GLuint, entry->index_count);
+    for (guint i = 0; i < entry->index_count; i++) {
+      if (entry->index_size == 2) {
+        GLushort v = ((const GLushort *) stored)[i];
+        indices[i] = v == G_MAXUINT16 ? GST_3D_GEOMETRY_RESTART_INDEX : v;
+      } else {
+        indices[i] = ((const GLuint *) stored)[i];
+      }
+    }
+    gst_3d_mesh_upload_indices (self, indices, entry->index_count);
+    g_free (indices);
+    return;
+  }
+
+  self->index_count = entry->index_count;
+  self->index_type = entry->index_size == 2 ? GL_UNSIGNED_SHORT :
+      GL_UNSIGNED_INT;
+  gl->BindBuffer (GL_ELEMENT_ARRAY_BUFFER, self->vbo_indices);
+  gl->BufferData (GL_ELEMENT_ARRAY_BUFFER,
+      (gsize) entry->index_count * entry->index_size,
+      gst_3d_mesh_file_get_indices (file, index), GL_STATIC_DRAW);
+  _account_indices (self, (gsize) entry->index_count * entry->index_size);
+}
 
+void
+gst_3d_mesh_upload_plane (Gst3DMesh * self, float aspect)
+{
   /* *INDENT-OFF* */
   GLfloat vertices[] = {
      -aspect,  1.0,  0.0, 1.0,
@@ -283,7 +1181,7 @@ gst_3d_mesh_upload_plane (Gst3DMesh * self, float aspect)
      0.0, 0.0
   };
   /* *INDENT-ON* */
-  const GLushort indices[] = { 0, 1, 2, 3, 0 };
+  const GLuint indices[] = { 0, 1, 2, 3, 0 };
 
   self->vertex_count = 4;
   self->draw_mode = GL_TRIANGLE_STRIP;
@@ -291,19 +1189,14 @@ gst_3d_mesh_upload_plane (Gst3DMesh * self, float aspect)
   gst_3d_mesh_append_attribute_buffer (self, "position", sizeof (GLfloat), 4,
       vertices);
   gst_3d_mesh_append_attribute_buffer (self, "uv", sizeof (GLfloat), 2, uvs);
+  gst_3d_mesh_upload_attributes (self);
 
-  // index
-  self->index_size = sizeof (indices);  // /sizeof(indices[0])
-  gl->BindBuffer (GL_ELEMENT_ARRAY_BUFFER, self->vbo_indices);
-  gl->BufferData (GL_ELEMENT_ARRAY_BUFFER, self->index_size, indices,
-      GL_STATIC_DRAW);
+  gst_3d_mesh_upload_indices (self, indices, G_N_ELEMENTS (indices));
 }
 
 void
 gst_3d_mesh_upload_cube (Gst3DMesh * self)
 {
-  GstGLFuncs *gl = self->context->gl_vtable;
-
   /* *INDENT-OFF* */
   GLfloat positions[] = {
       /* front face */
@@ -372,7 +1265,7 @@ gst_3d_mesh_upload_cube (Gst3DMesh * self)
        0.0, 0.0
   };
 
-  GLushort indices[] = {
+  GLuint indices[] = {
       0, 1, 2,
       0, 2, 3,
       4, 5, 6,
@@ -394,21 +1287,43 @@ gst_3d_mesh_upload_cube (Gst3DMesh * self)
   gst_3d_mesh_append_attribute_buffer (self, "position", sizeof (GLfloat), 3,
       positions);
   gst_3d_mesh_append_attribute_buffer (self, "uv", sizeof (GLfloat), 2, uvs);
+  gst_3d_mesh_upload_attributes (self);
 
-  // index
-  self->index_size = sizeof (indices);
-  gl->BindBuffer (GL_ELEMENT_ARRAY_BUFFER, self->vbo_indices);
-  gl->BufferData (GL_ELEMENT_ARRAY_BUFFER, self->index_size, indices,
-      GL_STATIC_DRAW);
+  gst_3d_mesh_upload_indices (self, indices, G_N_ELEMENTS (indices));
 }
 
 
+/* Streams the line into a dynamic mesh, the mesh data lives on the stack
+ * so rebuilding debug lines every frame does not allocate. */
+static void
+_update_line (Gst3DMesh * self, const GLfloat positions[8],
+    const GLfloat colors[6])
+{
+  GLfloat vertices[14];
+  guint32 indices[] = { 0, 1 };
+  Gst3DMeshData data;
+
+  memset (&data, 0, sizeof (data));
+  gst_3d_mesh_data_add_attribute (&data, "position", 4);
+  gst_3d_mesh_data_add_attribute (&data, "color", 3);
+  data.draw_mode = GL_LINES;
+  data.vertex_count = 2;
+  data.index_count = 2;
+  data.vertices = (guint8 *) vertices;
+  data.indices = indices;
+
+  for (guint v = 0; v < 2; v++) {
+    memcpy (&vertices[v * 7], &positions[v * 4], 4 * sizeof (GLfloat));
+    memcpy (&vertices[v * 7 + 4], &colors[v * 3], 3 * sizeof (GLfloat));
+  }
+
+  gst_3d_mesh_update_data (self, &data);
+}
+
 void
 gst_3d_mesh_upload_line (Gst3DMesh * self, graphene_vec3_t * from,
     graphene_vec3_t * to, graphene_vec3_t * color)
 {
-  GstGLFuncs *gl = self->context->gl_vtable;
-
   GLfloat vertices[] = {
     graphene_vec3_get_x (from), graphene_vec3_get_y (from),
     graphene_vec3_get_z (from), 1.0,
@@ -422,6 +1337,11 @@ gst_3d_mesh_upload_line (Gst3DMesh * self, graphene_vec3_t * from,
     graphene_vec3_get_z (color)
   };
 
+  if (self->type == GST_3D_MESH_TYPE_DYNAMIC) {
+    _update_line (self, vertices, colors);
+    return;
+  }
+
   self->vertex_count = 2;
   self->draw_mode = GL_LINES;
 
@@ -429,14 +1349,11 @@ gst_3d_mesh_upload_line (Gst3DMesh * self, graphene_vec3_t * from,
       vertices);
   gst_3d_mesh_append_attribute_buffer (self, "color", sizeof (GLfloat), 3,
       colors);
+  gst_3d_mesh_upload_attributes (self);
 
-  const GLushort indices[] = { 0, 1 };
+  const GLuint indices[] = { 0, 1 };
 
-  // index
-  self->index_size = sizeof (indices);
-  gl->BindBuffer (GL_ELEMENT_ARRAY_BUFFER, self->vbo_indices);
-  gl->BufferData (GL_ELEMENT_ARRAY_BUFFER, self->index_size, indices,
-      GL_STATIC_DRAW);
+  gst_3d_mesh_upload_indices (self, indices, G_N_ELEMENTS (indices));
 
 }
 
@@ -445,196 +1362,605 @@ void
 gst_3d_mesh_upload_point_plane (Gst3DMesh * self, unsigned width,
     unsigned height)
 {
-  GLfloat *vertices;
-  // GLfloat *texcoords;
-  GLuint *indices;
+  Gst3DGeometry *geometry = gst_3d_geometry_new ();
+  gst_3d_geometry_generate_point_plane (geometry, width, height);
 
-  GstGLFuncs *gl = self->context->gl_vtable;
+  self->vertex_count = geometry->vertex_count;
 
-  self->vertex_count = width * height;
-  const int component_size = sizeof (GLfloat) * self->vertex_count;
+  gst_3d_mesh_append_attribute_buffer (self, "position", sizeof (GLfloat), 3,
+      geometry->positions);
+  gst_3d_mesh_upload_attributes (self);
 
-  vertices = (GLfloat *) malloc (component_size * 3);
-  // texcoords = (GLfloat *) malloc (component_size * 2);
+  /* no index buffer, gst_3d_mesh_draw_mode draws it in vertex order */
+  self->draw_mode = GL_POINTS;
 
-  GLfloat *v = vertices;
-  // GLfloat *t = texcoords;
+  gst_3d_geometry_free (geometry);
+}
 
-  float w_step = 2.0 / (float) width;
-  float h_step = 2.0 / (float) height;
+void
+gst_3d_mesh_upload_sphere (Gst3DMesh * self, float radius, unsigned stacks,
+    unsigned slices)
+{
+  Gst3DGeometry *geometry = gst_3d_geometry_new ();
+  gst_3d_geometry_generate_sphere (geometry, radius, stacks, slices);
 
-  float curent_w = -1.0;
-/*
-  float u_step = 1.0 / (float) width;
-  float v_step = 1.0 / (float) height;
-
-  float curent_u = 0.0;
-*/
-
-  for (int i = 0; i < width; i++) {
-    float curent_h = -1.0;
-    // float curent_v = 0.0;
-    for (int j = 0; j < height; j++) {
-
-      *v++ = curent_w;
-      *v++ = curent_h;
-      *v++ = 0;
-
-      curent_h += h_step;
-      /*
-       *t++ = curent_u;
-       *t++ = curent_v;
-       curent_v += v_step;
-       */
-    }
-    // curent_u += u_step;
-    curent_w += w_step;
-  }
+  self->vertex_count = geometry->vertex_count;
 
   gst_3d_mesh_append_attribute_buffer (self, "position", sizeof (GLfloat), 3,
-      vertices);
+      geometry->positions);
+  gst_3d_mesh_append_attribute_buffer (self, "uv", sizeof (GLfloat), 2,
+      geometry->uvs);
+  gst_3d_mesh_upload_attributes (self);
 
-  // linear index. TODO: do not use index at all here.
-  self->index_size = self->vertex_count;
-  indices = (GLuint *) malloc (sizeof (GLuint) * self->index_size);
-  GLuint *indextemp = indices;
-  for (int i = 0; i < self->index_size; i++) {
-    *indextemp++ = i;
-  }
+  self->draw_mode = GL_TRIANGLE_STRIP;
+  gst_3d_mesh_upload_indices (self, geometry->indices, geometry->index_count);
 
-  // upload index
-  gl->BindBuffer (GL_ELEMENT_ARRAY_BUFFER, self->vbo_indices);
-  gl->BufferData (GL_ELEMENT_ARRAY_BUFFER, sizeof (GLuint) * self->index_size,
-      indices, GL_STATIC_DRAW);
+  gst_3d_geometry_free (geometry);
+}
+
+/* Sphere generated in mvp_uv_sphere.vert from gl_VertexID. Uses the same
+ * strip order as gst_3d_mesh_upload_sphere, but allocates no vertex or
+ * index buffers. Each band between two rows is drawn as an instance of
+ * one strip, so there is no need for restart indices.
+ */
+void
+gst_3d_mesh_upload_procedural_sphere (Gst3DMesh * self, float radius,
+    unsigned stacks, unsigned slices)
+{
+  self->type = GST_3D_MESH_TYPE_PROCEDURAL_SPHERE;
+  self->draw_mode = GL_TRIANGLE_STRIP;
+  self->radius = radius;
+  graphene_point3d_init (&self->bounds_center, 0.f, 0.f, 0.f);
+  self->bounds_radius = radius;
+  graphene_box_init (&self->bounds_box,
+      &GRAPHENE_POINT3D_INIT (-radius, -radius, -radius),
+      &GRAPHENE_POINT3D_INIT (radius, radius, radius));
+  self->bounds_valid = TRUE;
+  gst_3d_mesh_set_sphere_resolution (self, stacks, slices);
+}
+
+/* Point grid generated in points_grid.vert from gl_VertexID, in the same
+ * order as gst_3d_mesh_upload_point_plane, without vertex or index
+ * buffers. The shader places the points in [-1, 1] on x and y and samples
+ * z in [0, 1] from the depth texture.
+ */
+void
+gst_3d_mesh_upload_procedural_grid (Gst3DMesh * self, unsigned width,
+    unsigned height)
+{
+  self->type = GST_3D_MESH_TYPE_PROCEDURAL_GRID;
   self->draw_mode = GL_POINTS;
+  graphene_point3d_init (&self->bounds_center, 0.f, 0.f, 0.5f);
+  self->bounds_radius = 1.5f;
+  graphene_box_init (&self->bounds_box, &GRAPHENE_POINT3D_INIT (-1.f, -1.f,
+          0.f), &GRAPHENE_POINT3D_INIT (1.f, 1.f, 1.f));
+  self->bounds_valid = TRUE;
+  gst_3d_mesh_set_grid_size (self, width, height);
 }
 
+/* Follows the input size at the cost of a uniform update. */
 void
-gst_3d_mesh_upload_sphere (Gst3DMesh * self, float radius, unsigned stacks,
+gst_3d_mesh_set_grid_size (Gst3DMesh * self, unsigned width, unsigned height)
+{
+  g_return_if_fail (self->type == GST_3D_MESH_TYPE_PROCEDURAL_GRID);
+
+  if (self->grid_width == width && self->grid_height == height)
+    return;
+
+  self->grid_width = width;
+  self->grid_height = height;
+  self->vertex_count = width * height;
+  self->procedural_generation++;
+}
+
+/* Changing the resolution only costs a uniform update on the next draw. */
+void
+gst_3d_mesh_set_sphere_resolution (Gst3DMesh * self, unsigned stacks,
     unsigned slices)
 {
-  GLfloat *positions;
-  GLfloat *uvs;
-  GLushort *indices;
+  g_return_if_fail (self->type == GST_3D_MESH_TYPE_PROCEDURAL_SPHERE);
+  g_return_if_fail (stacks > 1 && slices > 1);
+
+  self->stacks = stacks;
+  self->slices = slices;
+  self->vertex_count = (slices - 1) * stacks * 2;
+  self->procedural_generation++;
+}
+
+static gboolean
+_dynamic_layout_matches (Gst3DMesh * self, const Gst3DMeshData * data)
+{
+  GList *l = self->attribute_buffers;
 
+  for (guint i = 0; i < data->n_attributes; i++, l = l->next) {
+    if (!l)
+      return FALSE;
+    struct Gst3DAttributeBuffer *buf = (struct Gst3DAttributeBuffer *) l->data;
+    if (buf->name != data->attributes[i].name
+        || buf->vector_length != data->attributes[i].vector_length
+        || buf->type != data->attributes[i].type
+        || buf->normalized != data->attributes[i].normalized
+        || buf->stride != data->stride)
+      return FALSE;
+  }
+
+  return l == NULL;
+}
+
+/* Streams @data into the next segment of the vertex and index rings of a
+ * dynamic mesh. Nothing is allocated unless @data outgrows the segments
+ * and the GPU is only waited for when it still reads the segment from
+ * GST_3D_STREAM_BUFFER_SEGMENTS updates ago. A changed attribute layout
+ * requires binding the shader again.
+ */
+void
+gst_3d_mesh_update_data (Gst3DMesh * self, const Gst3DMeshData * data)
+{
   GstGLFuncs *gl = self->context->gl_vtable;
+  gsize offset;
+
+  g_return_if_fail (self->type == GST_3D_MESH_TYPE_DYNAMIC);
+
+  if (!_dynamic_layout_matches (self, data)) {
+    _clear_attribute_buffers (self);
+    _append_data_attributes (self, data);
+  }
+
+  gsize vertex_size = data->vertex_count * data->stride;
+  if (!self->stream_vertices) {
+    self->stream_vertices = gst_3d_stream_buffer_new (self->context,
+        GL_ARRAY_BUFFER, vertex_size);
+  }
+
+  guint8 *vertices = gst_3d_stream_buffer_map (self->stream_vertices,
+      vertex_size, &offset);
+  memcpy (vertices, data->vertices, vertex_size);
+  gst_3d_stream_buffer_unmap (self->stream_vertices);
 
-  self->vertex_count = (slices + 1) * stacks;
-  const int component_size = sizeof (GLfloat) * self->vertex_count;
+  GList *l = self->attribute_buffers;
+  for (guint i = 0; i < data->n_attributes; i++, l = l->next) {
+    struct Gst3DAttributeBuffer *buf = (struct Gst3DAttributeBuffer *) l->data;
+    buf->offset = offset + data->attributes[i].offset;
+  }
 
-  positions = (GLfloat *) malloc (component_size * 3);
-  uvs = (GLfloat *) malloc (component_size * 2);
+  const GLuint *data_indices = data->indices;
+  guint index_count = data->index_count;
+  self->draw_mode = data->draw_mode;
+  GLuint *unrolled = _unroll_restarts (self, &data_indices, &index_count);
 
-  GLfloat *v = positions;
-  GLfloat *t = uvs;
+  self->index_type = _index_type (_max_index (data_indices, index_count));
+  gsize index_size = index_count *
+      (self->index_type == GL_UNSIGNED_SHORT ? sizeof (GLushort) :
+      sizeof (GLuint));
 
-  float const J = 1. / (float) (stacks - 1);
-  float const I = 1. / (float) (slices - 1);
+  /* the element array binding is VAO state */
+  gst_3d_gl_state_bind_vertex_array (self->context, self->vao);
 
-  for (int i = 0; i < slices; i++) {
-    float const theta = M_PI * i * I;
-    for (int j = 0; j < stacks; j++) {
-      float const phi = 2 * M_PI * j * J + M_PI / 2.0;
+  if (!self->stream_indices) {
+    self->stream_indices = gst_3d_stream_buffer_new (self->context,
+        GL_ELEMENT_ARRAY_BUFFER, index_size);
+  }
 
-      float const x = sin (theta) * cos (phi);
-      float const y = -cos (theta);
-      float const z = sin (phi) * sin (theta);
+  gpointer indices = gst_3d_stream_buffer_map (self->stream_indices,
+      index_size, &offset);
+  if (self->index_type == GL_UNSIGNED_SHORT) {
+    _convert_short_indices (indices, data_indices, index_count);
+  } else {
+    memcpy (indices, data_indices, index_size);
+  }
+  gst_3d_stream_buffer_unmap (self->stream_indices);
+  g_free (unrolled);
 
-      *v++ = x * radius;
-      *v++ = y * radius;
-      *v++ = z * radius;
+  self->index_offset = offset;
+  self->index_count = index_count;
+  self->vertex_count = data->vertex_count;
 
-      *t++ = j * J;
-      *t++ = i * I;
+  _bind_dynamic_attributes (self);
+}
+
+/* Uploads simplified versions of the mesh data, as returned by
+ * gst_3d_mesh_data_generate_lods, as levels of detail of @self. */
+void
+gst_3d_mesh_upload_lods (Gst3DMesh * self, GPtrArray * lods)
+{
+  gfloat screen_size = GST_3D_MESH_LOD_SCREEN_SIZE;
+
+  for (guint i = 0; i < lods->len; i++) {
+    Gst3DMesh *lod = gst_3d_mesh_new (self->context);
+    gst_3d_mesh_init_buffers (lod);
+    gst_3d_mesh_upload_data (lod, g_ptr_array_index (lods, i));
+    gst_3d_mesh_add_lod (self, lod, screen_size);
+    screen_size *= 0.5f;
+  }
+}
+
+/* Makes @self draw from the buffers of @owner. Replaces the index buffer
+ * created by gst_3d_mesh_init_buffers, if any. */
+static void
+_share_buffers (Gst3DMesh * self, Gst3DMesh * owner)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  g_return_if_fail (self->buffer_owner == NULL && self->vbo_vertices == 0);
+
+  if (self->vbo_indices)
+    gl->DeleteBuffers (1, &self->vbo_indices);
+  if (!self->vao)
+    gl->GenVertexArrays (1, &self->vao);
+
+  self->buffer_owner = gst_object_ref (owner);
+  self->vbo_vertices = owner->vbo_vertices;
+  self->vbo_indices = owner->vbo_indices;
+}
+
+/* Ranges start 16 byte aligned, which suits every attribute and index
+ * type. */
+static gsize
+_append_aligned (GByteArray * blob, gconstpointer data, gsize size)
+{
+  gsize offset = GST_ROUND_UP_16 (blob->len);
+  g_byte_array_set_size (blob, offset + size);
+  if (data)
+    memcpy (blob->data + offset, data, size);
+  return offset;
+}
+
+/* Appends @data to the vertex and index blobs of the shared buffers and
+ * points @self at its range. */
+static void
+_append_shared (Gst3DMesh * self, const Gst3DMeshData * data,
+    GByteArray * vertices, GByteArray * indices)
+{
+  const GLuint *index_data = data->indices;
+  guint count = data->index_count;
+
+  self->layout = GST_3D_MESH_LAYOUT_INTERLEAVED;
+  self->vertex_count = data->vertex_count;
+  self->draw_mode = data->draw_mode;
+
+  _append_data_attributes (self, data);
+  _update_data_bounds (self, data);
+
+  self->vertex_offset = _append_aligned (vertices, data->vertices,
+      (gsize) data->vertex_count * data->stride);
+
+  GLuint *unrolled = _unroll_restarts (self, &index_data, &count);
+  self->index_count = count;
+  self->index_type = _index_type (_max_index (index_data, count));
+
+  if (self->index_type == GL_UNSIGNED_SHORT) {
+    self->index_offset = _append_aligned (indices, NULL,
+        count * sizeof (GLushort));
+    _convert_short_indices ((GLushort *) (indices->data + self->index_offset),
+        index_data, count);
+  } else {
+    self->index_offset = _append_aligned (indices, index_data,
+        count * sizeof (GLuint));
+  }
+
+  g_free (unrolled);
+}
+
+/* Uploads @n_meshes meshes and their levels of detail with one BufferData
+ * for all vertices and one for all indices. @meshes must not hold any
+ * data yet, each draws its own range of the shared buffers afterwards.
+ * @lods has a GPtrArray of Gst3DMeshData or NULL per mesh. */
+static void
+_upload_shared (GstGLContext * context, guint n_meshes, Gst3DMesh ** meshes,
+    Gst3DMeshData ** data, GPtrArray ** lods)
+{
+  GstGLFuncs *gl = context->gl_vtable;
+  Gst3DMesh *owner = gst_3d_mesh_new (context);
+  GByteArray *vertices = g_byte_array_new ();
+  GByteArray *indices = g_byte_array_new ();
+  guint n_ranges = 0;
+
+  gl->GenBuffers (1, &owner->vbo_vertices);
+  gl->GenBuffers (1, &owner->vbo_indices);
+
+  for (guint i = 0; i < n_meshes; i++) {
+    _share_buffers (meshes[i], owner);
+    _append_shared (meshes[i], data[i], vertices, indices);
+    n_ranges++;
+
+    gfloat screen_size = GST_3D_MESH_LOD_SCREEN_SIZE;
+    for (guint j = 0; lods[i] && j < lods[i]->len; j++) {
+      Gst3DMesh *lod = gst_3d_mesh_new (context);
+      _share_buffers (lod, owner);
+      _append_shared (lod, g_ptr_array_index (lods[i], j), vertices, indices);
+      gst_3d_mesh_add_lod (meshes[i], lod, screen_size);
+      screen_size *= 0.5f;
+      n_ranges++;
     }
   }
 
-  gst_3d_mesh_append_attribute_buffer (self, "position", sizeof (GLfloat), 3,
-      positions);
-  gst_3d_mesh_append_attribute_buffer (self, "uv", sizeof (GLfloat), 2, uvs);
+  /* the copy target leaves the element array binding of the bound VAO
+   * alone */
+  gl->BindBuffer (GL_COPY_WRITE_BUFFER, owner->vbo_vertices);
+  gl->BufferData (GL_COPY_WRITE_BUFFER, vertices->len, vertices->data,
+      GL_STATIC_DRAW);
+  _account_vertices (owner, vertices->len);
 
-  /* index */
-  self->index_size = (slices - 1) * stacks * 2;
+  gl->BindBuffer (GL_COPY_WRITE_BUFFER, owner->vbo_indices);
+  gl->BufferData (GL_COPY_WRITE_BUFFER, indices->len, indices->data,
+      GL_STATIC_DRAW);
+  _account_indices (owner, indices->len);
+
+  GST_DEBUG ("uploaded %u ranges, %u vertex and %u index bytes", n_ranges,
+      vertices->len, indices->len);
+
+  g_byte_array_unref (vertices);
+  g_byte_array_unref (indices);
+  gst_object_unref (owner);
+}
 
-  indices = (GLushort *) malloc (sizeof (GLushort) * self->index_size);
-  GLushort *indextemp = indices;
+static void
+_mesh_unref (Gst3DMesh * mesh)
+{
+  if (mesh)
+    gst_object_unref (mesh);
+}
 
-  // -3 = minus caps slices - one to iterate over strips
-  for (int i = 0; i < slices - 1; i++) {
-    for (int j = 0; j < stacks; j++) {
-      *indextemp++ = i * stacks + j;
-      *indextemp++ = (i + 1) * stacks + j;
+/* Creates a mesh for every entry of @data, drawing from one vertex and
+ * one index buffer shared by all of them and their levels of detail from
+ * @lods, which can be NULL. Entries of @data can be NULL, giving NULL
+ * meshes. Must be called on the GL thread. */
+GPtrArray *
+gst_3d_mesh_new_batch (GstGLContext * context, GPtrArray * data,
+    GPtrArray * lods)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+  g_return_val_if_fail (lods == NULL || lods->len == data->len, NULL);
+
+  GPtrArray *meshes = g_ptr_array_new_full (data->len,
+      (GDestroyNotify) _mesh_unref);
+  Gst3DMesh **batch_meshes = g_new (Gst3DMesh *, data->len);
+  Gst3DMeshData **batch_data = g_new (Gst3DMeshData *, data->len);
+  GPtrArray **batch_lods = g_new (GPtrArray *, data->len);
+  guint n_meshes = 0;
+
+  for (guint i = 0; i < data->len; i++) {
+    Gst3DMeshData *mesh_data = g_ptr_array_index (data, i);
+    Gst3DMesh *mesh = NULL;
+    if (mesh_data) {
+      mesh = gst_3d_mesh_new (context);
+      batch_meshes[n_meshes] = mesh;
+      batch_data[n_meshes] = mesh_data;
+      batch_lods[n_meshes] = lods ? g_ptr_array_index (lods, i) : NULL;
+      n_meshes++;
     }
+    g_ptr_array_add (meshes, mesh);
   }
 
-  /* linear index */
-  /*
-     self->index_size = (slices - 2) * stacks;
-     for (int i = 0; i < self->index_size; i++)
-     *indextemp++ = i;
-   */
+  if (n_meshes > 0)
+    _upload_shared (context, n_meshes, batch_meshes, batch_data, batch_lods);
 
-  // upload index
-  gl->BindBuffer (GL_ELEMENT_ARRAY_BUFFER, self->vbo_indices);
-  gl->BufferData (GL_ELEMENT_ARRAY_BUFFER, sizeof (GLushort) * self->index_size,
-      indices, GL_STATIC_DRAW);
+  g_free (batch_meshes);
+  g_free (batch_data);
+  g_free (batch_lods);
 
-  self->draw_mode = GL_TRIANGLE_STRIP;
+  return meshes;
 }
 
-#include <assimp/cimport.h>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+static gint
+_compare_lods (gconstpointer a, gconstpointer b)
+{
+  const struct Gst3DMeshLod *la = a;
+  const struct Gst3DMeshLod *lb = b;
+  return la->screen_size > lb->screen_size ? -1 :
+      (la->screen_size < lb->screen_size);
+}
 
+/* Takes ownership of @lod, which is drawn instead of @self when the
+ * projected size drops below @screen_size. */
 void
-gst_3d_mesh_upload_assimp (Gst3DMesh * self, const char *file)
+gst_3d_mesh_add_lod (Gst3DMesh * self, Gst3DMesh * lod, gfloat screen_size)
 {
-  GstGLFuncs *gl = self->context->gl_vtable;
+  struct Gst3DMeshLod entry = { lod, screen_size };
 
-  const struct aiScene *scene = NULL;
-  scene = aiImportFile (file, 0);
+  if (!self->lods)
+    self->lods = g_array_new (FALSE, FALSE, sizeof (struct Gst3DMeshLod));
 
+  g_array_append_val (self->lods, entry);
+  g_array_sort (self->lods, _compare_lods);
+}
+
+/* Axis aligned bounding box in model space. Returns FALSE if the extent
+ * of the mesh is not known, like for dynamic meshes. */
+gboolean
+gst_3d_mesh_get_bounds (Gst3DMesh * self, graphene_box_t * box)
+{
+  if (!self->bounds_valid)
+    return FALSE;
+  graphene_box_init_from_box (box, &self->bounds_box);
+  return TRUE;
+}
+
+/* Projected diameter of the bounding sphere relative to the viewport
+ * height, using the largest scale @mvp applies along the vertical axis.
+ * Returns G_MAXFLOAT when the center is not in front of the camera. */
+gfloat
+gst_3d_mesh_get_screen_size (Gst3DMesh * self, const graphene_matrix_t * mvp)
+{
+  graphene_vec4_t center, clip;
+
+  graphene_vec4_init (&center, self->bounds_center.x, self->bounds_center.y,
+      self->bounds_center.z, 1.f);
+  graphene_matrix_transform_vec4 (mvp, &center, &clip);
 
-  const struct aiMesh *assimp_mesh =
-      scene->mMeshes[scene->mRootNode->mChildren[0]->mMeshes[0]];
+  gfloat w = graphene_vec4_get_w (&clip);
+  if (w <= 0.f)
+    return G_MAXFLOAT;
 
-  GST_ERROR ("Uploading %s with %d verts", file, assimp_mesh->mNumVertices);
+  gfloat sx = graphene_matrix_get_value (mvp, 0, 1);
+  gfloat sy = graphene_matrix_get_value (mvp, 1, 1);
+  gfloat sz = graphene_matrix_get_value (mvp, 2, 1);
 
-  // GLfloat *normals = malloc(3 * mesh->mNumVertices *sizeof(float));
+  return self->bounds_radius * sqrtf (sx * sx + sy * sy + sz * sz) / w;
+}
 
-  GLfloat *positions =
-      malloc (3 * assimp_mesh->mNumVertices * sizeof (GLfloat));
-  for (int i = 0; i < assimp_mesh->mNumVertices; ++i) {
-    positions[i * 3] = assimp_mesh->mVertices[i].x;
-    positions[i * 3 + 1] = assimp_mesh->mVertices[i].y;
-    positions[i * 3 + 2] = assimp_mesh->mVertices[i].z;
+/* Returns the coarsest level that still covers its projected size. */
+Gst3DMesh *
+gst_3d_mesh_select_lod (Gst3DMesh * self, const graphene_matrix_t * mvp)
+{
+  if (!self->lods || self->lods->len == 0)
+    return self;
+
+  gfloat screen_size = gst_3d_mesh_get_screen_size (self, mvp);
+  Gst3DMesh *selected = self;
+
+  for (guint i = 0; i < self->lods->len; i++) {
+    struct Gst3DMeshLod *lod =
+        &g_array_index (self->lods, struct Gst3DMeshLod, i);
+    if (screen_size >= lod->screen_size)
+      break;
+    selected = lod->mesh;
   }
 
-  GLfloat *uvs = malloc (2 * assimp_mesh->mNumVertices * sizeof (GLfloat));
-  for (int i = 0; i < assimp_mesh->mNumVertices; ++i) {
-    uvs[i * 2] = assimp_mesh->mTextureCoords[0][i].x;
-    uvs[i * 2 + 1] = assimp_mesh->mTextureCoords[0][i].y;
+  return selected;
+}
+
+/* Uploads the mesh and the levels of detail of @file with one BufferData
+ * for all vertex blobs and one for all index blobs, straight from the
+ * mapping. */
+static void
+_upload_file_shared (Gst3DMesh * self, Gst3DMeshFile * file)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+  guint n_entries = gst_3d_mesh_file_get_n_meshes (file);
+  const guint8 *data = (const guint8 *) gst_3d_mesh_file_get_vertices (file, 0)
+      - gst_3d_mesh_file_get_entry (file, 0)->vertices_offset;
+  guint64 vertex_begin = G_MAXUINT64, vertex_end = 0;
+  guint64 index_begin = G_MAXUINT64, index_end = 0;
+
+  for (guint i = 0; i < n_entries; i++) {
+    const Gst3DMeshFileEntry *entry = gst_3d_mesh_file_get_entry (file, i);
+    vertex_begin = MIN (vertex_begin, entry->vertices_offset);
+    vertex_end = MAX (vertex_end, entry->vertices_offset
+        + (guint64) entry->vertex_count * entry->stride);
+    index_begin = MIN (index_begin, entry->indices_offset);
+    index_end = MAX (index_end, entry->indices_offset
+        + (guint64) entry->index_count * entry->index_size);
+  }
+
+  Gst3DMesh *owner = gst_3d_mesh_new (self->context);
+  gl->GenBuffers (1, &owner->vbo_vertices);
+  gl->GenBuffers (1, &owner->vbo_indices);
+
+  gl->BindBuffer (GL_COPY_WRITE_BUFFER, owner->vbo_vertices);
+  gl->BufferData (GL_COPY_WRITE_BUFFER, vertex_end - vertex_begin,
+      data + vertex_begin, GL_STATIC_DRAW);
+  _account_vertices (owner, vertex_end - vertex_begin);
+
+  gl->BindBuffer (GL_COPY_WRITE_BUFFER, owner->vbo_indices);
+  gl->BufferData (GL_COPY_WRITE_BUFFER, index_end - index_begin,
+      data + index_begin, GL_STATIC_DRAW);
+  _account_indices (owner, index_end - index_begin);
+
+  for (guint i = 0; i < n_entries; i++) {
+    const Gst3DMeshFileEntry *entry = gst_3d_mesh_file_get_entry (file, i);
+    Gst3DMesh *mesh = i == 0 ? self : gst_3d_mesh_new (self->context);
+
+    _share_buffers (mesh, owner);
+    _append_file_attributes (mesh, file, i);
+    mesh->vertex_offset = entry->vertices_offset - vertex_begin;
+    mesh->index_offset = entry->indices_offset - index_begin;
+    mesh->index_count = entry->index_count;
+    mesh->index_type = entry->index_size == 2 ? GL_UNSIGNED_SHORT :
+        GL_UNSIGNED_INT;
+
+    if (i > 0)
+      gst_3d_mesh_add_lod (self, mesh,
+          ldexpf (GST_3D_MESH_LOD_SCREEN_SIZE, 1 - (gint) entry->lod));
   }
 
-  GLushort *indices = malloc (3 * assimp_mesh->mNumFaces * sizeof (GLushort));
+  gst_object_unref (owner);
+}
+
+/* A cache for gst_3d_mesh_upload_assimp holds one merged mesh and its
+ * levels of detail, drawable without unrolling restarts. */
+static gboolean
+_cache_file_usable (Gst3DMesh * self, Gst3DMeshFile * cache)
+{
+  guint n_entries = gst_3d_mesh_file_get_n_meshes (cache);
+
+  if (n_entries == 0)
+    return FALSE;
 
-  for (int i = 0; i < assimp_mesh->mNumFaces; ++i) {
-    indices[i * 3] = assimp_mesh->mFaces[i].mIndices[0];
-    indices[i * 3 + 1] = assimp_mesh->mFaces[i].mIndices[1];
-    indices[i * 3 + 2] = assimp_mesh->mFaces[i].mIndices[2];
+  for (guint i = 0; i < n_entries; i++) {
+    const Gst3DMeshFileEntry *entry = gst_3d_mesh_file_get_entry (cache, i);
+    if ((i > 0 && entry->lod == 0)
+        || (_draw_mode_restarts (entry->draw_mode)
+            && !gst_3d_gl_state_has_primitive_restart (self->context)))
+      return FALSE;
   }
 
-  self->vertex_count = assimp_mesh->mNumVertices;
-  self->draw_mode = GL_TRIANGLES;
-  //mesh->draw_mode = GL_LINE_STRIP;
+  return TRUE;
+}
 
-  gst_3d_mesh_append_attribute_buffer (self, "position", sizeof (GLfloat), 3,
-      positions);
-  gst_3d_mesh_append_attribute_buffer (self, "uv", sizeof (GLfloat), 2, uvs);
+static gboolean
+_upload_cache_file (Gst3DMesh * self, const char *file)
+{
+  GError *error = NULL;
+  gchar *cache_path = gst_3d_mesh_file_get_cache_path (file);
+  gboolean ret = FALSE;
+
+  if (!g_file_test (cache_path, G_FILE_TEST_EXISTS))
+    goto out;
+
+  Gst3DMeshFile *cache = gst_3d_mesh_file_open (cache_path, &error);
+  if (!cache) {
+    GST_WARNING ("Ignoring mesh cache %s: %s", cache_path, error->message);
+    g_clear_error (&error);
+    goto out;
+  }
 
-  // index
-  self->index_size = 3 * assimp_mesh->mNumFaces * sizeof (GLushort);
-  gl->BindBuffer (GL_ELEMENT_ARRAY_BUFFER, self->vbo_indices);
-  gl->BufferData (GL_ELEMENT_ARRAY_BUFFER, self->index_size, indices,
-      GL_STATIC_DRAW);
+  if (!gst_3d_mesh_file_matches_source (cache, file)) {
+    GST_INFO ("Mesh cache %s is stale, importing %s", cache_path, file);
+  } else if (!_cache_file_usable (self, cache)) {
+    GST_INFO ("Mesh cache %s can not be drawn as one mesh, importing %s",
+        cache_path, file);
+  } else {
+    GST_DEBUG ("Uploading %s from cache %s", file, cache_path);
+    _upload_file_shared (self, cache);
+    ret = TRUE;
+  }
+
+  gst_3d_mesh_file_close (cache);
+
+out:
+  g_free (cache_path);
+  return ret;
+}
+
+/* Uploads all triangle meshes of @file as one mesh, with the node
+ * transforms applied, and its levels of detail. A preprocessed cache file
+ * next to the source (see gst-3d-mesh-convert) is preferred when it is
+ * up to date. Otherwise the file is imported right away, which blocks the
+ * calling thread. Use gst_3d_scene_append_import to load a scene on a
+ * worker thread and keep its node hierarchy.
+ */
+void
+gst_3d_mesh_upload_assimp (Gst3DMesh * self, const char *file)
+{
+  GError *error = NULL;
+
+  if (_upload_cache_file (self, file))
+    return;
+
+  Gst3DImport *import = gst_3d_import_load (file,
+      GST_3D_IMPORT_FLAG_MERGE | GST_3D_IMPORT_FLAG_OPTIMIZE |
+      GST_3D_IMPORT_FLAG_GENERATE_LODS | GST_3D_IMPORT_FLAG_COMPRESS, &error);
+  if (!import) {
+    GST_ERROR ("%s", error->message);
+    g_clear_error (&error);
+    return;
+  }
+
+  Gst3DMeshData *data = gst_3d_import_get_mesh (import, 0);
+  GPtrArray *lods = gst_3d_import_get_lods (import, 0);
+  GST_DEBUG ("Uploading %s with %d verts", file, data->vertex_count);
+  _upload_shared (self->context, 1, &self, &data, &lods);
+
+  gst_3d_import_free (import);
 }
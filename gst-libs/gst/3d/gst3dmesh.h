@@ -26,6 +26,10 @@
 #include <gst/gl/gstgl_fwd.h>
 
 #include "gst3dshader.h"
+#include "gst3dmeshdata.h"
+#include "gst3dmeshcompress.h"
+#include "gst3dmeshfile.h"
+#include "gst3dstreambuffer.h"
 
 G_BEGIN_DECLS
 #define GST_3D_TYPE_MESH            (gst_3d_mesh_get_type ())
@@ -37,6 +41,19 @@ G_BEGIN_DECLS
 typedef struct _Gst3DMesh Gst3DMesh;
 typedef struct _Gst3DMeshClass Gst3DMeshClass;
 
+typedef enum
+{
+  GST_3D_MESH_TYPE_BUFFER,
+  GST_3D_MESH_TYPE_PROCEDURAL_SPHERE,
+  GST_3D_MESH_TYPE_PROCEDURAL_GRID,
+  GST_3D_MESH_TYPE_DYNAMIC,
+} Gst3DMeshType;
+
+typedef enum
+{
+  GST_3D_MESH_LAYOUT_SEPARATE,
+  GST_3D_MESH_LAYOUT_INTERLEAVED,
+} Gst3DMeshLayout;
 
 struct Gst3DAttributeBuffer
 {
@@ -44,8 +61,51 @@ struct Gst3DAttributeBuffer
   gint location;
   size_t element_size;
   guint vector_length;
+  GLenum type;
+  gboolean normalized;
+
+  /* interleaved layout */
+  gsize offset;
+  gsize stride;
+  gpointer data;
+
+  /* dynamic meshes re-point the attribute after every update */
+  gint shader_location;
 };
 
+/* Per instance vertex attribute, @vector_length floats per instance.
+ * Attributes longer than 4 floats, like a mat4, occupy consecutive
+ * locations of 4 floats each. */
+struct Gst3DInstanceBuffer
+{
+  guint location;
+  guint vector_length;
+  guint divisor;
+  guint vbo;
+  gsize size;
+};
+
+/* Location of the per instance mat4 "instance_model" in the *_instanced.vert
+ * shaders. Fixed in the shaders, so instance attributes can be set up in
+ * the VAO independent of the shader that draws them. */
+#define GST_3D_MESH_INSTANCE_LOCATION 8
+
+/* Locations of the vertex attributes in the shipped vertex shaders, for
+ * code that sets up attributes before or without a linked program. "uv"
+ * and "color" are never used together. */
+#define GST_3D_MESH_POSITION_LOCATION 0
+#define GST_3D_MESH_UV_LOCATION 1
+#define GST_3D_MESH_NORMAL_LOCATION 2
+
+/* Screen size of the first coarser level, every further level halves it */
+#define GST_3D_MESH_LOD_SCREEN_SIZE 0.5f
+
+struct Gst3DMeshLod
+{
+  Gst3DMesh *mesh;
+  /* drawn below this projected diameter, relative to the viewport height */
+  gfloat screen_size;
+};
 
 struct _Gst3DMesh
 {
@@ -56,13 +116,59 @@ struct _Gst3DMesh
 
   GList *attribute_buffers;
 
+  Gst3DMeshType type;
+  Gst3DMeshLayout layout;
+  Gst3DMeshCompressFlags compression;
+
   guint vao;
+  guint vbo_vertices;
   guint vbo_indices;
 
-  guint index_size;
+  /* byte offsets of the first vertex and index drawn, for dynamic meshes
+   * and meshes drawing a range of buffers shared with other meshes */
+  gsize vertex_offset;
+  gsize index_offset;
+  /* owns the shared buffers, NULL if the mesh owns its own */
+  Gst3DMesh *buffer_owner;
+
+  guint index_count;
+  GLenum index_type;
   guint vertex_count;
 
   GLenum draw_mode;
+
+  /* procedural sphere */
+  gfloat radius;
+  guint stacks;
+  guint slices;
+
+  /* procedural grid */
+  guint grid_width;
+  guint grid_height;
+
+  GList *procedural_shaders;
+  guint procedural_generation;
+
+  /* bounding sphere and box in model space, the box is only valid when
+   * the positions were known at upload */
+  graphene_point3d_t bounds_center;
+  gfloat bounds_radius;
+  graphene_box_t bounds_box;
+  gboolean bounds_valid;
+
+  /* coarser levels of detail, sorted by decreasing screen size */
+  GArray *lods;
+
+  /* dynamic */
+  Gst3DStreamBuffer *stream_vertices;
+  Gst3DStreamBuffer *stream_indices;
+
+  /* per instance attributes for gst_3d_mesh_draw_instanced */
+  GList *instance_buffers;
+
+  /* bytes reported to gst3dmemory, stream buffers report their own */
+  gsize vertex_bytes;
+  gsize index_bytes;
 };
 
 struct _Gst3DMeshClass
@@ -71,39 +177,84 @@ struct _Gst3DMeshClass
 };
 
 Gst3DMesh * gst_3d_mesh_new (GstGLContext * context);
+void gst_3d_mesh_set_layout (Gst3DMesh * self, Gst3DMeshLayout layout);
+void gst_3d_mesh_set_compression (Gst3DMesh * self,
+    Gst3DMeshCompressFlags flags);
 Gst3DMesh * gst_3d_mesh_new_sphere (GstGLContext * context, float radius, unsigned stacks,
     unsigned slices);
+Gst3DMesh * gst_3d_mesh_new_sphere_lod (GstGLContext * context, float radius,
+    unsigned stacks, unsigned slices, guint n_levels);
+Gst3DMesh * gst_3d_mesh_new_procedural_sphere (GstGLContext * context,
+    float radius, unsigned stacks, unsigned slices);
 Gst3DMesh * gst_3d_mesh_new_plane (GstGLContext * context, float aspect);
+Gst3DMesh * gst_3d_mesh_new_dynamic (GstGLContext * context);
 
 Gst3DMesh * gst_3d_mesh_new_point_plane (GstGLContext * context, unsigned width,
     unsigned height);
+Gst3DMesh * gst_3d_mesh_new_procedural_grid (GstGLContext * context,
+    unsigned width, unsigned height);
 
 Gst3DMesh * gst_3d_mesh_new_line (GstGLContext * context, graphene_vec3_t *from, graphene_vec3_t *to,  graphene_vec3_t *color);
 
 Gst3DMesh * gst_3d_mesh_new_cube (GstGLContext * context);
 
 Gst3DMesh * gst_3d_mesh_new_assimp (GstGLContext * context, const char *file);
+GPtrArray * gst_3d_mesh_new_batch (GstGLContext * context, GPtrArray * data,
+    GPtrArray * lods);
 
 void gst_3d_mesh_init_buffers (Gst3DMesh * self);
 void gst_3d_mesh_unbind_buffers (Gst3DMesh * self);
 void gst_3d_mesh_bind_shader (Gst3DMesh * self, Gst3DShader * shader);
+GLint gst_3d_mesh_attribute_location (const gchar * name);
 void gst_3d_mesh_bind (Gst3DMesh * self);
 void gst_3d_mesh_draw (Gst3DMesh * self);
 void gst_3d_mesh_draw_mode (Gst3DMesh * self, GLenum draw_mode);
+void gst_3d_mesh_set_primitive_restart (Gst3DMesh * self, GLenum draw_mode,
+    gboolean enable);
 
 void gst_3d_mesh_upload_sphere (Gst3DMesh * self, float radius, unsigned stacks,
     unsigned slices);
+void gst_3d_mesh_upload_procedural_sphere (Gst3DMesh * self, float radius,
+    unsigned stacks, unsigned slices);
+void gst_3d_mesh_set_sphere_resolution (Gst3DMesh * self, unsigned stacks,
+    unsigned slices);
 void gst_3d_mesh_upload_plane (Gst3DMesh * self, float aspect);
 void gst_3d_mesh_upload_point_plane (Gst3DMesh * self, unsigned width,
     unsigned height);
+void gst_3d_mesh_upload_procedural_grid (Gst3DMesh * self, unsigned width,
+    unsigned height);
+void gst_3d_mesh_set_grid_size (Gst3DMesh * self, unsigned width,
+    unsigned height);
 void gst_3d_mesh_upload_line (Gst3DMesh * self, graphene_vec3_t *from, graphene_vec3_t *to,  graphene_vec3_t *color);
 void gst_3d_mesh_upload_cube (Gst3DMesh * self);
 void gst_3d_mesh_draw_arrays (Gst3DMesh * self);
 
+void gst_3d_mesh_upload_instance_attribute (Gst3DMesh * self, guint location,
+    guint vector_length, guint divisor, const gfloat * data, guint count);
+void gst_3d_mesh_upload_instance_transforms (Gst3DMesh * self,
+    const graphene_matrix_t * transforms, guint count);
+void gst_3d_mesh_draw_instanced (Gst3DMesh * self, guint instance_count);
+
 void gst_3d_mesh_upload_assimp(Gst3DMesh * self, const char* file);
 
 void
 gst_3d_mesh_append_attribute_buffer(Gst3DMesh * self, const gchar* name, size_t element_size, guint vector_length, GLfloat *vertices);
+void gst_3d_mesh_upload_attributes (Gst3DMesh * self);
+void gst_3d_mesh_upload_indices (Gst3DMesh * self, const GLuint * indices,
+    guint count);
+void gst_3d_mesh_upload_data (Gst3DMesh * self, const Gst3DMeshData * data);
+void gst_3d_mesh_upload_file (Gst3DMesh * self, Gst3DMeshFile * file,
+    guint index);
+void gst_3d_mesh_upload_lods (Gst3DMesh * self, GPtrArray * lods);
+void gst_3d_mesh_update_data (Gst3DMesh * self, const Gst3DMeshData * data);
+
+void gst_3d_mesh_add_lod (Gst3DMesh * self, Gst3DMesh * lod,
+    gfloat screen_size);
+gboolean gst_3d_mesh_get_bounds (Gst3DMesh * self, graphene_box_t * box);
+gfloat gst_3d_mesh_get_screen_size (Gst3DMesh * self,
+    const graphene_matrix_t * mvp);
+Gst3DMesh *gst_3d_mesh_select_lod (Gst3DMesh * self,
+    const graphene_matrix_t * mvp);
 
 GType gst_3d_mesh_get_type (void);
 
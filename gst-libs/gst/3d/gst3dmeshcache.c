@@ -0,0 +1,210 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Meshes built from the same generator and parameters on one GstGLContext
+ * are shared between all elements using that context. The cache only holds
+ * weak references, so a mesh is freed as soon as its last user drops it.
+ * A shared mesh keeps a single set of vertex array bindings, so every
+ * shader drawing it declares position at location 0 and uv at location 1.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gl/gl.h>
+
+#include "gst3dmeshcache.h"
+
+#define GST_CAT_DEFAULT gst_3d_mesh_cache_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define MESH_CACHE_QUARK gst_3d_mesh_cache_quark ()
+
+struct Gst3DMeshCache
+{
+  GMutex lock;
+  GHashTable *meshes;
+};
+
+static GQuark
+gst_3d_mesh_cache_quark (void)
+{
+  static GQuark quark = 0;
+  if (!quark) {
+    quark = g_quark_from_static_string ("gst-3d-mesh-cache");
+    GST_DEBUG_CATEGORY_INIT (gst_3d_mesh_cache_debug, "3dmeshcache", 0,
+        "mesh cache");
+  }
+  return quark;
+}
+
+static void
+_weak_ref_free (GWeakRef * ref)
+{
+  g_weak_ref_clear (ref);
+  g_free (ref);
+}
+
+static void
+_cache_free (struct Gst3DMeshCache *cache)
+{
+  g_hash_table_unref (cache->meshes);
+  g_mutex_clear (&cache->lock);
+  g_free (cache);
+}
+
+static struct Gst3DMeshCache *
+_get_cache (GstGLContext * context)
+{
+  static GMutex create_lock;
+  struct Gst3DMeshCache *cache;
+
+  g_mutex_lock (&create_lock);
+  cache = g_object_get_qdata (G_OBJECT (context), MESH_CACHE_QUARK);
+  if (!cache) {
+    cache = g_new0 (struct Gst3DMeshCache, 1);
+    g_mutex_init (&cache->lock);
+    cache->meshes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) _weak_ref_free);
+    g_object_set_qdata_full (G_OBJECT (context), MESH_CACHE_QUARK, cache,
+        (GDestroyNotify) _cache_free);
+  }
+  g_mutex_unlock (&create_lock);
+
+  return cache;
+}
+
+static gboolean
+_is_dead (gpointer key, GWeakRef * ref, gpointer user_data)
+{
+  GObject *object = g_weak_ref_get (ref);
+  if (object) {
+    g_object_unref (object);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+Gst3DMesh *
+gst_3d_mesh_cache_lookup (GstGLContext * context, const gchar * key)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+
+  struct Gst3DMeshCache *cache = _get_cache (context);
+  Gst3DMesh *mesh = NULL;
+
+  g_mutex_lock (&cache->lock);
+  GWeakRef *ref = g_hash_table_lookup (cache->meshes, key);
+  if (ref)
+    mesh = g_weak_ref_get (ref);
+  g_mutex_unlock (&cache->lock);
+
+  GST_LOG ("%s %s", mesh ? "hit" : "miss", key);
+
+  return mesh;
+}
+
+void
+gst_3d_mesh_cache_insert (GstGLContext * context, const gchar * key,
+    Gst3DMesh * mesh)
+{
+  g_return_if_fail (GST_IS_GL_CONTEXT (context));
+  g_return_if_fail (GST_IS_3D_MESH (mesh));
+
+  struct Gst3DMeshCache *cache = _get_cache (context);
+  GWeakRef *ref = g_new0 (GWeakRef, 1);
+  g_weak_ref_init (ref, mesh);
+
+  g_mutex_lock (&cache->lock);
+  g_hash_table_foreach_remove (cache->meshes, (GHRFunc) _is_dead, NULL);
+  g_hash_table_replace (cache->meshes, g_strdup (key), ref);
+  g_mutex_unlock (&cache->lock);
+
+  GST_DEBUG ("cached %s", key);
+}
+
+Gst3DMesh *
+gst_3d_mesh_cache_get_sphere (GstGLContext * context, float radius,
+    unsigned stacks, unsigned slices)
+{
+  gchar *key = g_strdup_printf ("sphere:%f:%u:%u", radius, stacks, slices);
+  Gst3DMesh *mesh = gst_3d_mesh_cache_lookup (context, key);
+  if (!mesh) {
+    mesh = gst_3d_mesh_new_sphere (context, radius, stacks, slices);
+    gst_3d_mesh_cache_insert (context, key, mesh);
+  }
+  g_free (key);
+  return mesh;
+}
+
+Gst3DMesh *
+gst_3d_mesh_cache_get_procedural_sphere (GstGLContext * context,
+    float radius, unsigned stacks, unsigned slices)
+{
+  gchar *key = g_strdup_printf ("procedural_sphere:%f:%u:%u", radius, stacks,
+      slices);
+  Gst3DMesh *mesh = gst_3d_mesh_cache_lookup (context, key);
+  if (!mesh) {
+    mesh = gst_3d_mesh_new_procedural_sphere (context, radius, stacks, slices);
+    gst_3d_mesh_cache_insert (context, key, mesh);
+  }
+  g_free (key);
+  return mesh;
+}
+
+Gst3DMesh *
+gst_3d_mesh_cache_get_plane (GstGLContext * context, float aspect)
+{
+  gchar *key = g_strdup_printf ("plane:%f", aspect);
+  Gst3DMesh *mesh = gst_3d_mesh_cache_lookup (context, key);
+  if (!mesh) {
+    mesh = gst_3d_mesh_new_plane (context, aspect);
+    gst_3d_mesh_cache_insert (context, key, mesh);
+  }
+  g_free (key);
+  return mesh;
+}
+
+Gst3DMesh *
+gst_3d_mesh_cache_get_point_plane (GstGLContext * context, unsigned width,
+    unsigned height)
+{
+  gchar *key = g_strdup_printf ("point_plane:%u:%u", width, height);
+  Gst3DMesh *mesh = gst_3d_mesh_cache_lookup (context, key);
+  if (!mesh) {
+    mesh = gst_3d_mesh_new_point_plane (context, width, height);
+    gst_3d_mesh_cache_insert (context, key, mesh);
+  }
+  g_free (key);
+  return mesh;
+}
+
+Gst3DMesh *
+gst_3d_mesh_cache_get_cube (GstGLContext * context)
+{
+  Gst3DMesh *mesh = gst_3d_mesh_cache_lookup (context, "cube");
+  if (!mesh) {
+    mesh = gst_3d_mesh_new_cube (context);
+    gst_3d_mesh_cache_insert (context, "cube", mesh);
+  }
+  return mesh;
+}
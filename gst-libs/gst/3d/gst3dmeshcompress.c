@@ -0,0 +1,243 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Smaller vertex formats for Gst3DMeshData and Gst3DMesh attributes.
+ * Positions become half floats, UVs normalized 16 bit integers and
+ * normals packed 10_10_10_2, which takes an interleaved position, uv and
+ * normal vertex from 32 to 16 bytes. All packed attributes are 4 byte
+ * aligned, as some drivers fall back to slow paths otherwise.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <math.h>
+
+#include "gst3dmeshcompress.h"
+
+/* Round to nearest even, overflows to infinity. */
+guint16
+gst_3d_mesh_compress_half (gfloat value)
+{
+  union
+  {
+    gfloat f;
+    guint32 u;
+  } v = {.f = value };
+
+  guint32 sign = (v.u >> 16) & 0x8000;
+  guint32 float_exponent = (v.u >> 23) & 0xff;
+  gint32 exponent = (gint32) float_exponent - 127 + 15;
+  guint32 mantissa = v.u & 0x7fffff;
+  guint32 half, rest, halfway;
+
+  if (float_exponent == 0xff)
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  if (exponent >= 31)
+    return sign | 0x7c00;
+
+  if (exponent <= 0) {
+    /* subnormal half, the implicit bit becomes explicit */
+    if (exponent < -10)
+      return sign;
+    mantissa |= 0x800000;
+    guint32 shift = 14 - exponent;
+    half = mantissa >> shift;
+    rest = mantissa & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+  } else {
+    half = ((guint32) exponent << 10) | (mantissa >> 13);
+    rest = mantissa & 0x1fff;
+    halfway = 0x1000;
+  }
+
+  /* a carry out of the mantissa correctly bumps the exponent */
+  if (rest > halfway || (rest == halfway && (half & 1)))
+    half++;
+
+  return sign | half;
+}
+
+gfloat
+gst_3d_mesh_compress_half_to_float (guint16 half)
+{
+  guint32 exponent = (half >> 10) & 0x1f;
+  guint32 mantissa = half & 0x3ff;
+  gfloat sign = (half & 0x8000) ? -1.0f : 1.0f;
+
+  if (exponent == 0)
+    return sign * ldexpf (mantissa, -24);
+  if (exponent == 31)
+    return mantissa ? NAN : sign * INFINITY;
+
+  return sign * ldexpf (mantissa | 0x400, exponent - 25);
+}
+
+static guint32
+_snorm10 (gfloat value)
+{
+  value = CLAMP (value, -1.0f, 1.0f);
+  return (guint32) ((gint32) lrintf (value * 511.0f)) & 0x3ff;
+}
+
+/* xyz as normalized signed 10 bit values, w = 0, in the bit order of
+ * GL_INT_2_10_10_10_REV. */
+guint32
+gst_3d_mesh_compress_normal (const gfloat * normal)
+{
+  return _snorm10 (normal[0]) | (_snorm10 (normal[1]) << 10)
+      | (_snorm10 (normal[2]) << 20);
+}
+
+static gboolean
+_in_unit_range (const guint8 * vectors, gsize stride, guint count,
+    guint vector_length)
+{
+  for (guint v = 0; v < count; v++) {
+    const gfloat *p = (const gfloat *) (vectors + v * stride);
+    for (guint i = 0; i < vector_length; i++)
+      if (!(p[i] >= 0.0f && p[i] <= 1.0f))
+        return FALSE;
+  }
+  return TRUE;
+}
+
+/* Packs @count float vectors of the attribute @name, @stride bytes apart,
+ * into a new tightly packed array. @format receives the packed vector
+ * length, component type, size and normalization. Returns NULL if @flags
+ * do not select a smaller format for @name or its values do not fit. */
+gpointer
+gst_3d_mesh_compress_attribute (const gchar * name, const guint8 * vectors,
+    gsize stride, guint count, guint vector_length,
+    Gst3DMeshCompressFlags flags, struct Gst3DMeshDataAttribute *format)
+{
+  g_return_val_if_fail (format != NULL, NULL);
+
+  if ((flags & GST_3D_MESH_COMPRESS_POSITION)
+      && g_strcmp0 (name, "position") == 0
+      && (vector_length == 3 || vector_length == 4)) {
+    guint16 *packed = g_new (guint16, (gsize) count * 4);
+    for (guint v = 0; v < count; v++) {
+      const gfloat *p = (const gfloat *) (vectors + v * stride);
+      for (guint i = 0; i < 3; i++)
+        packed[v * 4 + i] = gst_3d_mesh_compress_half (p[i]);
+      packed[v * 4 + 3] =
+          gst_3d_mesh_compress_half (vector_length == 4 ? p[3] : 1.0f);
+    }
+    format->vector_length = 4;
+    format->element_size = sizeof (guint16);
+    format->type = GST_3D_MESH_DATA_HALF_FLOAT;
+    format->normalized = FALSE;
+    return packed;
+  }
+
+  if ((flags & GST_3D_MESH_COMPRESS_UV) && g_strcmp0 (name, "uv") == 0
+      && vector_length == 2
+      && _in_unit_range (vectors, stride, count, vector_length)) {
+    guint16 *packed = g_new (guint16, (gsize) count * 2);
+    for (guint v = 0; v < count; v++) {
+      const gfloat *p = (const gfloat *) (vectors + v * stride);
+      packed[v * 2 + 0] = (guint16) lrintf (p[0] * G_MAXUINT16);
+      packed[v * 2 + 1] = (guint16) lrintf (p[1] * G_MAXUINT16);
+    }
+    format->vector_length = 2;
+    format->element_size = sizeof (guint16);
+    format->type = GST_3D_MESH_DATA_UNSIGNED_SHORT;
+    format->normalized = TRUE;
+    return packed;
+  }
+
+  if ((flags & GST_3D_MESH_COMPRESS_NORMAL)
+      && g_strcmp0 (name, "normal") == 0 && vector_length == 3) {
+    guint32 *packed = g_new (guint32, count);
+    for (guint v = 0; v < count; v++)
+      packed[v] =
+          gst_3d_mesh_compress_normal ((const gfloat *) (vectors +
+              v * stride));
+    /* one packed element holding all four components */
+    format->vector_length = 4;
+    format->element_size = sizeof (guint32);
+    format->type = GST_3D_MESH_DATA_INT_2_10_10_10_REV;
+    format->normalized = TRUE;
+    return packed;
+  }
+
+  return NULL;
+}
+
+/* Repacks the vertex blob of @self with the formats selected by @flags.
+ * Attributes that are already packed or not selected are copied as is.
+ * Has to be the last CPU side step, see gst_3d_mesh_data_get_attribute.
+ * Returns TRUE if any attribute was packed. */
+gboolean
+gst_3d_mesh_data_compress (Gst3DMeshData * self, Gst3DMeshCompressFlags flags)
+{
+  struct Gst3DMeshDataAttribute formats[GST_3D_MESH_DATA_MAX_ATTRIBUTES];
+  gpointer packed[GST_3D_MESH_DATA_MAX_ATTRIBUTES] = { NULL, };
+  gboolean changed = FALSE;
+  gsize stride = 0;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  for (guint i = 0; i < self->n_attributes; i++) {
+    const struct Gst3DMeshDataAttribute *attrib = &self->attributes[i];
+    formats[i] = *attrib;
+
+    if (attrib->type == GST_3D_MESH_DATA_FLOAT)
+      packed[i] = gst_3d_mesh_compress_attribute (attrib->name,
+          self->vertices + attrib->offset, self->stride, self->vertex_count,
+          attrib->vector_length, flags, &formats[i]);
+    if (packed[i])
+      changed = TRUE;
+
+    formats[i].offset = stride;
+    stride += gst_3d_mesh_data_attribute_size (formats[i].type,
+        formats[i].vector_length, formats[i].element_size);
+  }
+
+  if (!changed)
+    return FALSE;
+
+  guint8 *vertices = g_malloc ((gsize) self->vertex_count * stride);
+
+  for (guint i = 0; i < self->n_attributes; i++) {
+    gsize size = gst_3d_mesh_data_attribute_size (formats[i].type,
+        formats[i].vector_length, formats[i].element_size);
+    const guint8 *src = packed[i] ? packed[i] :
+        self->vertices + self->attributes[i].offset;
+    gsize src_stride = packed[i] ? size : self->stride;
+    guint8 *dst = vertices + formats[i].offset;
+
+    for (guint v = 0; v < self->vertex_count; v++)
+      memcpy (dst + v * stride, src + v * src_stride, size);
+
+    g_free (packed[i]);
+  }
+
+  g_free (self->vertices);
+  self->vertices = vertices;
+  self->stride = stride;
+  memcpy (self->attributes, formats,
+      self->n_attributes * sizeof (struct Gst3DMeshDataAttribute));
+
+  return TRUE;
+}
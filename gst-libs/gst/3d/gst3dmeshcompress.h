@@ -0,0 +1,60 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_MESH_COMPRESS_H__
+#define __GST_3D_MESH_COMPRESS_H__
+
+#include <glib.h>
+
+#include "gst3dmeshdata.h"
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  GST_3D_MESH_COMPRESS_NONE = 0,
+  /* "position" as half float xyzw, w = 1 for 3 component positions */
+  GST_3D_MESH_COMPRESS_POSITION = (1 << 0),
+  /* "uv" as normalized unsigned short, when all values are in [0, 1] */
+  GST_3D_MESH_COMPRESS_UV = (1 << 1),
+  /* "normal" as normalized signed 10_10_10_2 */
+  GST_3D_MESH_COMPRESS_NORMAL = (1 << 2),
+} Gst3DMeshCompressFlags;
+
+/* uv and normal precision stays below what is visible, half float
+ * positions are only good for meshes of moderate extent */
+#define GST_3D_MESH_COMPRESS_DEFAULT \
+    (GST_3D_MESH_COMPRESS_UV | GST_3D_MESH_COMPRESS_NORMAL)
+#define GST_3D_MESH_COMPRESS_ALL \
+    (GST_3D_MESH_COMPRESS_DEFAULT | GST_3D_MESH_COMPRESS_POSITION)
+
+guint16 gst_3d_mesh_compress_half (gfloat value);
+gfloat gst_3d_mesh_compress_half_to_float (guint16 half);
+guint32 gst_3d_mesh_compress_normal (const gfloat * normal);
+
+gpointer gst_3d_mesh_compress_attribute (const gchar * name,
+    const guint8 * vectors, gsize stride, guint count, guint vector_length,
+    Gst3DMeshCompressFlags flags, struct Gst3DMeshDataAttribute *format);
+
+gboolean gst_3d_mesh_data_compress (Gst3DMeshData * self,
+    Gst3DMeshCompressFlags flags);
+
+G_END_DECLS
+#endif /* __GST_3D_MESH_COMPRESS_H__ */
@@ -0,0 +1,258 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gst3dmeshdata.h"
+#include "gst3dgeometry.h"
+
+/* GL_TRIANGLES */
+#define DEFAULT_DRAW_MODE 0x0004
+
+/* GL_LINE_LOOP, GL_LINE_STRIP, GL_TRIANGLE_STRIP and GL_TRIANGLE_FAN */
+#define IS_STRIP_MODE(mode) ((mode) == 0x0002 || (mode) == 0x0003 \
+    || (mode) == 0x0005 || (mode) == 0x0006)
+
+Gst3DMeshData *
+gst_3d_mesh_data_new (void)
+{
+  Gst3DMeshData *self = g_new0 (Gst3DMeshData, 1);
+  self->draw_mode = DEFAULT_DRAW_MODE;
+  return self;
+}
+
+void
+gst_3d_mesh_data_free (Gst3DMeshData * self)
+{
+  if (!self)
+    return;
+  g_free (self->vertices);
+  g_free (self->indices);
+  g_free (self);
+}
+
+Gst3DMeshData *
+gst_3d_mesh_data_copy (const Gst3DMeshData * self)
+{
+  Gst3DMeshData *copy = g_new (Gst3DMeshData, 1);
+  *copy = *self;
+  copy->vertices = g_memdup (self->vertices,
+      self->vertex_count * self->stride);
+  copy->indices = g_memdup (self->indices,
+      self->index_count * sizeof (guint32));
+  return copy;
+}
+
+/* Attributes have to be added before gst_3d_mesh_data_alloc. Returns the
+ * attribute index or -1 when the layout is full. */
+gint
+gst_3d_mesh_data_add_attribute (Gst3DMeshData * self, const gchar * name,
+    guint vector_length)
+{
+  g_return_val_if_fail (self->vertices == NULL, -1);
+  g_return_val_if_fail (self->n_attributes < GST_3D_MESH_DATA_MAX_ATTRIBUTES,
+      -1);
+
+  struct Gst3DMeshDataAttribute *attrib =
+      &self->attributes[self->n_attributes];
+  attrib->name = g_intern_string (name);
+  attrib->vector_length = vector_length;
+  attrib->element_size = sizeof (gfloat);
+  attrib->offset = self->stride;
+  attrib->type = GST_3D_MESH_DATA_FLOAT;
+  attrib->normalized = FALSE;
+
+  self->stride += vector_length * attrib->element_size;
+
+  return self->n_attributes++;
+}
+
+gint
+gst_3d_mesh_data_find_attribute (Gst3DMeshData * self, const gchar * name)
+{
+  for (guint i = 0; i < self->n_attributes; i++)
+    if (g_strcmp0 (self->attributes[i].name, name) == 0)
+      return i;
+  return -1;
+}
+
+/* Bytes of one vertex of an attribute. */
+gsize
+gst_3d_mesh_data_attribute_size (guint type, guint vector_length,
+    gsize element_size)
+{
+  if (type == GST_3D_MESH_DATA_INT_2_10_10_10_REV)
+    return element_size;
+  return vector_length * element_size;
+}
+
+void
+gst_3d_mesh_data_alloc (Gst3DMeshData * self, guint vertex_count,
+    guint index_count)
+{
+  g_free (self->vertices);
+  g_free (self->indices);
+
+  self->vertex_count = vertex_count;
+  self->index_count = index_count;
+  self->vertices = g_malloc0 (vertex_count * self->stride);
+  self->indices = g_new0 (guint32, index_count);
+}
+
+/* Only valid for GST_3D_MESH_DATA_FLOAT attributes, so CPU processing
+ * like optimization and simplification has to happen before
+ * gst_3d_mesh_data_compress. */
+gfloat *
+gst_3d_mesh_data_get_attribute (Gst3DMeshData * self, guint attribute,
+    guint vertex)
+{
+  g_return_val_if_fail (self->attributes[attribute].type ==
+      GST_3D_MESH_DATA_FLOAT, NULL);
+
+  return (gfloat *) (self->vertices + vertex * self->stride
+      + self->attributes[attribute].offset);
+}
+
+static gboolean
+_layout_matches (const Gst3DMeshData * self, const Gst3DMeshData * other)
+{
+  if (self->n_attributes != other->n_attributes
+      || self->stride != other->stride
+      || self->draw_mode != other->draw_mode)
+    return FALSE;
+
+  for (guint i = 0; i < self->n_attributes; i++) {
+    const struct Gst3DMeshDataAttribute *a = &self->attributes[i];
+    const struct Gst3DMeshDataAttribute *b = &other->attributes[i];
+    if (a->name != b->name || a->vector_length != b->vector_length
+        || a->offset != b->offset || a->type != b->type
+        || a->normalized != b->normalized)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Appends the vertices and indices of @other, so both are drawn with one
+ * call. Strips and fans are separated by GST_3D_GEOMETRY_RESTART_INDEX,
+ * which has to be drawn with primitive restart enabled as
+ * gst_3d_mesh_draw does. Returns FALSE without changing @self when the
+ * vertex layouts or draw modes differ. */
+gboolean
+gst_3d_mesh_data_concat (Gst3DMeshData * self, const Gst3DMeshData * other)
+{
+  g_return_val_if_fail (self != NULL && other != NULL, FALSE);
+  g_return_val_if_fail (self != other, FALSE);
+
+  if (!_layout_matches (self, other))
+    return FALSE;
+
+  gboolean restart = IS_STRIP_MODE (self->draw_mode)
+      && self->index_count > 0 && other->index_count > 0;
+  guint index_count = self->index_count + other->index_count + restart;
+
+  self->vertices = g_realloc (self->vertices,
+      (gsize) (self->vertex_count + other->vertex_count) * self->stride);
+  memcpy (self->vertices + (gsize) self->vertex_count * self->stride,
+      other->vertices, (gsize) other->vertex_count * other->stride);
+
+  self->indices = g_renew (guint32, self->indices, index_count);
+  guint32 *indices = self->indices + self->index_count;
+  if (restart)
+    *indices++ = GST_3D_GEOMETRY_RESTART_INDEX;
+  for (guint i = 0; i < other->index_count; i++)
+    indices[i] = other->indices[i] == GST_3D_GEOMETRY_RESTART_INDEX ?
+        GST_3D_GEOMETRY_RESTART_INDEX :
+        other->indices[i] + self->vertex_count;
+
+  self->vertex_count += other->vertex_count;
+  self->index_count = index_count;
+
+  return TRUE;
+}
+
+static void
+_append_segment (GArray * out, guint draw_mode, const guint32 * s, guint n)
+{
+  switch (draw_mode) {
+    case 0x0005:
+      /* GL_TRIANGLE_STRIP: repeat the last index and the first one of the
+       * next strip, plus one more to start it on an even triangle */
+      if (out->len > 0) {
+        guint32 last = g_array_index (out, guint32, out->len - 1);
+        g_array_append_val (out, last);
+        if (out->len % 2 == 0)
+          g_array_append_val (out, last);
+        g_array_append_val (out, s[0]);
+      }
+      g_array_append_vals (out, s, n);
+      break;
+    case 0x0006:
+      /* GL_TRIANGLE_FAN */
+      for (guint i = 1; i + 1 < n; i++) {
+        guint32 triangle[] = { s[0], s[i], s[i + 1] };
+        g_array_append_vals (out, triangle, 3);
+      }
+      break;
+    default:
+      /* GL_LINE_STRIP, closed for GL_LINE_LOOP */
+      for (guint i = 0; i + 1 < n; i++)
+        g_array_append_vals (out, &s[i], 2);
+      if (draw_mode == 0x0002 && n > 2) {
+        guint32 line[] = { s[n - 1], s[0] };
+        g_array_append_vals (out, line, 2);
+      }
+      break;
+  }
+}
+
+/* Rewrites @count indices drawn as @draw_mode for contexts without
+ * primitive restart, where GST_3D_GEOMETRY_RESTART_INDEX would be drawn
+ * as a vertex. Triangle strips are joined with degenerate triangles that
+ * keep the winding of every strip, fans and line strips or loops become
+ * lists. Returns the new indices, their count in @n_indices, and updates
+ * @draw_mode. */
+guint32 *
+gst_3d_mesh_data_unroll_restarts (const guint32 * indices, guint count,
+    guint * draw_mode, guint * n_indices)
+{
+  GArray *out = g_array_sized_new (FALSE, FALSE, sizeof (guint32), count);
+  guint start = 0;
+
+  for (guint i = 0; i <= count; i++) {
+    if (i < count && indices[i] != GST_3D_GEOMETRY_RESTART_INDEX)
+      continue;
+    if (i > start)
+      _append_segment (out, *draw_mode, indices + start, i - start);
+    start = i + 1;
+  }
+
+  if (*draw_mode == 0x0006)
+    *draw_mode = 0x0004;
+  else if (*draw_mode == 0x0002 || *draw_mode == 0x0003)
+    *draw_mode = 0x0001;
+
+  *n_indices = out->len;
+  return (guint32 *) g_array_free (out, FALSE);
+}
@@ -0,0 +1,90 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_MESH_DATA_H__
+#define __GST_3D_MESH_DATA_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define GST_3D_MESH_DATA_MAX_ATTRIBUTES 8
+
+/* attribute component types, same values as the GL enums */
+#define GST_3D_MESH_DATA_FLOAT 0x1406
+#define GST_3D_MESH_DATA_HALF_FLOAT 0x140B
+#define GST_3D_MESH_DATA_UNSIGNED_SHORT 0x1403
+#define GST_3D_MESH_DATA_INT_2_10_10_10_REV 0x8D9F
+
+typedef struct _Gst3DMeshData Gst3DMeshData;
+
+/* element_size is the size of one component, or of the whole vector for
+ * packed types like GST_3D_MESH_DATA_INT_2_10_10_10_REV, which hold all
+ * vector_length components in one element. See
+ * gst_3d_mesh_data_attribute_size. */
+struct Gst3DMeshDataAttribute
+{
+  const gchar *name;
+  guint vector_length;
+  gsize element_size;
+  gsize offset;
+  guint type;
+  gboolean normalized;
+};
+
+/* CPU side mesh: all attributes interleaved in one vertex blob, ready to
+ * be uploaded to an interleaved Gst3DMesh without further conversion. */
+struct _Gst3DMeshData
+{
+  struct Gst3DMeshDataAttribute attributes[GST_3D_MESH_DATA_MAX_ATTRIBUTES];
+  guint n_attributes;
+  gsize stride;
+
+  guint vertex_count;
+  guint index_count;
+
+  guint8 *vertices;
+  guint32 *indices;
+
+  guint draw_mode;
+};
+
+Gst3DMeshData *gst_3d_mesh_data_new (void);
+Gst3DMeshData *gst_3d_mesh_data_copy (const Gst3DMeshData * self);
+void gst_3d_mesh_data_free (Gst3DMeshData * self);
+
+gint gst_3d_mesh_data_add_attribute (Gst3DMeshData * self, const gchar * name,
+    guint vector_length);
+gint gst_3d_mesh_data_find_attribute (Gst3DMeshData * self,
+    const gchar * name);
+gsize gst_3d_mesh_data_attribute_size (guint type, guint vector_length,
+    gsize element_size);
+void gst_3d_mesh_data_alloc (Gst3DMeshData * self, guint vertex_count,
+    guint index_count);
+
+gfloat *gst_3d_mesh_data_get_attribute (Gst3DMeshData * self, guint attribute,
+    guint vertex);
+gboolean gst_3d_mesh_data_concat (Gst3DMeshData * self,
+    const Gst3DMeshData * other);
+guint32 *gst_3d_mesh_data_unroll_restarts (const guint32 * indices,
+    guint count, guint * draw_mode, guint * n_indices);
+
+G_END_DECLS
+#endif /* __GST_3D_MESH_DATA_H__ */
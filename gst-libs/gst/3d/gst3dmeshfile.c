@@ -0,0 +1,315 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "gst3dmeshfile.h"
+#include "gst3dgeometry.h"
+
+struct _Gst3DMeshFile
+{
+  GMappedFile *map;
+  const guint8 *data;
+  gsize size;
+  const Gst3DMeshFileHeader *header;
+  const Gst3DMeshFileEntry *entries;
+};
+
+G_DEFINE_QUARK (gst-3d-mesh-file-error-quark, gst_3d_mesh_file_error);
+
+static gsize
+_align (gsize offset)
+{
+  return (offset + GST_3D_MESH_FILE_ALIGNMENT - 1)
+      & ~((gsize) GST_3D_MESH_FILE_ALIGNMENT - 1);
+}
+
+/* G_MAXUINT16 is reserved for the restart index in 16 bit buffers */
+static gboolean
+_index_fits_short (const Gst3DMeshData * mesh)
+{
+  for (guint i = 0; i < mesh->index_count; i++)
+    if (mesh->indices[i] != GST_3D_GEOMETRY_RESTART_INDEX
+        && mesh->indices[i] >= G_MAXUINT16)
+      return FALSE;
+  return TRUE;
+}
+
+gchar *
+gst_3d_mesh_file_get_cache_path (const gchar * source)
+{
+  return g_strconcat (source, GST_3D_MESH_FILE_SUFFIX, NULL);
+}
+
+static gboolean
+_blob_in_bounds (Gst3DMeshFile * self, guint64 offset, guint64 size)
+{
+  return offset % GST_3D_MESH_FILE_ALIGNMENT == 0 && offset <= self->size
+      && size <= self->size - offset;
+}
+
+static gboolean
+_validate (Gst3DMeshFile * self, GError ** error)
+{
+  if (self->size < sizeof (Gst3DMeshFileHeader)
+      || memcmp (self->header->magic, GST_3D_MESH_FILE_MAGIC,
+          sizeof (GST_3D_MESH_FILE_MAGIC)) != 0) {
+    g_set_error (error, GST_3D_MESH_FILE_ERROR,
+        GST_3D_MESH_FILE_ERROR_INVALID, "Not a mesh cache file");
+    return FALSE;
+  }
+
+  if (self->header->version != GST_3D_MESH_FILE_VERSION) {
+    g_set_error (error, GST_3D_MESH_FILE_ERROR,
+        GST_3D_MESH_FILE_ERROR_VERSION, "Unsupported mesh cache version %d",
+        self->header->version);
+    return FALSE;
+  }
+
+  guint64 table_size =
+      (guint64) self->header->n_meshes * sizeof (Gst3DMeshFileEntry);
+  if (table_size > self->size - sizeof (Gst3DMeshFileHeader))
+    goto truncated;
+
+  for (guint i = 0; i < self->header->n_meshes; i++) {
+    const Gst3DMeshFileEntry *entry = &self->entries[i];
+
+    if (entry->n_attributes > GST_3D_MESH_DATA_MAX_ATTRIBUTES
+        || (entry->index_size != 2 && entry->index_size != 4))
+      goto truncated;
+
+    /* levels of detail continue the chain of the entry before */
+    if (entry->lod != 0 && (i == 0 || entry->lod != self->entries[i - 1].lod
+            + 1))
+      goto truncated;
+
+    for (guint j = 0; j < entry->n_attributes; j++) {
+      const Gst3DMeshFileAttribute *attrib = &entry->attributes[j];
+      if (!memchr (attrib->name, '\0', sizeof (attrib->name))
+          || attrib->offset + gst_3d_mesh_data_attribute_size (attrib->type,
+              attrib->vector_length, attrib->element_size) > entry->stride)
+        goto truncated;
+    }
+
+    if (!_blob_in_bounds (self, entry->vertices_offset,
+            (guint64) entry->vertex_count * entry->stride)
+        || !_blob_in_bounds (self, entry->indices_offset,
+            (guint64) entry->index_count * entry->index_size))
+      goto truncated;
+  }
+
+  return TRUE;
+
+truncated:
+  g_set_error (error, GST_3D_MESH_FILE_ERROR, GST_3D_MESH_FILE_ERROR_INVALID,
+      "Corrupt mesh cache file");
+  return FALSE;
+}
+
+/* Maps the file read only. Nothing is copied, the accessors return
+ * pointers into the mapping which stay valid until the file is closed. */
+Gst3DMeshFile *
+gst_3d_mesh_file_open (const gchar * path, GError ** error)
+{
+  GMappedFile *map = g_mapped_file_new (path, FALSE, error);
+  if (!map)
+    return NULL;
+
+  Gst3DMeshFile *self = g_new0 (Gst3DMeshFile, 1);
+  self->map = map;
+  self->data = (const guint8 *) g_mapped_file_get_contents (map);
+  self->size = g_mapped_file_get_length (map);
+  self->header = (const Gst3DMeshFileHeader *) self->data;
+  self->entries = (const Gst3DMeshFileEntry *) (self->data
+      + sizeof (Gst3DMeshFileHeader));
+
+  if (!_validate (self, error)) {
+    gst_3d_mesh_file_close (self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void
+gst_3d_mesh_file_close (Gst3DMeshFile * self)
+{
+  if (!self)
+    return;
+  g_mapped_file_unref (self->map);
+  g_free (self);
+}
+
+gboolean
+gst_3d_mesh_file_matches_source (Gst3DMeshFile * self, const gchar * source)
+{
+  GStatBuf buf;
+  if (g_stat (source, &buf) != 0)
+    return FALSE;
+  return self->header->source_size == (guint64) buf.st_size
+      && self->header->source_mtime == (gint64) buf.st_mtime;
+}
+
+guint
+gst_3d_mesh_file_get_n_meshes (Gst3DMeshFile * self)
+{
+  return self->header->n_meshes;
+}
+
+const Gst3DMeshFileEntry *
+gst_3d_mesh_file_get_entry (Gst3DMeshFile * self, guint index)
+{
+  g_return_val_if_fail (index < self->header->n_meshes, NULL);
+  return &self->entries[index];
+}
+
+gconstpointer
+gst_3d_mesh_file_get_vertices (Gst3DMeshFile * self, guint index)
+{
+  g_return_val_if_fail (index < self->header->n_meshes, NULL);
+  return self->data + self->entries[index].vertices_offset;
+}
+
+gconstpointer
+gst_3d_mesh_file_get_indices (Gst3DMeshFile * self, guint index)
+{
+  g_return_val_if_fail (index < self->header->n_meshes, NULL);
+  return self->data + self->entries[index].indices_offset;
+}
+
+static void
+_write_entry (Gst3DMeshFileEntry * entry, const Gst3DMeshData * mesh,
+    guint lod)
+{
+  entry->vertex_count = mesh->vertex_count;
+  entry->index_count = mesh->index_count;
+  entry->index_size = _index_fits_short (mesh) ? 2 : 4;
+  entry->stride = mesh->stride;
+  entry->draw_mode = mesh->draw_mode;
+  entry->n_attributes = mesh->n_attributes;
+  entry->lod = lod;
+
+  for (guint j = 0; j < mesh->n_attributes; j++) {
+    const struct Gst3DMeshDataAttribute *attrib = &mesh->attributes[j];
+    g_strlcpy (entry->attributes[j].name, attrib->name,
+        sizeof (entry->attributes[j].name));
+    entry->attributes[j].vector_length = attrib->vector_length;
+    entry->attributes[j].element_size = attrib->element_size;
+    entry->attributes[j].offset = attrib->offset;
+    entry->attributes[j].type = attrib->type;
+    entry->attributes[j].normalized = attrib->normalized;
+  }
+}
+
+static void
+_write_indices (guint8 * dest, const Gst3DMeshFileEntry * entry,
+    const Gst3DMeshData * mesh)
+{
+  if (entry->index_size == 2) {
+    guint16 *indices = (guint16 *) dest;
+    for (guint j = 0; j < mesh->index_count; j++)
+      indices[j] = mesh->indices[j] == GST_3D_GEOMETRY_RESTART_INDEX ?
+          G_MAXUINT16 : mesh->indices[j];
+  } else {
+    memcpy (dest, mesh->indices, (gsize) mesh->index_count * sizeof (guint32));
+  }
+}
+
+/* Writes @meshes and their levels of detail from @lods, which can be NULL
+ * or hold a GPtrArray of Gst3DMeshData or NULL per mesh, to @path.
+ * Size and mtime of @source are recorded to detect stale caches. NULL
+ * entries in @meshes are skipped. */
+gboolean
+gst_3d_mesh_file_save (const gchar * path, const gchar * source,
+    Gst3DMeshData ** meshes, GPtrArray ** lods, guint n_meshes,
+    GError ** error)
+{
+  Gst3DMeshFileHeader header;
+  GStatBuf buf;
+  GPtrArray *written = g_ptr_array_new ();
+  GArray *levels = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (guint i = 0; i < n_meshes; i++) {
+    if (!meshes[i])
+      continue;
+    guint lod = 0;
+    g_ptr_array_add (written, meshes[i]);
+    g_array_append_val (levels, lod);
+    for (lod = 1; lods && lods[i] && lod <= lods[i]->len; lod++) {
+      g_ptr_array_add (written, g_ptr_array_index (lods[i], lod - 1));
+      g_array_append_val (levels, lod);
+    }
+  }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, GST_3D_MESH_FILE_MAGIC,
+      sizeof (GST_3D_MESH_FILE_MAGIC));
+  header.version = GST_3D_MESH_FILE_VERSION;
+  header.n_meshes = written->len;
+  if (source && g_stat (source, &buf) == 0) {
+    header.source_size = buf.st_size;
+    header.source_mtime = buf.st_mtime;
+  }
+
+  Gst3DMeshFileEntry *entries = g_new0 (Gst3DMeshFileEntry, written->len);
+  gsize offset = sizeof (header) + written->len * sizeof (Gst3DMeshFileEntry);
+
+  for (guint i = 0; i < written->len; i++) {
+    const Gst3DMeshData *mesh = g_ptr_array_index (written, i);
+    _write_entry (&entries[i], mesh, g_array_index (levels, guint, i));
+    entries[i].vertices_offset = _align (offset);
+    offset = entries[i].vertices_offset
+        + (gsize) mesh->vertex_count * mesh->stride;
+  }
+
+  for (guint i = 0; i < written->len; i++) {
+    const Gst3DMeshData *mesh = g_ptr_array_index (written, i);
+    entries[i].indices_offset = _align (offset);
+    offset = entries[i].indices_offset
+        + (gsize) mesh->index_count * entries[i].index_size;
+  }
+
+  guint8 *contents = g_malloc0 (offset);
+  memcpy (contents, &header, sizeof (header));
+  memcpy (contents + sizeof (header), entries,
+      written->len * sizeof (Gst3DMeshFileEntry));
+
+  for (guint i = 0; i < written->len; i++) {
+    const Gst3DMeshData *mesh = g_ptr_array_index (written, i);
+    memcpy (contents + entries[i].vertices_offset, mesh->vertices,
+        (gsize) mesh->vertex_count * mesh->stride);
+    _write_indices (contents + entries[i].indices_offset, &entries[i], mesh);
+  }
+
+  gboolean ret = g_file_set_contents (path, (const gchar *) contents, offset,
+      error);
+
+  g_free (contents);
+  g_free (entries);
+  g_ptr_array_unref (written);
+  g_array_free (levels, TRUE);
+
+  return ret;
+}
@@ -0,0 +1,115 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_MESH_FILE_H__
+#define __GST_3D_MESH_FILE_H__
+
+#include <glib.h>
+
+#include "gst3dmeshdata.h"
+
+G_BEGIN_DECLS
+
+#define GST_3D_MESH_FILE_MAGIC "G3DMESH"
+#define GST_3D_MESH_FILE_VERSION 3
+#define GST_3D_MESH_FILE_ALIGNMENT 64
+#define GST_3D_MESH_FILE_SUFFIX ".g3dm"
+
+#define GST_3D_MESH_FILE_ERROR (gst_3d_mesh_file_error_quark ())
+
+typedef enum
+{
+  GST_3D_MESH_FILE_ERROR_INVALID,
+  GST_3D_MESH_FILE_ERROR_VERSION,
+} Gst3DMeshFileError;
+
+/* On disk layout, in host byte order since the files are a local cache:
+ *
+ *   Gst3DMeshFileHeader
+ *   Gst3DMeshFileEntry[n_meshes]
+ *   vertex blobs of all entries
+ *   index blobs of all entries
+ *
+ * Every blob is aligned to GST_3D_MESH_FILE_ALIGNMENT. Vertex blobs are
+ * interleaved and index blobs already use the smallest index type, so all
+ * vertices and all indices can each be passed to one BufferData straight
+ * from the map. Levels of detail follow the entry of their mesh.
+ */
+typedef struct
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 n_meshes;
+  guint64 source_size;
+  gint64 source_mtime;
+} Gst3DMeshFileHeader;
+
+typedef struct
+{
+  gchar name[16];
+  guint32 vector_length;
+  guint32 element_size;
+  guint32 offset;
+  /* GL component type, 0 in files written before packed formats means
+   * GST_3D_MESH_DATA_FLOAT */
+  guint16 type;
+  guint16 normalized;
+} Gst3DMeshFileAttribute;
+
+typedef struct
+{
+  guint32 vertex_count;
+  guint32 index_count;
+  guint32 index_size;
+  guint32 stride;
+  guint32 draw_mode;
+  guint32 n_attributes;
+  /* 0 for a mesh, n for the n-th coarser level of the preceding mesh */
+  guint32 lod;
+  guint64 vertices_offset;
+  guint64 indices_offset;
+  Gst3DMeshFileAttribute attributes[GST_3D_MESH_DATA_MAX_ATTRIBUTES];
+} Gst3DMeshFileEntry;
+
+typedef struct _Gst3DMeshFile Gst3DMeshFile;
+
+GQuark gst_3d_mesh_file_error_quark (void);
+
+gchar *gst_3d_mesh_file_get_cache_path (const gchar * source);
+
+Gst3DMeshFile *gst_3d_mesh_file_open (const gchar * path, GError ** error);
+void gst_3d_mesh_file_close (Gst3DMeshFile * self);
+gboolean gst_3d_mesh_file_matches_source (Gst3DMeshFile * self,
+    const gchar * source);
+
+guint gst_3d_mesh_file_get_n_meshes (Gst3DMeshFile * self);
+const Gst3DMeshFileEntry *gst_3d_mesh_file_get_entry (Gst3DMeshFile * self,
+    guint index);
+gconstpointer gst_3d_mesh_file_get_vertices (Gst3DMeshFile * self,
+    guint index);
+gconstpointer gst_3d_mesh_file_get_indices (Gst3DMeshFile * self,
+    guint index);
+
+gboolean gst_3d_mesh_file_save (const gchar * path, const gchar * source,
+    Gst3DMeshData ** meshes, GPtrArray ** lods, guint n_meshes,
+    GError ** error);
+
+G_END_DECLS
+#endif /* __GST_3D_MESH_FILE_H__ */
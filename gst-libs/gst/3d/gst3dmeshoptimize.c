@@ -0,0 +1,462 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Triangle and vertex reordering for Gst3DMeshData, run on the CPU before
+ * upload. gst_3d_mesh_optimize_vertex_cache implements Tipsify (Sander,
+ * Nehab, Barczak: Fast Triangle Reordering for Vertex Locality and Reduced
+ * Overdraw, 2007), gst_3d_mesh_optimize_overdraw its cluster sorting and
+ * gst_3d_mesh_optimize_vertex_fetch lays vertices out in first use order.
+ * All passes are deterministic, equal input gives equal output.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <math.h>
+
+#include "gst3dmeshoptimize.h"
+
+/* GL_TRIANGLES */
+#define TRIANGLES 0x0004
+
+struct Cluster
+{
+  guint start;
+  guint end;
+  gfloat sort_key;
+};
+
+static guint
+_count_misses (const guint32 * indices, guint index_count, guint vertex_count,
+    guint cache_size)
+{
+  guint *stamps = g_new0 (guint, vertex_count);
+  guint time = cache_size + 1;
+  guint misses = 0;
+
+  for (guint i = 0; i < index_count; i++) {
+    guint32 v = indices[i];
+    if (time - stamps[v] > cache_size) {
+      stamps[v] = time++;
+      misses++;
+    }
+  }
+
+  g_free (stamps);
+  return misses;
+}
+
+/* Simulates a FIFO post transform cache of @cache_size entries. */
+gfloat
+gst_3d_mesh_optimize_acmr (const guint32 * indices, guint index_count,
+    guint vertex_count, guint cache_size)
+{
+  if (index_count < 3)
+    return 0.0f;
+  return (gfloat) _count_misses (indices, index_count, vertex_count,
+      cache_size) / (index_count / 3);
+}
+
+gfloat
+gst_3d_mesh_optimize_atvr (const guint32 * indices, guint index_count,
+    guint vertex_count, guint cache_size)
+{
+  gboolean *used = g_new0 (gboolean, vertex_count);
+  guint n_used = 0;
+
+  for (guint i = 0; i < index_count; i++) {
+    if (!used[indices[i]]) {
+      used[indices[i]] = TRUE;
+      n_used++;
+    }
+  }
+  g_free (used);
+
+  if (n_used == 0)
+    return 0.0f;
+  return (gfloat) _count_misses (indices, index_count, vertex_count,
+      cache_size) / n_used;
+}
+
+static gint64
+_skip_dead_end (const guint * live, const guint32 * dead_end, guint * top,
+    guint * cursor, guint vertex_count)
+{
+  while (*top > 0) {
+    guint32 v = dead_end[--(*top)];
+    if (live[v] > 0)
+      return v;
+  }
+
+  for (; *cursor < vertex_count; (*cursor)++)
+    if (live[*cursor] > 0)
+      return *cursor;
+
+  return -1;
+}
+
+/* Reorders the triangles of @indices into @destination so consecutive
+ * triangles share cached vertices. When @clusters is not NULL it receives
+ * the first triangle of every cluster started at a dead end and has to
+ * hold index_count / 3 entries. Returns the number of clusters.
+ */
+guint
+gst_3d_mesh_optimize_vertex_cache (guint32 * destination,
+    const guint32 * indices, guint index_count, guint vertex_count,
+    guint cache_size, guint * clusters)
+{
+  guint triangle_count = index_count / 3;
+
+  if (triangle_count == 0)
+    return 0;
+
+  guint *live = g_new0 (guint, vertex_count);
+  for (guint i = 0; i < triangle_count * 3; i++)
+    live[indices[i]]++;
+
+  /* vertex to triangle adjacency in compressed row form */
+  guint *offsets = g_new (guint, vertex_count + 1);
+  offsets[0] = 0;
+  for (guint v = 0; v < vertex_count; v++)
+    offsets[v + 1] = offsets[v] + live[v];
+
+  guint *fill = g_new (guint, vertex_count);
+  memcpy (fill, offsets, vertex_count * sizeof (guint));
+  guint *adjacency = g_new (guint, triangle_count * 3);
+  for (guint t = 0; t < triangle_count; t++)
+    for (guint c = 0; c < 3; c++)
+      adjacency[fill[indices[t * 3 + c]]++] = t;
+  g_free (fill);
+
+  guint *stamps = g_new0 (guint, vertex_count);
+  gboolean *emitted = g_new0 (gboolean, triangle_count);
+  guint32 *dead_end = g_new (guint32, triangle_count * 3);
+  guint top = 0;
+  guint cursor = 0;
+  guint time = cache_size + 1;
+  guint output = 0;
+  guint n_clusters = 0;
+  gboolean new_cluster = TRUE;
+
+  gint64 fanning = _skip_dead_end (live, dead_end, &top, &cursor,
+      vertex_count);
+
+  while (fanning >= 0) {
+    if (new_cluster) {
+      if (clusters)
+        clusters[n_clusters] = output / 3;
+      n_clusters++;
+    }
+
+    guint candidates = top;
+
+    for (guint a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+      guint t = adjacency[a];
+      if (emitted[t])
+        continue;
+
+      for (guint c = 0; c < 3; c++) {
+        guint32 v = indices[t * 3 + c];
+        destination[output++] = v;
+        dead_end[top++] = v;
+        live[v]--;
+        if (time - stamps[v] > cache_size)
+          stamps[v] = time++;
+      }
+      emitted[t] = TRUE;
+    }
+
+    /* prefer the oldest cached candidate that stays cached while its
+     * remaining triangles are emitted */
+    gint64 best = -1;
+    gint64 best_priority = -1;
+    for (guint i = candidates; i < top; i++) {
+      guint32 v = dead_end[i];
+      if (live[v] == 0)
+        continue;
+
+      gint64 priority = 0;
+      if (time - stamps[v] + 2 * live[v] <= cache_size)
+        priority = time - stamps[v];
+
+      if (priority > best_priority) {
+        best = v;
+        best_priority = priority;
+      }
+    }
+
+    new_cluster = best == -1;
+    if (new_cluster)
+      fanning = _skip_dead_end (live, dead_end, &top, &cursor, vertex_count);
+    else
+      fanning = best;
+  }
+
+  g_free (dead_end);
+  g_free (emitted);
+  g_free (stamps);
+  g_free (adjacency);
+  g_free (offsets);
+  g_free (live);
+
+  return n_clusters;
+}
+
+static const gfloat *
+_position (const guint8 * positions, gsize stride, guint32 vertex)
+{
+  return (const gfloat *) (positions + vertex * stride);
+}
+
+static gint
+_compare_clusters (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const struct Cluster *ca = a;
+  const struct Cluster *cb = b;
+
+  if (ca->sort_key != cb->sort_key)
+    return ca->sort_key > cb->sort_key ? -1 : 1;
+  return ca->start < cb->start ? -1 : (ca->start > cb->start);
+}
+
+/* Splits the vertex cache @clusters further wherever the running ACMR
+ * drops below @threshold times the ACMR of the mesh, then draws the
+ * clusters facing away from the mesh center first, so they occlude the
+ * inner ones. @indices has to be the output of
+ * gst_3d_mesh_optimize_vertex_cache. Returns the number of clusters.
+ */
+guint
+gst_3d_mesh_optimize_overdraw (guint32 * destination, const guint32 * indices,
+    guint index_count, const guint8 * positions, gsize stride,
+    guint vertex_count, const guint * clusters, guint n_clusters,
+    guint cache_size, gfloat threshold)
+{
+  guint triangle_count = index_count / 3;
+
+  if (triangle_count == 0)
+    return 0;
+
+  gfloat limit = threshold * gst_3d_mesh_optimize_acmr (indices,
+      triangle_count * 3, vertex_count, cache_size);
+
+  GArray *soft = g_array_new (FALSE, TRUE, sizeof (struct Cluster));
+  guint *stamps = g_new0 (guint, vertex_count);
+  guint time = cache_size + 1;
+
+  for (guint c = 0; c < n_clusters; c++) {
+    guint end = c + 1 < n_clusters ? clusters[c + 1] : triangle_count;
+    struct Cluster cluster = { clusters[c], 0, 0.0f };
+    guint misses = 0;
+
+    /* clusters may be drawn in any order, measure them with a cold cache */
+    time += cache_size + 1;
+
+    for (guint t = clusters[c]; t < end; t++) {
+      for (guint i = 0; i < 3; i++) {
+        guint32 v = indices[t * 3 + i];
+        if (time - stamps[v] > cache_size) {
+          stamps[v] = time++;
+          misses++;
+        }
+      }
+
+      guint length = t + 1 - cluster.start;
+      if (t + 1 < end && (gfloat) misses / length <= limit) {
+        cluster.end = t + 1;
+        g_array_append_val (soft, cluster);
+        cluster.start = t + 1;
+        misses = 0;
+        time += cache_size + 1;
+      }
+    }
+
+    cluster.end = end;
+    g_array_append_val (soft, cluster);
+  }
+
+  g_free (stamps);
+
+  /* area weighted mesh centroid */
+  gdouble center[3] = { 0, 0, 0 };
+  gdouble total_area = 0;
+  for (guint t = 0; t < triangle_count; t++) {
+    const gfloat *p0 = _position (positions, stride, indices[t * 3]);
+    const gfloat *p1 = _position (positions, stride, indices[t * 3 + 1]);
+    const gfloat *p2 = _position (positions, stride, indices[t * 3 + 2]);
+    gdouble e1[3], e2[3];
+    for (guint i = 0; i < 3; i++) {
+      e1[i] = p1[i] - p0[i];
+      e2[i] = p2[i] - p0[i];
+    }
+    gdouble nx = e1[1] * e2[2] - e1[2] * e2[1];
+    gdouble ny = e1[2] * e2[0] - e1[0] * e2[2];
+    gdouble nz = e1[0] * e2[1] - e1[1] * e2[0];
+    gdouble area = sqrt (nx * nx + ny * ny + nz * nz);
+    for (guint i = 0; i < 3; i++)
+      center[i] += area * (p0[i] + p1[i] + p2[i]) / 3.0;
+    total_area += area;
+  }
+  if (total_area > 0)
+    for (guint i = 0; i < 3; i++)
+      center[i] /= total_area;
+
+  for (guint c = 0; c < soft->len; c++) {
+    struct Cluster *cluster = &g_array_index (soft, struct Cluster, c);
+    gdouble normal[3] = { 0, 0, 0 };
+    gdouble centroid[3] = { 0, 0, 0 };
+    gdouble area = 0;
+
+    for (guint t = cluster->start; t < cluster->end; t++) {
+      const gfloat *p0 = _position (positions, stride, indices[t * 3]);
+      const gfloat *p1 = _position (positions, stride, indices[t * 3 + 1]);
+      const gfloat *p2 = _position (positions, stride, indices[t * 3 + 2]);
+      gdouble e1[3], e2[3];
+      for (guint i = 0; i < 3; i++) {
+        e1[i] = p1[i] - p0[i];
+        e2[i] = p2[i] - p0[i];
+      }
+      gdouble n[3] = {
+        e1[1] * e2[2] - e1[2] * e2[1],
+        e1[2] * e2[0] - e1[0] * e2[2],
+        e1[0] * e2[1] - e1[1] * e2[0],
+      };
+      gdouble a = sqrt (n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      for (guint i = 0; i < 3; i++) {
+        normal[i] += n[i];
+        centroid[i] += a * (p0[i] + p1[i] + p2[i]) / 3.0;
+      }
+      area += a;
+    }
+
+    gdouble length = sqrt (normal[0] * normal[0] + normal[1] * normal[1]
+        + normal[2] * normal[2]);
+    if (area > 0 && length > 0) {
+      gdouble key = 0;
+      for (guint i = 0; i < 3; i++)
+        key += (centroid[i] / area - center[i]) * normal[i] / length;
+      cluster->sort_key = key;
+    }
+  }
+
+  g_qsort_with_data (soft->data, soft->len, sizeof (struct Cluster),
+      _compare_clusters, NULL);
+
+  guint output = 0;
+  for (guint c = 0; c < soft->len; c++) {
+    struct Cluster *cluster = &g_array_index (soft, struct Cluster, c);
+    guint count = (cluster->end - cluster->start) * 3;
+    memcpy (destination + output, indices + cluster->start * 3,
+        count * sizeof (guint32));
+    output += count;
+  }
+
+  guint n_soft = soft->len;
+  g_array_free (soft, TRUE);
+
+  return n_soft;
+}
+
+/* Stores vertices in the order the index buffer first references them and
+ * drops unreferenced ones, so vertex fetches walk memory linearly. */
+void
+gst_3d_mesh_optimize_vertex_fetch (Gst3DMeshData * self)
+{
+  guint32 *remap = g_new (guint32, self->vertex_count);
+  guint8 *vertices = g_malloc (self->vertex_count * self->stride);
+  guint next = 0;
+
+  memset (remap, 0xff, self->vertex_count * sizeof (guint32));
+
+  for (guint i = 0; i < self->index_count; i++) {
+    guint32 v = self->indices[i];
+    if (remap[v] == G_MAXUINT32) {
+      remap[v] = next;
+      memcpy (vertices + next * self->stride, self->vertices + v * self->stride,
+          self->stride);
+      next++;
+    }
+    self->indices[i] = remap[v];
+  }
+
+  g_free (self->vertices);
+  g_free (remap);
+  self->vertices = vertices;
+  self->vertex_count = next;
+}
+
+/* Runs vertex cache, overdraw and vertex fetch optimization in place.
+ * Overdraw ordering is skipped when there is no "position" attribute.
+ * Only indexed triangle lists are handled, returns FALSE otherwise.
+ */
+gboolean
+gst_3d_mesh_data_optimize (Gst3DMeshData * self, guint cache_size,
+    Gst3DMeshOptimizeStats * stats)
+{
+  g_return_val_if_fail (cache_size > 0, FALSE);
+
+  if (self->draw_mode != TRIANGLES || self->index_count < 3
+      || self->index_count % 3 != 0)
+    return FALSE;
+
+  for (guint i = 0; i < self->index_count; i++)
+    g_return_val_if_fail (self->indices[i] < self->vertex_count, FALSE);
+
+  if (stats) {
+    stats->cache_size = cache_size;
+    stats->acmr_before = gst_3d_mesh_optimize_acmr (self->indices,
+        self->index_count, self->vertex_count, cache_size);
+    stats->atvr_before = gst_3d_mesh_optimize_atvr (self->indices,
+        self->index_count, self->vertex_count, cache_size);
+  }
+
+  guint *clusters = g_new (guint, self->index_count / 3);
+  guint32 *reordered = g_new (guint32, self->index_count);
+  guint n_clusters = gst_3d_mesh_optimize_vertex_cache (reordered,
+      self->indices, self->index_count, self->vertex_count, cache_size,
+      clusters);
+
+  gint position = gst_3d_mesh_data_find_attribute (self, "position");
+  if (position != -1 && self->attributes[position].vector_length >= 3
+      && self->attributes[position].type == GST_3D_MESH_DATA_FLOAT) {
+    n_clusters = gst_3d_mesh_optimize_overdraw (self->indices, reordered,
+        self->index_count, self->vertices + self->attributes[position].offset,
+        self->stride, self->vertex_count, clusters, n_clusters, cache_size,
+        GST_3D_MESH_OPTIMIZE_OVERDRAW_THRESHOLD);
+  } else {
+    memcpy (self->indices, reordered, self->index_count * sizeof (guint32));
+  }
+
+  g_free (reordered);
+  g_free (clusters);
+
+  gst_3d_mesh_optimize_vertex_fetch (self);
+
+  if (stats) {
+    stats->clusters = n_clusters;
+    stats->acmr_after = gst_3d_mesh_optimize_acmr (self->indices,
+        self->index_count, self->vertex_count, cache_size);
+    stats->atvr_after = gst_3d_mesh_optimize_atvr (self->indices,
+        self->index_count, self->vertex_count, cache_size);
+  }
+
+  return TRUE;
+}
@@ -0,0 +1,65 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_MESH_OPTIMIZE_H__
+#define __GST_3D_MESH_OPTIMIZE_H__
+
+#include <glib.h>
+
+#include "gst3dmeshdata.h"
+
+G_BEGIN_DECLS
+
+#define GST_3D_MESH_OPTIMIZE_CACHE_SIZE 16
+#define GST_3D_MESH_OPTIMIZE_OVERDRAW_THRESHOLD 1.05f
+
+typedef struct
+{
+  guint cache_size;
+  guint clusters;
+
+  /* average cache miss ratio, misses per triangle */
+  gfloat acmr_before;
+  gfloat acmr_after;
+
+  /* average transform to vertex ratio, misses per referenced vertex */
+  gfloat atvr_before;
+  gfloat atvr_after;
+} Gst3DMeshOptimizeStats;
+
+gfloat gst_3d_mesh_optimize_acmr (const guint32 * indices, guint index_count,
+    guint vertex_count, guint cache_size);
+gfloat gst_3d_mesh_optimize_atvr (const guint32 * indices, guint index_count,
+    guint vertex_count, guint cache_size);
+
+guint gst_3d_mesh_optimize_vertex_cache (guint32 * destination,
+    const guint32 * indices, guint index_count, guint vertex_count,
+    guint cache_size, guint * clusters);
+guint gst_3d_mesh_optimize_overdraw (guint32 * destination,
+    const guint32 * indices, guint index_count, const guint8 * positions,
+    gsize stride, guint vertex_count, const guint * clusters,
+    guint n_clusters, guint cache_size, gfloat threshold);
+void gst_3d_mesh_optimize_vertex_fetch (Gst3DMeshData * data);
+
+gboolean gst_3d_mesh_data_optimize (Gst3DMeshData * self, guint cache_size,
+    Gst3DMeshOptimizeStats * stats);
+
+G_END_DECLS
+#endif /* __GST_3D_MESH_OPTIMIZE_H__ */
@@ -0,0 +1,464 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Quadric error metric simplification (Garland, Heckbert: Surface
+ * Simplification Using Quadric Error Metrics, 1997) for indexed triangle
+ * lists. Edges are collapsed onto one of their vertices, so all other
+ * attributes of the kept vertex stay valid and no new vertices are made.
+ * Open borders and attribute seams are held in place by constraint planes
+ * perpendicular to the border, and collapses that flip a triangle are
+ * rejected.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gst3dmeshsimplify.h"
+#include "gst3dmeshoptimize.h"
+
+/* GL_TRIANGLES */
+#define TRIANGLES 0x0004
+
+#define BORDER_WEIGHT 10.0
+
+/* each level keeps half of the triangles of the previous one */
+#define LOD_REDUCTION 0.5f
+
+/* symmetric 4x4 matrix of the plane equations plus the accumulated weight,
+ * the error divided by the weight is a squared distance */
+typedef struct
+{
+  gdouble a2, ab, ac, ad;
+  gdouble b2, bc, bd;
+  gdouble c2, cd;
+  gdouble d2;
+  gdouble weight;
+} Quadric;
+
+struct Collapse
+{
+  guint32 from;
+  guint32 to;
+  gdouble cost;
+};
+
+static void
+_quadric_add_plane (Quadric * q, const gdouble n[3], gdouble d, gdouble weight)
+{
+  q->a2 += weight * n[0] * n[0];
+  q->ab += weight * n[0] * n[1];
+  q->ac += weight * n[0] * n[2];
+  q->ad += weight * n[0] * d;
+  q->b2 += weight * n[1] * n[1];
+  q->bc += weight * n[1] * n[2];
+  q->bd += weight * n[1] * d;
+  q->c2 += weight * n[2] * n[2];
+  q->cd += weight * n[2] * d;
+  q->d2 += weight * d * d;
+  q->weight += weight;
+}
+
+static void
+_quadric_add (Quadric * q, const Quadric * other)
+{
+  q->a2 += other->a2;
+  q->ab += other->ab;
+  q->ac += other->ac;
+  q->ad += other->ad;
+  q->b2 += other->b2;
+  q->bc += other->bc;
+  q->bd += other->bd;
+  q->c2 += other->c2;
+  q->cd += other->cd;
+  q->d2 += other->d2;
+  q->weight += other->weight;
+}
+
+static gdouble
+_quadric_error (const Quadric * q, const gfloat * p)
+{
+  gdouble x = p[0], y = p[1], z = p[2];
+  gdouble e = q->a2 * x * x + 2 * q->ab * x * y + 2 * q->ac * x * z
+      + 2 * q->ad * x + q->b2 * y * y + 2 * q->bc * y * z + 2 * q->bd * y
+      + q->c2 * z * z + 2 * q->cd * z + q->d2;
+
+  if (q->weight > 0)
+    e /= q->weight;
+  return fabs (e);
+}
+
+static void
+_cross (const gdouble a[3], const gdouble b[3], gdouble r[3])
+{
+  r[0] = a[1] * b[2] - a[2] * b[1];
+  r[1] = a[2] * b[0] - a[0] * b[2];
+  r[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static gdouble
+_normalize (gdouble v[3])
+{
+  gdouble length = sqrt (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  if (length > 0)
+    for (guint i = 0; i < 3; i++)
+      v[i] /= length;
+  return length;
+}
+
+static void
+_triangle_normal (const gfloat * p0, const gfloat * p1, const gfloat * p2,
+    gdouble n[3])
+{
+  gdouble e1[3], e2[3];
+  for (guint i = 0; i < 3; i++) {
+    e1[i] = p1[i] - p0[i];
+    e2[i] = p2[i] - p0[i];
+  }
+  _cross (e1, e2, n);
+}
+
+static const gfloat *
+_position (const Gst3DMeshData * data, gint position, guint32 vertex)
+{
+  return (const gfloat *) (data->vertices + vertex * data->stride
+      + data->attributes[position].offset);
+}
+
+static guint64
+_edge_key (guint32 a, guint32 b)
+{
+  return ((guint64) a << 32) | b;
+}
+
+static gint
+_compare_edges (gconstpointer a, gconstpointer b)
+{
+  guint64 ea = *(const guint64 *) a;
+  guint64 eb = *(const guint64 *) b;
+  return ea < eb ? -1 : (ea > eb);
+}
+
+static gint
+_compare_collapses (gconstpointer a, gconstpointer b)
+{
+  const struct Collapse *ca = a;
+  const struct Collapse *cb = b;
+  if (ca->cost != cb->cost)
+    return ca->cost < cb->cost ? -1 : 1;
+  if (ca->from != cb->from)
+    return ca->from < cb->from ? -1 : 1;
+  return ca->to < cb->to ? -1 : (ca->to > cb->to);
+}
+
+static void
+_compute_quadrics (const Gst3DMeshData * data, gint position,
+    const guint32 * indices, guint index_count, Quadric * quadrics)
+{
+  GHashTable *directed = g_hash_table_new (g_int64_hash, g_int64_equal);
+  guint64 *keys = g_new (guint64, index_count);
+
+  for (guint t = 0; t < index_count / 3; t++) {
+    const guint32 *tri = &indices[t * 3];
+    gdouble n[3];
+    _triangle_normal (_position (data, position, tri[0]),
+        _position (data, position, tri[1]), _position (data, position, tri[2]),
+        n);
+    gdouble area = _normalize (n) * 0.5;
+    const gfloat *p0 = _position (data, position, tri[0]);
+    gdouble d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+
+    for (guint c = 0; c < 3; c++) {
+      _quadric_add_plane (&quadrics[tri[c]], n, d, area);
+      keys[t * 3 + c] = _edge_key (tri[c], tri[(c + 1) % 3]);
+      g_hash_table_add (directed, &keys[t * 3 + c]);
+    }
+  }
+
+  /* a directed edge without its opposite lies on a border or seam */
+  for (guint t = 0; t < index_count / 3; t++) {
+    const guint32 *tri = &indices[t * 3];
+    for (guint c = 0; c < 3; c++) {
+      guint32 a = tri[c], b = tri[(c + 1) % 3];
+      guint64 opposite = _edge_key (b, a);
+      if (g_hash_table_contains (directed, &opposite))
+        continue;
+
+      const gfloat *pa = _position (data, position, a);
+      const gfloat *pb = _position (data, position, b);
+      gdouble n[3], e[3], border[3];
+      _triangle_normal (_position (data, position, tri[0]),
+          _position (data, position, tri[1]),
+          _position (data, position, tri[2]), n);
+      for (guint i = 0; i < 3; i++)
+        e[i] = pb[i] - pa[i];
+      gdouble length = _normalize (e);
+      _normalize (n);
+      _cross (e, n, border);
+      _normalize (border);
+
+      gdouble d = -(border[0] * pa[0] + border[1] * pa[1] + border[2] * pa[2]);
+      gdouble weight = BORDER_WEIGHT * length * length;
+      _quadric_add_plane (&quadrics[a], border, d, weight);
+      _quadric_add_plane (&quadrics[b], border, d, weight);
+    }
+  }
+
+  g_hash_table_unref (directed);
+  g_free (keys);
+}
+
+/* Moving @from onto @to must not turn any remaining triangle around. */
+static gboolean
+_collapse_flips (const Gst3DMeshData * data, gint position,
+    const guint32 * indices, const guint * offsets, const guint * adjacency,
+    guint32 from, guint32 to)
+{
+  for (guint a = offsets[from]; a < offsets[from + 1]; a++) {
+    const guint32 *tri = &indices[adjacency[a] * 3];
+    if (tri[0] == to || tri[1] == to || tri[2] == to)
+      continue;
+
+    const gfloat *p[3], *moved[3];
+    for (guint c = 0; c < 3; c++) {
+      p[c] = _position (data, position, tri[c]);
+      moved[c] = tri[c] == from ? _position (data, position, to) : p[c];
+    }
+
+    gdouble before[3], after[3];
+    _triangle_normal (p[0], p[1], p[2], before);
+    _triangle_normal (moved[0], moved[1], moved[2], after);
+    if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2]
+        <= 0)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* One round of independent collapses, cheapest first. Returns the number
+ * of triangles left in @indices. */
+static guint
+_collapse_pass (const Gst3DMeshData * data, gint position, guint32 * indices,
+    guint index_count, guint target_index_count, gdouble max_cost,
+    Quadric * quadrics, gdouble * result_cost)
+{
+  guint triangle_count = index_count / 3;
+  guint64 *edges = g_new (guint64, index_count);
+
+  for (guint t = 0; t < triangle_count; t++) {
+    for (guint c = 0; c < 3; c++) {
+      guint32 a = indices[t * 3 + c], b = indices[t * 3 + (c + 1) % 3];
+      edges[t * 3 + c] = a < b ? _edge_key (a, b) : _edge_key (b, a);
+    }
+  }
+  qsort (edges, index_count, sizeof (guint64), _compare_edges);
+
+  struct Collapse *collapses = g_new (struct Collapse, index_count);
+  guint n_collapses = 0;
+  for (guint i = 0; i < index_count; i++) {
+    if (i > 0 && edges[i] == edges[i - 1])
+      continue;
+
+    guint32 a = edges[i] >> 32, b = edges[i] & G_MAXUINT32;
+    Quadric q = quadrics[a];
+    _quadric_add (&q, &quadrics[b]);
+
+    gdouble cost_ab = _quadric_error (&q, _position (data, position, b));
+    gdouble cost_ba = _quadric_error (&q, _position (data, position, a));
+
+    struct Collapse *collapse = &collapses[n_collapses++];
+    collapse->from = cost_ab <= cost_ba ? a : b;
+    collapse->to = cost_ab <= cost_ba ? b : a;
+    collapse->cost = MIN (cost_ab, cost_ba);
+  }
+  g_free (edges);
+
+  qsort (collapses, n_collapses, sizeof (struct Collapse), _compare_collapses);
+
+  /* vertex to triangle adjacency */
+  guint *offsets = g_new0 (guint, data->vertex_count + 1);
+  for (guint i = 0; i < index_count; i++)
+    offsets[indices[i] + 1]++;
+  for (guint v = 0; v < data->vertex_count; v++)
+    offsets[v + 1] += offsets[v];
+  guint *fill = g_new (guint, data->vertex_count);
+  memcpy (fill, offsets, data->vertex_count * sizeof (guint));
+  guint *adjacency = g_new (guint, index_count);
+  for (guint t = 0; t < triangle_count; t++)
+    for (guint c = 0; c < 3; c++)
+      adjacency[fill[indices[t * 3 + c]]++] = t;
+  g_free (fill);
+
+  guint32 *remap = g_new (guint32, data->vertex_count);
+  gboolean *locked = g_new0 (gboolean, data->vertex_count);
+  for (guint v = 0; v < data->vertex_count; v++)
+    remap[v] = v;
+
+  guint removable = (index_count - MIN (index_count, target_index_count)) / 3;
+  guint removed = 0;
+
+  for (guint i = 0; i < n_collapses && removed < removable; i++) {
+    const struct Collapse *collapse = &collapses[i];
+    if (collapse->cost > max_cost)
+      break;
+    if (locked[collapse->from] || locked[collapse->to])
+      continue;
+    if (_collapse_flips (data, position, indices, offsets, adjacency,
+            collapse->from, collapse->to))
+      continue;
+
+    remap[collapse->from] = collapse->to;
+    _quadric_add (&quadrics[collapse->to], &quadrics[collapse->from]);
+    *result_cost = MAX (*result_cost, collapse->cost);
+
+    /* triangles around @from changed shape, keep their vertices for the
+     * next pass so the flip test above stays valid */
+    for (guint a = offsets[collapse->from]; a < offsets[collapse->from + 1];
+        a++) {
+      const guint32 *tri = &indices[adjacency[a] * 3];
+      if (tri[0] == collapse->to || tri[1] == collapse->to
+          || tri[2] == collapse->to)
+        removed++;
+      for (guint c = 0; c < 3; c++)
+        locked[tri[c]] = TRUE;
+    }
+  }
+
+  guint output = 0;
+  for (guint t = 0; t < triangle_count; t++) {
+    guint32 a = remap[indices[t * 3]];
+    guint32 b = remap[indices[t * 3 + 1]];
+    guint32 c = remap[indices[t * 3 + 2]];
+    if (a == b || b == c || a == c)
+      continue;
+    indices[output++] = a;
+    indices[output++] = b;
+    indices[output++] = c;
+  }
+
+  g_free (locked);
+  g_free (remap);
+  g_free (adjacency);
+  g_free (offsets);
+  g_free (collapses);
+
+  return output;
+}
+
+/* Returns a simplified copy with at most @target_index_count indices, or
+ * as close as possible without exceeding @target_error, given relative
+ * to the extent of the mesh. @result_error receives the largest error
+ * that was introduced, in the same unit. Vertices that are no longer
+ * used are dropped. Returns NULL for anything but indexed triangle lists
+ * with a "position" attribute.
+ */
+Gst3DMeshData *
+gst_3d_mesh_data_simplify (const Gst3DMeshData * self,
+    guint target_index_count, gfloat target_error, gfloat * result_error)
+{
+  gint position = gst_3d_mesh_data_find_attribute ((Gst3DMeshData *) self,
+      "position");
+
+  if (self->draw_mode != TRIANGLES || position == -1
+      || self->attributes[position].vector_length < 3
+      || self->attributes[position].type != GST_3D_MESH_DATA_FLOAT
+      || self->index_count % 3 != 0)
+    return NULL;
+
+  gfloat min[3] = { G_MAXFLOAT, G_MAXFLOAT, G_MAXFLOAT };
+  gfloat max[3] = { -G_MAXFLOAT, -G_MAXFLOAT, -G_MAXFLOAT };
+  for (guint v = 0; v < self->vertex_count; v++) {
+    const gfloat *p = _position (self, position, v);
+    for (guint i = 0; i < 3; i++) {
+      min[i] = MIN (min[i], p[i]);
+      max[i] = MAX (max[i], p[i]);
+    }
+  }
+  gdouble extent = 0;
+  for (guint i = 0; i < 3; i++)
+    extent = MAX (extent, max[i] - min[i]);
+
+  Gst3DMeshData *result = gst_3d_mesh_data_copy (self);
+  Quadric *quadrics = g_new0 (Quadric, self->vertex_count);
+  _compute_quadrics (self, position, self->indices, self->index_count,
+      quadrics);
+
+  gdouble max_cost = (gdouble) target_error * extent;
+  max_cost *= max_cost;
+  gdouble result_cost = 0;
+  guint index_count = result->index_count;
+
+  while (index_count > target_index_count) {
+    guint count = _collapse_pass (result, position, result->indices,
+        index_count, target_index_count, max_cost, quadrics, &result_cost);
+    if (count == index_count)
+      break;
+    index_count = count;
+  }
+
+  g_free (quadrics);
+
+  result->index_count = index_count;
+  gst_3d_mesh_optimize_vertex_fetch (result);
+
+  if (result_error)
+    *result_error = extent > 0 ? sqrt (result_cost) / extent : 0.0f;
+
+  return result;
+}
+
+/* Builds a chain of successively simplified meshes, each with about half
+ * the triangles of the previous one. Stops early when @target_error does
+ * not allow a meaningful reduction. The array does not include @self.
+ */
+GPtrArray *
+gst_3d_mesh_data_generate_lods (const Gst3DMeshData * self, guint max_levels,
+    gfloat target_error)
+{
+  GPtrArray *lods =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) gst_3d_mesh_data_free);
+  const Gst3DMeshData *previous = self;
+
+  for (guint level = 1; level <= max_levels; level++) {
+    guint target = (guint) (previous->index_count * LOD_REDUCTION) / 3 * 3;
+    gfloat error;
+
+    Gst3DMeshData *lod = gst_3d_mesh_data_simplify (previous, target,
+        target_error, &error);
+    if (!lod)
+      break;
+
+    /* less than 10% fewer triangles is not worth another level */
+    if (lod->index_count == 0
+        || lod->index_count > previous->index_count * 0.9f) {
+      gst_3d_mesh_data_free (lod);
+      break;
+    }
+
+    g_ptr_array_add (lods, lod);
+    previous = lod;
+  }
+
+  return lods;
+}
@@ -0,0 +1,39 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_MESH_SIMPLIFY_H__
+#define __GST_3D_MESH_SIMPLIFY_H__
+
+#include <glib.h>
+
+#include "gst3dmeshdata.h"
+
+G_BEGIN_DECLS
+
+#define GST_3D_MESH_SIMPLIFY_MAX_LODS 4
+#define GST_3D_MESH_SIMPLIFY_TARGET_ERROR 0.02f
+
+Gst3DMeshData *gst_3d_mesh_data_simplify (const Gst3DMeshData * self,
+    guint target_index_count, gfloat target_error, gfloat * result_error);
+GPtrArray *gst_3d_mesh_data_generate_lods (const Gst3DMeshData * self,
+    guint max_levels, gfloat target_error);
+
+G_END_DECLS
+#endif /* __GST_3D_MESH_SIMPLIFY_H__ */
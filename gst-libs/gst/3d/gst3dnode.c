@@ -42,6 +42,14 @@ void
 gst_3d_node_init (Gst3DNode * self)
 {
   self->context = NULL;
+  self->shader = NULL;
+  self->instanced_shader = NULL;
+  self->meshes = NULL;
+  self->children = NULL;
+  graphene_matrix_init_identity (&self->transform);
+  graphene_matrix_init_identity (&self->mvp);
+  graphene_box_init_from_box (&self->bounds, graphene_box_empty ());
+  self->bounded = TRUE;
 }
 
 Gst3DNode *
@@ -60,7 +68,7 @@ gst_3d_node_new_from_mesh_shader (GstGLContext * context, Gst3DMesh * mesh,
   Gst3DNode *node = gst_3d_node_new (context);
   node->meshes = g_list_append (node->meshes, mesh);
   node->shader = shader;
-  gst_gl_shader_use (shader->shader);
+  gst_3d_shader_bind (shader);
   gst_3d_mesh_bind_shader (mesh, shader);
   return node;
 }
@@ -71,6 +79,22 @@ gst_3d_node_finalize (GObject * object)
   Gst3DNode *self = GST_3D_NODE (object);
   g_return_if_fail (self != NULL);
 
+  g_list_free_full (self->children, (GDestroyNotify) gst_object_unref);
+  self->children = NULL;
+
+  g_list_free_full (self->meshes, (GDestroyNotify) gst_object_unref);
+  self->meshes = NULL;
+
+  if (self->shader) {
+    gst_object_unref (self->shader);
+    self->shader = NULL;
+  }
+
+  if (self->instanced_shader) {
+    gst_object_unref (self->instanced_shader);
+    self->instanced_shader = NULL;
+  }
+
   if (self->context) {
     gst_object_unref (self->context);
     self->context = NULL;
@@ -105,7 +129,7 @@ gst_3d_node_new_debug_axes (GstGLContext * context)
     return NULL;
   }
 
-  gst_gl_shader_use (node->shader->shader);
+  gst_3d_shader_bind (node->shader);
 
   graphene_vec3_t from, to, color;
   graphene_vec3_init (&from, 0.f, 0.f, 0.f);
@@ -132,12 +156,75 @@ gst_3d_node_new_debug_axes (GstGLContext * context)
   return node;
 }
 
+/* Takes ownership of @child. Children without a shader are drawn with
+ * the shader of their parent. */
+void
+gst_3d_node_append_child (Gst3DNode * self, Gst3DNode * child)
+{
+  self->children = g_list_append (self->children, child);
+}
+
+/* Takes ownership of @shader, which has to read its mvp from the per
+ * instance attribute at GST_3D_MESH_INSTANCE_LOCATION, like
+ * mvp_uv_instanced.vert. */
+void
+gst_3d_node_set_instanced_shader (Gst3DNode * self, Gst3DShader * shader)
+{
+  GList *l;
+
+  if (self->instanced_shader)
+    gst_object_unref (self->instanced_shader);
+  self->instanced_shader = shader;
+
+  if (!shader)
+    return;
+
+  for (l = self->meshes; l != NULL; l = l->next)
+    gst_3d_mesh_bind_shader ((Gst3DMesh *) l->data, shader);
+}
+
+/* Aggregates the mesh boxes of the node and its children in world space.
+ * A node is unbounded if any of its meshes has no known extent. */
+void
+gst_3d_node_update_bounds (Gst3DNode * self,
+    const graphene_matrix_t * parent_model)
+{
+  graphene_matrix_t model;
+  graphene_box_t box, world_box;
+  GList *l;
+
+  graphene_matrix_multiply (&self->transform, parent_model, &model);
+  graphene_box_init_from_box (&self->bounds, graphene_box_empty ());
+  self->bounded = TRUE;
+
+  for (l = self->meshes; l != NULL; l = l->next) {
+    if (!gst_3d_mesh_get_bounds ((Gst3DMesh *) l->data, &box)) {
+      self->bounded = FALSE;
+      continue;
+    }
+    graphene_matrix_transform_box (&model, &box, &world_box);
+    graphene_box_union (&self->bounds, &world_box, &self->bounds);
+  }
+
+  for (l = self->children; l != NULL; l = l->next) {
+    Gst3DNode *child = (Gst3DNode *) l->data;
+    gst_3d_node_update_bounds (child, &model);
+    if (!child->bounded)
+      self->bounded = FALSE;
+    else
+      graphene_box_union (&self->bounds, &child->bounds, &self->bounds);
+  }
+}
+
+/* Draws the level of detail matching the projected size of each mesh
+ * under the mvp the node was last drawn with. */
 void
 gst_3d_node_draw (Gst3DNode * self)
 {
   GList *l;
   for (l = self->meshes; l != NULL; l = l->next) {
-    Gst3DMesh *mesh = (Gst3DMesh *) l->data;
+    Gst3DMesh *mesh = gst_3d_mesh_select_lod ((Gst3DMesh *) l->data,
+        &self->mvp);
     gst_3d_mesh_bind (mesh);
     gst_3d_mesh_draw (mesh);
   }
@@ -148,7 +235,8 @@ gst_3d_node_draw_wireframe (Gst3DNode * self)
 {
   GList *l;
   for (l = self->meshes; l != NULL; l = l->next) {
-    Gst3DMesh *mesh = (Gst3DMesh *) l->data;
+    Gst3DMesh *mesh = gst_3d_mesh_select_lod ((Gst3DMesh *) l->data,
+        &self->mvp);
     gst_3d_mesh_bind (mesh);
     gst_3d_mesh_draw_mode (mesh, GL_LINE_STRIP);
   }
@@ -45,6 +45,22 @@ struct _Gst3DNode
   
   GList *meshes;
   Gst3DShader *shader;
+
+  /* if set, the scene batches the meshes of all nodes sharing it into
+   * one instanced draw per mesh, see gst_3d_scene_draw_nodes */
+  Gst3DShader *instanced_shader;
+
+  /* relative to the parent node */
+  graphene_matrix_t transform;
+  GList *children;
+
+  /* set by the scene before drawing, used to select mesh LODs */
+  graphene_matrix_t mvp;
+
+  /* world space box of the meshes of the node and all its children, set
+   * by gst_3d_node_update_bounds. Unbounded nodes are never culled. */
+  graphene_box_t bounds;
+  gboolean bounded;
 };
 
 struct _Gst3DNodeClass
@@ -57,6 +73,14 @@ GType gst_3d_node_get_type (void);
 
 Gst3DNode *gst_3d_node_new_debug_axes (GstGLContext * context);
 
+void gst_3d_node_append_child (Gst3DNode * self, Gst3DNode * child);
+
+void gst_3d_node_set_instanced_shader (Gst3DNode * self,
+    Gst3DShader * shader);
+
+void gst_3d_node_update_bounds (Gst3DNode * self,
+    const graphene_matrix_t * parent_model);
+
 void gst_3d_node_draw (Gst3DNode * self);
 void gst_3d_node_draw_wireframe (Gst3DNode * self);
 
@@ -0,0 +1,120 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* A linked GL program owned by a refcounted object, so it can be shared
+ * through gst3dprogramcache and carry qdata. GstGLShader can not wrap a
+ * program it did not link itself, and building one always compiles its
+ * stages synchronously, which the program binary cache and the queued
+ * compiles of gst3dshader avoid.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gl/gl.h>
+#include <gst/gl/gstglfuncs.h>
+
+#include "gst3dprogram.h"
+#include "gst3dglstate.h"
+
+#define GST_CAT_DEFAULT gst_3d_program_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+G_DEFINE_TYPE_WITH_CODE (Gst3DProgram, gst_3d_program, GST_TYPE_OBJECT,
+    GST_DEBUG_CATEGORY_INIT (gst_3d_program_debug, "3dprogram", 0,
+        "program"));
+
+static void
+gst_3d_program_init (Gst3DProgram * self)
+{
+  self->context = NULL;
+  self->handle = 0;
+}
+
+/* Takes ownership of @handle, which has to be linked successfully. */
+Gst3DProgram *
+gst_3d_program_new (GstGLContext * context, GLuint handle)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+  g_return_val_if_fail (handle != 0, NULL);
+
+  Gst3DProgram *program = g_object_new (GST_3D_TYPE_PROGRAM, NULL);
+  program->context = gst_object_ref (context);
+  program->handle = handle;
+
+  GST_DEBUG_OBJECT (program, "wrapping program %u", handle);
+
+  return program;
+}
+
+static void
+_delete_program (GstGLContext * context, Gst3DProgram * self)
+{
+  GstGLFuncs *gl = context->gl_vtable;
+
+  gl->DeleteProgram (self->handle);
+  gst_3d_gl_state_invalidate (context);
+}
+
+static void
+gst_3d_program_finalize (GObject * object)
+{
+  Gst3DProgram *self = GST_3D_PROGRAM (object);
+
+  if (self->handle)
+    gst_gl_context_thread_add (self->context,
+        (GstGLContextThreadFunc) _delete_program, self);
+  self->handle = 0;
+
+  if (self->context) {
+    gst_object_unref (self->context);
+    self->context = NULL;
+  }
+
+  G_OBJECT_CLASS (gst_3d_program_parent_class)->finalize (object);
+}
+
+static void
+gst_3d_program_class_init (Gst3DProgramClass * klass)
+{
+  GObjectClass *obj_class = G_OBJECT_CLASS (klass);
+  obj_class->finalize = gst_3d_program_finalize;
+}
+
+GLint
+gst_3d_program_get_attribute_location (Gst3DProgram * self,
+    const gchar * name)
+{
+  g_return_val_if_fail (GST_IS_3D_PROGRAM (self), -1);
+
+  GstGLFuncs *gl = self->context->gl_vtable;
+  return gl->GetAttribLocation (self->handle, name);
+}
+
+GLint
+gst_3d_program_get_uniform_location (Gst3DProgram * self, const gchar * name)
+{
+  g_return_val_if_fail (GST_IS_3D_PROGRAM (self), -1);
+
+  GstGLFuncs *gl = self->context->gl_vtable;
+  return gl->GetUniformLocation (self->handle, name);
+}
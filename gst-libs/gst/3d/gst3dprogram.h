@@ -0,0 +1,64 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_PROGRAM_H__
+#define __GST_3D_PROGRAM_H__
+
+#include <gst/gst.h>
+#include <gst/gl/gstgl_fwd.h>
+#include <gst/gl/gstglfuncs.h>
+
+G_BEGIN_DECLS
+#define GST_3D_TYPE_PROGRAM            (gst_3d_program_get_type ())
+#define GST_3D_PROGRAM(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_3D_TYPE_PROGRAM, Gst3DProgram))
+#define GST_3D_PROGRAM_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GST_3D_TYPE_PROGRAM, Gst3DProgramClass))
+#define GST_IS_3D_PROGRAM(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_3D_TYPE_PROGRAM))
+#define GST_IS_3D_PROGRAM_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_3D_TYPE_PROGRAM))
+#define GST_3D_PROGRAM_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_3D_TYPE_PROGRAM, Gst3DProgramClass))
+typedef struct _Gst3DProgram Gst3DProgram;
+typedef struct _Gst3DProgramClass Gst3DProgramClass;
+
+struct _Gst3DProgram
+{
+  /*< private > */
+  GstObject parent;
+
+  GstGLContext *context;
+
+  /* linked GL program, deleted with the last reference */
+  GLuint handle;
+};
+
+struct _Gst3DProgramClass
+{
+  GstObjectClass parent_class;
+};
+
+GType gst_3d_program_get_type (void);
+
+Gst3DProgram *gst_3d_program_new (GstGLContext * context, GLuint handle);
+
+GLint gst_3d_program_get_attribute_location (Gst3DProgram * self,
+    const gchar * name);
+GLint gst_3d_program_get_uniform_location (Gst3DProgram * self,
+    const gchar * name);
+
+G_END_DECLS
+#endif /* __GST_3D_PROGRAM_H__ */
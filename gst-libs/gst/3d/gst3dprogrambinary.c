@@ -0,0 +1,292 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Disk cache of linked GL programs. Binaries are stored under the user
+ * cache directory, named after a hash of everything that makes a binary
+ * valid: the shader sources as compiled and the vendor, renderer and
+ * version strings of the driver. A driver update changes the key, so
+ * stale files are never loaded, and the driver still gets to reject a
+ * binary it does not like, in which case the file is removed and the
+ * program is built from source again.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gl/gl.h>
+#include <gst/gl/gstglfuncs.h>
+
+#include "gst3dprogrambinary.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_3d_program_binary_debug);
+#define GST_CAT_DEFAULT gst_3d_program_binary_debug
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+typedef void (GSTGLAPI * Gst3DGetProgramBinary) (GLuint program,
+    GLsizei buf_size, GLsizei * length, GLenum * format, void *binary);
+typedef void (GSTGLAPI * Gst3DProgramBinary) (GLuint program, GLenum format,
+    const void *binary, GLsizei length);
+typedef void (GSTGLAPI * Gst3DProgramParameteri) (GLuint program,
+    GLenum pname, GLint value);
+
+static void
+_init_debug (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    GST_DEBUG_CATEGORY_INIT (gst_3d_program_binary_debug, "3dprogrambinary",
+        0, "program binary cache");
+    g_once_init_leave (&initialized, 1);
+  }
+}
+
+/* Returns a newly allocated directory, or NULL when the cache is
+ * disabled. */
+static gchar *
+_get_dir (void)
+{
+  const gchar *dir = g_getenv (GST_3D_PROGRAM_BINARY_DIR_ENV);
+
+  if (dir)
+    return dir[0] != '\0' ? g_strdup (dir) : NULL;
+
+  return g_build_filename (g_get_user_cache_dir (), "gst-plugins-vr",
+      "programs", NULL);
+}
+
+static gchar *
+_get_path (const gchar * key)
+{
+  gchar *dir = _get_dir ();
+  if (!dir)
+    return NULL;
+
+  gchar *name = g_strconcat (key, GST_3D_PROGRAM_BINARY_SUFFIX, NULL);
+  gchar *path = g_build_filename (dir, name, NULL);
+  g_free (name);
+  g_free (dir);
+  return path;
+}
+
+/* Core in GL 4.1 and GLES 3.0. Drivers may still not offer a single
+ * binary format, which disables the cache as well. */
+gboolean
+gst_3d_program_binary_is_supported (GstGLContext * context)
+{
+  GstGLFuncs *gl = context->gl_vtable;
+  GLint n_formats = 0;
+
+  if (!gst_gl_context_check_gl_version (context, GST_GL_API_OPENGL3, 4, 1)
+      && !gst_gl_context_check_gl_version (context, GST_GL_API_GLES2, 3, 0)
+      && !gst_gl_context_check_feature (context, "GL_ARB_get_program_binary"))
+    return FALSE;
+
+  gl->GetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+  return n_formats > 0;
+}
+
+static void
+_checksum_update_string (GChecksum * checksum, const gchar * str)
+{
+  if (str)
+    g_checksum_update (checksum, (const guchar *) str, strlen (str));
+  /* separator, so moving text between fields changes the key */
+  g_checksum_update (checksum, (const guchar *) "", 1);
+}
+
+/* Returns the cache key of a program built from the given sources on the
+ * driver of @context, or NULL when the cache can not be used. The
+ * sources have to be the final strings passed to the compiler, including
+ * any injected defines. */
+gchar *
+gst_3d_program_binary_get_key (GstGLContext * context,
+    const gchar * vertex_src, const gchar * fragment_src)
+{
+  GstGLFuncs *gl = context->gl_vtable;
+
+  _init_debug ();
+
+  gchar *dir = _get_dir ();
+  if (!dir)
+    return NULL;
+  g_free (dir);
+
+  if (!gst_3d_program_binary_is_supported (context))
+    return NULL;
+
+  GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  guint32 version = GST_3D_PROGRAM_BINARY_VERSION;
+  g_checksum_update (checksum, (const guchar *) &version, sizeof (version));
+  _checksum_update_string (checksum,
+      (const gchar *) gl->GetString (GL_VENDOR));
+  _checksum_update_string (checksum,
+      (const gchar *) gl->GetString (GL_RENDERER));
+  _checksum_update_string (checksum,
+      (const gchar *) gl->GetString (GL_VERSION));
+  _checksum_update_string (checksum, vertex_src);
+  _checksum_update_string (checksum, fragment_src);
+
+  gchar *key = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  return key;
+}
+
+/* Asks the driver to keep the binary of @program retrievable. Has to be
+ * called before linking. */
+void
+gst_3d_program_binary_prepare (GstGLContext * context, guint program)
+{
+  Gst3DProgramParameteri program_parameteri = (Gst3DProgramParameteri)
+      gst_gl_context_get_proc_address (context, "glProgramParameteri");
+
+  if (program_parameteri)
+    program_parameteri (program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+/* Replaces the executable of @program with the cached binary for @key.
+ * On success @program is linked. On failure the state of @program is
+ * undefined and it has to be linked from source again. */
+gboolean
+gst_3d_program_binary_load (GstGLContext * context, guint program,
+    const gchar * key)
+{
+  GstGLFuncs *gl = context->gl_vtable;
+  GError *error = NULL;
+  gchar *contents = NULL;
+  gsize length = 0;
+  GLint status = GL_FALSE;
+
+  Gst3DProgramBinary program_binary = (Gst3DProgramBinary)
+      gst_gl_context_get_proc_address (context, "glProgramBinary");
+
+  gchar *path = _get_path (key);
+  if (!path || !program_binary)
+    goto out;
+
+  if (!g_file_get_contents (path, &contents, &length, &error)) {
+    GST_DEBUG ("no cached program %s: %s", key, error->message);
+    g_clear_error (&error);
+    goto out;
+  }
+
+  const Gst3DProgramBinaryHeader *header =
+      (const Gst3DProgramBinaryHeader *) contents;
+  if (length < sizeof (Gst3DProgramBinaryHeader)
+      || memcmp (header->magic, GST_3D_PROGRAM_BINARY_MAGIC,
+          sizeof (GST_3D_PROGRAM_BINARY_MAGIC)) != 0
+      || header->version != GST_3D_PROGRAM_BINARY_VERSION
+      || header->size != length - sizeof (Gst3DProgramBinaryHeader)
+      || header->size > G_MAXINT32) {
+    GST_WARNING ("removing corrupt program cache %s", path);
+    g_unlink (path);
+    goto out;
+  }
+
+  program_binary (program, header->format, contents + sizeof (*header),
+      header->size);
+  gl->GetProgramiv (program, GL_LINK_STATUS, &status);
+
+  if (status != GL_TRUE) {
+    GST_INFO ("driver rejected cached program %s, rebuilding", key);
+    g_unlink (path);
+  } else {
+    GST_DEBUG ("loaded program %s, %" G_GUINT64_FORMAT " bytes", key,
+        header->size);
+  }
+
+out:
+  g_free (contents);
+  g_free (path);
+  return status == GL_TRUE;
+}
+
+/* Stores the binary of the linked @program under @key. Writes go through
+ * a temporary file, so concurrent processes never see a partial file. */
+gboolean
+gst_3d_program_binary_save (GstGLContext * context, guint program,
+    const gchar * key)
+{
+  GstGLFuncs *gl = context->gl_vtable;
+  GError *error = NULL;
+  GLint size = 0;
+  GLenum format = 0;
+  gboolean ret = FALSE;
+
+  Gst3DGetProgramBinary get_program_binary = (Gst3DGetProgramBinary)
+      gst_gl_context_get_proc_address (context, "glGetProgramBinary");
+
+  gchar *path = _get_path (key);
+  if (!path || !get_program_binary)
+    goto out;
+
+  gl->GetProgramiv (program, GL_PROGRAM_BINARY_LENGTH, &size);
+  if (size <= 0)
+    goto out;
+
+  gsize length = sizeof (Gst3DProgramBinaryHeader) + size;
+  guint8 *contents = g_malloc0 (length);
+  Gst3DProgramBinaryHeader *header = (Gst3DProgramBinaryHeader *) contents;
+
+  get_program_binary (program, size, &size, &format,
+      contents + sizeof (*header));
+
+  memcpy (header->magic, GST_3D_PROGRAM_BINARY_MAGIC,
+      sizeof (GST_3D_PROGRAM_BINARY_MAGIC));
+  header->version = GST_3D_PROGRAM_BINARY_VERSION;
+  header->format = format;
+  header->size = size;
+  length = sizeof (*header) + size;
+
+  gchar *dir = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dir, 0700) == 0
+      && g_file_set_contents (path, (const gchar *) contents, length,
+          &error)) {
+    GST_DEBUG ("saved program %s, %d bytes", key, size);
+    ret = TRUE;
+  } else {
+    GST_WARNING ("could not save program cache %s: %s", path,
+        error ? error->message : g_strerror (errno));
+    g_clear_error (&error);
+  }
+
+  g_free (dir);
+  g_free (contents);
+
+out:
+  g_free (path);
+  return ret;
+}
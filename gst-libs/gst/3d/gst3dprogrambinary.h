@@ -0,0 +1,61 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_PROGRAM_BINARY_H__
+#define __GST_3D_PROGRAM_BINARY_H__
+
+#include <gst/gst.h>
+#include <gst/gl/gstgl_fwd.h>
+
+G_BEGIN_DECLS
+
+#define GST_3D_PROGRAM_BINARY_MAGIC "G3DPROG"
+#define GST_3D_PROGRAM_BINARY_VERSION 1
+#define GST_3D_PROGRAM_BINARY_SUFFIX ".g3dp"
+
+/* Overrides the cache directory, an empty value disables the cache */
+#define GST_3D_PROGRAM_BINARY_DIR_ENV "GST_3D_PROGRAM_CACHE_DIR"
+
+/* On disk layout, in host byte order since binaries only load on the
+ * driver that wrote them anyway:
+ *
+ *   Gst3DProgramBinaryHeader
+ *   binary of size bytes as returned by GetProgramBinary
+ */
+typedef struct
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 format;
+  guint64 size;
+} Gst3DProgramBinaryHeader;
+
+gboolean gst_3d_program_binary_is_supported (GstGLContext * context);
+gchar *gst_3d_program_binary_get_key (GstGLContext * context,
+    const gchar * vertex_src, const gchar * fragment_src);
+
+void gst_3d_program_binary_prepare (GstGLContext * context, guint program);
+gboolean gst_3d_program_binary_load (GstGLContext * context, guint program,
+    const gchar * key);
+gboolean gst_3d_program_binary_save (GstGLContext * context, guint program,
+    const gchar * key);
+
+G_END_DECLS
+#endif /* __GST_3D_PROGRAM_BINARY_H__ */
@@ -0,0 +1,167 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Linked programs on one GstGLContext are shared between all Gst3DShaders
+ * built from the same sources, so elements on a shared context link each
+ * program once. Variants are covered since their defines are part of the
+ * specialized sources. Like gst3dmeshcache the cache only holds weak
+ * references, a program is deleted with its last user.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gl/gl.h>
+
+#include "gst3dprogramcache.h"
+
+#define GST_CAT_DEFAULT gst_3d_program_cache_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define PROGRAM_CACHE_QUARK gst_3d_program_cache_quark ()
+
+struct Gst3DProgramCache
+{
+  GMutex lock;
+  GHashTable *programs;
+};
+
+static GQuark
+gst_3d_program_cache_quark (void)
+{
+  static GQuark quark = 0;
+  if (!quark) {
+    quark = g_quark_from_static_string ("gst-3d-program-cache");
+    GST_DEBUG_CATEGORY_INIT (gst_3d_program_cache_debug, "3dprogramcache", 0,
+        "program cache");
+  }
+  return quark;
+}
+
+static void
+_weak_ref_free (GWeakRef * ref)
+{
+  g_weak_ref_clear (ref);
+  g_free (ref);
+}
+
+static void
+_cache_free (struct Gst3DProgramCache *cache)
+{
+  g_hash_table_unref (cache->programs);
+  g_mutex_clear (&cache->lock);
+  g_free (cache);
+}
+
+static struct Gst3DProgramCache *
+_get_cache (GstGLContext * context)
+{
+  static GMutex create_lock;
+  struct Gst3DProgramCache *cache;
+
+  g_mutex_lock (&create_lock);
+  cache = g_object_get_qdata (G_OBJECT (context), PROGRAM_CACHE_QUARK);
+  if (!cache) {
+    cache = g_new0 (struct Gst3DProgramCache, 1);
+    g_mutex_init (&cache->lock);
+    cache->programs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) _weak_ref_free);
+    g_object_set_qdata_full (G_OBJECT (context), PROGRAM_CACHE_QUARK, cache,
+        (GDestroyNotify) _cache_free);
+  }
+  g_mutex_unlock (&create_lock);
+
+  return cache;
+}
+
+static gboolean
+_is_dead (gpointer key, GWeakRef * ref, gpointer user_data)
+{
+  GObject *object = g_weak_ref_get (ref);
+  if (object) {
+    g_object_unref (object);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* Unlike the key of gst3dprogrambinary this does not depend on the
+ * driver, the cache only lives as long as the context. */
+gchar *
+gst_3d_program_cache_get_key (const gchar * vertex_src,
+    const gchar * fragment_src)
+{
+  GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+  /* including the terminators keeps the stage boundary unambiguous */
+  g_checksum_update (checksum, (const guchar *) vertex_src,
+      strlen (vertex_src) + 1);
+  g_checksum_update (checksum, (const guchar *) fragment_src,
+      strlen (fragment_src) + 1);
+
+  gchar *key = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  return key;
+}
+
+Gst3DProgram *
+gst_3d_program_cache_lookup (GstGLContext * context, const gchar * key)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+
+  struct Gst3DProgramCache *cache = _get_cache (context);
+  Gst3DProgram *program = NULL;
+
+  g_mutex_lock (&cache->lock);
+  GWeakRef *ref = g_hash_table_lookup (cache->programs, key);
+  if (ref)
+    program = g_weak_ref_get (ref);
+  g_mutex_unlock (&cache->lock);
+
+  GST_LOG ("%s %s", program ? "hit" : "miss", key);
+
+  return program;
+}
+
+/* Only linked programs should be inserted, users of a cached program
+ * assume it is ready. */
+void
+gst_3d_program_cache_insert (GstGLContext * context, const gchar * key,
+    Gst3DProgram * program)
+{
+  g_return_if_fail (GST_IS_GL_CONTEXT (context));
+  g_return_if_fail (GST_IS_3D_PROGRAM (program));
+
+  struct Gst3DProgramCache *cache = _get_cache (context);
+  GWeakRef *ref = g_new0 (GWeakRef, 1);
+  g_weak_ref_init (ref, program);
+
+  g_mutex_lock (&cache->lock);
+  g_hash_table_foreach_remove (cache->programs, (GHRFunc) _is_dead, NULL);
+  g_hash_table_replace (cache->programs, g_strdup (key), ref);
+  g_mutex_unlock (&cache->lock);
+
+  GST_DEBUG ("cached %s", key);
+}
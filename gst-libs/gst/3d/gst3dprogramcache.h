@@ -0,0 +1,40 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_PROGRAM_CACHE_H__
+#define __GST_3D_PROGRAM_CACHE_H__
+
+#include <gst/gst.h>
+#include <gst/gl/gstgl_fwd.h>
+
+#include "gst3dprogram.h"
+
+G_BEGIN_DECLS
+
+gchar *gst_3d_program_cache_get_key (const gchar * vertex_src,
+    const gchar * fragment_src);
+
+Gst3DProgram *gst_3d_program_cache_lookup (GstGLContext * context,
+    const gchar * key);
+void gst_3d_program_cache_insert (GstGLContext * context, const gchar * key,
+    Gst3DProgram * program);
+
+G_END_DECLS
+#endif /* __GST_3D_PROGRAM_CACHE_H__ */
@@ -33,6 +33,9 @@
 #include "gst3dhmd.h"
 #include "gst3dcamera_hmd.h"
 #include "gst3dscene.h"
+#include "gst3dmeshcache.h"
+#include "gst3dmemory.h"
+#include "gst3dglstate.h"
 
 
 #define GST_CAT_DEFAULT gst_3d_renderer_debug
@@ -56,6 +59,7 @@ gst_3d_renderer_init (Gst3DRenderer * self)
 {
   self->context = NULL;
   self->shader = NULL;
+  self->render_plane = NULL;
   self->left_color_tex = 0;
   self->left_fbo = 0;
   self->right_color_tex = 0;
@@ -80,8 +84,29 @@ gst_3d_renderer_finalize (GObject * object)
   Gst3DRenderer *self = GST_3D_RENDERER (object);
   g_return_if_fail (self != NULL);
 
-  if (self->shader)
+  if (self->shader) {
     gst_3d_shader_delete (self->shader);
+    gst_object_unref (self->shader);
+    self->shader = NULL;
+  }
+
+  /* shared through the mesh cache, only drop our reference */
+  if (self->render_plane) {
+    gst_object_unref (self->render_plane);
+    self->render_plane = NULL;
+  }
+
+  if (self->left_fbo) {
+    GstGLFuncs *gl = self->context->gl_vtable;
+    GLuint fbos[] = { self->left_fbo, self->right_fbo };
+    GLuint textures[] = { self->left_color_tex, self->right_color_tex };
+    gl->DeleteFramebuffers (G_N_ELEMENTS (fbos), fbos);
+    gl->DeleteTextures (G_N_ELEMENTS (textures), textures);
+    gst_3d_gl_state_invalidate (self->context);
+    gst_3d_memory_release (self->context, GST_3D_MEMORY_TEXTURE,
+        self->texture_bytes);
+    self->texture_bytes = 0;
+  }
 
   if (self->context) {
     gst_object_unref (self->context);
@@ -98,10 +123,14 @@ gst_3d_renderer_class_init (Gst3DRendererClass * klass)
   obj_class->finalize = gst_3d_renderer_finalize;
 }
 
+/* Binds to edit, which has to happen on the active texture unit, so the
+ * bindings are made directly and the state cache is told afterwards. */
 static void
-_create_fbo (GstGLFuncs * gl, GLuint * fbo, GLuint * color_tex,
+_create_fbo (GstGLContext * context, GLuint * fbo, GLuint * color_tex,
     int width, int height)
 {
+  GstGLFuncs *gl = context->gl_vtable;
+
   gl->GenTextures (1, color_tex);
   gl->GenFramebuffers (1, fbo);
 
@@ -122,6 +151,8 @@ _create_fbo (GstGLFuncs * gl, GLuint * fbo, GLuint * color_tex,
   if (status != GL_FRAMEBUFFER_COMPLETE) {
     GST_ERROR ("failed to create fbo %x\n", status);
   }
+
+  gst_3d_gl_state_invalidate (context);
 }
 
 /* stereo rendering */
@@ -156,69 +187,70 @@ gst_3d_renderer_stero_init_from_filter (Gst3DRenderer * self,
 
 static void
 _draw_eye (Gst3DRenderer * self, GLuint fbo, Gst3DScene * scene,
-    graphene_matrix_t * mvp)
+    guint eye, graphene_matrix_t * vp)
 {
   GstGLFuncs *gl = self->context->gl_vtable;
   _insert_gl_debug_marker (self->context, "_draw_eye");
-  gl->BindFramebuffer (GL_FRAMEBUFFER, fbo);
-  gl->Viewport (0, 0, self->eye_width, self->eye_height);
+  gst_3d_gl_state_bind_framebuffer (self->context, GL_FRAMEBUFFER, fbo);
+  gst_3d_gl_state_viewport (self->context, 0, 0, self->eye_width,
+      self->eye_height);
   gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  gst_3d_scene_draw_nodes (scene, mvp);
+  gst_3d_scene_draw_nodes (scene, eye, vp);
 }
 
 static void
 _draw_framebuffers_on_planes (Gst3DRenderer * self)
 {
-  GstGLFuncs *gl = self->context->gl_vtable;
-
   _insert_gl_debug_marker (self->context, "_draw_framebuffers_on_planes");
 
   graphene_matrix_t projection_ortho;
   graphene_matrix_init_ortho (&projection_ortho, -self->filter_aspect,
       self->filter_aspect, -1.0, 1.0, -1.0, 1.0);
-  gst_3d_shader_upload_matrix (self->shader, &projection_ortho, "mvp");
+  gst_3d_shader_set_matrix (self->shader, self->shader->mvp_uniform,
+      &projection_ortho);
   gst_3d_mesh_bind (self->render_plane);
 
   /* left framebuffer */
-  gl->Viewport (0, 0, self->eye_width, self->eye_height);
-  gl->BindTexture (GL_TEXTURE_2D, self->left_color_tex);
+  gst_3d_gl_state_viewport (self->context, 0, 0, self->eye_width,
+      self->eye_height);
+  gst_3d_gl_state_bind_texture (self->context, 0, self->left_color_tex);
   gst_3d_mesh_draw (self->render_plane);
 
   /* right framebuffer */
-  gl->Viewport (self->eye_width, 0, self->eye_width, self->eye_height);
-  gl->BindTexture (GL_TEXTURE_2D, self->right_color_tex);
+  gst_3d_gl_state_viewport (self->context, self->eye_width, 0,
+      self->eye_width, self->eye_height);
+  gst_3d_gl_state_bind_texture (self->context, 0, self->right_color_tex);
   gst_3d_mesh_draw (self->render_plane);
 }
 
 
+/* The eye rays are reconstructed from the inverse view projection of
+ * each eye in the camera buffer of @scene. */
 static void
 _draw_framebuffers_on_planes_shader_proj (Gst3DRenderer * self,
-    Gst3DCamera * cam)
+    Gst3DScene * scene)
 {
-  GstGLFuncs *gl = self->context->gl_vtable;
-
   _insert_gl_debug_marker (self->context, "_draw_framebuffers_on_planes");
 
-  Gst3DCameraHmd *hmd_cam = GST_3D_CAMERA_HMD (cam);
-
   graphene_matrix_t projection_ortho;
   graphene_matrix_init_ortho (&projection_ortho, -self->filter_aspect,
       self->filter_aspect, -1.0, 1.0, -1.0, 1.0);
-  gst_3d_shader_upload_matrix (self->shader, &projection_ortho, "mvp");
-
-
-  gst_3d_shader_upload_matrix (self->shader, &hmd_cam->left_vp_matrix, "vp");
+  gst_3d_shader_set_matrix (self->shader, self->shader->mvp_uniform,
+      &projection_ortho);
 
+  gst_3d_camera_buffer_bind (scene->camera_buffer, 0);
   gst_3d_mesh_bind (self->render_plane);
 
   /* left framebuffer */
-  gl->Viewport (0, 0, self->eye_width, self->eye_height);
+  gst_3d_gl_state_viewport (self->context, 0, 0, self->eye_width,
+      self->eye_height);
   gst_3d_mesh_draw (self->render_plane);
 
-  gst_3d_shader_upload_matrix (self->shader, &hmd_cam->right_vp_matrix, "vp");
+  gst_3d_camera_buffer_bind (scene->camera_buffer, 1);
 
   /* right framebuffer */
-  gl->Viewport (self->eye_width, 0, self->eye_width, self->eye_height);
+  gst_3d_gl_state_viewport (self->context, self->eye_width, 0,
+      self->eye_width, self->eye_height);
   gst_3d_mesh_draw (self->render_plane);
 }
 
@@ -229,12 +261,12 @@ gst_3d_renderer_init_stereo (Gst3DRenderer * self, Gst3DCamera * cam)
 {
   GError *error = NULL;
 
-  GstGLFuncs *gl = self->context->gl_vtable;
   Gst3DCameraHmd *hmd_cam = GST_3D_CAMERA_HMD (cam);
   Gst3DHmd *hmd = hmd_cam->hmd;
   float aspect_ratio = hmd->left_aspect;
-  self->render_plane = gst_3d_mesh_new_plane (self->context, aspect_ratio);
-  self->shader = gst_3d_shader_new_vert_frag (self->context, "mvp_uv.vert",
+  self->render_plane =
+      gst_3d_mesh_cache_get_plane (self->context, aspect_ratio);
+  self->shader = gst_3d_shader_new_vert_frag (self->context, "plane_uv.vert",
       "texture_uv.frag", &error);
 
   if (self->shader == NULL) {
@@ -245,13 +277,19 @@ gst_3d_renderer_init_stereo (Gst3DRenderer * self, Gst3DCamera * cam)
 
   gst_3d_mesh_bind_shader (self->render_plane, self->shader);
 
-  _create_fbo (gl, &self->left_fbo, &self->left_color_tex,
+  _create_fbo (self->context, &self->left_fbo, &self->left_color_tex,
       self->eye_width, self->eye_height);
-  _create_fbo (gl, &self->right_fbo, &self->right_color_tex,
+  _create_fbo (self->context, &self->right_fbo, &self->right_color_tex,
       self->eye_width, self->eye_height);
 
+  /* two RGBA8 eye textures */
+  self->texture_bytes = (gsize) self->eye_width * self->eye_height * 4 * 2;
+  gst_3d_memory_alloc (self->context, GST_3D_MEMORY_TEXTURE,
+      self->texture_bytes);
+
   gst_3d_shader_bind (self->shader);
-  gst_gl_shader_set_uniform_1i (self->shader->shader, "texture", 0);
+  gst_3d_shader_set_int (self->shader,
+      gst_3d_shader_get_uniform (self->shader, "texture"), 0);
 }
 
 
@@ -264,10 +302,12 @@ gst_3d_renderer_init_stereo_shader_proj (Gst3DRenderer * self,
   Gst3DCameraHmd *hmd_cam = GST_3D_CAMERA_HMD (cam);
   Gst3DHmd *hmd = hmd_cam->hmd;
   float aspect_ratio = hmd->left_aspect;
-  self->render_plane = gst_3d_mesh_new_plane (self->context, aspect_ratio);
+  self->render_plane =
+      gst_3d_mesh_cache_get_plane (self->context, aspect_ratio);
 
-  self->shader = gst_3d_shader_new_vert_frag (self->context, "mvp_uv.vert",
-      "texture_equirectangular_sphere.frag", &error);
+  const gchar *defines[] = { "INPUT_EQUIRECTANGULAR", NULL };
+  self->shader = gst_3d_shader_new_variant (self->context, "plane_uv.vert",
+      "texture_uv.frag", defines, &error);
 
   if (self->shader == NULL) {
     GST_WARNING ("Failed to create shaders. Error: %s", error->message);
@@ -278,7 +318,8 @@ gst_3d_renderer_init_stereo_shader_proj (Gst3DRenderer * self,
   gst_3d_mesh_bind_shader (self->render_plane, self->shader);
 
   gst_3d_shader_bind (self->shader);
-  gst_gl_shader_set_uniform_1i (self->shader->shader, "texture", 0);
+  gst_3d_shader_set_int (self->shader,
+      gst_3d_shader_get_uniform (self->shader, "texture"), 0);
 }
 
 void
@@ -288,24 +329,23 @@ gst_3d_renderer_draw_stereo (Gst3DRenderer * self, Gst3DScene * scene)
 
   _insert_gl_debug_marker (self->context, "gst_3d_renderer_draw_stereo");
 
-  /* aquire current fbo id */
-  GLint bound_fbo;
-  gl->GetIntegerv (GL_DRAW_FRAMEBUFFER_BINDING, &bound_fbo);
+  /* aquire current fbo id, only queried when the state cache lost it */
+  GLuint bound_fbo = gst_3d_gl_state_get_draw_framebuffer (self->context);
   if (bound_fbo == 0)
     return;
 
   Gst3DCameraHmd *hmd_cam = GST_3D_CAMERA_HMD (scene->camera);
 
   /* left eye */
-  _draw_eye (self, self->left_fbo, scene, &hmd_cam->left_vp_matrix);
+  _draw_eye (self, self->left_fbo, scene, 0, &hmd_cam->left_vp_matrix);
 
   /* right eye */
-  _draw_eye (self, self->right_fbo, scene, &hmd_cam->right_vp_matrix);
+  _draw_eye (self, self->right_fbo, scene, 1, &hmd_cam->right_vp_matrix);
 
   gst_3d_scene_clear_state (scene);
 
   gst_3d_shader_bind (self->shader);
-  gl->BindFramebuffer (GL_FRAMEBUFFER, bound_fbo);
+  gst_3d_gl_state_bind_framebuffer (self->context, GL_FRAMEBUFFER, bound_fbo);
   gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   _draw_framebuffers_on_planes (self);
@@ -322,5 +362,5 @@ gst_3d_renderer_draw_stereo_shader_proj (Gst3DRenderer * self,
 
   gst_3d_shader_bind (self->shader);
   gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  _draw_framebuffers_on_planes_shader_proj (self, scene->camera);
+  _draw_framebuffers_on_planes_shader_proj (self, scene);
 }
@@ -58,6 +58,8 @@ struct _Gst3DRenderer
   
   GLuint left_color_tex, left_fbo;
   GLuint right_color_tex, right_fbo;
+  /* eye texture size reported to gst3dmemory */
+  gsize texture_bytes;
   
   guint eye_width;
   guint eye_height;
@@ -30,6 +30,7 @@
 #include <gst/gl/gl.h>
 
 #include "gst3dscene.h"
+#include "gst3dglstate.h"
 
 #ifdef HAVE_OPENHMD
 #include "gst3dcamera_hmd.h"
@@ -41,6 +42,21 @@ bool use_shader_proj = FALSE;
 #define GST_CAT_DEFAULT gst_3d_scene_debug
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 
+/* Instances of one mesh collected from the nodes sharing an instanced
+ * shader during gst_3d_scene_draw_nodes. */
+struct Gst3DInstanceBatch
+{
+  Gst3DMesh *mesh;
+  Gst3DShader *shader;
+  GArray *transforms;
+};
+
+struct Gst3DSceneImport
+{
+  Gst3DImport *import;
+  Gst3DShader *shader;
+};
+
 G_DEFINE_TYPE_WITH_CODE (Gst3DScene, gst_3d_scene, GST_TYPE_OBJECT,
     GST_DEBUG_CATEGORY_INIT (gst_3d_scene_debug, "3dscene", 0, "scene"));
 
@@ -53,6 +69,36 @@ gst_3d_scene_init (Gst3DScene * self)
   self->context = NULL;
   self->gl_initialized = FALSE;
   self->node_draw_func = &gst_3d_node_draw;
+  self->imports = NULL;
+  self->draw_batches = NULL;
+  self->batches = NULL;
+  self->camera_buffer = NULL;
+  self->time = 0.f;
+  self->culling = TRUE;
+  self->bvh = NULL;
+  self->bvh_nodes = g_ptr_array_new ();
+  self->bvh_boxes = g_array_new (FALSE, FALSE, sizeof (graphene_box_t));
+  self->bvh_visible = NULL;
+  self->bvh_dirty = TRUE;
+  memset (&self->cull_stats, 0, sizeof (Gst3DCullStats));
+}
+
+static void
+_free_batch (struct Gst3DInstanceBatch *batch)
+{
+  gst_object_unref (batch->mesh);
+  gst_object_unref (batch->shader);
+  g_array_free (batch->transforms, TRUE);
+  g_free (batch);
+}
+
+static void
+_free_import (struct Gst3DSceneImport *pending)
+{
+  gst_3d_import_free (pending->import);
+  if (pending->shader)
+    gst_object_unref (pending->shader);
+  g_free (pending);
 }
 
 Gst3DScene *
@@ -88,6 +134,25 @@ gst_3d_scene_finalize (GObject * object)
     gst_object_unref (node);
   }
 
+  g_list_free_full (self->imports, (GDestroyNotify) _free_import);
+  self->imports = NULL;
+
+  g_list_free_full (self->draw_batches,
+      (GDestroyNotify) gst_3d_draw_batch_free);
+  self->draw_batches = NULL;
+
+  g_list_free_full (self->batches, (GDestroyNotify) _free_batch);
+  self->batches = NULL;
+
+  gst_3d_camera_buffer_free (self->camera_buffer);
+  self->camera_buffer = NULL;
+
+  gst_3d_bvh_free (self->bvh);
+  self->bvh = NULL;
+  g_ptr_array_free (self->bvh_nodes, TRUE);
+  g_array_free (self->bvh_boxes, TRUE);
+  g_free (self->bvh_visible);
+
   G_OBJECT_CLASS (gst_3d_scene_parent_class)->finalize (object);
 }
 
@@ -104,6 +169,7 @@ gst_3d_scene_init_gl (Gst3DScene * self, GstGLContext * context)
   if (self->gl_initialized)
     return;
   self->context = gst_object_ref (context);
+  self->camera_buffer = gst_3d_camera_buffer_new (context);
   self->gl_init_func (self);
   self->gl_initialized = TRUE;
   gst_3d_camera_update_view (self->camera);
@@ -112,22 +178,342 @@ gst_3d_scene_init_gl (Gst3DScene * self, GstGLContext * context)
 #endif
 }
 
+static struct Gst3DInstanceBatch *
+_get_batch (Gst3DScene * self, Gst3DMesh * mesh, Gst3DShader * shader)
+{
+  GList *l;
+  for (l = self->batches; l != NULL; l = l->next) {
+    struct Gst3DInstanceBatch *batch = (struct Gst3DInstanceBatch *) l->data;
+    if (batch->mesh == mesh && batch->shader == shader)
+      return batch;
+  }
+
+  struct Gst3DInstanceBatch *batch = g_new0 (struct Gst3DInstanceBatch, 1);
+  batch->mesh = gst_object_ref (mesh);
+  batch->shader = gst_object_ref (shader);
+  batch->transforms = g_array_new (FALSE, FALSE, sizeof (graphene_matrix_t));
+  self->batches = g_list_append (self->batches, batch);
+  return batch;
+}
+
+/* Queues @lod in the draw batch of @shader holding @mesh, packing @mesh
+ * with all its levels into a compatible batch on first use. */
+static gboolean
+_push_draw_batch (Gst3DScene * self, Gst3DMesh * mesh, Gst3DMesh * lod,
+    Gst3DShader * shader, const graphene_matrix_t * model)
+{
+  GList *l;
+
+  if (!gst_3d_draw_batch_can_pack (mesh))
+    return FALSE;
+
+  for (l = self->draw_batches; l != NULL; l = l->next) {
+    Gst3DDrawBatch *batch = (Gst3DDrawBatch *) l->data;
+    if (gst_3d_draw_batch_get_shader (batch) != shader)
+      continue;
+    if (gst_3d_draw_batch_push (batch, lod, model))
+      return TRUE;
+    if (gst_3d_draw_batch_add_mesh (batch, mesh))
+      return gst_3d_draw_batch_push (batch, lod, model);
+  }
+
+  Gst3DDrawBatch *batch = gst_3d_draw_batch_new (self->context, shader);
+  if (!gst_3d_draw_batch_add_mesh (batch, mesh)) {
+    gst_3d_draw_batch_free (batch);
+    return FALSE;
+  }
+  self->draw_batches = g_list_append (self->draw_batches, batch);
+  return gst_3d_draw_batch_push (batch, lod, model);
+}
+
+/* The instances carry their model matrix, the view projection comes from
+ * the camera block. node->mvp is still used to select the level of
+ * detail. */
+static void
+_batch_node (Gst3DScene * self, Gst3DNode * node,
+    const graphene_matrix_t * model)
+{
+  GList *l;
+  for (l = node->meshes; l != NULL; l = l->next) {
+    Gst3DMesh *mesh = gst_3d_mesh_select_lod ((Gst3DMesh *) l->data,
+        &node->mvp);
+    if (_push_draw_batch (self, (Gst3DMesh *) l->data, mesh,
+            node->instanced_shader, model))
+      continue;
+
+    struct Gst3DInstanceBatch *batch =
+        _get_batch (self, mesh, node->instanced_shader);
+    g_array_append_val (batch->transforms, *model);
+  }
+}
+
+/* One indirect draw per draw batch, then one instanced draw per remaining
+ * mesh. Instance batches that stayed empty for a frame belong to meshes
+ * no longer drawn and are dropped. */
+static void
+_flush_batches (Gst3DScene * self)
+{
+  GList *d;
+  for (d = self->draw_batches; d != NULL; d = d->next)
+    gst_3d_draw_batch_flush ((Gst3DDrawBatch *) d->data);
+
+  GList *l = self->batches;
+  while (l != NULL) {
+    GList *next = l->next;
+    struct Gst3DInstanceBatch *batch = (struct Gst3DInstanceBatch *) l->data;
+
+    if (batch->transforms->len == 0) {
+      _free_batch (batch);
+      self->batches = g_list_delete_link (self->batches, l);
+      l = next;
+      continue;
+    }
+
+    gst_3d_shader_bind (batch->shader);
+    gst_3d_mesh_upload_instance_transforms (batch->mesh,
+        (const graphene_matrix_t *) batch->transforms->data,
+        batch->transforms->len);
+    gst_3d_mesh_bind (batch->mesh);
+    gst_3d_mesh_draw_instanced (batch->mesh, batch->transforms->len);
+
+    g_array_set_size (batch->transforms, 0);
+    l = next;
+  }
+}
+
+static gboolean
+_node_visible (Gst3DScene * self, Gst3DNode * node,
+    const graphene_frustum_t * frustum)
+{
+  if (!frustum || !node->bounded)
+    return TRUE;
+
+  self->cull_stats.tested++;
+  if (graphene_frustum_intersects_box (frustum, &node->bounds))
+    return TRUE;
+
+  self->cull_stats.culled++;
+  return FALSE;
+}
+
+/* Children outside of @frustum are skipped with their subtrees, @node
+ * itself was tested by the caller. */
+static void
+_draw_node (Gst3DScene * self, Gst3DNode * node, Gst3DShader * parent_shader,
+    const graphene_matrix_t * parent_model, graphene_matrix_t * vp,
+    const graphene_frustum_t * frustum)
+{
+  graphene_matrix_t model;
+  graphene_matrix_multiply (&node->transform, parent_model, &model);
+
+  Gst3DShader *shader = node->shader ? node->shader : parent_shader;
+
+  if (node->meshes && node->instanced_shader
+      && self->node_draw_func == &gst_3d_node_draw) {
+    graphene_matrix_multiply (&model, vp, &node->mvp);
+    _batch_node (self, node, &model);
+  } else if (node->meshes && shader) {
+    graphene_matrix_multiply (&model, vp, &node->mvp);
+    gst_3d_shader_bind (shader);
+    /* skipped by the uniform cache when the model did not change */
+    gst_3d_shader_set_matrix (shader, shader->model_uniform, &model);
+    self->node_draw_func (node);
+  }
+
+  GList *l;
+  for (l = node->children; l != NULL; l = l->next) {
+    Gst3DNode *child = (Gst3DNode *) l->data;
+    if (_node_visible (self, child, frustum))
+      _draw_node (self, child, shader, &model, vp, frustum);
+  }
+}
+
+/* Updates the world bounds of all nodes, to be called once per frame
+ * before the views are drawn. The BVH over the top level nodes is rebuilt
+ * when nodes were added or changed between bounded and unbounded, and
+ * refitted otherwise. */
 void
-gst_3d_scene_draw_nodes (Gst3DScene * self, graphene_matrix_t * mvp)
+gst_3d_scene_update_bounds (Gst3DScene * self)
 {
+  graphene_matrix_t identity;
+  graphene_matrix_init_identity (&identity);
+  guint n = 0;
+
   GList *l;
   for (l = self->nodes; l != NULL; l = l->next) {
     Gst3DNode *node = (Gst3DNode *) l->data;
-    gst_3d_shader_bind (node->shader);
-    gst_3d_shader_upload_matrix (node->shader, mvp, "mvp");
-    self->node_draw_func (node);
+    gst_3d_node_update_bounds (node, &identity);
+    if (!node->bounded)
+      continue;
+
+    if (n >= self->bvh_nodes->len || self->bvh_nodes->pdata[n] != node) {
+      g_ptr_array_set_size (self->bvh_nodes, n);
+      g_ptr_array_add (self->bvh_nodes, node);
+      self->bvh_dirty = TRUE;
+    }
+    if (n >= self->bvh_boxes->len)
+      g_array_set_size (self->bvh_boxes, n + 1);
+    g_array_index (self->bvh_boxes, graphene_box_t, n) = node->bounds;
+    n++;
+  }
+
+  if (n != self->bvh_nodes->len) {
+    g_ptr_array_set_size (self->bvh_nodes, n);
+    self->bvh_dirty = TRUE;
+  }
+
+  if (!self->bvh)
+    self->bvh = gst_3d_bvh_new ();
+
+  if (self->bvh_dirty) {
+    gst_3d_bvh_build (self->bvh, (const graphene_box_t *) self->bvh_boxes->data,
+        n);
+    self->bvh_visible = g_renew (guint8, self->bvh_visible, MAX (n, 1));
+    self->bvh_dirty = FALSE;
+    GST_DEBUG ("built BVH over %u of %u nodes", n,
+        g_list_length (self->nodes));
+  } else {
+    gst_3d_bvh_refit (self->bvh,
+        (const graphene_box_t *) self->bvh_boxes->data);
+  }
+}
+
+void
+gst_3d_scene_set_culling (Gst3DScene * self, gboolean culling)
+{
+  self->culling = culling;
+}
+
+void
+gst_3d_scene_get_cull_stats (Gst3DScene * self, Gst3DCullStats * stats)
+{
+  *stats = self->cull_stats;
+}
+
+/* Draws the nodes intersecting the frustum of @vp, the view projection
+ * of @eye in the camera buffer, which is bound for the shaders. Culling
+ * uses the bounds of the last gst_3d_scene_update_bounds, and is skipped
+ * before the first update.
+ *
+ * Nodes with an instanced shader are collected while walking the tree
+ * and drawn after all other nodes. Static meshes sharing a vertex format
+ * are drawn with one indirect draw call per shader, other meshes with one
+ * instanced draw call each. The wireframe mode draws them one by one with
+ * their regular shader. */
+void
+gst_3d_scene_draw_nodes (Gst3DScene * self, guint eye,
+    graphene_matrix_t * vp)
+{
+  graphene_matrix_t identity;
+  graphene_matrix_init_identity (&identity);
+
+  graphene_frustum_t frustum_storage;
+  const graphene_frustum_t *frustum = NULL;
+  guint bvh_index = 0;
+
+  if (self->culling && self->bvh) {
+    graphene_frustum_init_from_matrix (&frustum_storage, vp);
+    frustum = &frustum_storage;
+    self->cull_stats.bvh_tests +=
+        gst_3d_bvh_cull (self->bvh, frustum, self->bvh_visible);
+  }
+
+  gst_3d_camera_buffer_bind (self->camera_buffer, eye);
+
+  GList *l;
+  for (l = self->nodes; l != NULL; l = l->next) {
+    Gst3DNode *node = (Gst3DNode *) l->data;
+
+    /* bvh_nodes holds the bounded nodes in list order */
+    if (frustum && bvh_index < self->bvh_nodes->len
+        && self->bvh_nodes->pdata[bvh_index] == node) {
+      gboolean visible = self->bvh_visible[bvh_index++];
+      self->cull_stats.tested++;
+      if (!visible) {
+        self->cull_stats.culled++;
+        continue;
+      }
+    }
+
+    _draw_node (self, node, NULL, &identity, vp, frustum);
+  }
+
+  _flush_batches (self);
+}
+
+void
+gst_3d_scene_set_time (Gst3DScene * self, gfloat seconds)
+{
+  self->time = seconds;
+}
+
+/* Writes the cameras of all eyes drawn this frame and uploads them in one
+ * buffer update. */
+static void
+_update_camera_buffer (Gst3DScene * self)
+{
+#ifdef HAVE_OPENHMD
+  if (GST_IS_3D_CAMERA_HMD (self->camera)) {
+    Gst3DCameraHmd *hmd_cam = GST_3D_CAMERA_HMD (self->camera);
+    gst_3d_camera_buffer_set_eye (self->camera_buffer, 0,
+        &hmd_cam->left_view_matrix, &hmd_cam->left_projection_matrix);
+    gst_3d_camera_buffer_set_eye (self->camera_buffer, 1,
+        &hmd_cam->right_view_matrix, &hmd_cam->right_projection_matrix);
+  } else
+#endif
+    gst_3d_camera_buffer_set_eye (self->camera_buffer, 0,
+        &self->camera->view, &self->camera->projection);
+
+  gst_3d_camera_buffer_set_time (self->camera_buffer, self->time);
+  gst_3d_camera_buffer_upload (self->camera_buffer);
+}
+
+/* Redundant binds between the nodes and eyes are skipped by
+ * gst3dglstate for the duration of the draw. */
+/* Uploads the imports that finished loading since the last frame, before
+ * anything is drawn. */
+static void
+_upload_imports (Gst3DScene * self)
+{
+  GList *l = self->imports;
+
+  while (l != NULL) {
+    GList *next = l->next;
+    struct Gst3DSceneImport *pending = l->data;
+    GError *error = NULL;
+
+    if (gst_3d_import_is_loaded (pending->import)) {
+      if (gst_3d_import_wait (pending->import, &error)) {
+        gst_3d_scene_append_node (self,
+            gst_3d_import_upload (pending->import, self->context,
+                pending->shader));
+      } else {
+        GST_ERROR ("%s", error->message);
+        g_clear_error (&error);
+      }
+      _free_import (pending);
+      self->imports = g_list_delete_link (self->imports, l);
+    }
+
+    l = next;
   }
 }
 
 void
 gst_3d_scene_draw (Gst3DScene * self)
 {
+  guint64 issued, avoided;
+
+  if (self->imports)
+    _upload_imports (self);
+
+  gst_3d_gl_state_begin (self->context);
   gst_3d_camera_update_view (self->camera);
+  _update_camera_buffer (self);
+
+  memset (&self->cull_stats, 0, sizeof (Gst3DCullStats));
+  if (self->culling)
+    gst_3d_scene_update_bounds (self);
 
 #ifdef HAVE_OPENHMD
   if (GST_IS_3D_CAMERA_HMD (self->camera))
@@ -136,17 +522,42 @@ gst_3d_scene_draw (Gst3DScene * self)
     else
       gst_3d_renderer_draw_stereo (self->renderer, self);
   else
-    gst_3d_scene_draw_nodes (self, &self->camera->mvp);
+    gst_3d_scene_draw_nodes (self, 0, &self->camera->mvp);
 #else
-  gst_3d_scene_draw_nodes (self, &self->camera->mvp);
+  gst_3d_scene_draw_nodes (self, 0, &self->camera->mvp);
 #endif
   gst_3d_scene_clear_state (self);
+  gst_3d_gl_state_end (self->context);
+
+  GST_LOG ("culled %u of %u tested nodes, %u BVH tests",
+      self->cull_stats.culled, self->cull_stats.tested,
+      self->cull_stats.bvh_tests);
+
+  gst_3d_gl_state_get_stats (self->context, &issued, &avoided);
+  GST_LOG ("issued %" G_GUINT64_FORMAT " binds, avoided %" G_GUINT64_FORMAT,
+      issued, avoided);
 }
 
 void
 gst_3d_scene_append_node (Gst3DScene * self, Gst3DNode * node)
 {
   self->nodes = g_list_append (self->nodes, node);
+  self->bvh_dirty = TRUE;
+}
+
+/* Takes ownership of @import, usually started with
+ * gst_3d_import_load_async, so the scene keeps drawing while it loads. Its
+ * meshes are uploaded at the start of the first frame after it finished
+ * and its root node is appended, drawn with @shader. */
+void
+gst_3d_scene_append_import (Gst3DScene * self, Gst3DImport * import,
+    Gst3DShader * shader)
+{
+  struct Gst3DSceneImport *pending = g_new0 (struct Gst3DSceneImport, 1);
+
+  pending->import = import;
+  pending->shader = shader ? gst_object_ref (shader) : NULL;
+  self->imports = g_list_append (self->imports, pending);
 }
 
 void
@@ -181,13 +592,11 @@ gst_3d_scene_navigation_event (Gst3DScene * self, GstEvent * event)
   }
 }
 
+/* Only unbinds what is still bound, see gst_3d_gl_state_reset. */
 void
 gst_3d_scene_clear_state (Gst3DScene * self)
 {
-  GstGLFuncs *gl = self->context->gl_vtable;
-  gl->BindVertexArray (0);
-  gl->BindTexture (GL_TEXTURE_2D, 0);
-  gst_gl_context_clear_shader (self->context);
+  gst_3d_gl_state_reset (self->context);
 }
 
 
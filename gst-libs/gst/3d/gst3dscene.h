@@ -28,6 +28,10 @@
 #include "gst3dnode.h"
 #include "gst3dcamera.h"
 #include "gst3drenderer.h"
+#include "gst3ddrawbatch.h"
+#include "gst3dcamerabuffer.h"
+#include "gst3dbvh.h"
+#include "gst3dimport.h"
 
 G_BEGIN_DECLS
 #define GST_3D_TYPE_SCENE            (gst_3d_scene_get_type ())
@@ -39,6 +43,16 @@ G_BEGIN_DECLS
 typedef struct _Gst3DScene Gst3DScene;
 typedef struct _Gst3DSceneClass Gst3DSceneClass;
 
+/* summed over all views drawn by the last gst_3d_scene_draw */
+typedef struct
+{
+  /* nodes tested against a view frustum */
+  guint tested;
+  guint culled;
+  /* BVH nodes and boxes visited for the top level nodes */
+  guint bvh_tests;
+} Gst3DCullStats;
+
 struct _Gst3DScene
 {
   /*< private > */
@@ -53,6 +67,33 @@ struct _Gst3DScene
   Gst3DCamera *camera;
   Gst3DRenderer *renderer;
   GList *nodes;
+
+  /* imports still loading, appended as nodes once loaded, see
+   * gst_3d_scene_append_import */
+  GList *imports;
+
+  /* view and projection of each eye, uploaded once per frame and read
+   * by all shaders through the camera block */
+  Gst3DCameraBuffer *camera_buffer;
+  gfloat time;
+
+  /* BVH over the world bounds of the bounded top level nodes, kept in
+   * list order in bvh_nodes */
+  gboolean culling;
+  Gst3DBvh *bvh;
+  GPtrArray *bvh_nodes;
+  GArray *bvh_boxes;
+  guint8 *bvh_visible;
+  gboolean bvh_dirty;
+  Gst3DCullStats cull_stats;
+
+  /* Gst3DDrawBatch per instanced shader and vertex format, packing the
+   * static meshes of the nodes drawn with it */
+  GList *draw_batches;
+
+  /* Gst3DInstanceBatch per mesh and instanced shader for meshes that can
+   * not be packed, kept between frames to reuse the transform arrays */
+  GList *batches;
 };
 
 struct _Gst3DSceneClass
@@ -62,12 +103,21 @@ struct _Gst3DSceneClass
 
 Gst3DScene *gst_3d_scene_new (Gst3DCamera * camera, void (*_init_func)(Gst3DScene *));
 void gst_3d_scene_append_node(Gst3DScene *self, Gst3DNode * node);
+void gst_3d_scene_append_import (Gst3DScene * self, Gst3DImport * import,
+    Gst3DShader * shader);
 void gst_3d_scene_toggle_wireframe_mode (Gst3DScene *self);
 void gst_3d_scene_navigation_event (Gst3DScene *self, GstEvent * event);
 
 void gst_3d_scene_init_gl(Gst3DScene *self, GstGLContext *context);
 
-void gst_3d_scene_draw_nodes (Gst3DScene * self, graphene_matrix_t * mvp);
+void gst_3d_scene_update_bounds (Gst3DScene * self);
+void gst_3d_scene_set_culling (Gst3DScene * self, gboolean culling);
+void gst_3d_scene_get_cull_stats (Gst3DScene * self, Gst3DCullStats * stats);
+
+void gst_3d_scene_set_time (Gst3DScene * self, gfloat seconds);
+
+void gst_3d_scene_draw_nodes (Gst3DScene * self, guint eye,
+    graphene_matrix_t * vp);
 void gst_3d_scene_draw (Gst3DScene * self);
 
 void gst_3d_scene_send_eos_on_esc (GstElement * element, GstEvent * event);
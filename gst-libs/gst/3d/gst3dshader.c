@@ -33,17 +33,55 @@
 #include <gio/gio.h>
 
 #include "gst3dshader.h"
+#include "gst3dmemory.h"
+#include "gst3dprogrambinary.h"
+#include "gst3dprogramcache.h"
+#include "gst3dcamerabuffer.h"
+#include "gst3dglstate.h"
 
 #define GST_CAT_DEFAULT gst_3d_shader_debug
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (GSTGLAPI * Gst3DMaxShaderCompilerThreads) (GLuint count);
+
+/* Programs from gst3dprogramcache are shared between shaders. The last
+ * shader that uploaded uniforms to a program is kept on it, the uniform
+ * values another shader has cached are stale once it changes. */
+#define PROGRAM_OWNER_QUARK \
+    g_quark_from_static_string ("gst-3d-shader-owner")
+/* The program size is reported to gst3dmemory once per program and
+ * released when its last user drops it. */
+#define PROGRAM_USAGE_QUARK \
+    g_quark_from_static_string ("gst-3d-shader-usage")
+
+struct Gst3DProgramUsage
+{
+  GstGLContext *context;
+  gsize bytes;
+};
+
 G_DEFINE_TYPE_WITH_CODE (Gst3DShader, gst_3d_shader, GST_TYPE_OBJECT,
     GST_DEBUG_CATEGORY_INIT (gst_3d_shader_debug, "3dshader", 0, "shader"));
 
 void
 gst_3d_shader_init (Gst3DShader * self)
 {
-  self->shader = NULL;
+  self->program = NULL;
+  self->pending = 0;
+  self->pending_key = NULL;
+  self->pending_cache_key = NULL;
+  self->uniforms = g_array_new (FALSE, TRUE,
+      sizeof (struct Gst3DShaderUniform));
+  self->uniform_handles = g_hash_table_new (g_str_hash, g_str_equal);
+  self->mvp_uniform = gst_3d_shader_get_uniform (self, "mvp");
+  self->model_uniform = gst_3d_shader_get_uniform (self, "model");
 }
 
 Gst3DShader *
@@ -56,12 +94,12 @@ gst_3d_shader_new (GstGLContext * context)
 }
 
 Gst3DShader *
-gst_3d_shader_new_vert_frag (GstGLContext * context, const gchar * vertex,
-    const gchar * fragment, GError **error)
+gst_3d_shader_new_variant (GstGLContext * context, const gchar * vertex,
+    const gchar * fragment, const gchar * const *defines, GError ** error)
 {
   g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
   Gst3DShader *shader = gst_3d_shader_new (context);
-  if (!gst_3d_shader_from_vert_frag (shader, vertex, fragment, error)) {
+  if (!gst_3d_shader_from_variant (shader, vertex, fragment, defines, error)) {
     gst_object_unref (shader);
     return NULL;
   }
@@ -69,12 +107,24 @@ gst_3d_shader_new_vert_frag (GstGLContext * context, const gchar * vertex,
   return shader;
 }
 
+Gst3DShader *
+gst_3d_shader_new_vert_frag (GstGLContext * context, const gchar * vertex,
+    const gchar * fragment, GError **error)
+{
+  return gst_3d_shader_new_variant (context, vertex, fragment, NULL, error);
+}
+
 static void
 gst_3d_shader_finalize (GObject * object)
 {
   Gst3DShader *self = GST_3D_SHADER (object);
   g_return_if_fail (self != NULL);
 
+  gst_3d_shader_delete (self);
+
+  g_hash_table_unref (self->uniform_handles);
+  g_array_free (self->uniforms, TRUE);
+
   if (self->context) {
     gst_object_unref (self->context);
     self->context = NULL;
@@ -90,10 +140,23 @@ gst_3d_shader_class_init (Gst3DShaderClass * klass)
   obj_class->finalize = gst_3d_shader_finalize;
 }
 
+/* Waits for a queued program first, see gst_3d_shader_queue_vert_frag.
+ * The program is made current through gst3dglstate, which skips the bind
+ * when it already is. */
 void
 gst_3d_shader_bind (Gst3DShader * self)
 {
-  gst_gl_shader_use (self->shader);
+  if (self->pending) {
+    GError *error = NULL;
+    if (!gst_3d_shader_finish (self, &error)) {
+      GST_ERROR_OBJECT (self, "%s", error->message);
+      g_clear_error (&error);
+    }
+  }
+
+  g_return_if_fail (GST_IS_3D_PROGRAM (self->program));
+
+  gst_3d_gl_state_use_program (self->context, self->program->handle);
 }
 
 const char *
@@ -121,87 +184,605 @@ gst_3d_shader_read (const char *file)
   return shader;
 }
 
+/* Looks up the locations of all registered uniforms in the current
+ * program and points its camera block at the shared binding. Values of
+ * a new program are unknown until uploaded. */
+static void
+_resolve_uniforms (Gst3DShader * self)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+  GLuint program = 0;
+
+  if (self->program)
+    program = self->program->handle;
+
+  if (program)
+    gst_3d_camera_buffer_bind_program (self->context, program);
+
+  for (guint i = 0; i < self->uniforms->len; i++) {
+    struct Gst3DShaderUniform *uniform =
+        &g_array_index (self->uniforms, struct Gst3DShaderUniform, i);
+    uniform->location = program ?
+        gl->GetUniformLocation (program, uniform->name) : -1;
+    uniform->uploaded = FALSE;
+  }
+}
+
+static void
+_delete_stages (Gst3DShader * self)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  for (guint i = 0; i < G_N_ELEMENTS (self->pending_stages); i++) {
+    if (!self->pending_stages[i])
+      continue;
+    gl->DetachShader (self->pending, self->pending_stages[i]);
+    gl->DeleteShader (self->pending_stages[i]);
+    self->pending_stages[i] = 0;
+  }
+}
+
+static void
+_delete_pending (GstGLContext * context, Gst3DShader * self)
+{
+  _delete_stages (self);
+  context->gl_vtable->DeleteProgram (self->pending);
+}
+
+/* Also drops the keys of a program finish already took over. */
+static void
+_clear_pending (Gst3DShader * self)
+{
+  if (self->pending)
+    gst_gl_context_thread_add (self->context,
+        (GstGLContextThreadFunc) _delete_pending, self);
+  self->pending = 0;
+
+  g_free (self->pending_key);
+  self->pending_key = NULL;
+  g_free (self->pending_cache_key);
+  self->pending_cache_key = NULL;
+}
+
 void
 gst_3d_shader_delete (Gst3DShader * self)
 {
-  if (self->shader != NULL) {
-    gst_object_unref (self->shader);
-    self->shader = NULL;
+  _clear_pending (self);
+
+  if (self->program != NULL) {
+    GObject *program = G_OBJECT (self->program);
+    if (g_object_get_qdata (program, PROGRAM_OWNER_QUARK) == self)
+      g_object_set_qdata (program, PROGRAM_OWNER_QUARK, NULL);
+    gst_object_unref (self->program);
+    self->program = NULL;
   }
+
+  self->program_bytes = 0;
+
+  _resolve_uniforms (self);
 }
 
-gboolean
-gst_3d_shader_from_vert_frag (Gst3DShader * self, const gchar * vertex,
-    const gchar * fragment, GError **error)
+/* GL does not expose the memory a program occupies. The size of its
+ * binary is the closest estimate, falling back to the source length when
+ * program binaries are not supported. */
+static gsize
+_program_size (GstGLContext * context, Gst3DProgram * program,
+    gsize source_length)
+{
+  GstGLFuncs *gl = context->gl_vtable;
+  GLint length = 0;
+
+  if (gl->GetProgramiv)
+    gl->GetProgramiv (program->handle, GL_PROGRAM_BINARY_LENGTH, &length);
+
+  if (length > 0)
+    return length;
+
+  return source_length;
+}
+
+static void
+_usage_free (struct Gst3DProgramUsage *usage)
+{
+  gst_3d_memory_release (usage->context, GST_3D_MEMORY_PROGRAM, usage->bytes);
+  gst_object_unref (usage->context);
+  g_free (usage);
+}
+
+static gsize
+_track_program (GstGLContext * context, Gst3DProgram * program,
+    gsize source_length)
+{
+  struct Gst3DProgramUsage *usage =
+      g_object_get_qdata (G_OBJECT (program), PROGRAM_USAGE_QUARK);
+
+  if (!usage) {
+    usage = g_new0 (struct Gst3DProgramUsage, 1);
+    usage->context = gst_object_ref (context);
+    usage->bytes = _program_size (context, program, source_length);
+    gst_3d_memory_alloc (context, GST_3D_MEMORY_PROGRAM, usage->bytes);
+    g_object_set_qdata_full (G_OBJECT (program), PROGRAM_USAGE_QUARK, usage,
+        (GDestroyNotify) _usage_free);
+  }
+
+  return usage->bytes;
+}
+
+static void
+_set_program (Gst3DShader * self, Gst3DProgram * program,
+    gsize source_length)
+{
+  gst_3d_shader_delete (self);
+  self->program = program;
+  self->program_bytes = _track_program (self->context, program,
+      source_length);
+  _resolve_uniforms (self);
+}
+
+/* The binary goes into an empty program, so a cache hit compiles no
+ * stage at all. */
+static Gst3DProgram *
+_load_binary (GstGLContext * context, const gchar * key)
+{
+  GstGLFuncs *gl = context->gl_vtable;
+  GLuint handle = gl->CreateProgram ();
+
+  if (!handle)
+    return NULL;
+
+  if (!gst_3d_program_binary_load (context, handle, key)) {
+    gl->DeleteProgram (handle);
+    return NULL;
+  }
+
+  return gst_3d_program_new (context, handle);
+}
+
+static gboolean
+_parallel_compile_supported (GstGLContext * context)
+{
+  return gst_gl_context_check_feature (context,
+      "GL_KHR_parallel_shader_compile")
+      || gst_gl_context_check_feature (context,
+      "GL_ARB_parallel_shader_compile");
+}
+
+/* Lets the driver use as many compiler threads as it likes, which is
+ * not the default of every implementation. */
+static void
+_init_parallel_compile (GstGLContext * context)
+{
+  Gst3DMaxShaderCompilerThreads max_threads;
+
+  if (!_parallel_compile_supported (context))
+    return;
+
+  max_threads = (Gst3DMaxShaderCompilerThreads)
+      gst_gl_context_get_proc_address (context,
+      "glMaxShaderCompilerThreadsKHR");
+  if (!max_threads)
+    max_threads = (Gst3DMaxShaderCompilerThreads)
+        gst_gl_context_get_proc_address (context,
+        "glMaxShaderCompilerThreadsARB");
+  if (max_threads)
+    max_threads (0xFFFFFFFF);
+}
+
+/* Issues the compile without asking for its status, which would block
+ * until the driver is done. */
+static GLuint
+_compile_stage (GstGLFuncs * gl, GLenum type, const gchar * src)
+{
+  GLuint stage = gl->CreateShader (type);
+  gl->ShaderSource (stage, 1, &src, NULL);
+  gl->CompileShader (stage);
+  return stage;
+}
+
+static gint
+_compare_defines (gconstpointer a, gconstpointer b)
+{
+  return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+/* Returns @src with a #define line for each of the NULL terminated
+ * @defines, given as "NAME" or "NAME value", inserted after the #version
+ * line. The defines are sorted, so equal sets give equal sources and
+ * share their program binary in the disk cache. */
+gchar *
+gst_3d_shader_specialize (const gchar * src, const gchar * const *defines)
+{
+  if (!defines || !defines[0])
+    return g_strdup (src);
+
+  guint n = g_strv_length ((gchar **) defines);
+  const gchar **sorted = g_new (const gchar *, n);
+  memcpy (sorted, defines, n * sizeof (const gchar *));
+  qsort (sorted, n, sizeof (const gchar *), _compare_defines);
+
+  /* only comments may precede #version */
+  const gchar *body = src;
+  const gchar *version = strstr (src, "#version");
+  if (version) {
+    const gchar *eol = strchr (version, '\n');
+    body = eol ? eol + 1 : version + strlen (version);
+  }
+
+  GString *out = g_string_new_len (src, body - src);
+  if (out->len && out->str[out->len - 1] != '\n')
+    g_string_append_c (out, '\n');
+  for (guint i = 0; i < n; i++)
+    g_string_append_printf (out, "#define %s\n", sorted[i]);
+  g_string_append (out, body);
+
+  g_free (sorted);
+  return g_string_free (out, FALSE);
+}
+
+/* Queues the compile and link of @vertex_src and @fragment_src and
+ * returns without waiting for the driver. A cached program binary is
+ * loaded right away instead. With KHR_parallel_shader_compile the driver
+ * works on its own threads, otherwise it may still defer the work until
+ * the status is queried. gst_3d_shader_is_ready polls without blocking
+ * and gst_3d_shader_finish or the first gst_3d_shader_bind waits for the
+ * program, so compiles can be queued for all programs when the context
+ * becomes available and overlap with negotiation, each other and the
+ * first frames, which draw paths skip until the program is ready.
+ *
+ * A program already linked from the same sources on the context is
+ * shared through gst3dprogramcache and needs no compile at all. Programs
+ * are only cached once linked, shaders queueing the same sources at the
+ * same time still compile their own. */
+static gboolean
+_queue (Gst3DShader * self, const gchar * vertex, const gchar * fragment,
+    const gchar * vertex_src, const gchar * fragment_src, GError ** error)
 {
-  gboolean ret = FALSE;
-  GstGLShader *shader = NULL;
   GstGLContext *context = self->context;
+  GstGLFuncs *gl = context->gl_vtable;
+  Gst3DProgram *cached = NULL;
+  gsize source_length = strlen (vertex_src) + strlen (fragment_src);
 
-  if (gst_gl_context_get_gl_api (context)) {
-    GstGLSLStage *stage;
+  GST_LOG_OBJECT (self, "Creating shader from vertex src %s, fragment src %s",
+      vertex_src, fragment_src);
 
-    const gchar *vertex_src = gst_3d_shader_read (vertex);
-    const gchar *fragment_src = gst_3d_shader_read (fragment);
+  _clear_pending (self);
 
-    GST_LOG_OBJECT (self, "Creating shader from vertex src %s, fragment src %s",
-        vertex_src, fragment_src);
+  gchar *cache_key = gst_3d_program_cache_get_key (vertex_src, fragment_src);
 
-    shader = gst_gl_shader_new (context);
+  if ((cached = gst_3d_program_cache_lookup (context, cache_key))) {
+    GST_DEBUG_OBJECT (self, "sharing the linked program of %s and %s",
+        vertex, fragment);
+    g_free (cache_key);
+    _set_program (self, cached, source_length);
+    return TRUE;
+  }
 
-    if (!(stage = gst_glsl_stage_new_with_string (context, GL_VERTEX_SHADER,
-                GST_GLSL_VERSION_NONE, GST_GLSL_PROFILE_NONE, vertex_src))) {
-      goto print_error;
-    }
+  gchar *key = gst_3d_program_binary_get_key (context, vertex_src,
+      fragment_src);
+
+  if (key && (cached = _load_binary (context, key))) {
+    GST_DEBUG_OBJECT (self, "loaded %s and %s from the program cache",
+        vertex, fragment);
+    gst_3d_program_cache_insert (context, cache_key, cached);
+    g_free (cache_key);
+    g_free (key);
+    _set_program (self, cached, source_length);
+    return TRUE;
+  }
 
-    if (!gst_gl_shader_compile_attach_stage (shader, stage, error)) {
-      gst_object_unref (stage);
-      goto print_error;
-    }
+  GLuint program = gl->CreateProgram ();
+  if (!program) {
+    g_set_error (error, GST_GLSL_ERROR, GST_GLSL_ERROR_PROGRAM,
+        "Failed to create program");
+    g_free (cache_key);
+    g_free (key);
+    return FALSE;
+  }
 
-    if (!(stage = gst_glsl_stage_new_with_string (context, GL_FRAGMENT_SHADER,
-                GST_GLSL_VERSION_NONE, GST_GLSL_PROFILE_NONE, fragment_src))) {
-      goto print_error;
-    }
+  _init_parallel_compile (context);
 
-    if (!gst_gl_shader_compile_attach_stage (shader, stage, error)) {
-      gst_object_unref (stage);
-      goto print_error;
-    }
+  self->pending_stages[0] = _compile_stage (gl, GL_VERTEX_SHADER, vertex_src);
+  self->pending_stages[1] =
+      _compile_stage (gl, GL_FRAGMENT_SHADER, fragment_src);
+  for (guint i = 0; i < G_N_ELEMENTS (self->pending_stages); i++)
+    gl->AttachShader (program, self->pending_stages[i]);
 
-    if (!gst_gl_shader_link (shader, error)) {
-      goto print_error;
-    }
-    if (self->shader)
-      gst_object_unref (self->shader);
-    self->shader = gst_object_ref (shader);
-    ret = TRUE;
+  if (key)
+    gst_3d_program_binary_prepare (context, program);
+  gl->LinkProgram (program);
+
+  self->pending = program;
+  self->pending_key = key;
+  self->pending_cache_key = cache_key;
+  self->pending_source_length = source_length;
+
+  GST_DEBUG_OBJECT (self, "queued %s and %s", vertex, fragment);
+
+  return TRUE;
+}
+
+/* Queues @vertex and @fragment from gpu/ specialized with @defines, see
+ * gst_3d_shader_specialize. */
+gboolean
+gst_3d_shader_queue_variant (Gst3DShader * self, const gchar * vertex,
+    const gchar * fragment, const gchar * const *defines, GError ** error)
+{
+  if (!gst_gl_context_get_gl_api (self->context)) {
+    g_set_error (error, GST_GL_CONTEXT_ERROR, GST_GL_CONTEXT_ERROR_WRONG_API,
+        "GL context has no usable API");
+    return FALSE;
   }
 
+  gchar *vertex_src = gst_3d_shader_specialize (gst_3d_shader_read (vertex),
+      defines);
+  gchar *fragment_src =
+      gst_3d_shader_specialize (gst_3d_shader_read (fragment), defines);
+
+  gboolean ret = _queue (self, vertex, fragment, vertex_src, fragment_src,
+      error);
+
+  g_free (vertex_src);
+  g_free (fragment_src);
   return ret;
+}
 
-print_error:
-  if (shader)
-    gst_object_unref (shader);
+gboolean
+gst_3d_shader_queue_vert_frag (Gst3DShader * self, const gchar * vertex,
+    const gchar * fragment, GError ** error)
+{
+  return gst_3d_shader_queue_variant (self, vertex, fragment, NULL, error);
+}
+
+/* Returns FALSE while the driver is still building the queued program,
+ * for draw paths that skip work until it is ready instead of waiting in
+ * gst_3d_shader_finish. Without KHR_parallel_shader_compile the driver
+ * can not be asked without blocking, queued programs then report ready
+ * and are waited for when first used. */
+gboolean
+gst_3d_shader_is_ready (Gst3DShader * self)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+  GLint done = GL_FALSE;
+
+  if (!self->pending)
+    return self->program != NULL;
 
-  return FALSE;
+  if (!_parallel_compile_supported (self->context))
+    return TRUE;
+
+  gl->GetProgramiv (self->pending, GL_COMPLETION_STATUS_KHR, &done);
+
+  return done == GL_TRUE;
+}
+
+static gchar *
+_stage_log (GstGLFuncs * gl, GLuint stage)
+{
+  GLint status = GL_FALSE, length = 0;
+
+  gl->GetShaderiv (stage, GL_COMPILE_STATUS, &status);
+  if (status)
+    return NULL;
+
+  gl->GetShaderiv (stage, GL_INFO_LOG_LENGTH, &length);
+  gchar *log = g_malloc0 (MAX (length, 1));
+  gl->GetShaderInfoLog (stage, length, NULL, log);
+  return log;
+}
+
+/* Waits for the program queued by gst_3d_shader_queue_vert_frag and
+ * makes it the program of @self. Does nothing when no program is
+ * queued, but fails if @self has none either. */
+gboolean
+gst_3d_shader_finish (Gst3DShader * self, GError ** error)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+  GLint status = GL_FALSE;
+
+  if (!self->pending) {
+    if (self->program)
+      return TRUE;
+    g_set_error (error, GST_GLSL_ERROR, GST_GLSL_ERROR_PROGRAM,
+        "No program queued");
+    return FALSE;
+  }
+
+  GLuint program = self->pending;
+  gsize source_length = self->pending_source_length;
+
+  gl->GetProgramiv (program, GL_LINK_STATUS, &status);
+
+  if (!status) {
+    gchar *log = NULL;
+    for (guint i = 0; i < G_N_ELEMENTS (self->pending_stages) && !log; i++)
+      log = _stage_log (gl, self->pending_stages[i]);
+
+    if (log) {
+      g_set_error (error, GST_GLSL_ERROR, GST_GLSL_ERROR_COMPILE,
+          "Compilation failed: %s", log);
+    } else {
+      GLint length = 0;
+      gl->GetProgramiv (program, GL_INFO_LOG_LENGTH, &length);
+      log = g_malloc0 (MAX (length, 1));
+      gl->GetProgramInfoLog (program, length, NULL, log);
+      g_set_error (error, GST_GLSL_ERROR, GST_GLSL_ERROR_LINK,
+          "Linking failed: %s", log);
+    }
+    g_free (log);
+
+    _clear_pending (self);
+    return FALSE;
+  }
+
+  if (self->pending_key)
+    gst_3d_program_binary_save (self->context, program, self->pending_key);
+
+  /* the executable stays linked without its stages */
+  _delete_stages (self);
+  Gst3DProgram *linked = gst_3d_program_new (self->context, program);
+  gst_3d_program_cache_insert (self->context, self->pending_cache_key,
+      linked);
+  self->pending = 0;
+
+  _set_program (self, linked, source_length);
+
+  return TRUE;
+}
+
+/* Programs are loaded from the disk cache of gst3dprogrambinary when the
+ * driver supports program binaries, and only compiled and linked when
+ * there is no cached binary or the driver rejects it. */
+gboolean
+gst_3d_shader_from_variant (Gst3DShader * self, const gchar * vertex,
+    const gchar * fragment, const gchar * const *defines, GError ** error)
+{
+  if (!gst_3d_shader_queue_variant (self, vertex, fragment, defines, error))
+    return FALSE;
+
+  return gst_3d_shader_finish (self, error);
+}
+
+gboolean
+gst_3d_shader_from_vert_frag (Gst3DShader * self, const gchar * vertex,
+    const gchar * fragment, GError **error)
+{
+  return gst_3d_shader_from_variant (self, vertex, fragment, NULL, error);
+}
+
+/* Returns the handle of the uniform @name, registering it on first use.
+ * Locations are looked up once per linked program instead of on every
+ * upload, so the handle should be kept by callers drawing every frame. */
+Gst3DUniform
+gst_3d_shader_get_uniform (Gst3DShader * self, const gchar * name)
+{
+  gpointer handle;
+
+  if (g_hash_table_lookup_extended (self->uniform_handles, name, NULL,
+          &handle))
+    return GPOINTER_TO_INT (handle);
+
+  struct Gst3DShaderUniform uniform = { 0, };
+  uniform.name = g_intern_string (name);
+  uniform.location = -1;
+  if (self->program)
+    uniform.location = gst_3d_program_get_uniform_location (self->program,
+        uniform.name);
+
+  g_array_append_val (self->uniforms, uniform);
+  Gst3DUniform result = self->uniforms->len - 1;
+  g_hash_table_insert (self->uniform_handles, (gpointer) uniform.name,
+      GINT_TO_POINTER (result));
+
+  return result;
+}
+
+/* The setters below skip the upload when the program already holds the
+ * value, otherwise the program has to be in use. Uniforms set through
+ * handles must not be set with glUniform directly as well, which would
+ * leave the cached value stale. Shaders sharing a program forget their
+ * cached values when another one has uploaded. */
+static struct Gst3DShaderUniform *
+_get_active_uniform (Gst3DShader * self, Gst3DUniform handle)
+{
+  g_return_val_if_fail (handle >= 0
+      && (guint) handle < self->uniforms->len, NULL);
+
+  struct Gst3DShaderUniform *uniform =
+      &g_array_index (self->uniforms, struct Gst3DShaderUniform, handle);
+  if (uniform->location < 0)
+    return NULL;
+
+  GObject *program = G_OBJECT (self->program);
+  if (g_object_get_qdata (program, PROGRAM_OWNER_QUARK) != self) {
+    for (guint i = 0; i < self->uniforms->len; i++)
+      g_array_index (self->uniforms, struct Gst3DShaderUniform,
+          i).uploaded = FALSE;
+    g_object_set_qdata (program, PROGRAM_OWNER_QUARK, self);
+  }
+
+  return uniform;
 }
 
 void
-gst_3d_shader_upload_matrix (Gst3DShader * self, graphene_matrix_t * mat,
-    const gchar * name)
+gst_3d_shader_set_matrix (Gst3DShader * self, Gst3DUniform handle,
+    const graphene_matrix_t * mat)
 {
+  struct Gst3DShaderUniform *uniform = _get_active_uniform (self, handle);
+  if (!uniform || (uniform->uploaded
+          && memcmp (&uniform->value.matrix, mat, sizeof (*mat)) == 0))
+    return;
+
+  GstGLFuncs *gl = self->context->gl_vtable;
   GLfloat temp_matrix[16];
   graphene_matrix_to_float (mat, temp_matrix);
-  gst_gl_shader_set_uniform_matrix_4fv (self->shader, name, 1, GL_FALSE,
-      temp_matrix);
+  gl->UniformMatrix4fv (uniform->location, 1, GL_FALSE, temp_matrix);
+
+  uniform->value.matrix = *mat;
+  uniform->uploaded = TRUE;
 }
 
 void
-gst_3d_shader_upload_vec2 (Gst3DShader * self, graphene_vec2_t * vec,
-    const gchar * name)
+gst_3d_shader_set_vec2 (Gst3DShader * self, Gst3DUniform handle,
+    const graphene_vec2_t * vec)
 {
+  struct Gst3DShaderUniform *uniform = _get_active_uniform (self, handle);
   GLfloat temp_vec[2];
+
+  if (!uniform)
+    return;
+
   graphene_vec2_to_float (vec, temp_vec);
-  gst_gl_shader_set_uniform_2fv (self->shader, name, 1, temp_vec);
+  if (uniform->uploaded
+      && memcmp (uniform->value.floats, temp_vec, sizeof (temp_vec)) == 0)
+    return;
+
+  GstGLFuncs *gl = self->context->gl_vtable;
+  gl->Uniform2fv (uniform->location, 1, temp_vec);
+
+  memcpy (uniform->value.floats, temp_vec, sizeof (temp_vec));
+  uniform->uploaded = TRUE;
+}
+
+void
+gst_3d_shader_set_float (Gst3DShader * self, Gst3DUniform handle,
+    gfloat value)
+{
+  struct Gst3DShaderUniform *uniform = _get_active_uniform (self, handle);
+  if (!uniform || (uniform->uploaded && uniform->value.floats[0] == value))
+    return;
+
+  GstGLFuncs *gl = self->context->gl_vtable;
+  gl->Uniform1f (uniform->location, value);
+
+  uniform->value.floats[0] = value;
+  uniform->uploaded = TRUE;
+}
+
+void
+gst_3d_shader_set_int (Gst3DShader * self, Gst3DUniform handle, gint value)
+{
+  struct Gst3DShaderUniform *uniform = _get_active_uniform (self, handle);
+  if (!uniform || (uniform->uploaded && uniform->value.integer == value))
+    return;
+
+  GstGLFuncs *gl = self->context->gl_vtable;
+  gl->Uniform1i (uniform->location, value);
+
+  uniform->value.integer = value;
+  uniform->uploaded = TRUE;
+}
+
+void
+gst_3d_shader_upload_matrix (Gst3DShader * self, graphene_matrix_t * mat,
+    const gchar * name)
+{
+  gst_3d_shader_set_matrix (self, gst_3d_shader_get_uniform (self, name),
+      mat);
+}
+
+void
+gst_3d_shader_upload_vec2 (Gst3DShader * self, graphene_vec2_t * vec,
+    const gchar * name)
+{
+  gst_3d_shader_set_vec2 (self, gst_3d_shader_get_uniform (self, name), vec);
 }
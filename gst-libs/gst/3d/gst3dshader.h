@@ -28,6 +28,8 @@
 
 #include <graphene-gobject.h>
 
+#include "gst3dprogram.h"
+
 G_BEGIN_DECLS
 #define GST_3D_TYPE_SHADER            (gst_3d_shader_get_type ())
 #define GST_3D_SHADER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_3D_TYPE_SHADER, Gst3DShader))
@@ -38,6 +40,26 @@ G_BEGIN_DECLS
 typedef struct _Gst3DShader Gst3DShader;
 typedef struct _Gst3DShaderClass Gst3DShaderClass;
 
+/* Uniform handle from gst_3d_shader_get_uniform, valid for the lifetime
+ * of the shader, also when the program is built again. */
+typedef gint Gst3DUniform;
+
+struct Gst3DShaderUniform
+{
+  const gchar *name;
+  /* -1 when the program has no active uniform of that name */
+  GLint location;
+
+  /* last value uploaded to the program, compared before every upload */
+  gboolean uploaded;
+  union
+  {
+    graphene_matrix_t matrix;
+    gfloat floats[4];
+    gint integer;
+  } value;
+};
+
 struct _Gst3DShader
 {
   /*< private > */
@@ -45,9 +67,29 @@ struct _Gst3DShader
 
   GstGLContext *context;
 
-  GstGLShader *shader;
+  Gst3DProgram *program;
+  /* program queued by gst_3d_shader_queue_vert_frag, replacing program
+   * once linked, with its stages kept for the compile logs */
+  GLuint pending;
+  GLuint pending_stages[2];
+  gchar *pending_key;
+  gchar *pending_cache_key;
+  gsize pending_source_length;
+
   GLint attr_position;
   GLint attr_uv;
+
+  /* struct Gst3DShaderUniform, indexed by Gst3DUniform */
+  GArray *uniforms;
+  GHashTable *uniform_handles;
+  /* scene shaders in gpu/ read the view projection from the camera
+   * block and take a "model", screen space ones take a "mvp" */
+  Gst3DUniform mvp_uniform;
+  Gst3DUniform model_uniform;
+
+  /* linked program size, reported to gst3dmemory once per program since
+   * programs are shared through gst3dprogramcache */
+  gsize program_bytes;
 };
 
 struct _Gst3DShaderClass
@@ -59,6 +101,8 @@ Gst3DShader *gst_3d_shader_new (GstGLContext * context);
 GType gst_3d_shader_get_type (void);
 
 const char *gst_3d_shader_read (const char *file);
+gchar *gst_3d_shader_specialize (const gchar * src,
+    const gchar * const *defines);
 void gst_3d_shader_bind (Gst3DShader * self);
 /*
 void gst_3d_shader_disable_attribs (Gst3DShader * self);
@@ -66,16 +110,39 @@ void gst_3d_shader_enable_attribs (Gst3DShader * self);
 */	
 gboolean gst_3d_shader_from_vert_frag (Gst3DShader * self, const gchar * vertex,
     const gchar * fragment, GError **error);
+gboolean gst_3d_shader_from_variant (Gst3DShader * self, const gchar * vertex,
+    const gchar * fragment, const gchar * const *defines, GError ** error);
+gboolean gst_3d_shader_queue_vert_frag (Gst3DShader * self,
+    const gchar * vertex, const gchar * fragment, GError ** error);
+gboolean gst_3d_shader_queue_variant (Gst3DShader * self,
+    const gchar * vertex, const gchar * fragment,
+    const gchar * const *defines, GError ** error);
+gboolean gst_3d_shader_is_ready (Gst3DShader * self);
+gboolean gst_3d_shader_finish (Gst3DShader * self, GError ** error);
 void gst_3d_shader_delete (Gst3DShader * self);
 
 void gst_3d_shader_upload_matrix (Gst3DShader * self, graphene_matrix_t * mat,
     const gchar * name);
 void gst_3d_shader_upload_vec2 (Gst3DShader * self, graphene_vec2_t * vec,
     const gchar * name);
+
+Gst3DUniform gst_3d_shader_get_uniform (Gst3DShader * self,
+    const gchar * name);
+void gst_3d_shader_set_matrix (Gst3DShader * self, Gst3DUniform uniform,
+    const graphene_matrix_t * mat);
+void gst_3d_shader_set_vec2 (Gst3DShader * self, Gst3DUniform uniform,
+    const graphene_vec2_t * vec);
+void gst_3d_shader_set_float (Gst3DShader * self, Gst3DUniform uniform,
+    gfloat value);
+void gst_3d_shader_set_int (Gst3DShader * self, Gst3DUniform uniform,
+    gint value);
     
 Gst3DShader *
 gst_3d_shader_new_vert_frag (GstGLContext * context, const gchar * vertex,
     const gchar * fragment, GError **error);
+Gst3DShader *
+gst_3d_shader_new_variant (GstGLContext * context, const gchar * vertex,
+    const gchar * fragment, const gchar * const *defines, GError ** error);
 
 G_END_DECLS
 #endif /* __GST_3D_SHADER_H__ */
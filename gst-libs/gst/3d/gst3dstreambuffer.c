@@ -0,0 +1,356 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Ring of GST_3D_STREAM_BUFFER_SEGMENTS segments in one GL buffer for
+ * geometry that changes every frame. Each map writes to the next segment,
+ * while the GPU may still read the previous ones. A fence is inserted when
+ * a segment is left and waited on before it is written again, so updates
+ * neither allocate nor stall on implicit synchronization.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gl/gl.h>
+#include <gst/gl/gstglfuncs.h>
+
+#include "gst3dstreambuffer.h"
+#include "gst3dmemory.h"
+
+#define GST_CAT_DEFAULT gst_3d_stream_buffer_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+/* keeps attribute offsets aligned for every component type */
+#define SEGMENT_ALIGNMENT 256
+#define MIN_SEGMENT_SIZE 4096
+
+#define WAIT_TIMEOUT_NS 1000000
+
+struct _Gst3DStreamBuffer
+{
+  GstGLContext *context;
+  GLenum target;
+  Gst3DStreamBufferMode mode;
+
+  GLuint id;
+  gsize segment_size;
+  guint segment;
+  gboolean written;
+  GLsync fences[GST_3D_STREAM_BUFFER_SEGMENTS];
+
+  guint8 *persistent;
+  guint8 *staging;
+
+  /* GL storage reported to gst3dmemory */
+  gsize gpu_bytes;
+  gsize mapped_size;
+
+  guint stalls;
+};
+
+static void
+_init_debug (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    GST_DEBUG_CATEGORY_INIT (gst_3d_stream_buffer_debug, "3dstreambuffer", 0,
+        "stream buffer");
+    g_once_init_leave (&initialized, 1);
+  }
+}
+
+static gsize
+_segment_size_for (gsize size)
+{
+  gsize segment_size = MIN_SEGMENT_SIZE;
+  while (segment_size < size)
+    segment_size <<= 1;
+  return segment_size;
+}
+
+static void
+_delete_fences (Gst3DStreamBuffer * self)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  for (guint i = 0; i < GST_3D_STREAM_BUFFER_SEGMENTS; i++) {
+    if (self->fences[i]) {
+      gl->DeleteSync (self->fences[i]);
+      self->fences[i] = NULL;
+    }
+  }
+}
+
+static void
+_release_storage (Gst3DStreamBuffer * self)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  _delete_fences (self);
+
+  if (self->persistent) {
+    gl->BindBuffer (self->target, self->id);
+    gl->UnmapBuffer (self->target);
+    self->persistent = NULL;
+  }
+
+  if (self->id) {
+    gl->DeleteBuffers (1, &self->id);
+    self->id = 0;
+  }
+
+  g_free (self->staging);
+  self->staging = NULL;
+
+  gst_3d_memory_release (self->context, GST_3D_MEMORY_BUFFER, self->gpu_bytes);
+  self->gpu_bytes = 0;
+}
+
+static void
+_allocate_storage (Gst3DStreamBuffer * self, gsize size)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  self->segment_size = _segment_size_for (size);
+  self->segment = 0;
+  self->written = FALSE;
+
+  gl->GenBuffers (1, &self->id);
+  gl->BindBuffer (self->target, self->id);
+
+  gsize total = self->segment_size * GST_3D_STREAM_BUFFER_SEGMENTS;
+
+  switch (self->mode) {
+    case GST_3D_STREAM_BUFFER_MODE_PERSISTENT:{
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+          | GL_MAP_COHERENT_BIT;
+      gl->BufferStorage (self->target, total, NULL, flags);
+      self->persistent = gl->MapBufferRange (self->target, 0, total, flags);
+      self->gpu_bytes = total;
+      break;
+    }
+    case GST_3D_STREAM_BUFFER_MODE_MAP_RANGE:
+      gl->BufferData (self->target, total, NULL, GL_STREAM_DRAW);
+      self->gpu_bytes = total;
+      break;
+    case GST_3D_STREAM_BUFFER_MODE_ORPHAN:
+      gl->BufferData (self->target, self->segment_size, NULL, GL_STREAM_DRAW);
+      self->staging = g_malloc (self->segment_size);
+      /* orphaned storage is recycled by the driver, count one segment */
+      self->gpu_bytes = self->segment_size;
+      break;
+  }
+
+  gst_3d_memory_alloc (self->context, GST_3D_MEMORY_BUFFER, self->gpu_bytes);
+
+  GST_DEBUG ("allocated %" G_GSIZE_FORMAT " byte segments for buffer %d, "
+      "mode %d", self->segment_size, self->id, self->mode);
+}
+
+static gboolean
+_mode_supported (GstGLContext * context, Gst3DStreamBufferMode mode)
+{
+  GstGLFuncs *gl = context->gl_vtable;
+
+  switch (mode) {
+    case GST_3D_STREAM_BUFFER_MODE_PERSISTENT:
+      return gl->BufferStorage && gl->MapBufferRange && gl->FenceSync;
+    case GST_3D_STREAM_BUFFER_MODE_MAP_RANGE:
+      return gl->MapBufferRange && gl->FenceSync;
+    case GST_3D_STREAM_BUFFER_MODE_ORPHAN:
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* @target is the GL binding point, for GL_ELEMENT_ARRAY_BUFFER the VAO
+ * that should reference the buffer has to be bound during map and unmap.
+ * @size is the initial segment size, segments grow when needed. Uses the
+ * first mode of Gst3DStreamBufferMode the context supports. */
+Gst3DStreamBuffer *
+gst_3d_stream_buffer_new (GstGLContext * context, guint target, gsize size)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+
+  Gst3DStreamBufferMode mode = GST_3D_STREAM_BUFFER_MODE_PERSISTENT;
+  while (!_mode_supported (context, mode))
+    mode++;
+
+  return gst_3d_stream_buffer_new_with_mode (context, target, size, mode);
+}
+
+/* Like gst_3d_stream_buffer_new, with a fixed @mode. Returns NULL if the
+ * context does not support @mode. */
+Gst3DStreamBuffer *
+gst_3d_stream_buffer_new_with_mode (GstGLContext * context, guint target,
+    gsize size, Gst3DStreamBufferMode mode)
+{
+  g_return_val_if_fail (GST_IS_GL_CONTEXT (context), NULL);
+
+  _init_debug ();
+
+  if (!_mode_supported (context, mode)) {
+    GST_DEBUG ("stream buffer mode %d is not supported", mode);
+    return NULL;
+  }
+
+  Gst3DStreamBuffer *self = g_new0 (Gst3DStreamBuffer, 1);
+  self->context = gst_object_ref (context);
+  self->target = target;
+  self->mode = mode;
+
+  _allocate_storage (self, size);
+
+  return self;
+}
+
+void
+gst_3d_stream_buffer_free (Gst3DStreamBuffer * self)
+{
+  if (!self)
+    return;
+  _release_storage (self);
+  gst_object_unref (self->context);
+  g_free (self);
+}
+
+static void
+_wait_segment (Gst3DStreamBuffer * self, guint segment)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+  GLsync fence = self->fences[segment];
+
+  if (!fence)
+    return;
+
+  GLenum result;
+  do {
+    result = gl->ClientWaitSync (fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+        WAIT_TIMEOUT_NS);
+  } while (result == GL_TIMEOUT_EXPIRED);
+
+  if (result == GL_CONDITION_SATISFIED) {
+    self->stalls++;
+    GST_LOG ("waited for segment %d of buffer %d", segment, self->id);
+  }
+
+  gl->DeleteSync (fence);
+  self->fences[segment] = NULL;
+}
+
+/* Returns a write only pointer to @size bytes of the next free segment.
+ * @offset receives the byte offset of the segment in the GL buffer, to be
+ * used for attribute pointers and index offsets. */
+gpointer
+gst_3d_stream_buffer_map (Gst3DStreamBuffer * self, gsize size,
+    gsize * offset)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  if (self->written) {
+    if (self->mode != GST_3D_STREAM_BUFFER_MODE_ORPHAN) {
+      self->fences[self->segment] =
+          gl->FenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      self->segment = (self->segment + 1) % GST_3D_STREAM_BUFFER_SEGMENTS;
+    }
+    self->written = FALSE;
+  }
+
+  if (size > self->segment_size) {
+    /* GL keeps the old storage alive until pending draws are done */
+    _release_storage (self);
+    _allocate_storage (self, size);
+  }
+
+  _wait_segment (self, self->segment);
+
+  self->written = TRUE;
+  self->mapped_size = size;
+  *offset = self->mode == GST_3D_STREAM_BUFFER_MODE_ORPHAN ? 0 :
+      self->segment * self->segment_size;
+
+  switch (self->mode) {
+    case GST_3D_STREAM_BUFFER_MODE_PERSISTENT:
+      return self->persistent + *offset;
+    case GST_3D_STREAM_BUFFER_MODE_MAP_RANGE:
+      gl->BindBuffer (self->target, self->id);
+      return gl->MapBufferRange (self->target, *offset, size,
+          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+          | GL_MAP_UNSYNCHRONIZED_BIT);
+    case GST_3D_STREAM_BUFFER_MODE_ORPHAN:
+      return self->staging;
+  }
+
+  return NULL;
+}
+
+void
+gst_3d_stream_buffer_unmap (Gst3DStreamBuffer * self)
+{
+  GstGLFuncs *gl = self->context->gl_vtable;
+
+  switch (self->mode) {
+    case GST_3D_STREAM_BUFFER_MODE_PERSISTENT:
+      /* coherent mapping, nothing to flush */
+      break;
+    case GST_3D_STREAM_BUFFER_MODE_MAP_RANGE:
+      gl->BindBuffer (self->target, self->id);
+      gl->UnmapBuffer (self->target);
+      break;
+    case GST_3D_STREAM_BUFFER_MODE_ORPHAN:
+      gl->BindBuffer (self->target, self->id);
+      gl->BufferData (self->target, self->segment_size, NULL, GL_STREAM_DRAW);
+      gl->BufferSubData (self->target, 0, self->mapped_size, self->staging);
+      break;
+  }
+}
+
+guint
+gst_3d_stream_buffer_get_id (Gst3DStreamBuffer * self)
+{
+  return self->id;
+}
+
+Gst3DStreamBufferMode
+gst_3d_stream_buffer_get_mode (Gst3DStreamBuffer * self)
+{
+  return self->mode;
+}
+
+/* Number of maps that had to wait for the GPU, a growing count means the
+ * ring is too short for the frame latency. */
+guint
+gst_3d_stream_buffer_get_stalls (Gst3DStreamBuffer * self)
+{
+  return self->stalls;
+}
@@ -0,0 +1,58 @@
+/*
+ * GStreamer Plugins VR
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_3D_STREAM_BUFFER_H__
+#define __GST_3D_STREAM_BUFFER_H__
+
+#include <gst/gst.h>
+#include <gst/gl/gstgl_fwd.h>
+
+G_BEGIN_DECLS
+
+#define GST_3D_STREAM_BUFFER_SEGMENTS 3
+
+typedef enum
+{
+  /* ARB_buffer_storage, mapped once for the lifetime of the buffer */
+  GST_3D_STREAM_BUFFER_MODE_PERSISTENT,
+  /* unsynchronized MapBufferRange of the segment, guarded by fences */
+  GST_3D_STREAM_BUFFER_MODE_MAP_RANGE,
+  /* no fences, orphan the storage and upload from a staging copy */
+  GST_3D_STREAM_BUFFER_MODE_ORPHAN,
+} Gst3DStreamBufferMode;
+
+typedef struct _Gst3DStreamBuffer Gst3DStreamBuffer;
+
+Gst3DStreamBuffer *gst_3d_stream_buffer_new (GstGLContext * context,
+    guint target, gsize size);
+Gst3DStreamBuffer *gst_3d_stream_buffer_new_with_mode (GstGLContext * context,
+    guint target, gsize size, Gst3DStreamBufferMode mode);
+void gst_3d_stream_buffer_free (Gst3DStreamBuffer * self);
+
+gpointer gst_3d_stream_buffer_map (Gst3DStreamBuffer * self, gsize size,
+    gsize * offset);
+void gst_3d_stream_buffer_unmap (Gst3DStreamBuffer * self);
+
+guint gst_3d_stream_buffer_get_id (Gst3DStreamBuffer * self);
+Gst3DStreamBufferMode gst_3d_stream_buffer_get_mode (Gst3DStreamBuffer * self);
+guint gst_3d_stream_buffer_get_stalls (Gst3DStreamBuffer * self);
+
+G_END_DECLS
+#endif /* __GST_3D_STREAM_BUFFER_H__ */
@@ -38,6 +38,9 @@
 #endif
 
 #include "gsthmdwarp.h"
+#include "gst/3d/gst3dmeshcache.h"
+#include "gst/3d/gst3dhmd.h"
+#include "gst/3d/gst3dglstate.h"
 
 #include <gst/gl/gstglapi.h>
 #include <graphene-gobject.h>
@@ -51,6 +54,7 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 enum
 {
   PROP_0,
+  PROP_MONO,
 };
 
 #define DEBUG_INIT \
@@ -67,6 +71,7 @@ static void gst_hmd_warp_get_property (GObject * object, guint prop_id,
 static gboolean gst_hmd_warp_set_caps (GstGLFilter * filter,
     GstCaps * incaps, GstCaps * outcaps);
 
+static gboolean gst_hmd_warp_gl_start (GstGLBaseFilter * filter);
 static void gst_hmd_warp_gl_stop (GstGLBaseFilter * filter);
 static gboolean gst_hmd_warp_stop (GstBaseTransform * trans);
 static gboolean gst_hmd_warp_init_gl (GstGLFilter * filter);
@@ -89,6 +94,13 @@ gst_hmd_warp_class_init (GstHmdWarpClass * klass)
   gobject_class->set_property = gst_hmd_warp_set_property;
   gobject_class->get_property = gst_hmd_warp_get_property;
 
+  g_object_class_install_property (gobject_class, PROP_MONO,
+      g_param_spec_boolean ("mono", "Mono",
+          "Show a mono input to both eyes instead of side by side eyes, "
+          "applied when the element starts", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  GST_GL_BASE_FILTER_CLASS (klass)->gl_start = gst_hmd_warp_gl_start;
   GST_GL_BASE_FILTER_CLASS (klass)->gl_stop = gst_hmd_warp_gl_stop;
 
   gst_gl_filter_add_rgba_pad_templates (GST_GL_FILTER_CLASS (klass));
@@ -112,13 +124,19 @@ gst_hmd_warp_init (GstHmdWarp * self)
   self->shader = NULL;
   self->in_tex = 0;
   self->render_plane = NULL;
+  self->mono = FALSE;
 }
 
 static void
 gst_hmd_warp_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
 {
+  GstHmdWarp *self = GST_HMD_WARP (object);
+
   switch (prop_id) {
+    case PROP_MONO:
+      self->mono = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -130,7 +148,12 @@ static void
 gst_hmd_warp_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
+  GstHmdWarp *self = GST_HMD_WARP (object);
+
   switch (prop_id) {
+    case PROP_MONO:
+      g_value_set_boolean (value, self->mono);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -160,6 +183,88 @@ gst_hmd_warp_set_caps (GstGLFilter * filter, GstCaps * incaps,
   return TRUE;
 }
 
+static gchar *
+_vec_define (const gchar * name, const gfloat * v, guint n)
+{
+  GString *define = g_string_new (NULL);
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append_printf (define, "%s vec%u(", name, n);
+  for (guint i = 0; i < n; i++) {
+    if (i)
+      g_string_append (define, ", ");
+    /* GLSL wants a dot regardless of the locale */
+    g_string_append (define, g_ascii_formatd (buf, sizeof (buf), "%f", v[i]));
+  }
+  g_string_append_c (define, ')');
+
+  return g_string_free (define, FALSE);
+}
+
+/* The distortion of the HMD is compiled into the shader as constants,
+ * the defaults of warp.frag are kept without a device. The HMD is the
+ * one shared with the compositor camera, so the device is not opened
+ * twice. */
+static gchar **
+_warp_defines (GstHmdWarp * self)
+{
+  GPtrArray *defines = g_ptr_array_new ();
+  Gst3DHmd *hmd = gst_3d_hmd_get_default ();
+  gfloat v[2];
+
+  if (hmd->device) {
+    g_ptr_array_add (defines, _vec_define ("HMD_DISTORTION_K",
+            hmd->distortion_k, 4));
+    graphene_vec2_to_float (&hmd->left_lens_center, v);
+    g_ptr_array_add (defines, _vec_define ("HMD_LENS_CENTER_LEFT", v, 2));
+    graphene_vec2_to_float (&hmd->right_lens_center, v);
+    g_ptr_array_add (defines, _vec_define ("HMD_LENS_CENTER_RIGHT", v, 2));
+    graphene_vec2_to_float (&hmd->warp_scale, v);
+    g_ptr_array_add (defines, _vec_define ("HMD_WARP_SCALE", v, 2));
+    graphene_vec2_to_float (&hmd->warp_scale_in, v);
+    g_ptr_array_add (defines, _vec_define ("HMD_WARP_SCALE_IN", v, 2));
+  }
+  gst_object_unref (hmd);
+
+  if (self->mono)
+    g_ptr_array_add (defines, g_strdup ("STEREO_MONO"));
+
+  g_ptr_array_add (defines, NULL);
+  return (gchar **) g_ptr_array_free (defines, FALSE);
+}
+
+/* Queues the shader as soon as the context exists, it is compiled while
+ * the caps are negotiated and picked up by the first draw it is ready
+ * for. */
+static gboolean
+gst_hmd_warp_gl_start (GstGLBaseFilter * filter)
+{
+  GstHmdWarp *self = GST_HMD_WARP (filter);
+  GError *error = NULL;
+
+  if (!GST_GL_BASE_FILTER_CLASS (parent_class)->gl_start (filter))
+    return FALSE;
+
+  if (!self->shader) {
+    gchar **defines = _warp_defines (self);
+    self->shader = gst_3d_shader_new (filter->context);
+    gboolean queued = gst_3d_shader_queue_variant (self->shader,
+        "plane_uv.vert", "warp.frag", (const gchar * const *) defines,
+        &error);
+    g_strfreev (defines);
+    if (!queued) {
+      GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("%s", error->message),
+          (NULL));
+      g_clear_error (&error);
+      gst_object_unref (self->shader);
+      self->shader = NULL;
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
 static void
 gst_hmd_warp_gl_stop (GstGLBaseFilter * filter)
 {
@@ -187,36 +292,40 @@ gst_hmd_warp_stop (GstBaseTransform * trans)
 static gboolean
 gst_hmd_warp_init_gl (GstGLFilter * filter)
 {
-  GstHmdWarp *self = GST_HMD_WARP (filter);
-  GstGLContext *context = GST_GL_BASE_FILTER (self)->context;
+  GstGLContext *context = GST_GL_BASE_FILTER (filter)->context;
   GstGLFuncs *gl = context->gl_vtable;
-  GError *error = NULL;
 
-  if (!self->render_plane) {
-    self->shader = gst_3d_shader_new (context);
-    if (!gst_3d_shader_from_vert_frag (self->shader, "mvp_uv.vert", "warp.frag", &error))
-      goto handle_error;
+  gl->ClearColor (0.f, 0.f, 0.f, 0.f);
 
-    gst_3d_shader_bind (self->shader);
+  return TRUE;
+}
 
-    self->render_plane = gst_3d_mesh_new_plane (context, self->aspect);
+/* Sets up the plane once the program queued in gl_start is needed. */
+static gboolean
+_init_plane (GstHmdWarp * self, GstGLContext * context)
+{
+  GstGLFuncs *gl = context->gl_vtable;
+  GError *error = NULL;
 
-    gl->ClearColor (0.f, 0.f, 0.f, 0.f);
-    gl->ActiveTexture (GL_TEXTURE0);
-    gst_gl_shader_set_uniform_1i (self->shader->shader, "texture", 0);
+  if (!gst_3d_shader_finish (self->shader, &error)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("%s", error->message),
+        (NULL));
+    g_clear_error (&error);
+    return FALSE;
+  }
 
-    gst_gl_shader_use (self->shader->shader);
-    gst_3d_shader_upload_vec2 (self->shader, &self->screen_size, "screen_size");
+  self->render_plane = gst_3d_mesh_cache_get_plane (context, self->aspect);
 
-    gst_3d_mesh_bind_shader (self->render_plane, self->shader);
-  }
-  return TRUE;
+  gst_3d_shader_bind (self->shader);
 
-handle_error:
-  GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("%s", error->message), (NULL));
-  g_clear_error (&error);
+  gl->ActiveTexture (GL_TEXTURE0);
+  gst_3d_shader_set_int (self->shader,
+      gst_3d_shader_get_uniform (self->shader, "texture"), 0);
+  gst_3d_shader_upload_vec2 (self->shader, &self->screen_size, "screen_size");
 
-  return FALSE;
+  gst_3d_mesh_bind_shader (self->render_plane, self->shader);
+
+  return TRUE;
 }
 
 static gboolean
@@ -238,21 +347,33 @@ gst_hmd_warp_draw (gpointer this)
   GstGLContext *context = GST_GL_BASE_FILTER (this)->context;
   GstGLFuncs *gl = context->gl_vtable;
 
+  /* frames stay empty while the driver is still compiling the shader */
+  if (!self->render_plane) {
+    if (!gst_3d_shader_is_ready (self->shader)) {
+      GST_LOG_OBJECT (self, "shader not ready, skipping the frame");
+      gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      return TRUE;
+    }
+    if (!_init_plane (self, context))
+      return FALSE;
+  }
+
+  gst_3d_gl_state_begin (context);
   gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  gst_gl_shader_use (self->shader->shader);
-  gl->BindTexture (GL_TEXTURE_2D, self->in_tex->tex_id);
+  gst_3d_shader_bind (self->shader);
+  gst_3d_gl_state_bind_texture (context, 0, self->in_tex->tex_id);
 
   graphene_matrix_t projection_ortho;
   graphene_matrix_init_ortho (&projection_ortho, -self->aspect, self->aspect,
       -1.0, 1.0, -1.0, 1.0);
-  gst_3d_shader_upload_matrix (self->shader, &projection_ortho, "mvp");
+  gst_3d_shader_set_matrix (self->shader, self->shader->mvp_uniform,
+      &projection_ortho);
   gst_3d_mesh_bind (self->render_plane);
   gst_3d_mesh_draw (self->render_plane);
 
-  gl->BindVertexArray (0);
-  gl->BindTexture (GL_TEXTURE_2D, 0);
-  gst_gl_context_clear_shader (context);
+  gst_3d_gl_state_reset (context);
+  gst_3d_gl_state_end (context);
 
   return TRUE;
 }
@@ -47,6 +47,9 @@ struct _GstHmdWarp
   graphene_vec2_t screen_size;
   Gst3DMesh *render_plane;
   float aspect;
+
+  /* compiled into the warp shader variant */
+  gboolean mono;
 };
 
 struct _GstHmdWarpClass
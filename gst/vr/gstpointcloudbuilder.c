@@ -40,6 +40,8 @@
 #include "gstpointcloudbuilder.h"
 #include "gst/3d/gst3dcamera_arcball.h"
 #include "gst/3d/gst3dscene.h"
+#include "gst/3d/gst3dmemory.h"
+#include "gst/3d/gst3dglstate.h"
 
 #include <gst/gl/gstglapi.h>
 #include <graphene-gobject.h>
@@ -54,6 +56,8 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 enum
 {
   PROP_0,
+  PROP_GPU_MEMORY,
+  PROP_GPU_MEMORY_BUDGET,
 };
 
 #define DEBUG_INIT \
@@ -71,7 +75,10 @@ static gboolean gst_point_cloud_builder_set_caps (GstGLFilter * filter,
     GstCaps * incaps, GstCaps * outcaps);
 static gboolean gst_point_cloud_builder_src_event (GstBaseTransform * trans,
     GstEvent * event);
+static gboolean gst_point_cloud_builder_query (GstBaseTransform * trans,
+    GstPadDirection direction, GstQuery * query);
 
+static gboolean gst_point_cloud_builder_gl_start (GstGLBaseFilter * filter);
 static void gst_point_cloud_builder_gl_stop (GstGLBaseFilter * filter);
 static gboolean gst_point_cloud_builder_stop (GstBaseTransform * trans);
 static gboolean gst_point_cloud_builder_init_scene (GstGLFilter * filter);
@@ -95,7 +102,21 @@ gst_point_cloud_builder_class_init (GstPointCloudBuilderClass * klass)
   gobject_class->get_property = gst_point_cloud_builder_get_property;
 
   base_transform_class->src_event = gst_point_cloud_builder_src_event;
+  base_transform_class->query = gst_point_cloud_builder_query;
 
+  g_object_class_install_property (gobject_class, PROP_GPU_MEMORY,
+      g_param_spec_uint64 ("gpu-memory", "GPU memory",
+          "Bytes of GPU memory held by Gst3D objects on the GL context",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_GPU_MEMORY_BUDGET,
+      g_param_spec_uint64 ("gpu-memory-budget", "GPU memory budget",
+          "Warn when Gst3D objects on the GL context exceed this many "
+          "bytes (0 = unlimited)", 0, G_MAXUINT64, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  GST_GL_BASE_FILTER_CLASS (klass)->gl_start =
+      gst_point_cloud_builder_gl_start;
   GST_GL_BASE_FILTER_CLASS (klass)->gl_stop = gst_point_cloud_builder_gl_stop;
 
   gst_gl_filter_add_rgba_pad_templates (GST_GL_FILTER_CLASS (klass));
@@ -121,6 +142,7 @@ gst_point_cloud_builder_init (GstPointCloudBuilder * self)
   self->render_mode = GL_TRIANGLE_STRIP;
   self->in_tex = 0;
   self->mesh = NULL;
+  self->camera_buffer = NULL;
   self->camera = (gst_3d_camera_arcball_new ());
   (self->camera)->theta = 1.6 * M_PI;
   (self->camera)->phi = 2.67 * M_PI;
@@ -134,14 +156,26 @@ gst_point_cloud_builder_init (GstPointCloudBuilder * self)
   self->eye_width = 1;
   self->eye_height = 1;
 
+  self->grid_width = 512;
+  self->grid_height = 424;
+
   self->default_fbo = 0;
+  self->gpu_memory_budget = 0;
 }
 
 static void
 gst_point_cloud_builder_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
 {
+  GstPointCloudBuilder *self = GST_POINT_CLOUD_BUILDER (object);
+  GstGLContext *context = GST_GL_BASE_FILTER (object)->context;
+
   switch (prop_id) {
+    case PROP_GPU_MEMORY_BUDGET:
+      self->gpu_memory_budget = g_value_get_uint64 (value);
+      if (context)
+        gst_3d_memory_set_budget (context, self->gpu_memory_budget);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -153,7 +187,17 @@ static void
 gst_point_cloud_builder_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
+  GstPointCloudBuilder *self = GST_POINT_CLOUD_BUILDER (object);
+  GstGLContext *context = GST_GL_BASE_FILTER (object)->context;
+
   switch (prop_id) {
+    case PROP_GPU_MEMORY:
+      g_value_set_uint64 (value,
+          context ? gst_3d_memory_get_total (context) : 0);
+      break;
+    case PROP_GPU_MEMORY_BUDGET:
+      g_value_set_uint64 (value, self->gpu_memory_budget);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -173,6 +217,9 @@ gst_point_cloud_builder_set_caps (GstGLFilter * filter, GstCaps * incaps,
   self->eye_width = GST_VIDEO_INFO_WIDTH (&filter->out_info);
   self->eye_height = GST_VIDEO_INFO_HEIGHT (&filter->out_info);
 
+  self->grid_width = GST_VIDEO_INFO_WIDTH (&filter->in_info);
+  self->grid_height = GST_VIDEO_INFO_HEIGHT (&filter->in_info);
+
   self->caps_change = TRUE;
 
   return TRUE;
@@ -199,6 +246,45 @@ gst_point_cloud_builder_src_event (GstBaseTransform * trans, GstEvent * event)
   return GST_BASE_TRANSFORM_CLASS (parent_class)->src_event (trans, event);
 }
 
+static gboolean
+gst_point_cloud_builder_query (GstBaseTransform * trans,
+    GstPadDirection direction, GstQuery * query)
+{
+  if (gst_3d_memory_handle_query (GST_GL_BASE_FILTER (trans)->context, query))
+    return TRUE;
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->query (trans, direction,
+      query);
+}
+
+/* Queues the shader as soon as the context exists, it is compiled while
+ * the caps are negotiated and picked up by the first draw it is ready
+ * for. */
+static gboolean
+gst_point_cloud_builder_gl_start (GstGLBaseFilter * filter)
+{
+  GstPointCloudBuilder *self = GST_POINT_CLOUD_BUILDER (filter);
+  GError *error = NULL;
+
+  if (!GST_GL_BASE_FILTER_CLASS (parent_class)->gl_start (filter))
+    return FALSE;
+
+  if (!self->shader) {
+    self->shader = gst_3d_shader_new (filter->context);
+    if (!gst_3d_shader_queue_vert_frag (self->shader, "points_grid.vert",
+            "points.frag", &error)) {
+      GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("%s", error->message),
+          (NULL));
+      g_clear_error (&error);
+      gst_object_unref (self->shader);
+      self->shader = NULL;
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
 static void
 gst_point_cloud_builder_gl_stop (GstGLBaseFilter * filter)
 {
@@ -212,6 +298,8 @@ gst_point_cloud_builder_gl_stop (GstGLBaseFilter * filter)
     gst_object_unref (self->mesh);
     self->mesh = NULL;
   }
+  gst_3d_camera_buffer_free (self->camera_buffer);
+  self->camera_buffer = NULL;
 
   GST_GL_BASE_FILTER_CLASS (parent_class)->gl_stop (filter);
 }
@@ -234,30 +322,39 @@ gst_point_cloud_builder_init_scene (GstGLFilter * filter)
   GstPointCloudBuilder *self = GST_POINT_CLOUD_BUILDER (filter);
   GstGLContext *context = GST_GL_BASE_FILTER (self)->context;
   GstGLFuncs *gl = context->gl_vtable;
-  gboolean ret = TRUE;
+
+  if (self->gpu_memory_budget)
+    gst_3d_memory_set_budget (context, self->gpu_memory_budget);
+
+  gl->ClearColor (0.f, 0.f, 0.f, 0.f);
+
+  return TRUE;
+}
+
+/* Creates the grid once the program queued in gl_start is needed. */
+static gboolean
+_init_mesh (GstPointCloudBuilder * self, GstGLContext * context)
+{
+  GstGLFuncs *gl = context->gl_vtable;
   GError *error = NULL;
 
-  if (!self->mesh) {
-    GError *error = NULL;
-
-    self->shader = gst_3d_shader_new_vert_frag (context, "points.vert",
-        "points.frag", &error);
-    if (self->shader == NULL)
-      goto handle_error;
-    gst_3d_shader_bind (self->shader);
-    self->mesh = gst_3d_mesh_new_point_plane (context, 512, 424);
-    gst_3d_mesh_bind_shader (self->mesh, self->shader);
-
-    gl->ClearColor (0.f, 0.f, 0.f, 0.f);
-    gl->ActiveTexture (GL_TEXTURE0);
-    gst_gl_shader_set_uniform_1i (self->shader->shader, "texture", 0);
+  if (!gst_3d_shader_finish (self->shader, &error)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("%s", error->message),
+        (NULL));
+    g_clear_error (&error);
+    return FALSE;
   }
-  return ret;
 
-handle_error:
-  GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("%s", error->message), (NULL));
-  g_clear_error (&error);
-  return FALSE;
+  self->mesh = gst_3d_mesh_new_procedural_grid (context, self->grid_width,
+      self->grid_height);
+  self->camera_buffer = gst_3d_camera_buffer_new (context);
+  gst_3d_mesh_bind_shader (self->mesh, self->shader);
+
+  gl->ActiveTexture (GL_TEXTURE0);
+  gst_3d_shader_set_int (self->shader,
+      gst_3d_shader_get_uniform (self->shader, "texture"), 0);
+
+  return TRUE;
 }
 
 static gboolean
@@ -279,21 +376,41 @@ gst_point_cloud_builder_draw (gpointer this)
   GstGLContext *context = GST_GL_BASE_FILTER (this)->context;
   GstGLFuncs *gl = context->gl_vtable;
 
+  /* frames stay empty while the driver is still compiling the shader */
+  if (!self->mesh) {
+    if (!gst_3d_shader_is_ready (self->shader)) {
+      GST_LOG_OBJECT (self, "shader not ready, skipping the frame");
+      gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      return TRUE;
+    }
+    if (!_init_mesh (self, context))
+      return FALSE;
+  }
+
+  gst_3d_gl_state_begin (context);
   gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  gst_gl_shader_use (self->shader->shader);
-  gl->BindTexture (GL_TEXTURE_2D, self->in_tex->tex_id);
+  gst_3d_shader_bind (self->shader);
+  gst_3d_gl_state_bind_texture (context, 0, self->in_tex->tex_id);
 
-  gst_3d_camera_update_view (GST_3D_CAMERA (self->camera));
-  gst_3d_shader_upload_matrix (self->shader, &GST_3D_CAMERA (self->camera)->mvp,
-      "mvp");
+  Gst3DCamera *camera = GST_3D_CAMERA (self->camera);
+  gst_3d_camera_update_view (camera);
+  gst_3d_camera_buffer_set_eye (self->camera_buffer, 0, &camera->view,
+      &camera->projection);
+  gst_3d_camera_buffer_upload (self->camera_buffer);
+  gst_3d_camera_buffer_bind (self->camera_buffer, 0);
+
+  if (self->caps_change) {
+    gst_3d_mesh_set_grid_size (self->mesh, self->grid_width,
+        self->grid_height);
+    self->caps_change = FALSE;
+  }
 
   gst_3d_mesh_bind (self->mesh);
   gst_3d_mesh_draw_arrays (self->mesh);
 
-  gl->BindVertexArray (0);
-  gl->BindTexture (GL_TEXTURE_2D, 0);
-  gst_gl_context_clear_shader (context);
+  gst_3d_gl_state_reset (context);
+  gst_3d_gl_state_end (context);
 
   return TRUE;
 }
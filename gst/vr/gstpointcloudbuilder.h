@@ -26,6 +26,7 @@
 #include "gst/3d/gst3dmesh.h"
 #include "gst/3d/gst3dcamera_arcball.h"
 #include "gst/3d/gst3dshader.h"
+#include "gst/3d/gst3dcamerabuffer.h"
 #include "gst/3d/gst3drenderer.h"
 
 G_BEGIN_DECLS
@@ -47,6 +48,10 @@ struct _GstPointCloudBuilder
   guint eye_width;
   guint eye_height;
 
+  /* size of the depth input, one point per texel */
+  guint grid_width;
+  guint grid_height;
+
   GLenum render_mode;
 
   gboolean caps_change;
@@ -55,12 +60,15 @@ struct _GstPointCloudBuilder
 
   Gst3DShader *shader;
   Gst3DCameraArcball *camera;
+  Gst3DCameraBuffer *camera_buffer;
 
   GstPad *srcpad;
 
   GLuint left_color_tex, left_fbo;
   GLuint right_color_tex, right_fbo;
   GLint default_fbo;
+
+  guint64 gpu_memory_budget;
 };
 
 struct _GstPointCloudBuilderClass
@@ -46,6 +46,9 @@
 #include "gst/3d/gst3dnode.h"
 #include "gst/3d/gst3dscene.h"
 #include "gst/3d/gst3dcamera_arcball.h"
+#include "gst/3d/gst3dmemory.h"
+#include "gst/3d/gst3dglstate.h"
+#include "gst/3d/gst3dgeometry.h"
 
 #ifdef HAVE_OPENHMD
 #include "gst/3d/gst3dcamera_hmd.h"
@@ -59,8 +62,13 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 enum
 {
   PROP_0,
+  PROP_GPU_MEMORY,
+  PROP_GPU_MEMORY_BUDGET,
+  PROP_SPHERE_DETAIL,
 };
 
+#define SPHERE_RADIUS 800.0
+
 #define DEBUG_INIT \
     GST_DEBUG_CATEGORY_INIT (gst_vr_compositor_debug, "vrcompositor", 0, "vrcompositor element");
 
@@ -76,9 +84,12 @@ static gboolean gst_vr_compositor_set_caps (GstGLFilter * filter,
     GstCaps * incaps, GstCaps * outcaps);
 static gboolean gst_vr_compositor_src_event (GstBaseTransform * trans,
     GstEvent * event);
+static gboolean gst_vr_compositor_query (GstBaseTransform * trans,
+    GstPadDirection direction, GstQuery * query);
 
 // static void gst_vr_compositor_reset_gl (GstGLFilter * filter);
 static gboolean gst_vr_compositor_stop (GstBaseTransform * trans);
+static gboolean gst_vr_compositor_gl_start (GstGLBaseFilter * filter);
 static gboolean gst_vr_compositor_init_scene (GstGLFilter * filter);
 static gboolean gst_vr_compositor_draw (gpointer stuff);
 
@@ -102,6 +113,24 @@ gst_vr_compositor_class_init (GstVRCompositorClass * klass)
   gobject_class->get_property = gst_vr_compositor_get_property;
 
   base_transform_class->src_event = gst_vr_compositor_src_event;
+  base_transform_class->query = gst_vr_compositor_query;
+
+  g_object_class_install_property (gobject_class, PROP_GPU_MEMORY,
+      g_param_spec_uint64 ("gpu-memory", "GPU memory",
+          "Bytes of GPU memory held by Gst3D objects on the GL context",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_GPU_MEMORY_BUDGET,
+      g_param_spec_uint64 ("gpu-memory-budget", "GPU memory budget",
+          "Warn when Gst3D objects on the GL context exceed this many "
+          "bytes (0 = unlimited)", 0, G_MAXUINT64, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SPHERE_DETAIL,
+      g_param_spec_uint ("sphere-detail", "Sphere detail",
+          "Segments around the video sphere (0 = derive from the eye and "
+          "video resolution)", 0, GST_3D_GEOMETRY_SPHERE_MAX_SEGMENTS, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_gl_filter_add_rgba_pad_templates (GST_GL_FILTER_CLASS (klass));
 
@@ -111,6 +140,7 @@ gst_vr_compositor_class_init (GstVRCompositorClass * klass)
   GST_GL_FILTER_CLASS (klass)->filter_texture =
       gst_vr_compositor_filter_texture;
   GST_BASE_TRANSFORM_CLASS (klass)->stop = gst_vr_compositor_stop;
+  GST_GL_BASE_FILTER_CLASS (klass)->gl_start = gst_vr_compositor_gl_start;
 
   gst_element_class_set_metadata (element_class, "VR compositor",
       "Filter/Effect/Video", "Transform video for VR",
@@ -123,14 +153,34 @@ static void
 gst_vr_compositor_init (GstVRCompositor * self)
 {
   self->scene = NULL;
+  self->sphere_mesh = NULL;
+  self->sphere_shader = NULL;
+  self->sphere_detail = 0;
+  self->sphere_detail_changed = FALSE;
   self->in_tex = 0;
+  self->gpu_memory_budget = 0;
 }
 
 static void
 gst_vr_compositor_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
 {
+  GstVRCompositor *self = GST_VR_COMPOSITOR (object);
+  GstGLContext *context = GST_GL_BASE_FILTER (object)->context;
+
   switch (prop_id) {
+    case PROP_GPU_MEMORY_BUDGET:
+      self->gpu_memory_budget = g_value_get_uint64 (value);
+      if (context)
+        gst_3d_memory_set_budget (context, self->gpu_memory_budget);
+      break;
+    case PROP_SPHERE_DETAIL:
+      /* the mesh is only touched on the GL thread, see draw */
+      GST_OBJECT_LOCK (self);
+      self->sphere_detail = g_value_get_uint (value);
+      self->sphere_detail_changed = TRUE;
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -142,7 +192,22 @@ static void
 gst_vr_compositor_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
+  GstVRCompositor *self = GST_VR_COMPOSITOR (object);
+  GstGLContext *context = GST_GL_BASE_FILTER (object)->context;
+
   switch (prop_id) {
+    case PROP_GPU_MEMORY:
+      g_value_set_uint64 (value,
+          context ? gst_3d_memory_get_total (context) : 0);
+      break;
+    case PROP_GPU_MEMORY_BUDGET:
+      g_value_set_uint64 (value, self->gpu_memory_budget);
+      break;
+    case PROP_SPHERE_DETAIL:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->sphere_detail);
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -191,6 +256,17 @@ gst_vr_compositor_src_event (GstBaseTransform * trans, GstEvent * event)
   return GST_BASE_TRANSFORM_CLASS (parent_class)->src_event (trans, event);
 }
 
+static gboolean
+gst_vr_compositor_query (GstBaseTransform * trans, GstPadDirection direction,
+    GstQuery * query)
+{
+  if (gst_3d_memory_handle_query (GST_GL_BASE_FILTER (trans)->context, query))
+    return TRUE;
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->query (trans, direction,
+      query);
+}
+
 /*
 static void
 gst_vr_compositor_reset_gl (GstGLFilter * filter)
@@ -211,6 +287,16 @@ gst_vr_compositor_stop (GstBaseTransform * trans)
 
   /* blocking call, wait until the opengl thread has destroyed the shader */
 
+  if (self->sphere_mesh) {
+    gst_object_unref (self->sphere_mesh);
+    self->sphere_mesh = NULL;
+  }
+
+  if (self->sphere_shader) {
+    gst_object_unref (self->sphere_shader);
+    self->sphere_shader = NULL;
+  }
+
   if (self->scene)
     gst_object_unref (self->scene);
 
@@ -222,27 +308,120 @@ _init_scene (Gst3DScene * scene)
 {
   GstGLContext *context = scene->context;
   GstGLFuncs *gl = context->gl_vtable;
+
+  gl->ClearColor (0.f, 0.f, 0.f, 0.f);
+  gl->ActiveTexture (GL_TEXTURE0);
+}
+
+/* Angular size in radians of the coarser of an eye buffer pixel and an
+ * input texel of the equirectangular video. Geometric error below it is
+ * not visible. */
+static gfloat
+_sphere_tolerance (GstVRCompositor * self)
+{
+  GstGLFilter *filter = GST_GL_FILTER (self);
+  gfloat fov, eye_height;
+
+#ifdef HAVE_OPENHMD
+  Gst3DHmd *hmd = GST_3D_CAMERA_HMD (self->scene->camera)->hmd;
+  fov = hmd->left_fov;
+  eye_height = gst_3d_hmd_get_eye_height (hmd);
+#else
+  fov = self->scene->camera->fov * G_PI / 180.0;
+  eye_height = GST_VIDEO_INFO_HEIGHT (&filter->out_info);
+#endif
+
+  gfloat pixel = fov / MAX (eye_height, 1.f);
+  gfloat texel = MIN (2.0 * G_PI / MAX (GST_VIDEO_INFO_WIDTH
+          (&filter->in_info), 1), G_PI / MAX (GST_VIDEO_INFO_HEIGHT
+          (&filter->in_info), 1));
+
+  return MAX (pixel, texel);
+}
+
+/* Tessellates the video sphere for half the visible error, unless the
+ * detail is set explicitly. The sphere is procedural, so this is only a
+ * uniform update. Must be called on the GL thread. */
+static void
+_update_sphere_resolution (GstVRCompositor * self)
+{
+  guint stacks, slices, detail;
+
+  GST_OBJECT_LOCK (self);
+  detail = self->sphere_detail;
+  self->sphere_detail_changed = FALSE;
+  GST_OBJECT_UNLOCK (self);
+
+  if (detail) {
+    stacks = MAX (detail, 3) + 1;
+    slices = MAX (detail, 3) / 2 + 1;
+  } else {
+    gst_3d_geometry_sphere_resolution (_sphere_tolerance (self) / 2.f,
+        &stacks, &slices);
+  }
+
+  GST_DEBUG_OBJECT (self, "sphere resolution %ux%u", stacks, slices);
+  gst_3d_mesh_set_sphere_resolution (self->sphere_mesh, stacks, slices);
+}
+
+/* Queues the sphere shader as soon as the context exists, it is compiled
+ * while the caps are negotiated and the scene is set up, and picked up by
+ * the first draw it is ready for. */
+static gboolean
+gst_vr_compositor_gl_start (GstGLBaseFilter * filter)
+{
+  GstVRCompositor *self = GST_VR_COMPOSITOR (filter);
   GError *error = NULL;
-  Gst3DMesh *sphere_mesh;
-  Gst3DNode *sphere_node;
-  Gst3DShader *sphere_shader =
-      gst_3d_shader_new_vert_frag (context, "mvp_uv.vert",
-      "texture_uv.frag", &error);
-  if (sphere_shader == NULL) {
-    GST_WARNING ("Failed to create VR compositor shaders. Error: %s", error->message);
-    g_clear_error (&error);
-    return; /* FIXME: Add boolean return result */
+
+  if (!GST_GL_BASE_FILTER_CLASS (parent_class)->gl_start (filter))
+    return FALSE;
+
+  if (!self->sphere_mesh && !self->sphere_shader) {
+    self->sphere_shader = gst_3d_shader_new (filter->context);
+    if (!gst_3d_shader_queue_vert_frag (self->sphere_shader,
+            "mvp_uv_sphere.vert", "texture_uv.frag", &error)) {
+      GST_WARNING ("Failed to create VR compositor shaders. Error: %s",
+          error->message);
+      g_clear_error (&error);
+      gst_object_unref (self->sphere_shader);
+      self->sphere_shader = NULL;
+      return FALSE;
+    }
   }
 
-  sphere_mesh = gst_3d_mesh_new_sphere (context, 800.0, 100, 100);
-  sphere_node = gst_3d_node_new_from_mesh_shader (context, sphere_mesh, sphere_shader);
-  gst_3d_scene_append_node (scene, sphere_node);
+  return TRUE;
+}
 
-  gl->ClearColor (0.f, 0.f, 0.f, 0.f);
-  gl->ActiveTexture (GL_TEXTURE0);
+static gboolean
+_init_sphere (GstVRCompositor * self, GstGLContext * context)
+{
+  GError *error = NULL;
+  Gst3DShader *sphere_shader = self->sphere_shader;
+
+  if (!sphere_shader || !gst_3d_shader_finish (sphere_shader, &error)) {
+    GST_WARNING ("Failed to create VR compositor shaders. Error: %s",
+        error ? error->message : "not queued");
+    g_clear_error (&error);
+    if (sphere_shader) {
+      gst_object_unref (sphere_shader);
+      self->sphere_shader = NULL;
+    }
+    return FALSE;
+  }
+  self->sphere_shader = NULL;
+
+  /* not shared through the mesh cache, its resolution follows the caps */
+  self->sphere_mesh = gst_3d_mesh_new_procedural_sphere (context,
+      SPHERE_RADIUS, 100, 100);
+  Gst3DNode *sphere_node = gst_3d_node_new_from_mesh_shader (context,
+      gst_object_ref (self->sphere_mesh), sphere_shader);
+  gst_3d_scene_append_node (self->scene, sphere_node);
 
   gst_3d_shader_bind (sphere_shader);
-  gst_gl_shader_set_uniform_1i (sphere_shader->shader, "texture", 0);
+  gst_3d_shader_set_int (sphere_shader,
+      gst_3d_shader_get_uniform (sphere_shader, "texture"), 0);
+
+  return TRUE;
 }
 
 static gboolean
@@ -257,8 +436,16 @@ gst_vr_compositor_init_scene (GstGLFilter * filter)
     return FALSE;
 #endif
 
+  if (self->gpu_memory_budget)
+    gst_3d_memory_set_budget (context, self->gpu_memory_budget);
+
   gst_3d_scene_init_gl (self->scene, context);
 
+  /* called again on every caps change, the first draw with the sphere
+   * applies it otherwise */
+  if (self->sphere_mesh)
+    _update_sphere_resolution (self);
+
   return TRUE;
 }
 
@@ -283,9 +470,31 @@ gst_vr_compositor_draw (gpointer this)
   GstGLContext *context = GST_GL_BASE_FILTER (this)->context;
   GstGLFuncs *gl = context->gl_vtable;
 
-  gl->BindTexture (GL_TEXTURE_2D, self->in_tex->tex_id);
+  /* the sphere shader is first needed here, frames stay empty while the
+   * driver is still compiling it */
+  if (!self->sphere_mesh) {
+    if (self->sphere_shader && !gst_3d_shader_is_ready (self->sphere_shader)) {
+      GST_LOG_OBJECT (self, "sphere shader not ready, skipping the scene");
+      gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      return TRUE;
+    }
+    if (!_init_sphere (self, context))
+      return FALSE;
+    _update_sphere_resolution (self);
+  } else {
+    GST_OBJECT_LOCK (self);
+    gboolean detail_changed = self->sphere_detail_changed;
+    GST_OBJECT_UNLOCK (self);
+
+    if (detail_changed)
+      _update_sphere_resolution (self);
+  }
+
+  gst_3d_gl_state_begin (context);
+  gst_3d_gl_state_bind_texture (context, 0, self->in_tex->tex_id);
   gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   gst_3d_scene_draw (self->scene);
+  gst_3d_gl_state_end (context);
 
   return TRUE;
 }
@@ -51,6 +51,17 @@ struct _GstVRCompositor
   gboolean caps_change;
 
   Gst3DScene *scene;
+  Gst3DMesh *sphere_mesh;
+  /* queued in gl_start, handed to the sphere node by the first draw
+   * after the driver has built it */
+  Gst3DShader *sphere_shader;
+
+  /* segments around the sphere, 0 derives them from the resolutions.
+   * Set from the application thread, applied on the GL thread. */
+  guint sphere_detail;
+  gboolean sphere_detail_changed;
+
+  guint64 gpu_memory_budget;
 };
 
 struct _GstVRCompositorClass
@@ -27,6 +27,7 @@
 
 #include "gst/3d/gst3dshader.h"
 #include "gst/3d/gst3dmesh.h"
+#include "gst/3d/gst3dmeshcache.h"
 #include "gst/3d/gst3dcamera_arcball.h"
 #include "gst/3d/gst3dcamera_wasd.h"
 #include "gst/3d/gst3dscene.h"
@@ -55,8 +56,9 @@ _init_scene (Gst3DScene * scene)
   GstGLContext *context = scene->context;
   Gst3DNode *axes_node;
   GError *error = NULL;
-  Gst3DShader *uv_shader =
-      gst_3d_shader_new_vert_frag (context, "mvp_uv.vert", "debug_uv.frag", &error);
+  const gchar *defines[] = { "DEBUG_UV", NULL };
+  Gst3DShader *uv_shader = gst_3d_shader_new_variant (context, "mvp_uv.vert",
+      "texture_uv.frag", defines, &error);
 
   if (uv_shader == NULL) {
     GST_WARNING ("Failed to create VR shaders. Error: %s", error->message);
@@ -67,7 +69,8 @@ _init_scene (Gst3DScene * scene)
   axes_node = gst_3d_node_new_debug_axes (context);
   gst_3d_scene_append_node (scene, axes_node);
 
-  Gst3DMesh *sphere_mesh = gst_3d_mesh_new_sphere (context, 0.5, 100, 100);
+  Gst3DMesh *sphere_mesh =
+      gst_3d_mesh_cache_get_sphere (context, 0.5, 100, 100);
   Gst3DNode *sphere_node =
       gst_3d_node_new_from_mesh_shader (context, sphere_mesh, uv_shader);
 
@@ -129,11 +132,9 @@ _scene_geometry_draw (gpointer impl)
   g_return_val_if_fail (self->base.context, FALSE);
 
   GstGLFuncs *gl = self->base.context->gl_vtable;
-  /*
-     gst_gl_shader_use (self->shader->shader);
-     gst_gl_shader_set_uniform_1f (self->shader->shader, "time",
-     (gfloat) self->base.src->running_time / GST_SECOND);
-   */
+
+  gst_3d_scene_set_time (self->scene,
+      (gfloat) self->base.src->running_time / GST_SECOND);
 
   gl->Enable (GL_DEPTH_TEST);
   gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -0,0 +1,133 @@
+/* Checks Gst3DBvh frustum culling against testing every box, and compares
+ * the time of both for growing numbers of boxes. */
+
+#include <glib.h>
+#include <math.h>
+#include <graphene.h>
+
+#include "../../gst-libs/gst/3d/gst3dbvh.h"
+
+#define ITERATIONS 20
+#define WORLD_SIZE 500.f
+
+static const guint sizes[] = { 100, 1000, 10000, 100000 };
+
+static void
+init_boxes (graphene_box_t * boxes, guint count, GRand * rand)
+{
+  for (guint i = 0; i < count; i++) {
+    gfloat x = g_rand_double_range (rand, -WORLD_SIZE, WORLD_SIZE);
+    gfloat y = g_rand_double_range (rand, -WORLD_SIZE, WORLD_SIZE);
+    gfloat z = g_rand_double_range (rand, -WORLD_SIZE, WORLD_SIZE);
+    gfloat s = g_rand_double_range (rand, 0.1, 5.0);
+    graphene_box_init (&boxes[i], &GRAPHENE_POINT3D_INIT (x - s, y - s, z - s),
+        &GRAPHENE_POINT3D_INIT (x + s, y + s, z + s));
+  }
+}
+
+static void
+init_frustum (graphene_frustum_t * frustum, gfloat yaw)
+{
+  graphene_matrix_t view, projection, vp;
+  graphene_vec3_t eye, center, up;
+
+  graphene_vec3_init (&eye, 0.f, 0.f, 0.f);
+  graphene_vec3_init (&center, sinf (yaw), 0.f, cosf (yaw));
+  graphene_vec3_init (&up, 0.f, 1.f, 0.f);
+  graphene_matrix_init_look_at (&view, &eye, &center, &up);
+  graphene_matrix_init_perspective (&projection, 90.f, 1.f, 0.1f, 300.f);
+  graphene_matrix_multiply (&view, &projection, &vp);
+  graphene_frustum_init_from_matrix (frustum, &vp);
+}
+
+static void
+test_bvh_matches_brute_force (void)
+{
+  const guint count = 5000;
+  GRand *rand = g_rand_new_with_seed (42);
+  graphene_box_t *boxes = g_new (graphene_box_t, count);
+  guint8 *visible = g_new (guint8, count);
+  Gst3DBvh *bvh = gst_3d_bvh_new ();
+  graphene_frustum_t frustum;
+
+  init_boxes (boxes, count, rand);
+  gst_3d_bvh_build (bvh, boxes, count);
+
+  for (guint f = 0; f < 8; f++) {
+    /* move the boxes to exercise the refit */
+    if (f == 4) {
+      init_boxes (boxes, count, rand);
+      gst_3d_bvh_refit (bvh, boxes);
+    }
+
+    init_frustum (&frustum, f * G_PI / 4);
+    gst_3d_bvh_cull (bvh, &frustum, visible);
+
+    for (guint i = 0; i < count; i++)
+      g_assert_cmpint (visible[i], ==,
+          graphene_frustum_intersects_box (&frustum, &boxes[i]));
+  }
+
+  gst_3d_bvh_free (bvh);
+  g_free (visible);
+  g_free (boxes);
+  g_rand_free (rand);
+}
+
+static void
+test_bvh_bench (void)
+{
+  GRand *rand = g_rand_new_with_seed (42);
+  graphene_frustum_t frustum;
+  init_frustum (&frustum, 0.f);
+
+  for (guint s = 0; s < G_N_ELEMENTS (sizes); s++) {
+    guint count = sizes[s];
+    graphene_box_t *boxes = g_new (graphene_box_t, count);
+    guint8 *visible = g_new (guint8, count);
+    Gst3DBvh *bvh = gst_3d_bvh_new ();
+    guint tests = 0, n_visible = 0;
+
+    init_boxes (boxes, count, rand);
+
+    gint64 start = g_get_monotonic_time ();
+    gst_3d_bvh_build (bvh, boxes, count);
+    gint64 build = g_get_monotonic_time () - start;
+
+    start = g_get_monotonic_time ();
+    for (guint i = 0; i < ITERATIONS; i++)
+      tests = gst_3d_bvh_cull (bvh, &frustum, visible);
+    gint64 culled = g_get_monotonic_time () - start;
+
+    start = g_get_monotonic_time ();
+    for (guint i = 0; i < ITERATIONS; i++) {
+      n_visible = 0;
+      for (guint b = 0; b < count; b++)
+        n_visible += graphene_frustum_intersects_box (&frustum, &boxes[b]);
+    }
+    gint64 brute = g_get_monotonic_time () - start;
+
+    g_print ("%6u boxes, %6u visible: build %8.3f ms  bvh %8.3f ms "
+        "(%u tests)  brute force %8.3f ms\n", count, n_visible,
+        build / 1000.0, culled / 1000.0 / ITERATIONS, tests,
+        brute / 1000.0 / ITERATIONS);
+
+    gst_3d_bvh_free (bvh);
+    g_free (visible);
+    g_free (boxes);
+  }
+
+  g_rand_free (rand);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/gst3d/bvh/matches_brute_force",
+      test_bvh_matches_brute_force);
+  g_test_add_func ("/gst3d/bvh/bench", test_bvh_bench);
+
+  return g_test_run ();
+}
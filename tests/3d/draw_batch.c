@@ -0,0 +1,212 @@
+/* Checks that a Gst3DDrawBatch draws the same image as drawing its meshes
+ * one by one, and compares the time of both. */
+
+#include <glib.h>
+
+#include "gl_test.h"
+#include "../../gst-libs/gst/3d/gst3dmesh.h"
+#include "../../gst-libs/gst/3d/gst3ddrawbatch.h"
+#include "../../gst-libs/gst/3d/gst3dcamerabuffer.h"
+#include "../../gst-libs/gst/3d/gst3dglstate.h"
+
+#define WIDTH 640
+#define HEIGHT 360
+#define OBJECTS 2000
+#define FRAMES 100
+
+struct BatchScene
+{
+  Gst3DShader *shader;
+  Gst3DShader *instanced_shader;
+  Gst3DCameraBuffer *camera_buffer;
+  Gst3DMesh *meshes[OBJECTS];
+  graphene_matrix_t models[OBJECTS];
+  Gst3DDrawBatch *batch;
+};
+
+struct BenchRun
+{
+  gboolean batched;
+  gint64 time_us;
+};
+
+static Gst3DShader *
+new_shader (GstGLContext * context, const gchar * vertex)
+{
+  GError *error = NULL;
+  const gchar *defines[] = { "DEBUG_UV", NULL };
+
+  Gst3DShader *shader = gst_3d_shader_new_variant (context, vertex,
+      "texture_uv.frag", defines, &error);
+  g_assert_no_error (error);
+  return shader;
+}
+
+/* Spheres of a few resolutions, all packable into one batch. */
+static void
+scene_init (struct BatchScene *scene, GstGLContext * context)
+{
+  scene->shader = new_shader (context, "mvp_uv.vert");
+  scene->instanced_shader = new_shader (context, "mvp_uv_instanced.vert");
+
+  /* identity view projection, the models place the meshes on screen */
+  scene->camera_buffer = gst_3d_camera_buffer_new (context);
+  gst_3d_camera_buffer_bind (scene->camera_buffer, 0);
+
+  scene->batch = gst_3d_draw_batch_new (context, scene->instanced_shader);
+
+  for (guint i = 0; i < OBJECTS; i++) {
+    Gst3DMesh *mesh = gst_3d_mesh_new (context);
+    gst_3d_mesh_set_layout (mesh, GST_3D_MESH_LAYOUT_INTERLEAVED);
+    gst_3d_mesh_init_buffers (mesh);
+    gst_3d_mesh_upload_sphere (mesh, 0.5, 6 + i % 4, 6);
+    gst_3d_mesh_bind_shader (mesh, scene->shader);
+    g_assert (gst_3d_draw_batch_add_mesh (scene->batch, mesh));
+    scene->meshes[i] = mesh;
+
+    graphene_matrix_init_scale (&scene->models[i], 0.02, 0.02, 0.02);
+    graphene_matrix_translate (&scene->models[i], &GRAPHENE_POINT3D_INIT
+        ((i % 50) / 25.0 - 1.0, (i / 50) / 20.0 - 1.0, 0));
+  }
+}
+
+static void
+scene_clear (struct BatchScene *scene, GstGLContext * context)
+{
+  gst_3d_gl_state_reset (context);
+
+  gst_3d_draw_batch_free (scene->batch);
+  gst_3d_camera_buffer_free (scene->camera_buffer);
+  for (guint i = 0; i < OBJECTS; i++)
+    gst_object_unref (scene->meshes[i]);
+  gst_object_unref (scene->shader);
+  gst_object_unref (scene->instanced_shader);
+}
+
+static void
+draw_one_by_one (struct BatchScene *scene)
+{
+  Gst3DShader *shader = scene->shader;
+
+  gst_3d_shader_bind (shader);
+  for (guint i = 0; i < OBJECTS; i++) {
+    gst_3d_shader_set_matrix (shader, shader->model_uniform,
+        &scene->models[i]);
+    gst_3d_mesh_bind (scene->meshes[i]);
+    gst_3d_mesh_draw (scene->meshes[i]);
+  }
+}
+
+static void
+draw_batched (struct BatchScene *scene)
+{
+  for (guint i = 0; i < OBJECTS; i++)
+    g_assert (gst_3d_draw_batch_push (scene->batch, scene->meshes[i],
+            &scene->models[i]));
+  gst_3d_draw_batch_flush (scene->batch);
+}
+
+/* Multi draw indirect needs base instance, see gst3ddrawbatch.c */
+static gboolean
+expect_indirect (GstGLContext * context)
+{
+  return gst_gl_context_check_gl_version (context, GST_GL_API_OPENGL3, 4, 3)
+      || (gst_gl_context_check_feature (context, "GL_ARB_multi_draw_indirect")
+      && gst_gl_context_check_feature (context, "GL_ARB_base_instance"));
+}
+
+static void
+compare_draws (GstGLContext * context, gpointer data)
+{
+  struct BatchScene scene;
+  GLTestTarget *target = gl_test_target_new (context, WIDTH, HEIGHT);
+
+  scene_init (&scene, context);
+  g_assert_cmpint (gst_3d_draw_batch_is_indirect (scene.batch), ==,
+      expect_indirect (context));
+
+  gl_test_target_bind (target);
+  draw_one_by_one (&scene);
+  guint8 *one_by_one = gl_test_target_read (target);
+
+  gl_test_target_bind (target);
+  draw_batched (&scene);
+  guint8 *batched = gl_test_target_read (target);
+
+  /* the model matrix comes from a uniform in one and from an instanced
+   * attribute in the other, rasterization may differ on a few edges */
+  g_assert_cmpuint (gl_test_count_drawn (one_by_one, WIDTH, HEIGHT), >,
+      WIDTH * HEIGHT / 100);
+  g_assert_cmpuint (gl_test_count_differences (one_by_one, batched, WIDTH,
+          HEIGHT), <=, WIDTH * HEIGHT / 1000);
+
+  g_free (one_by_one);
+  g_free (batched);
+  scene_clear (&scene, context);
+  gl_test_target_free (target);
+}
+
+static void
+run_benchmark (GstGLContext * context, gpointer data)
+{
+  struct BenchRun *run = data;
+  const GstGLFuncs *gl = context->gl_vtable;
+  struct BatchScene scene;
+  GLTestTarget *target = gl_test_target_new (context, WIDTH, HEIGHT);
+
+  scene_init (&scene, context);
+  gl_test_target_bind (target);
+  gl->Finish ();
+
+  gint64 start = g_get_monotonic_time ();
+  for (int f = 0; f < FRAMES; f++) {
+    if (run->batched)
+      draw_batched (&scene);
+    else
+      draw_one_by_one (&scene);
+  }
+  gl->Finish ();
+  run->time_us = g_get_monotonic_time () - start;
+
+  g_print ("%-20s %d objects, %d frames: %8.3f ms (%.3f ms/frame)\n",
+      run->batched ? (gst_3d_draw_batch_is_indirect (scene.batch) ?
+          "multi draw indirect" : "batched draw loop") : "one by one",
+      OBJECTS, FRAMES, run->time_us / 1000.0, run->time_us / 1000.0 / FRAMES);
+
+  scene_clear (&scene, context);
+  gl_test_target_free (target);
+}
+
+static void
+test_draw_batch_matches (void)
+{
+  gl_test_init (WIDTH, HEIGHT);
+  gl_test_run (compare_draws, NULL);
+  gl_test_deinit ();
+}
+
+static void
+test_draw_batch_bench (void)
+{
+  struct BenchRun runs[] = {
+    {FALSE, 0},
+    {TRUE, 0},
+  };
+
+  gl_test_init (WIDTH, HEIGHT);
+  for (guint i = 0; i < G_N_ELEMENTS (runs); i++)
+    gl_test_run (run_benchmark, &runs[i]);
+  gl_test_deinit ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/gst3d/draw_batch/matches_one_by_one",
+      test_draw_batch_matches);
+  g_test_add_func ("/gst3d/draw_batch/bench", test_draw_batch_bench);
+
+  return g_test_run ();
+}
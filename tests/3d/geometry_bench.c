@@ -0,0 +1,307 @@
+/* Microbenchmark for the CPU sphere tessellation in Gst3DGeometry,
+ * compared against evaluating sin and cos for every vertex. */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "../../gst-libs/gst/3d/gst3dgeometry.h"
+#include "../../gst-libs/gst/3d/gst3dmeshdata.h"
+
+#define RADIUS 0.5f
+#define ITERATIONS 3
+
+static const guint sizes[] = { 100, 256, 512, 1024, 2048 };
+
+/* previous per vertex implementation of gst_3d_mesh_upload_sphere */
+static void
+generate_reference (gfloat * positions, gfloat * uvs, guint stacks,
+    guint slices)
+{
+  gfloat *v = positions;
+  gfloat *t = uvs;
+
+  float const J = 1. / (float) (stacks - 1);
+  float const I = 1. / (float) (slices - 1);
+
+  for (guint i = 0; i < slices; i++) {
+    float const theta = M_PI * i * I;
+    for (guint j = 0; j < stacks; j++) {
+      float const phi = 2 * M_PI * j * J + M_PI / 2.0;
+
+      *v++ = sin (theta) * cos (phi) * RADIUS;
+      *v++ = -cos (theta) * RADIUS;
+      *v++ = sin (phi) * sin (theta) * RADIUS;
+
+      *t++ = j * J;
+      *t++ = i * I;
+    }
+  }
+}
+
+static gint64
+time_geometry (Gst3DGeometry * geometry, guint size)
+{
+  gint64 best = G_MAXINT64;
+  for (guint i = 0; i < ITERATIONS; i++) {
+    gint64 start = g_get_monotonic_time ();
+    gst_3d_geometry_generate_sphere (geometry, RADIUS, size, size);
+    best = MIN (best, g_get_monotonic_time () - start);
+  }
+  return best;
+}
+
+static void
+test_sphere_matches_reference (void)
+{
+  const guint stacks = 37, slices = 23;
+  Gst3DGeometry *geometry = gst_3d_geometry_new ();
+  gfloat *positions = g_new (gfloat, stacks * slices * 3);
+  gfloat *uvs = g_new (gfloat, stacks * slices * 2);
+
+  generate_reference (positions, uvs, stacks, slices);
+  gst_3d_geometry_generate_sphere (geometry, RADIUS, stacks, slices);
+
+  g_assert_cmpuint (geometry->vertex_count, ==, stacks * slices);
+  g_assert_cmpuint (geometry->index_count, ==,
+      (slices - 1) * (stacks * 2 + 1) - 1);
+
+  for (guint i = 0; i < stacks * slices * 3; i++)
+    g_assert_cmpfloat (fabsf (geometry->positions[i] - positions[i]), <, 1e-5f);
+  for (guint i = 0; i < stacks * slices * 2; i++)
+    g_assert_cmpfloat (fabsf (geometry->uvs[i] - uvs[i]), <, 1e-6f);
+
+  for (guint i = 0; i < slices - 1; i++) {
+    guint32 *strip = &geometry->indices[i * (stacks * 2 + 1)];
+    for (guint j = 0; j < stacks; j++) {
+      g_assert_cmpuint (strip[j * 2], ==, i * stacks + j);
+      g_assert_cmpuint (strip[j * 2 + 1], ==, (i + 1) * stacks + j);
+    }
+    if (i + 2 < slices)
+      g_assert_cmpuint (strip[stacks * 2], ==, GST_3D_GEOMETRY_RESTART_INDEX);
+  }
+
+  g_free (positions);
+  g_free (uvs);
+  gst_3d_geometry_free (geometry);
+}
+
+static void
+test_sphere_threads_match (void)
+{
+  const guint size = 600;
+  Gst3DGeometry *single = gst_3d_geometry_new ();
+  Gst3DGeometry *threaded = gst_3d_geometry_new ();
+  single->n_threads = 1;
+  threaded->n_threads = 4;
+
+  gst_3d_geometry_generate_sphere (single, RADIUS, size, size);
+  gst_3d_geometry_generate_sphere (threaded, RADIUS, size, size);
+
+  g_assert (memcmp (single->positions, threaded->positions,
+          single->vertex_count * 3 * sizeof (gfloat)) == 0);
+  g_assert (memcmp (single->uvs, threaded->uvs,
+          single->vertex_count * 2 * sizeof (gfloat)) == 0);
+  g_assert (memcmp (single->indices, threaded->indices,
+          single->index_count * sizeof (guint32)) == 0);
+
+  gst_3d_geometry_free (single);
+  gst_3d_geometry_free (threaded);
+}
+
+static void
+test_sphere_resolution_error (void)
+{
+  const gfloat errors[] = { 1e-3f, 1e-4f, 1e-5f, 1e-6f };
+
+  for (guint e = 0; e < G_N_ELEMENTS (errors); e++) {
+    guint stacks, slices;
+    gst_3d_geometry_sphere_resolution (errors[e], &stacks, &slices);
+
+    /* angle of the chord point against the linearly interpolated angle */
+    gdouble segment = 2.0 * M_PI / (stacks - 1);
+    gdouble max_error = 0.0;
+    for (guint i = 0; i <= 1000; i++) {
+      gdouble t = i / 1000.0;
+      gdouble angle = atan2 (t * sin (segment), 1.0 - t + t * cos (segment));
+      max_error = MAX (max_error, fabs (angle - t * segment));
+    }
+
+    g_assert_cmpfloat (max_error, <=, errors[e]);
+    g_assert_cmpuint (slices, ==, stacks / 2 + 1);
+  }
+}
+
+static void
+test_sphere_bench (void)
+{
+  Gst3DGeometry *single = gst_3d_geometry_new ();
+  Gst3DGeometry *threaded = gst_3d_geometry_new ();
+  single->n_threads = 1;
+
+  for (guint s = 0; s < G_N_ELEMENTS (sizes); s++) {
+    guint size = sizes[s];
+    gsize vertex_count = (gsize) size * size;
+    gfloat *positions = g_new (gfloat, vertex_count * 3);
+    gfloat *uvs = g_new (gfloat, vertex_count * 2);
+
+    gint64 reference = G_MAXINT64;
+    for (guint i = 0; i < ITERATIONS; i++) {
+      gint64 start = g_get_monotonic_time ();
+      generate_reference (positions, uvs, size, size);
+      reference = MIN (reference, g_get_monotonic_time () - start);
+    }
+
+    gint64 separable = time_geometry (single, size);
+    gint64 parallel = time_geometry (threaded, size);
+
+    g_print ("%4ux%-4u reference %9.3f ms  separable %9.3f ms  "
+        "threaded %9.3f ms\n", size, size, reference / 1000.0,
+        separable / 1000.0, parallel / 1000.0);
+
+    g_free (positions);
+    g_free (uvs);
+  }
+
+  gst_3d_geometry_free (single);
+  gst_3d_geometry_free (threaded);
+}
+
+static void
+test_point_plane (void)
+{
+  const guint width = 8, height = 4;
+  Gst3DGeometry *geometry = gst_3d_geometry_new ();
+
+  gst_3d_geometry_generate_point_plane (geometry, width, height);
+
+  /* drawn in vertex order, column by column */
+  g_assert_cmpuint (geometry->vertex_count, ==, width * height);
+  g_assert_cmpuint (geometry->index_count, ==, 0);
+  for (guint i = 0; i < width; i++) {
+    for (guint j = 0; j < height; j++) {
+      const gfloat *position = &geometry->positions[(i * height + j) * 3];
+      g_assert_cmpfloat (fabs (position[0] - (-1.0 + i * 2.0 / width)), <=,
+          1e-6);
+      g_assert_cmpfloat (fabs (position[1] - (-1.0 + j * 2.0 / height)), <=,
+          1e-6);
+      g_assert_cmpfloat (position[2], ==, 0.0);
+    }
+  }
+
+  gst_3d_geometry_free (geometry);
+}
+
+static Gst3DMeshData *
+new_strip (guint draw_mode)
+{
+  Gst3DMeshData *data = gst_3d_mesh_data_new ();
+  data->draw_mode = draw_mode;
+  gst_3d_mesh_data_add_attribute (data, "position", 3);
+  gst_3d_mesh_data_alloc (data, 4, 4);
+  for (guint i = 0; i < 4; i++) {
+    data->indices[i] = i;
+    gst_3d_mesh_data_get_attribute (data, 0, i)[0] = i;
+  }
+  return data;
+}
+
+static void
+test_strip_concat (void)
+{
+  /* GL_TRIANGLE_STRIP and GL_TRIANGLES */
+  Gst3DMeshData *strip = new_strip (0x0005);
+  Gst3DMeshData *other = new_strip (0x0005);
+  Gst3DMeshData *list = new_strip (0x0004);
+  Gst3DMeshData *other_list = new_strip (0x0004);
+
+  g_assert (!gst_3d_mesh_data_concat (strip, list));
+  g_assert_cmpuint (strip->index_count, ==, 4);
+
+  g_assert (gst_3d_mesh_data_concat (strip, other));
+  g_assert_cmpuint (strip->vertex_count, ==, 8);
+  g_assert_cmpuint (strip->index_count, ==, 9);
+  g_assert_cmpuint (strip->indices[4], ==, GST_3D_GEOMETRY_RESTART_INDEX);
+  for (guint i = 0; i < 4; i++) {
+    g_assert_cmpuint (strip->indices[5 + i], ==, 4 + i);
+    g_assert_cmpfloat (gst_3d_mesh_data_get_attribute (strip, 0, 4 + i)[0],
+        ==, i);
+  }
+
+  g_assert (gst_3d_mesh_data_concat (list, other_list));
+  g_assert_cmpuint (list->index_count, ==, 8);
+  g_assert_cmpuint (list->indices[4], ==, 4);
+
+  gst_3d_mesh_data_free (strip);
+  gst_3d_mesh_data_free (other);
+  gst_3d_mesh_data_free (list);
+  gst_3d_mesh_data_free (other_list);
+}
+
+static void
+assert_unrolled (const guint32 * indices, guint count, guint draw_mode,
+    const guint32 * expected, guint expected_count, guint expected_mode)
+{
+  guint n_indices;
+  guint32 *unrolled = gst_3d_mesh_data_unroll_restarts (indices, count,
+      &draw_mode, &n_indices);
+
+  g_assert_cmpuint (draw_mode, ==, expected_mode);
+  g_assert_cmpuint (n_indices, ==, expected_count);
+  for (guint i = 0; i < n_indices; i++)
+    g_assert_cmpuint (unrolled[i], ==, expected[i]);
+
+  g_free (unrolled);
+}
+
+static void
+test_unroll_restarts (void)
+{
+  const guint32 R = GST_3D_GEOMETRY_RESTART_INDEX;
+
+  /* GL_TRIANGLE_STRIP, the next strip starts on an even triangle */
+  const guint32 even[] = { 0, 1, 2, 3, R, 4, 5, 6 };
+  const guint32 even_joined[] = { 0, 1, 2, 3, 3, 4, 4, 5, 6 };
+  assert_unrolled (even, G_N_ELEMENTS (even), 0x0005, even_joined,
+      G_N_ELEMENTS (even_joined), 0x0005);
+
+  const guint32 odd[] = { 0, 1, 2, R, 3, 4, 5 };
+  const guint32 odd_joined[] = { 0, 1, 2, 2, 2, 3, 3, 4, 5 };
+  assert_unrolled (odd, G_N_ELEMENTS (odd), 0x0005, odd_joined,
+      G_N_ELEMENTS (odd_joined), 0x0005);
+
+  /* GL_TRIANGLE_FAN to GL_TRIANGLES */
+  const guint32 fan[] = { 0, 1, 2, 3, R, 4, 5, 6 };
+  const guint32 fan_list[] = { 0, 1, 2, 0, 2, 3, 4, 5, 6 };
+  assert_unrolled (fan, G_N_ELEMENTS (fan), 0x0006, fan_list,
+      G_N_ELEMENTS (fan_list), 0x0004);
+
+  /* GL_LINE_LOOP and GL_LINE_STRIP to GL_LINES */
+  const guint32 loop[] = { 0, 1, 2, R, 3, 4 };
+  const guint32 loop_lines[] = { 0, 1, 1, 2, 2, 0, 3, 4 };
+  assert_unrolled (loop, G_N_ELEMENTS (loop), 0x0002, loop_lines,
+      G_N_ELEMENTS (loop_lines), 0x0001);
+
+  const guint32 strip_lines[] = { 0, 1, 1, 2, 3, 4 };
+  assert_unrolled (loop, G_N_ELEMENTS (loop), 0x0003, strip_lines,
+      G_N_ELEMENTS (strip_lines), 0x0001);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/gst3d/geometry/sphere_matches_reference",
+      test_sphere_matches_reference);
+  g_test_add_func ("/gst3d/geometry/sphere_threads_match",
+      test_sphere_threads_match);
+  g_test_add_func ("/gst3d/geometry/sphere_resolution_error",
+      test_sphere_resolution_error);
+  g_test_add_func ("/gst3d/geometry/point_plane", test_point_plane);
+  g_test_add_func ("/gst3d/geometry/strip_concat", test_strip_concat);
+  g_test_add_func ("/gst3d/geometry/unroll_restarts", test_unroll_restarts);
+  g_test_add_func ("/gst3d/geometry/sphere_bench", test_sphere_bench);
+
+  return g_test_run ();
+}
@@ -0,0 +1,149 @@
+#include <string.h>
+
+#include "gl_test.h"
+
+struct _GLTestTarget
+{
+  GstGLContext *context;
+  guint width;
+  guint height;
+  GLuint fbo;
+  GLuint renderbuffers[2];
+};
+
+static GstGLDisplay *display = NULL;
+static GstGLContext *context = NULL;
+static GstGLWindow *window = NULL;
+
+GstGLContext *
+gl_test_init (guint width, guint height)
+{
+  GError *error = NULL;
+
+  gst_init (NULL, NULL);
+
+  display = gst_gl_display_new ();
+  context = gst_gl_context_new (display);
+
+  gst_gl_context_create (context, 0, &error);
+  g_assert_no_error (error);
+
+  window = gst_gl_context_get_window (context);
+  gst_gl_window_set_preferred_size (window, width, height);
+  gst_gl_window_draw (window);
+
+  return context;
+}
+
+void
+gl_test_deinit (void)
+{
+  gst_object_unref (window);
+  gst_object_unref (context);
+  gst_object_unref (display);
+  window = NULL;
+  context = NULL;
+  display = NULL;
+}
+
+/* Runs @func on the GL thread and returns once it is done. */
+void
+gl_test_run (GstGLContextThreadFunc func, gpointer data)
+{
+  gst_gl_context_thread_add (context, func, data);
+}
+
+/* RGBA8 color and depth renderbuffers, independent of the window size. */
+GLTestTarget *
+gl_test_target_new (GstGLContext * context, guint width, guint height)
+{
+  const GstGLFuncs *gl = context->gl_vtable;
+  GLTestTarget *target = g_new0 (GLTestTarget, 1);
+
+  target->context = gst_object_ref (context);
+  target->width = width;
+  target->height = height;
+
+  gl->GenFramebuffers (1, &target->fbo);
+  gl->BindFramebuffer (GL_FRAMEBUFFER, target->fbo);
+
+  gl->GenRenderbuffers (2, target->renderbuffers);
+  gl->BindRenderbuffer (GL_RENDERBUFFER, target->renderbuffers[0]);
+  gl->RenderbufferStorage (GL_RENDERBUFFER, GL_RGBA8, width, height);
+  gl->FramebufferRenderbuffer (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      GL_RENDERBUFFER, target->renderbuffers[0]);
+  gl->BindRenderbuffer (GL_RENDERBUFFER, target->renderbuffers[1]);
+  gl->RenderbufferStorage (GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width,
+      height);
+  gl->FramebufferRenderbuffer (GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+      GL_RENDERBUFFER, target->renderbuffers[1]);
+  gl->BindRenderbuffer (GL_RENDERBUFFER, 0);
+
+  g_assert_cmpuint (gl->CheckFramebufferStatus (GL_FRAMEBUFFER), ==,
+      GL_FRAMEBUFFER_COMPLETE);
+
+  return target;
+}
+
+void
+gl_test_target_free (GLTestTarget * target)
+{
+  const GstGLFuncs *gl = target->context->gl_vtable;
+
+  gl->BindFramebuffer (GL_FRAMEBUFFER, 0);
+  gl->DeleteRenderbuffers (2, target->renderbuffers);
+  gl->DeleteFramebuffers (1, &target->fbo);
+  gst_object_unref (target->context);
+  g_free (target);
+}
+
+/* Binds and clears @target to transparent black. */
+void
+gl_test_target_bind (GLTestTarget * target)
+{
+  const GstGLFuncs *gl = target->context->gl_vtable;
+
+  gl->BindFramebuffer (GL_FRAMEBUFFER, target->fbo);
+  gl->Viewport (0, 0, target->width, target->height);
+  gl->ClearColor (0.f, 0.f, 0.f, 0.f);
+  gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/* Returns the RGBA pixels of @target, free with g_free. */
+guint8 *
+gl_test_target_read (GLTestTarget * target)
+{
+  const GstGLFuncs *gl = target->context->gl_vtable;
+  guint8 *pixels = g_malloc (target->width * target->height * 4);
+
+  gl->BindFramebuffer (GL_FRAMEBUFFER, target->fbo);
+  gl->PixelStorei (GL_PACK_ALIGNMENT, 1);
+  gl->ReadPixels (0, 0, target->width, target->height, GL_RGBA,
+      GL_UNSIGNED_BYTE, pixels);
+
+  return pixels;
+}
+
+/* Pixels that are not transparent, i.e. covered by a draw. */
+guint
+gl_test_count_drawn (const guint8 * pixels, guint width, guint height)
+{
+  guint drawn = 0;
+
+  for (guint i = 0; i < width * height; i++)
+    drawn += pixels[i * 4 + 3] != 0;
+
+  return drawn;
+}
+
+guint
+gl_test_count_differences (const guint8 * a, const guint8 * b, guint width,
+    guint height)
+{
+  guint differences = 0;
+
+  for (guint i = 0; i < width * height; i++)
+    differences += memcmp (&a[i * 4], &b[i * 4], 4) != 0;
+
+  return differences;
+}
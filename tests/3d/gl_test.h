@@ -0,0 +1,33 @@
+/* Shared setup of the GL tests: one context with a window, whose GL
+ * thread runs the test functions, and an offscreen target to read back
+ * what they drew. */
+
+#ifndef __GL_TEST_H__
+#define __GL_TEST_H__
+
+#include <glib.h>
+
+#define GST_USE_UNSTABLE_API 1
+#include <gst/gl/gl.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GLTestTarget GLTestTarget;
+
+GstGLContext *gl_test_init (guint width, guint height);
+void gl_test_deinit (void);
+void gl_test_run (GstGLContextThreadFunc func, gpointer data);
+
+/* the target functions have to be called on the GL thread */
+GLTestTarget *gl_test_target_new (GstGLContext * context, guint width,
+    guint height);
+void gl_test_target_free (GLTestTarget * target);
+void gl_test_target_bind (GLTestTarget * target);
+guint8 *gl_test_target_read (GLTestTarget * target);
+
+guint gl_test_count_drawn (const guint8 * pixels, guint width, guint height);
+guint gl_test_count_differences (const guint8 * a, const guint8 * b,
+    guint width, guint height);
+
+G_END_DECLS
+#endif /* __GL_TEST_H__ */
@@ -38,11 +38,12 @@ draw_render (gpointer data)
 
   gl->Clear (GL_COLOR_BUFFER_BIT);
 
-  gst_gl_shader_use (shader->shader);
+  gst_3d_shader_bind (shader);
 
   gl->ActiveTexture (GL_TEXTURE0);
   gl->BindTexture (GL_TEXTURE_2D, tex_id);
-  gst_gl_shader_set_uniform_1i (shader->shader, "s_texture", 0);
+  gst_3d_shader_set_int (shader, gst_3d_shader_get_uniform (shader,
+          "s_texture"), 0);
 
   gst_3d_mesh_bind (mesh);
   gst_3d_mesh_draw (mesh);
@@ -54,9 +55,10 @@ static void
 init (gpointer data)
 {
   GError *error;
+  const gchar *defines[] = { "DEBUG_UV", NULL };
 
-  shader =
-      gst_3d_shader_new_vert_frag (context, "mvp_uv.vert", "debug_uv.frag", &error);
+  shader = gst_3d_shader_new_variant (context, "plane_uv.vert",
+      "texture_uv.frag", defines, &error);
   if (shader == NULL) {
     GST_WARNING ("Failed to create VR compositor shaders. Error: %s", error->message);
     g_clear_error (&error);
@@ -64,7 +66,7 @@ init (gpointer data)
   }
 
   mesh = gst_3d_mesh_new_sphere (context, 0.5, 100, 100);
-  gst_gl_shader_use (shader->shader);
+  gst_3d_shader_bind (shader);
   gst_3d_mesh_bind_shader (mesh, shader);
 
   g_assert_false (shader == NULL);
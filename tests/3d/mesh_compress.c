@@ -0,0 +1,245 @@
+/* CPU tests for the half float, unorm16 and 10_10_10_2 vertex formats of
+ * Gst3DMeshData compression. */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "../../gst-libs/gst/3d/gst3dmeshcompress.h"
+
+/* normalized signed component of a GL_INT_2_10_10_10_REV vector */
+static gfloat
+unpack_snorm10 (guint32 packed, guint component)
+{
+  gint32 v = (packed >> (component * 10)) & 0x3ff;
+  if (v & 0x200)
+    v -= 0x400;
+  return MAX (v / 511.0f, -1.0f);
+}
+
+static void
+test_half_special_values (void)
+{
+  g_assert_cmphex (gst_3d_mesh_compress_half (0.0f), ==, 0x0000);
+  g_assert_cmphex (gst_3d_mesh_compress_half (-0.0f), ==, 0x8000);
+  g_assert_cmphex (gst_3d_mesh_compress_half (1.0f), ==, 0x3c00);
+  g_assert_cmphex (gst_3d_mesh_compress_half (-1.0f), ==, 0xbc00);
+
+  /* largest half, and the first value rounding past it */
+  g_assert_cmphex (gst_3d_mesh_compress_half (65504.0f), ==, 0x7bff);
+  g_assert_cmphex (gst_3d_mesh_compress_half (65520.0f), ==, 0x7c00);
+  g_assert_cmphex (gst_3d_mesh_compress_half (1e6f), ==, 0x7c00);
+  g_assert_cmphex (gst_3d_mesh_compress_half (-1e6f), ==, 0xfc00);
+  g_assert_cmphex (gst_3d_mesh_compress_half (INFINITY), ==, 0x7c00);
+  g_assert_cmphex (gst_3d_mesh_compress_half (-INFINITY), ==, 0xfc00);
+  guint16 nan = gst_3d_mesh_compress_half (NAN);
+  g_assert_cmphex (nan & 0x7c00, ==, 0x7c00);
+  g_assert_cmphex (nan & 0x03ff, !=, 0);
+
+  /* subnormal halves, ties round to even */
+  g_assert_cmphex (gst_3d_mesh_compress_half (ldexpf (1.0f, -14)), ==,
+      0x0400);
+  g_assert_cmphex (gst_3d_mesh_compress_half (ldexpf (1023.0f, -24)), ==,
+      0x03ff);
+  g_assert_cmphex (gst_3d_mesh_compress_half (ldexpf (1.0f, -24)), ==,
+      0x0001);
+  g_assert_cmphex (gst_3d_mesh_compress_half (ldexpf (1.0f, -25)), ==,
+      0x0000);
+  g_assert_cmphex (gst_3d_mesh_compress_half (ldexpf (3.0f, -26)), ==,
+      0x0001);
+  g_assert_cmphex (gst_3d_mesh_compress_half (ldexpf (3.0f, -25)), ==,
+      0x0002);
+  g_assert_cmphex (gst_3d_mesh_compress_half (-ldexpf (1.0f, -24)), ==,
+      0x8001);
+
+  /* float denormals are far below the smallest half */
+  g_assert_cmphex (gst_3d_mesh_compress_half (1e-40f), ==, 0x0000);
+  g_assert_cmphex (gst_3d_mesh_compress_half (-1e-40f), ==, 0x8000);
+
+  g_assert_cmpfloat (gst_3d_mesh_compress_half_to_float (0x7c00), ==,
+      INFINITY);
+  g_assert (isnan (gst_3d_mesh_compress_half_to_float (0x7e00)));
+}
+
+static void
+test_half_round_trip (void)
+{
+  /* every finite half survives the trip through float exactly */
+  for (guint h = 0; h <= G_MAXUINT16; h++) {
+    if ((h & 0x7c00) == 0x7c00)
+      continue;
+    gfloat f = gst_3d_mesh_compress_half_to_float (h);
+    g_assert_cmphex (gst_3d_mesh_compress_half (f), ==, h);
+  }
+
+  /* normal halves keep 11 significant bits, rounding to nearest halves
+   * the error of the last one */
+  for (gint i = -100000; i <= 100000; i++) {
+    gfloat f = i * 0.01f;
+    if (fabsf (f) < ldexpf (1.0f, -14))
+      continue;
+    gfloat back =
+        gst_3d_mesh_compress_half_to_float (gst_3d_mesh_compress_half (f));
+    g_assert_cmpfloat (fabsf (back - f), <=, fabsf (f) * ldexpf (1.0f, -11));
+  }
+}
+
+static void
+test_normal_special_values (void)
+{
+  const gfloat x[] = { 1.0f, 0.0f, 0.0f };
+  const gfloat minus_x[] = { -1.0f, 0.0f, 0.0f };
+  const gfloat out_of_range[] = { 2.0f, -2.0f, 0.0f };
+
+  guint32 packed = gst_3d_mesh_compress_normal (x);
+  g_assert_cmphex (packed & 0x3ff, ==, 511);
+  g_assert_cmpfloat (unpack_snorm10 (packed, 0), ==, 1.0f);
+  g_assert_cmpfloat (unpack_snorm10 (packed, 1), ==, 0.0f);
+  g_assert_cmpfloat (unpack_snorm10 (packed, 2), ==, 0.0f);
+  g_assert_cmphex (packed >> 30, ==, 0);
+
+  packed = gst_3d_mesh_compress_normal (minus_x);
+  g_assert_cmpfloat (unpack_snorm10 (packed, 0), ==, -1.0f);
+
+  /* clamped to [-1, 1] instead of wrapping into the neighbour bits */
+  packed = gst_3d_mesh_compress_normal (out_of_range);
+  g_assert_cmpfloat (unpack_snorm10 (packed, 0), ==, 1.0f);
+  g_assert_cmpfloat (unpack_snorm10 (packed, 1), ==, -1.0f);
+  g_assert_cmpfloat (unpack_snorm10 (packed, 2), ==, 0.0f);
+  g_assert_cmphex (packed >> 30, ==, 0);
+}
+
+static void
+test_normal_round_trip (void)
+{
+  GRand *rand = g_rand_new_with_seed (42);
+
+  for (guint i = 0; i < 10000; i++) {
+    gfloat n[3];
+    for (guint c = 0; c < 3; c++)
+      n[c] = g_rand_double_range (rand, -1.0, 1.0);
+    gfloat length = sqrtf (n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length < 1e-3f)
+      continue;
+    for (guint c = 0; c < 3; c++)
+      n[c] /= length;
+
+    guint32 packed = gst_3d_mesh_compress_normal (n);
+    for (guint c = 0; c < 3; c++)
+      g_assert_cmpfloat (fabsf (unpack_snorm10 (packed, c) - n[c]), <=,
+          0.5f / 511.0f + 1e-6f);
+  }
+
+  g_rand_free (rand);
+}
+
+static void
+test_uv (void)
+{
+  const gfloat uvs[] = { 0.0f, 1.0f, 0.5f, 0.25f, 1e-6f, 0.999999f };
+  struct Gst3DMeshDataAttribute format;
+
+  guint16 *packed = gst_3d_mesh_compress_attribute ("uv",
+      (const guint8 *) uvs, 2 * sizeof (gfloat), 3, 2,
+      GST_3D_MESH_COMPRESS_UV, &format);
+  g_assert (packed != NULL);
+  g_assert_cmpuint (format.type, ==, GST_3D_MESH_DATA_UNSIGNED_SHORT);
+  g_assert_cmpuint (format.vector_length, ==, 2);
+  g_assert_cmpuint (format.element_size, ==, sizeof (guint16));
+  g_assert (format.normalized);
+
+  g_assert_cmpuint (packed[0], ==, 0);
+  g_assert_cmpuint (packed[1], ==, G_MAXUINT16);
+  for (guint i = 0; i < G_N_ELEMENTS (uvs); i++)
+    g_assert_cmpfloat (fabsf (packed[i] / (gfloat) G_MAXUINT16 - uvs[i]), <=,
+        0.5f / G_MAXUINT16);
+  g_free (packed);
+
+  /* values outside of [0, 1] stay floats */
+  const gfloat wrapped[] = { 0.0f, 1.5f };
+  g_assert (gst_3d_mesh_compress_attribute ("uv", (const guint8 *) wrapped,
+          2 * sizeof (gfloat), 1, 2, GST_3D_MESH_COMPRESS_UV,
+          &format) == NULL);
+}
+
+static void
+test_vertex_format (void)
+{
+  Gst3DMeshData *data = gst_3d_mesh_data_new ();
+  gint position = gst_3d_mesh_data_add_attribute (data, "position", 3);
+  gint uv = gst_3d_mesh_data_add_attribute (data, "uv", 2);
+  gint normal = gst_3d_mesh_data_add_attribute (data, "normal", 3);
+  gst_3d_mesh_data_alloc (data, 2, 0);
+
+  for (guint v = 0; v < 2; v++) {
+    gfloat *p = gst_3d_mesh_data_get_attribute (data, position, v);
+    gfloat *t = gst_3d_mesh_data_get_attribute (data, uv, v);
+    gfloat *n = gst_3d_mesh_data_get_attribute (data, normal, v);
+    p[0] = v;
+    p[1] = -2.0f * v;
+    p[2] = 0.5f;
+    t[0] = t[1] = v * 0.5f;
+    n[0] = n[1] = 0.0f;
+    n[2] = v ? 1.0f : -1.0f;
+  }
+  g_assert_cmpuint (data->stride, ==, 32);
+
+  g_assert (gst_3d_mesh_data_compress (data, GST_3D_MESH_COMPRESS_ALL));
+  g_assert_cmpuint (data->stride, ==, 16);
+
+  const struct Gst3DMeshDataAttribute *p = &data->attributes[position];
+  g_assert_cmpuint (p->type, ==, GST_3D_MESH_DATA_HALF_FLOAT);
+  g_assert_cmpuint (p->vector_length, ==, 4);
+  g_assert_cmpuint (p->offset, ==, 0);
+
+  const struct Gst3DMeshDataAttribute *t = &data->attributes[uv];
+  g_assert_cmpuint (t->offset, ==, 8);
+
+  /* one packed element of four components */
+  const struct Gst3DMeshDataAttribute *n = &data->attributes[normal];
+  g_assert_cmpuint (n->type, ==, GST_3D_MESH_DATA_INT_2_10_10_10_REV);
+  g_assert_cmpuint (n->vector_length, ==, 4);
+  g_assert_cmpuint (n->element_size, ==, sizeof (guint32));
+  g_assert_cmpuint (gst_3d_mesh_data_attribute_size (n->type,
+          n->vector_length, n->element_size), ==, 4);
+  g_assert (n->normalized);
+  g_assert_cmpuint (n->offset, ==, 12);
+
+  for (guint v = 0; v < 2; v++) {
+    const guint8 *vertex = data->vertices + v * data->stride;
+    guint16 half[4];
+    guint32 packed;
+    memcpy (half, vertex + p->offset, sizeof (half));
+    memcpy (&packed, vertex + n->offset, sizeof (packed));
+
+    g_assert_cmpfloat (gst_3d_mesh_compress_half_to_float (half[1]), ==,
+        -2.0f * v);
+    g_assert_cmpfloat (gst_3d_mesh_compress_half_to_float (half[3]), ==,
+        1.0f);
+    g_assert_cmpfloat (unpack_snorm10 (packed, 2), ==, v ? 1.0f : -1.0f);
+  }
+
+  /* packed attributes are not packed again */
+  g_assert (!gst_3d_mesh_data_compress (data, GST_3D_MESH_COMPRESS_ALL));
+
+  gst_3d_mesh_data_free (data);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/gst3d/mesh_compress/half_special_values",
+      test_half_special_values);
+  g_test_add_func ("/gst3d/mesh_compress/half_round_trip",
+      test_half_round_trip);
+  g_test_add_func ("/gst3d/mesh_compress/normal_special_values",
+      test_normal_special_values);
+  g_test_add_func ("/gst3d/mesh_compress/normal_round_trip",
+      test_normal_round_trip);
+  g_test_add_func ("/gst3d/mesh_compress/uv", test_uv);
+  g_test_add_func ("/gst3d/mesh_compress/vertex_format", test_vertex_format);
+
+  return g_test_run ();
+}
@@ -0,0 +1,307 @@
+/* CPU tests for writing, mapping and validating Gst3DMeshFile caches. */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "../../gst-libs/gst/3d/gst3dmeshfile.h"
+#include "../../gst-libs/gst/3d/gst3dgeometry.h"
+
+/* GL_TRIANGLE_STRIP */
+#define STRIP_MODE 0x0005
+
+static gchar *tmp_dir;
+
+/* Strip of @quads quads, cut in two by a restart index. */
+static Gst3DMeshData *
+create_strip (guint quads)
+{
+  Gst3DMeshData *data = gst_3d_mesh_data_new ();
+  gint position = gst_3d_mesh_data_add_attribute (data, "position", 3);
+  gint uv = gst_3d_mesh_data_add_attribute (data, "uv", 2);
+  guint count = (quads + 1) * 2;
+  gst_3d_mesh_data_alloc (data, count, count + 1);
+  data->draw_mode = STRIP_MODE;
+
+  for (guint v = 0; v < count; v++) {
+    gfloat *p = gst_3d_mesh_data_get_attribute (data, position, v);
+    gfloat *t = gst_3d_mesh_data_get_attribute (data, uv, v);
+    p[0] = v / 2;
+    p[1] = v % 2;
+    p[2] = -0.5f * v;
+    t[0] = v / (gfloat) count;
+    t[1] = v % 2;
+  }
+
+  guint half = count / 2;
+  guint i = 0;
+  for (guint v = 0; v < half; v++)
+    data->indices[i++] = v;
+  data->indices[i++] = GST_3D_GEOMETRY_RESTART_INDEX;
+  for (guint v = half; v < count; v++)
+    data->indices[i++] = v;
+
+  return data;
+}
+
+static gchar *
+save_meshes (const gchar * name, Gst3DMeshData ** meshes, GPtrArray ** lods,
+    guint n_meshes)
+{
+  GError *error = NULL;
+  gchar *path = g_build_filename (tmp_dir, name, NULL);
+  g_assert (gst_3d_mesh_file_save (path, NULL, meshes, lods, n_meshes,
+          &error));
+  g_assert_no_error (error);
+  return path;
+}
+
+static void
+assert_entry_matches (Gst3DMeshFile * file, guint index,
+    const Gst3DMeshData * mesh, guint lod)
+{
+  const Gst3DMeshFileEntry *entry = gst_3d_mesh_file_get_entry (file, index);
+
+  g_assert_cmpuint (entry->lod, ==, lod);
+  g_assert_cmpuint (entry->vertex_count, ==, mesh->vertex_count);
+  g_assert_cmpuint (entry->index_count, ==, mesh->index_count);
+  g_assert_cmpuint (entry->stride, ==, mesh->stride);
+  g_assert_cmpuint (entry->draw_mode, ==, mesh->draw_mode);
+  g_assert_cmpuint (entry->n_attributes, ==, mesh->n_attributes);
+
+  for (guint j = 0; j < mesh->n_attributes; j++) {
+    g_assert_cmpstr (entry->attributes[j].name, ==, mesh->attributes[j].name);
+    g_assert_cmpuint (entry->attributes[j].vector_length, ==,
+        mesh->attributes[j].vector_length);
+    g_assert_cmpuint (entry->attributes[j].offset, ==,
+        mesh->attributes[j].offset);
+    g_assert_cmpuint (entry->attributes[j].type, ==,
+        mesh->attributes[j].type);
+  }
+
+  g_assert_cmpuint (entry->vertices_offset % GST_3D_MESH_FILE_ALIGNMENT, ==,
+      0);
+  g_assert_cmpuint (entry->indices_offset % GST_3D_MESH_FILE_ALIGNMENT, ==,
+      0);
+  g_assert (memcmp (gst_3d_mesh_file_get_vertices (file, index),
+          mesh->vertices, mesh->vertex_count * mesh->stride) == 0);
+
+  /* small meshes are stored with 16 bit indices, restarts included */
+  g_assert_cmpuint (entry->index_size, ==, 2);
+  const guint16 *indices = gst_3d_mesh_file_get_indices (file, index);
+  for (guint j = 0; j < mesh->index_count; j++) {
+    if (mesh->indices[j] == GST_3D_GEOMETRY_RESTART_INDEX)
+      g_assert_cmphex (indices[j], ==, G_MAXUINT16);
+    else
+      g_assert_cmpuint (indices[j], ==, mesh->indices[j]);
+  }
+}
+
+static void
+test_round_trip (void)
+{
+  GError *error = NULL;
+  Gst3DMeshData *meshes[] = { create_strip (8), NULL, create_strip (5) };
+  GPtrArray *lods[] = { g_ptr_array_new_with_free_func (
+        (GDestroyNotify) gst_3d_mesh_data_free), NULL, NULL
+  };
+  g_ptr_array_add (lods[0], create_strip (4));
+  g_ptr_array_add (lods[0], create_strip (2));
+
+  gchar *path = save_meshes ("round_trip.g3dm", meshes, lods, 3);
+  Gst3DMeshFile *file = gst_3d_mesh_file_open (path, &error);
+  g_assert_no_error (error);
+  g_assert (file != NULL);
+
+  /* NULL meshes are skipped, levels of detail follow their mesh */
+  g_assert_cmpuint (gst_3d_mesh_file_get_n_meshes (file), ==, 4);
+  assert_entry_matches (file, 0, meshes[0], 0);
+  assert_entry_matches (file, 1, g_ptr_array_index (lods[0], 0), 1);
+  assert_entry_matches (file, 2, g_ptr_array_index (lods[0], 1), 2);
+  assert_entry_matches (file, 3, meshes[2], 0);
+
+  /* all vertices come before all indices, so each uploads in one piece */
+  const Gst3DMeshFileEntry *last = gst_3d_mesh_file_get_entry (file, 3);
+  guint64 vertices_end = last->vertices_offset
+      + (guint64) last->vertex_count * last->stride;
+  for (guint i = 0; i < 4; i++) {
+    const Gst3DMeshFileEntry *entry = gst_3d_mesh_file_get_entry (file, i);
+    g_assert_cmpuint (entry->vertices_offset, <, vertices_end);
+    g_assert_cmpuint (entry->indices_offset, >=, vertices_end);
+  }
+
+  /* no source recorded, and none to compare against */
+  g_assert (!gst_3d_mesh_file_matches_source (file, "/nonexistent/model"));
+  gst_3d_mesh_file_close (file);
+
+  /* the cache knows the size and mtime of its source */
+  gchar *source = g_build_filename (tmp_dir, "model.obj", NULL);
+  g_assert (g_file_set_contents (source, "o model\n", -1, NULL));
+  g_assert (gst_3d_mesh_file_save (path, source, meshes, NULL, 1, &error));
+  file = gst_3d_mesh_file_open (path, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (gst_3d_mesh_file_get_n_meshes (file), ==, 1);
+  g_assert (gst_3d_mesh_file_matches_source (file, source));
+  gst_3d_mesh_file_close (file);
+
+  g_assert (g_file_set_contents (source, "o changed model\n", -1, NULL));
+  file = gst_3d_mesh_file_open (path, &error);
+  g_assert (!gst_3d_mesh_file_matches_source (file, source));
+  gst_3d_mesh_file_close (file);
+
+  g_unlink (source);
+  g_unlink (path);
+  g_free (source);
+  g_free (path);
+  gst_3d_mesh_data_free (meshes[0]);
+  gst_3d_mesh_data_free (meshes[2]);
+  g_ptr_array_unref (lods[0]);
+}
+
+static void
+test_wide_indices (void)
+{
+  GError *error = NULL;
+  Gst3DMeshData *mesh = gst_3d_mesh_data_new ();
+  gst_3d_mesh_data_add_attribute (mesh, "position", 3);
+  gst_3d_mesh_data_alloc (mesh, G_MAXUINT16 + 1, 3);
+  mesh->indices[0] = 0;
+  mesh->indices[1] = 1;
+  mesh->indices[2] = G_MAXUINT16;
+
+  gchar *path = save_meshes ("wide.g3dm", &mesh, NULL, 1);
+  Gst3DMeshFile *file = gst_3d_mesh_file_open (path, &error);
+  g_assert_no_error (error);
+
+  /* G_MAXUINT16 is the 16 bit restart index, so it needs 32 bits */
+  const Gst3DMeshFileEntry *entry = gst_3d_mesh_file_get_entry (file, 0);
+  g_assert_cmpuint (entry->index_size, ==, 4);
+  const guint32 *indices = gst_3d_mesh_file_get_indices (file, 0);
+  g_assert_cmpuint (indices[2], ==, G_MAXUINT16);
+
+  gst_3d_mesh_file_close (file);
+  g_unlink (path);
+  g_free (path);
+  gst_3d_mesh_data_free (mesh);
+}
+
+/* Writes @contents of @length bytes and expects opening it to fail with
+ * @code. */
+static void
+assert_rejected (const gchar * contents, gsize length, gint code)
+{
+  GError *error = NULL;
+  gchar *path = g_build_filename (tmp_dir, "corrupt.g3dm", NULL);
+  g_assert (g_file_set_contents (path, contents, length, NULL));
+
+  Gst3DMeshFile *file = gst_3d_mesh_file_open (path, &error);
+  g_assert (file == NULL);
+  g_assert_error (error, GST_3D_MESH_FILE_ERROR, code);
+
+  g_clear_error (&error);
+  g_unlink (path);
+  g_free (path);
+}
+
+static void
+test_rejected (void)
+{
+  Gst3DMeshData *meshes[] = { create_strip (8), create_strip (3) };
+  GPtrArray *lods[] = { g_ptr_array_new_with_free_func (
+        (GDestroyNotify) gst_3d_mesh_data_free), NULL
+  };
+  g_ptr_array_add (lods[0], create_strip (4));
+
+  gchar *path = save_meshes ("valid.g3dm", meshes, lods, 2);
+  gchar *valid;
+  gsize length;
+  g_assert (g_file_get_contents (path, &valid, &length, NULL));
+  gchar *contents = g_memdup (valid, length);
+  Gst3DMeshFileHeader *header = (Gst3DMeshFileHeader *) contents;
+  Gst3DMeshFileEntry *entries = (Gst3DMeshFileEntry *) (contents
+      + sizeof (Gst3DMeshFileHeader));
+  g_assert_cmpuint (header->n_meshes, ==, 3);
+
+  assert_rejected ("", 0, GST_3D_MESH_FILE_ERROR_INVALID);
+
+  header->magic[0] = 'X';
+  assert_rejected (contents, length, GST_3D_MESH_FILE_ERROR_INVALID);
+  memcpy (contents, valid, length);
+
+  header->version = GST_3D_MESH_FILE_VERSION - 1;
+  assert_rejected (contents, length, GST_3D_MESH_FILE_ERROR_VERSION);
+  memcpy (contents, valid, length);
+
+  /* cut in the header, the entry table and the last index blob */
+  gsize cuts[] = { sizeof (Gst3DMeshFileHeader) - 1,
+    sizeof (Gst3DMeshFileHeader) + sizeof (Gst3DMeshFileEntry),
+    length - 1
+  };
+  for (guint i = 0; i < G_N_ELEMENTS (cuts); i++)
+    assert_rejected (contents, cuts[i], GST_3D_MESH_FILE_ERROR_INVALID);
+
+  header->n_meshes = G_MAXUINT32;
+  assert_rejected (contents, length, GST_3D_MESH_FILE_ERROR_INVALID);
+  memcpy (contents, valid, length);
+
+  entries[1].index_size = 3;
+  assert_rejected (contents, length, GST_3D_MESH_FILE_ERROR_INVALID);
+  memcpy (contents, valid, length);
+
+  entries[2].index_count = G_MAXUINT32;
+  assert_rejected (contents, length, GST_3D_MESH_FILE_ERROR_INVALID);
+  memcpy (contents, valid, length);
+
+  entries[0].vertices_offset += 4;
+  assert_rejected (contents, length, GST_3D_MESH_FILE_ERROR_INVALID);
+  memcpy (contents, valid, length);
+
+  entries[0].attributes[1].offset = entries[0].stride;
+  assert_rejected (contents, length, GST_3D_MESH_FILE_ERROR_INVALID);
+  memcpy (contents, valid, length);
+
+  entries[0].n_attributes = GST_3D_MESH_DATA_MAX_ATTRIBUTES + 1;
+  assert_rejected (contents, length, GST_3D_MESH_FILE_ERROR_INVALID);
+  memcpy (contents, valid, length);
+
+  memset (entries[0].attributes[0].name, 'a',
+      sizeof (entries[0].attributes[0].name));
+  assert_rejected (contents, length, GST_3D_MESH_FILE_ERROR_INVALID);
+  memcpy (contents, valid, length);
+
+  /* a level of detail without a mesh before it, and a skipped level */
+  entries[0].lod = 1;
+  assert_rejected (contents, length, GST_3D_MESH_FILE_ERROR_INVALID);
+  memcpy (contents, valid, length);
+
+  entries[1].lod = 2;
+  assert_rejected (contents, length, GST_3D_MESH_FILE_ERROR_INVALID);
+
+  g_unlink (path);
+  g_free (path);
+  g_free (contents);
+  g_free (valid);
+  gst_3d_mesh_data_free (meshes[0]);
+  gst_3d_mesh_data_free (meshes[1]);
+  g_ptr_array_unref (lods[0]);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  tmp_dir = g_dir_make_tmp ("gst3d-mesh-file-XXXXXX", NULL);
+  g_assert (tmp_dir != NULL);
+
+  g_test_add_func ("/gst3d/mesh_file/round_trip", test_round_trip);
+  g_test_add_func ("/gst3d/mesh_file/wide_indices", test_wide_indices);
+  g_test_add_func ("/gst3d/mesh_file/rejected", test_rejected);
+
+  gint ret = g_test_run ();
+
+  g_rmdir (tmp_dir);
+  g_free (tmp_dir);
+
+  return ret;
+}
@@ -0,0 +1,139 @@
+/* Checks that separate and interleaved vertex layouts of Gst3DMesh draw
+ * the same image and that the bind cache skips the repeated VAO binds,
+ * and compares the time of both layouts for the sphere and cube
+ * generators. */
+
+#include <glib.h>
+
+#include "gl_test.h"
+#include "../../gst-libs/gst/3d/gst3dmesh.h"
+#include "../../gst-libs/gst/3d/gst3dglstate.h"
+
+#define WIDTH 320
+#define HEIGHT 240
+#define DRAW_ITERATIONS 10000
+
+typedef enum
+{
+  GENERATOR_SPHERE,
+  GENERATOR_CUBE,
+} Generator;
+
+struct LayoutRun
+{
+  Generator generator;
+  Gst3DMeshLayout layout;
+  gint64 time_us;
+  guint8 *pixels;
+};
+
+static const gchar *
+generator_name (Generator generator)
+{
+  return generator == GENERATOR_SPHERE ? "sphere" : "cube";
+}
+
+static const gchar *
+layout_name (Gst3DMeshLayout layout)
+{
+  return layout == GST_3D_MESH_LAYOUT_INTERLEAVED ? "interleaved" : "separate";
+}
+
+static void
+draw_layout (GstGLContext * context, gpointer data)
+{
+  struct LayoutRun *run = data;
+  const GstGLFuncs *gl = context->gl_vtable;
+  GError *error = NULL;
+  const gchar *defines[] = { "DEBUG_UV", NULL };
+  guint64 issued_before, avoided_before, issued_after, avoided_after;
+
+  Gst3DShader *shader = gst_3d_shader_new_variant (context, "plane_uv.vert",
+      "texture_uv.frag", defines, &error);
+  g_assert_no_error (error);
+
+  Gst3DMesh *mesh = gst_3d_mesh_new (context);
+  gst_3d_mesh_set_layout (mesh, run->layout);
+  gst_3d_mesh_init_buffers (mesh);
+  if (run->generator == GENERATOR_SPHERE)
+    gst_3d_mesh_upload_sphere (mesh, 0.5, 100, 100);
+  else
+    gst_3d_mesh_upload_cube (mesh);
+  gst_3d_mesh_bind_shader (mesh, shader);
+
+  graphene_matrix_t scale;
+  graphene_matrix_init_scale (&scale, 0.5, 0.5, 0.5);
+  gst_3d_shader_upload_matrix (shader, &scale, "mvp");
+
+  GLTestTarget *target = gl_test_target_new (context, WIDTH, HEIGHT);
+  gl_test_target_bind (target);
+  gl->Finish ();
+
+  gst_3d_gl_state_get_stats (context, &issued_before, &avoided_before);
+
+  gint64 start = g_get_monotonic_time ();
+  gst_3d_gl_state_begin (context);
+  for (int i = 0; i < DRAW_ITERATIONS; i++) {
+    gst_3d_mesh_bind (mesh);
+    gst_3d_mesh_draw (mesh);
+  }
+  gst_3d_gl_state_end (context);
+  gl->Finish ();
+  run->time_us = g_get_monotonic_time () - start;
+
+  /* only the first VAO bind of the scope reaches GL */
+  gst_3d_gl_state_get_stats (context, &issued_after, &avoided_after);
+  g_assert_cmpuint (issued_after - issued_before, ==, 1);
+  g_assert_cmpuint (avoided_after - avoided_before, ==, DRAW_ITERATIONS - 1);
+
+  run->pixels = gl_test_target_read (target);
+
+  gst_3d_gl_state_reset (context);
+  gl_test_target_free (target);
+  gst_object_unref (mesh);
+  gst_object_unref (shader);
+}
+
+static void
+test_mesh_layout (void)
+{
+  struct LayoutRun runs[] = {
+    {GENERATOR_SPHERE, GST_3D_MESH_LAYOUT_SEPARATE, 0, NULL},
+    {GENERATOR_SPHERE, GST_3D_MESH_LAYOUT_INTERLEAVED, 0, NULL},
+    {GENERATOR_CUBE, GST_3D_MESH_LAYOUT_SEPARATE, 0, NULL},
+    {GENERATOR_CUBE, GST_3D_MESH_LAYOUT_INTERLEAVED, 0, NULL},
+  };
+
+  gl_test_init (WIDTH, HEIGHT);
+
+  for (guint i = 0; i < G_N_ELEMENTS (runs); i++) {
+    gl_test_run (draw_layout, &runs[i]);
+    g_print ("%-8s %-12s %d draws: %8.3f ms (%.3f us/draw)\n",
+        generator_name (runs[i].generator), layout_name (runs[i].layout),
+        DRAW_ITERATIONS, runs[i].time_us / 1000.0,
+        (gdouble) runs[i].time_us / DRAW_ITERATIONS);
+  }
+
+  /* the layout only changes where the attributes are read from */
+  for (guint i = 0; i < G_N_ELEMENTS (runs); i += 2) {
+    g_assert_cmpuint (gl_test_count_drawn (runs[i].pixels, WIDTH, HEIGHT),
+        >, 0);
+    g_assert_cmpuint (gl_test_count_differences (runs[i].pixels,
+            runs[i + 1].pixels, WIDTH, HEIGHT), ==, 0);
+  }
+
+  for (guint i = 0; i < G_N_ELEMENTS (runs); i++)
+    g_free (runs[i].pixels);
+
+  gl_test_deinit ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/gst3d/mesh_layout", test_mesh_layout);
+
+  return g_test_run ();
+}
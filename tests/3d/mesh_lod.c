@@ -0,0 +1,116 @@
+/* Checks that gst_3d_mesh_select_lod picks the level of detail matching
+ * the projected size of the mesh for a given MVP. */
+
+#include <glib.h>
+#include <math.h>
+
+#include "gl_test.h"
+#include "../../gst-libs/gst/3d/gst3dmesh.h"
+
+#define WIDTH 320
+#define HEIGHT 240
+#define LEVELS 3
+
+/* Looks at the origin from @distance along +z with a vertical field of
+ * view of 90 degrees, which projects a sphere of radius 1 to a screen
+ * size of 1 / @distance. */
+static void
+init_mvp (graphene_matrix_t * mvp, gfloat distance, gfloat scale)
+{
+  graphene_matrix_t model, view, projection, model_view;
+  graphene_point3d_t eye;
+
+  graphene_matrix_init_scale (&model, scale, scale, scale);
+  graphene_matrix_init_translate (&view,
+      graphene_point3d_init (&eye, 0.f, 0.f, -distance));
+  graphene_matrix_init_perspective (&projection, 90.f, 1.f, 0.1f, 1000.f);
+
+  graphene_matrix_multiply (&model, &view, &model_view);
+  graphene_matrix_multiply (&model_view, &projection, mvp);
+}
+
+static Gst3DMesh *
+get_level (Gst3DMesh * mesh, guint level)
+{
+  if (level == 0)
+    return mesh;
+  return g_array_index (mesh->lods, struct Gst3DMeshLod, level - 1).mesh;
+}
+
+static void
+check_select_lod (GstGLContext * context, gpointer data)
+{
+  graphene_matrix_t mvp;
+
+  Gst3DMesh *mesh = gst_3d_mesh_new_sphere_lod (context, 1.f, 64, 64,
+      LEVELS);
+  g_assert_cmpuint (mesh->lods->len, ==, LEVELS);
+
+  /* the levels take over below 1/2, 1/4 and 1/8 of the viewport */
+  const struct
+  {
+    gfloat distance;
+    guint level;
+  } cases[] = {
+    {1.5f, 0}, {1.9f, 0}, {2.1f, 1}, {3.f, 1}, {6.f, 2}, {12.f, 3},
+    {500.f, 3},
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (cases); i++) {
+    init_mvp (&mvp, cases[i].distance, 1.f);
+    g_assert_cmpfloat (fabsf (gst_3d_mesh_get_screen_size (mesh, &mvp)
+            - 1.f / cases[i].distance), <, 1e-4f);
+    g_assert (gst_3d_mesh_select_lod (mesh, &mvp) == get_level (mesh,
+            cases[i].level));
+  }
+
+  /* the model scale of the MVP counts, not only the distance */
+  init_mvp (&mvp, 6.f, 4.f);
+  g_assert (gst_3d_mesh_select_lod (mesh, &mvp) == mesh);
+  init_mvp (&mvp, 3.f, 0.25f);
+  g_assert (gst_3d_mesh_select_lod (mesh, &mvp) == get_level (mesh, 3));
+
+  /* behind the camera nothing is known, so the full mesh is kept */
+  init_mvp (&mvp, -12.f, 1.f);
+  g_assert (gst_3d_mesh_select_lod (mesh, &mvp) == mesh);
+
+  /* levels are ordered by their size, not by the order they were added */
+  Gst3DMesh *sphere = gst_3d_mesh_new_sphere (context, 1.f, 64, 64);
+  Gst3DMesh *coarse = gst_3d_mesh_new_sphere (context, 1.f, 8, 8);
+  Gst3DMesh *medium = gst_3d_mesh_new_sphere (context, 1.f, 16, 16);
+  gst_3d_mesh_add_lod (sphere, coarse, 0.1f);
+  gst_3d_mesh_add_lod (sphere, medium, 0.4f);
+
+  init_mvp (&mvp, 2.f, 1.f);
+  g_assert (gst_3d_mesh_select_lod (sphere, &mvp) == sphere);
+  init_mvp (&mvp, 5.f, 1.f);
+  g_assert (gst_3d_mesh_select_lod (sphere, &mvp) == medium);
+  init_mvp (&mvp, 20.f, 1.f);
+  g_assert (gst_3d_mesh_select_lod (sphere, &mvp) == coarse);
+
+  /* without levels the mesh is its own level at any size */
+  Gst3DMesh *plain = gst_3d_mesh_new_sphere (context, 1.f, 8, 8);
+  g_assert (gst_3d_mesh_select_lod (plain, &mvp) == plain);
+
+  gst_object_unref (plain);
+  gst_object_unref (sphere);
+  gst_object_unref (mesh);
+}
+
+static void
+test_select_lod (void)
+{
+  gl_test_init (WIDTH, HEIGHT);
+  gl_test_run (check_select_lod, NULL);
+  gl_test_deinit ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/gst3d/mesh_lod/select_lod", test_select_lod);
+
+  return g_test_run ();
+}
@@ -0,0 +1,192 @@
+/* CPU tests for the Gst3DMeshData vertex cache, overdraw and vertex
+ * fetch optimization. */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../gst-libs/gst/3d/gst3dmeshoptimize.h"
+
+#define GRID_SIZE 64
+
+/* Grid of GRID_SIZE^2 vertices, triangles shuffled with a fixed seed to
+ * model an unordered import. */
+static Gst3DMeshData *
+create_shuffled_grid (void)
+{
+  Gst3DMeshData *data = gst_3d_mesh_data_new ();
+  gint position = gst_3d_mesh_data_add_attribute (data, "position", 3);
+  guint quads = (GRID_SIZE - 1) * (GRID_SIZE - 1);
+  gst_3d_mesh_data_alloc (data, GRID_SIZE * GRID_SIZE, quads * 6);
+
+  for (guint y = 0; y < GRID_SIZE; y++) {
+    for (guint x = 0; x < GRID_SIZE; x++) {
+      gfloat *p = gst_3d_mesh_data_get_attribute (data, position,
+          y * GRID_SIZE + x);
+      p[0] = x;
+      p[1] = y;
+      p[2] = 0.0f;
+    }
+  }
+
+  guint i = 0;
+  for (guint y = 0; y < GRID_SIZE - 1; y++) {
+    for (guint x = 0; x < GRID_SIZE - 1; x++) {
+      guint32 v = y * GRID_SIZE + x;
+      guint32 quad[] = { v, v + 1, v + GRID_SIZE,
+        v + 1, v + GRID_SIZE + 1, v + GRID_SIZE
+      };
+      memcpy (&data->indices[i], quad, sizeof (quad));
+      i += 6;
+    }
+  }
+
+  GRand *rand = g_rand_new_with_seed (42);
+  guint triangles = data->index_count / 3;
+  for (guint t = triangles - 1; t > 0; t--) {
+    guint j = g_rand_int_range (rand, 0, t + 1);
+    guint32 tmp[3];
+    memcpy (tmp, &data->indices[t * 3], sizeof (tmp));
+    memcpy (&data->indices[t * 3], &data->indices[j * 3], sizeof (tmp));
+    memcpy (&data->indices[j * 3], tmp, sizeof (tmp));
+  }
+  g_rand_free (rand);
+
+  return data;
+}
+
+static gint
+compare_triangles (gconstpointer a, gconstpointer b)
+{
+  return memcmp (a, b, 3 * sizeof (guint32));
+}
+
+/* Rotates each triangle so its smallest index comes first, keeping the
+ * winding, then sorts the triangle list. */
+static guint32 *
+canonical_triangles (Gst3DMeshData * data, gboolean resolve_positions)
+{
+  guint32 *triangles = g_new (guint32, data->index_count);
+
+  for (guint t = 0; t < data->index_count / 3; t++) {
+    guint32 tri[3];
+    for (guint c = 0; c < 3; c++) {
+      guint32 v = data->indices[t * 3 + c];
+      if (resolve_positions) {
+        gfloat *p = gst_3d_mesh_data_get_attribute (data, 0, v);
+        v = (guint32) p[1] * GRID_SIZE + (guint32) p[0];
+      }
+      tri[c] = v;
+    }
+    guint first = 0;
+    for (guint c = 1; c < 3; c++)
+      if (tri[c] < tri[first])
+        first = c;
+    for (guint c = 0; c < 3; c++)
+      triangles[t * 3 + c] = tri[(first + c) % 3];
+  }
+
+  qsort (triangles, data->index_count / 3, 3 * sizeof (guint32),
+      compare_triangles);
+
+  return triangles;
+}
+
+static void
+test_acmr (void)
+{
+  /* two triangles sharing an edge: 4 misses for 2 triangles */
+  guint32 indices[] = { 0, 1, 2, 1, 3, 2 };
+  g_assert_cmpfloat (gst_3d_mesh_optimize_acmr (indices, 6, 4, 16), ==, 2.0f);
+  g_assert_cmpfloat (gst_3d_mesh_optimize_atvr (indices, 6, 4, 16), ==, 1.0f);
+
+  /* a cache of 2 evicts vertex 0 before it is reused */
+  guint32 evict[] = { 0, 1, 2, 0, 1, 2 };
+  g_assert_cmpfloat (gst_3d_mesh_optimize_acmr (evict, 6, 3, 2), ==, 3.0f);
+}
+
+static void
+test_optimize_improves_acmr (void)
+{
+  Gst3DMeshData *data = create_shuffled_grid ();
+  Gst3DMeshOptimizeStats stats;
+
+  g_assert (gst_3d_mesh_data_optimize (data, GST_3D_MESH_OPTIMIZE_CACHE_SIZE,
+          &stats));
+  g_assert_cmpfloat (stats.acmr_after, <, stats.acmr_before * 0.5f);
+  g_assert_cmpfloat (stats.acmr_after, <, 0.8f);
+
+  gst_3d_mesh_data_free (data);
+}
+
+static void
+test_optimize_preserves_triangles (void)
+{
+  Gst3DMeshData *data = create_shuffled_grid ();
+  guint32 *before = canonical_triangles (data, FALSE);
+
+  gst_3d_mesh_data_optimize (data, GST_3D_MESH_OPTIMIZE_CACHE_SIZE, NULL);
+
+  guint32 *after = canonical_triangles (data, TRUE);
+  g_assert_cmpmem (before, data->index_count * sizeof (guint32), after,
+      data->index_count * sizeof (guint32));
+
+  g_free (before);
+  g_free (after);
+  gst_3d_mesh_data_free (data);
+}
+
+static void
+test_optimize_deterministic (void)
+{
+  Gst3DMeshData *a = create_shuffled_grid ();
+  Gst3DMeshData *b = create_shuffled_grid ();
+
+  gst_3d_mesh_data_optimize (a, GST_3D_MESH_OPTIMIZE_CACHE_SIZE, NULL);
+  gst_3d_mesh_data_optimize (b, GST_3D_MESH_OPTIMIZE_CACHE_SIZE, NULL);
+
+  g_assert_cmpmem (a->indices, a->index_count * sizeof (guint32),
+      b->indices, b->index_count * sizeof (guint32));
+  g_assert_cmpmem (a->vertices, a->vertex_count * a->stride,
+      b->vertices, b->vertex_count * b->stride);
+
+  gst_3d_mesh_data_free (a);
+  gst_3d_mesh_data_free (b);
+}
+
+static void
+test_vertex_fetch_order (void)
+{
+  Gst3DMeshData *data = create_shuffled_grid ();
+  guint32 next = 0;
+
+  gst_3d_mesh_optimize_vertex_fetch (data);
+
+  /* every new vertex is the next one in memory */
+  for (guint i = 0; i < data->index_count; i++) {
+    g_assert_cmpuint (data->indices[i], <=, next);
+    if (data->indices[i] == next)
+      next++;
+  }
+  g_assert_cmpuint (next, ==, data->vertex_count);
+
+  gst_3d_mesh_data_free (data);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/gst3d/mesh_optimize/acmr", test_acmr);
+  g_test_add_func ("/gst3d/mesh_optimize/improves_acmr",
+      test_optimize_improves_acmr);
+  g_test_add_func ("/gst3d/mesh_optimize/preserves_triangles",
+      test_optimize_preserves_triangles);
+  g_test_add_func ("/gst3d/mesh_optimize/deterministic",
+      test_optimize_deterministic);
+  g_test_add_func ("/gst3d/mesh_optimize/vertex_fetch_order",
+      test_vertex_fetch_order);
+
+  return g_test_run ();
+}
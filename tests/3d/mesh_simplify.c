@@ -0,0 +1,261 @@
+/* CPU tests for the quadric error simplification of Gst3DMeshData and
+ * the level of detail chains built from it. */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "../../gst-libs/gst/3d/gst3dmeshsimplify.h"
+
+#define GRID_SIZE 32
+
+/* GL_TRIANGLE_STRIP */
+#define STRIP_MODE 0x0005
+
+/* Height field of GRID_SIZE^2 vertices facing +z, flat for @amplitude 0. */
+static Gst3DMeshData *
+create_grid (gfloat amplitude)
+{
+  Gst3DMeshData *data = gst_3d_mesh_data_new ();
+  gint position = gst_3d_mesh_data_add_attribute (data, "position", 3);
+  guint quads = (GRID_SIZE - 1) * (GRID_SIZE - 1);
+  gst_3d_mesh_data_alloc (data, GRID_SIZE * GRID_SIZE, quads * 6);
+
+  for (guint y = 0; y < GRID_SIZE; y++) {
+    for (guint x = 0; x < GRID_SIZE; x++) {
+      gfloat *p = gst_3d_mesh_data_get_attribute (data, position,
+          y * GRID_SIZE + x);
+      p[0] = x;
+      p[1] = y;
+      p[2] = amplitude * sinf (x * 0.4f) * cosf (y * 0.3f);
+    }
+  }
+
+  guint i = 0;
+  for (guint y = 0; y < GRID_SIZE - 1; y++) {
+    for (guint x = 0; x < GRID_SIZE - 1; x++) {
+      guint32 v = y * GRID_SIZE + x;
+      guint32 quad[] = { v, v + 1, v + GRID_SIZE,
+        v + 1, v + GRID_SIZE + 1, v + GRID_SIZE
+      };
+      memcpy (&data->indices[i], quad, sizeof (quad));
+      i += 6;
+    }
+  }
+
+  return data;
+}
+
+static const gfloat *
+get_position (Gst3DMeshData * data, guint32 vertex)
+{
+  gint position = gst_3d_mesh_data_find_attribute (data, "position");
+  return gst_3d_mesh_data_get_attribute (data, position, vertex);
+}
+
+/* z component of the unnormalized face normal, twice the signed area of
+ * the triangle projected onto the grid plane */
+static gfloat
+triangle_normal_z (Gst3DMeshData * data, const guint32 * tri)
+{
+  const gfloat *a = get_position (data, tri[0]);
+  const gfloat *b = get_position (data, tri[1]);
+  const gfloat *c = get_position (data, tri[2]);
+  return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+static void
+assert_indices_valid (const Gst3DMeshData * data)
+{
+  g_assert_cmpuint (data->index_count % 3, ==, 0);
+  for (guint i = 0; i < data->index_count; i++)
+    g_assert_cmpuint (data->indices[i], <, data->vertex_count);
+}
+
+static void
+test_target_count (void)
+{
+  Gst3DMeshData *grid = create_grid (1.0f);
+  guint target = grid->index_count / 4 / 3 * 3;
+  gfloat error = -1.0f;
+
+  Gst3DMeshData *result = gst_3d_mesh_data_simplify (grid, target, 1.0f,
+      &error);
+  g_assert (result != NULL);
+  assert_indices_valid (result);
+
+  /* a collapse removes up to two triangles, so it may undershoot by one */
+  g_assert_cmpuint (result->index_count, <=, target);
+  g_assert_cmpuint (result->index_count + 3, >=, target);
+  g_assert_cmpfloat (error, >, 0.0f);
+  g_assert_cmpfloat (error, <=, 1.0f);
+
+  /* unused vertices are dropped */
+  g_assert_cmpuint (result->vertex_count, <, grid->vertex_count);
+  g_assert_cmpuint (result->stride, ==, grid->stride);
+
+  gst_3d_mesh_data_free (result);
+  gst_3d_mesh_data_free (grid);
+}
+
+static void
+test_target_error (void)
+{
+  Gst3DMeshData *grid = create_grid (1.0f);
+  const gfloat target_errors[] = { 0.001f, 0.01f, 0.05f };
+  guint previous = grid->index_count + 1;
+
+  /* asking for nothing stops at the error bound instead */
+  for (guint i = 0; i < G_N_ELEMENTS (target_errors); i++) {
+    gfloat error = -1.0f;
+    Gst3DMeshData *result = gst_3d_mesh_data_simplify (grid, 0,
+        target_errors[i], &error);
+    assert_indices_valid (result);
+    g_assert_cmpuint (result->index_count, >, 0);
+    g_assert_cmpuint (result->index_count, <, previous);
+    g_assert_cmpfloat (error, >=, 0.0f);
+    g_assert_cmpfloat (error, <=, target_errors[i]);
+    previous = result->index_count;
+    gst_3d_mesh_data_free (result);
+  }
+
+  gst_3d_mesh_data_free (grid);
+}
+
+static gboolean
+on_grid_border (const gfloat * a, const gfloat * b)
+{
+  const gfloat last = GRID_SIZE - 1;
+  return (a[0] == 0.0f && b[0] == 0.0f) || (a[0] == last && b[0] == last)
+      || (a[1] == 0.0f && b[1] == 0.0f) || (a[1] == last && b[1] == last);
+}
+
+static void
+test_borders (void)
+{
+  Gst3DMeshData *grid = create_grid (0.0f);
+  const gfloat last = GRID_SIZE - 1;
+
+  Gst3DMeshData *result = gst_3d_mesh_data_simplify (grid, 0, 0.001f, NULL);
+  assert_indices_valid (result);
+
+  /* a flat grid collapses to a handful of triangles */
+  g_assert_cmpuint (result->index_count, <, grid->index_count / 10);
+
+  /* the corners stay, and so does the outline: every open edge of the
+   * result lies on the border of the grid and the area does not change */
+  guint corners = 0;
+  for (guint v = 0; v < result->vertex_count; v++) {
+    const gfloat *p = get_position (result, v);
+    g_assert_cmpfloat (p[2], ==, 0.0f);
+    if ((p[0] == 0.0f || p[0] == last) && (p[1] == 0.0f || p[1] == last))
+      corners++;
+  }
+  g_assert_cmpuint (corners, ==, 4);
+
+  gdouble area = 0;
+  for (guint t = 0; t < result->index_count / 3; t++) {
+    const guint32 *tri = &result->indices[t * 3];
+    area += triangle_normal_z (result, tri) * 0.5;
+
+    for (guint c = 0; c < 3; c++) {
+      guint32 a = tri[c], b = tri[(c + 1) % 3];
+      gboolean shared = FALSE;
+      for (guint i = 0; i < result->index_count / 3 && !shared; i++) {
+        const guint32 *other = &result->indices[i * 3];
+        for (guint j = 0; j < 3; j++)
+          shared |= other[j] == b && other[(j + 1) % 3] == a;
+      }
+      if (!shared)
+        g_assert (on_grid_border (get_position (result, a),
+                get_position (result, b)));
+    }
+  }
+  g_assert_cmpfloat (fabs (area - last * last), <, 1e-3);
+
+  gst_3d_mesh_data_free (result);
+  gst_3d_mesh_data_free (grid);
+}
+
+static void
+test_no_flips (void)
+{
+  /* every collapse in a plane costs nothing, so only the flip test keeps
+   * the order of the collapses from folding triangles over */
+  Gst3DMeshData *grid = create_grid (0.0f);
+  guint target = grid->index_count / 10 / 3 * 3;
+
+  Gst3DMeshData *result = gst_3d_mesh_data_simplify (grid, target, 1.0f,
+      NULL);
+  assert_indices_valid (result);
+  g_assert_cmpuint (result->index_count, <=, target);
+  g_assert_cmpuint (result->index_count + 3, >=, target);
+
+  for (guint t = 0; t < result->index_count / 3; t++)
+    g_assert_cmpfloat (triangle_normal_z (result, &result->indices[t * 3]),
+        >, 0.0f);
+
+  gst_3d_mesh_data_free (result);
+  gst_3d_mesh_data_free (grid);
+}
+
+static void
+test_unsupported (void)
+{
+  Gst3DMeshData *grid = create_grid (1.0f);
+
+  grid->draw_mode = STRIP_MODE;
+  g_assert (gst_3d_mesh_data_simplify (grid, 0, 1.0f, NULL) == NULL);
+
+  GPtrArray *lods = gst_3d_mesh_data_generate_lods (grid,
+      GST_3D_MESH_SIMPLIFY_MAX_LODS, 1.0f);
+  g_assert_cmpuint (lods->len, ==, 0);
+  g_ptr_array_unref (lods);
+
+  gst_3d_mesh_data_free (grid);
+}
+
+static void
+test_lods (void)
+{
+  Gst3DMeshData *grid = create_grid (1.0f);
+
+  GPtrArray *lods = gst_3d_mesh_data_generate_lods (grid,
+      GST_3D_MESH_SIMPLIFY_MAX_LODS, 1.0f);
+  g_assert_cmpuint (lods->len, ==, GST_3D_MESH_SIMPLIFY_MAX_LODS);
+
+  /* each level halves the triangles of the one before */
+  const Gst3DMeshData *previous = grid;
+  for (guint i = 0; i < lods->len; i++) {
+    Gst3DMeshData *lod = g_ptr_array_index (lods, i);
+    assert_indices_valid (lod);
+    g_assert_cmpuint (lod->index_count, <=, previous->index_count / 2);
+    g_assert_cmpuint (lod->index_count + 6, >=, previous->index_count / 2);
+    g_assert_cmpuint (lod->vertex_count, <, previous->vertex_count);
+    previous = lod;
+  }
+  g_ptr_array_unref (lods);
+
+  /* a tight error bound ends the chain early */
+  lods = gst_3d_mesh_data_generate_lods (grid, GST_3D_MESH_SIMPLIFY_MAX_LODS,
+      0.001f);
+  g_assert_cmpuint (lods->len, <, GST_3D_MESH_SIMPLIFY_MAX_LODS);
+  g_ptr_array_unref (lods);
+
+  gst_3d_mesh_data_free (grid);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/gst3d/mesh_simplify/target_count", test_target_count);
+  g_test_add_func ("/gst3d/mesh_simplify/target_error", test_target_error);
+  g_test_add_func ("/gst3d/mesh_simplify/borders", test_borders);
+  g_test_add_func ("/gst3d/mesh_simplify/no_flips", test_no_flips);
+  g_test_add_func ("/gst3d/mesh_simplify/unsupported", test_unsupported);
+  g_test_add_func ("/gst3d/mesh_simplify/lods", test_lods);
+
+  return g_test_run ();
+}
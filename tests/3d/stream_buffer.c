@@ -0,0 +1,180 @@
+/* Checks that every mode of Gst3DStreamBuffer keeps the data of earlier
+ * frames intact while later frames are written, across ring wrap around
+ * and segment growth. */
+
+#include <glib.h>
+#include <string.h>
+
+#include "gl_test.h"
+#include "../../gst-libs/gst/3d/gst3dstreambuffer.h"
+
+#define WIDTH 64
+#define HEIGHT 64
+#define FRAMES (GST_3D_STREAM_BUFFER_SEGMENTS * 3)
+#define SIZE 1000
+#define GROWN_SIZE 10000
+
+/* segment sizes SIZE and GROWN_SIZE are rounded up to */
+#define INITIAL_SEGMENT_SIZE 4096
+#define GROWN_SEGMENT_SIZE 16384
+
+struct StreamRun
+{
+  Gst3DStreamBufferMode mode;
+  gboolean supported;
+};
+
+struct Frame
+{
+  gsize size;
+  gsize offset;
+  GLuint copy;
+};
+
+static const gchar *
+mode_name (Gst3DStreamBufferMode mode)
+{
+  switch (mode) {
+    case GST_3D_STREAM_BUFFER_MODE_PERSISTENT:
+      return "persistent";
+    case GST_3D_STREAM_BUFFER_MODE_MAP_RANGE:
+      return "map range";
+    case GST_3D_STREAM_BUFFER_MODE_ORPHAN:
+      return "orphan";
+  }
+  return NULL;
+}
+
+static void
+fill_frame (guint8 * data, gsize size, guint frame)
+{
+  for (gsize i = 0; i < size; i++)
+    data[i] = (i * 7 + frame * 31) & 0xff;
+}
+
+/* Writes frame @index and queues a GPU copy of what the buffer holds for
+ * it, like a draw reading the segment would. */
+static void
+write_frame (GstGLContext * context, Gst3DStreamBuffer * stream,
+    struct Frame *frame, guint index)
+{
+  const GstGLFuncs *gl = context->gl_vtable;
+
+  guint8 *data = gst_3d_stream_buffer_map (stream, frame->size,
+      &frame->offset);
+  g_assert (data != NULL);
+  fill_frame (data, frame->size, index);
+  gst_3d_stream_buffer_unmap (stream);
+
+  gl->GenBuffers (1, &frame->copy);
+  gl->BindBuffer (GL_COPY_WRITE_BUFFER, frame->copy);
+  gl->BufferData (GL_COPY_WRITE_BUFFER, frame->size, NULL, GL_STREAM_READ);
+  gl->BindBuffer (GL_COPY_READ_BUFFER, gst_3d_stream_buffer_get_id (stream));
+  gl->CopyBufferSubData (GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+      frame->offset, 0, frame->size);
+}
+
+static void
+check_frame (GstGLContext * context, struct Frame *frame, guint index)
+{
+  const GstGLFuncs *gl = context->gl_vtable;
+  guint8 *expected = g_malloc (frame->size);
+  fill_frame (expected, frame->size, index);
+
+  gl->BindBuffer (GL_COPY_READ_BUFFER, frame->copy);
+  const guint8 *copied = gl->MapBufferRange (GL_COPY_READ_BUFFER, 0,
+      frame->size, GL_MAP_READ_BIT);
+  g_assert (copied != NULL);
+  g_assert_cmpmem (copied, frame->size, expected, frame->size);
+  gl->UnmapBuffer (GL_COPY_READ_BUFFER);
+
+  gl->DeleteBuffers (1, &frame->copy);
+  g_free (expected);
+}
+
+static void
+run_mode (GstGLContext * context, gpointer data)
+{
+  struct StreamRun *run = data;
+  const GstGLFuncs *gl = context->gl_vtable;
+  struct Frame frames[FRAMES * 2];
+  guint n_frames = 0;
+
+  Gst3DStreamBuffer *stream = gst_3d_stream_buffer_new_with_mode (context,
+      GL_ARRAY_BUFFER, SIZE, run->mode);
+  run->supported = stream != NULL;
+  if (!stream)
+    return;
+  g_assert_cmpint (gst_3d_stream_buffer_get_mode (stream), ==, run->mode);
+  gboolean ring = run->mode != GST_3D_STREAM_BUFFER_MODE_ORPHAN;
+
+  /* each frame goes to the next segment, wrapping around the ring while
+   * the copies of the frames before are still queued */
+  for (guint f = 0; f < FRAMES; f++, n_frames++) {
+    frames[n_frames].size = SIZE;
+    write_frame (context, stream, &frames[n_frames], n_frames);
+    g_assert_cmpuint (frames[n_frames].offset, ==, ring ?
+        (f % GST_3D_STREAM_BUFFER_SEGMENTS) * INITIAL_SEGMENT_SIZE : 0);
+  }
+
+  /* a larger frame replaces the storage and starts the ring over */
+  for (guint f = 0; f < FRAMES; f++, n_frames++) {
+    frames[n_frames].size = f % 2 ? SIZE : GROWN_SIZE;
+    write_frame (context, stream, &frames[n_frames], n_frames);
+    g_assert_cmpuint (frames[n_frames].offset, ==, ring ?
+        (f % GST_3D_STREAM_BUFFER_SEGMENTS) * GROWN_SEGMENT_SIZE : 0);
+  }
+
+  for (guint f = 0; f < n_frames; f++)
+    check_frame (context, &frames[f], f);
+
+  /* nothing is pending after Finish, so the fences are already signaled
+   * and mapping never waits */
+  guint stalls = gst_3d_stream_buffer_get_stalls (stream);
+  for (guint f = 0; f < FRAMES; f++) {
+    struct Frame frame = { SIZE, 0, 0 };
+    gl->Finish ();
+    write_frame (context, stream, &frame, f);
+    check_frame (context, &frame, f);
+  }
+  g_assert_cmpuint (gst_3d_stream_buffer_get_stalls (stream), ==, stalls);
+
+  g_print ("%-10s %d frames, %u stalls\n", mode_name (run->mode),
+      n_frames + FRAMES, stalls);
+
+  gst_3d_stream_buffer_free (stream);
+}
+
+static void
+test_stream_buffer (void)
+{
+  struct StreamRun runs[] = {
+    {GST_3D_STREAM_BUFFER_MODE_PERSISTENT, FALSE},
+    {GST_3D_STREAM_BUFFER_MODE_MAP_RANGE, FALSE},
+    {GST_3D_STREAM_BUFFER_MODE_ORPHAN, FALSE},
+  };
+
+  gl_test_init (WIDTH, HEIGHT);
+
+  for (guint i = 0; i < G_N_ELEMENTS (runs); i++) {
+    gl_test_run (run_mode, &runs[i]);
+    if (!runs[i].supported)
+      g_print ("%-10s not supported by the context\n",
+          mode_name (runs[i].mode));
+  }
+
+  /* the fallback is always there */
+  g_assert (runs[GST_3D_STREAM_BUFFER_MODE_ORPHAN].supported);
+
+  gl_test_deinit ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/gst3d/stream_buffer/modes", test_stream_buffer);
+
+  return g_test_run ();
+}
@@ -0,0 +1,124 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 Lubosz Sarnecki <lubosz.sarnecki@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:gst3dmeshconvert
+ * @short_description: Preprocesses meshes into the Gst3D mesh cache format
+ *
+ * Imports a model with assimp and writes its triangle meshes, merged into
+ * one with the node transforms applied, to a memory mappable cache file.
+ * By default the file is written next to the source, where
+ * gst_3d_mesh_new_assimp () picks it up instead of importing. The mesh is
+ * optimized for vertex cache, overdraw and vertex fetch unless
+ * --no-optimize is passed, and simplified levels of detail are stored
+ * after it unless --no-lods is passed. --compress packs UVs and normals
+ * into smaller vertex formats, --half-positions also stores positions as
+ * half floats.
+ */
+
+#include <stdio.h>
+
+#include "../gst-libs/gst/3d/gst3dimport.h"
+#include "../gst-libs/gst/3d/gst3dmeshfile.h"
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  gboolean no_optimize = FALSE;
+  gboolean no_lods = FALSE;
+  gboolean compress = FALSE;
+  gboolean half_positions = FALSE;
+
+  GOptionEntry entries[] = {
+    {"no-optimize", 'n', 0, G_OPTION_ARG_NONE, &no_optimize,
+        "Keep the triangle and vertex order of the source", NULL},
+    {"no-lods", 'l', 0, G_OPTION_ARG_NONE, &no_lods,
+        "Do not store simplified levels of detail", NULL},
+    {"compress", 'c', 0, G_OPTION_ARG_NONE, &compress,
+        "Store UVs as unorm16 and normals as packed 10_10_10_2", NULL},
+    {"half-positions", 'p', 0, G_OPTION_ARG_NONE, &half_positions,
+        "Store positions as half floats", NULL},
+    {NULL}
+  };
+
+  GOptionContext *ctx = g_option_context_new ("<model> [output]");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  if (!g_option_context_parse (ctx, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (argc < 2 || argc > 3) {
+    g_printerr ("Usage: %s [--no-optimize] [--no-lods] [--compress] "
+        "[--half-positions] <model> [output]\n", argv[0]);
+    return 1;
+  }
+
+  const gchar *source = argv[1];
+  gchar *output = argc == 3 ? g_strdup (argv[2]) :
+      gst_3d_mesh_file_get_cache_path (source);
+
+  Gst3DImportFlags flags = GST_3D_IMPORT_FLAG_MERGE;
+  if (!no_optimize)
+    flags |= GST_3D_IMPORT_FLAG_OPTIMIZE;
+  if (!no_lods)
+    flags |= GST_3D_IMPORT_FLAG_GENERATE_LODS;
+  if (compress)
+    flags |= GST_3D_IMPORT_FLAG_COMPRESS;
+  if (half_positions)
+    flags |= GST_3D_IMPORT_FLAG_COMPRESS_POSITIONS;
+
+  Gst3DImport *import = gst_3d_import_load (source, flags, &error);
+  if (!import) {
+    g_printerr ("Could not import %s: %s\n", source, error->message);
+    g_clear_error (&error);
+    g_free (output);
+    return 1;
+  }
+
+  Gst3DMeshData *mesh = gst_3d_import_get_mesh (import, 0);
+  GPtrArray *lods = gst_3d_import_get_lods (import, 0);
+
+  g_print ("mesh: %d vertices, %d indices, stride %d\n", mesh->vertex_count,
+      mesh->index_count, (gint) mesh->stride);
+  for (guint i = 0; lods && i < lods->len; i++) {
+    Gst3DMeshData *lod = g_ptr_array_index (lods, i);
+    g_print ("LOD %d: %d vertices, %d indices\n", i + 1, lod->vertex_count,
+        lod->index_count);
+  }
+
+  gboolean ret = gst_3d_mesh_file_save (output, source, &mesh, &lods, 1,
+      &error);
+  if (ret) {
+    g_print ("Wrote %s\n", output);
+  } else {
+    g_printerr ("Could not write %s: %s\n", output, error->message);
+    g_clear_error (&error);
+  }
+
+  g_free (output);
+  gst_3d_import_free (import);
+
+  return ret ? 0 : 1;
+}